@@ -5,6 +5,15 @@
 QT += core
 QT += gui-private
 
+# ZipWriter needs raw deflate: use zlib bundled with Qt if there is one,
+# otherwise the system zlib.
+qtHaveModule(zlib) {
+    QT += zlib-private
+    DEFINES += QXLSX_QT_ZLIB
+} else {
+    LIBS += -lz
+}
+
 # TODO: Define your C++ version. c++14, c++17, etc.
 CONFIG += c++17
 
@@ -115,7 +124,21 @@ $${QXLSX_HEADERPATH}xlsxworkbook_p.h \
 $${QXLSX_HEADERPATH}xlsxworksheet.h \
 $${QXLSX_HEADERPATH}xlsxworksheet_p.h \
 $${QXLSX_HEADERPATH}xlsxzipreader_p.h \
-$${QXLSX_HEADERPATH}xlsxzipwriter_p.h
+$${QXLSX_HEADERPATH}xlsxzipwriter_p.h \
+$${QXLSX_HEADERPATH}xlsxsaveoptions.h \
+$${QXLSX_HEADERPATH}xlsxprogresscontrol_p.h \
+$${QXLSX_HEADERPATH}xlsxtemplate.h \
+$${QXLSX_HEADERPATH}xlsxtemplate_p.h \
+$${QXLSX_HEADERPATH}xlsxcelliterator.h \
+$${QXLSX_HEADERPATH}xlsxcellindex.h \
+$${QXLSX_HEADERPATH}xlsxconditionalformatevaluator.h \
+$${QXLSX_HEADERPATH}xlsxrowfilter.h \
+$${QXLSX_HEADERPATH}xlsxrowfilter_p.h \
+$${QXLSX_HEADERPATH}xlsxformulaparser_p.h \
+$${QXLSX_HEADERPATH}xlsxformulaengine_p.h \
+$${QXLSX_HEADERPATH}xlsxformulacache_p.h \
+$${QXLSX_HEADERPATH}xlsxreferenceindex_p.h \
+$${QXLSX_HEADERPATH}xlsxrangeindex_p.h
 
 SOURCES += \
 $${QXLSX_SOURCEPATH}xlsxheaderfooter.cpp \
@@ -169,7 +192,20 @@ $${QXLSX_SOURCEPATH}xlsxutility.cpp \
 $${QXLSX_SOURCEPATH}xlsxworkbook.cpp \
 $${QXLSX_SOURCEPATH}xlsxworksheet.cpp \
 $${QXLSX_SOURCEPATH}xlsxzipreader.cpp \
-$${QXLSX_SOURCEPATH}xlsxzipwriter.cpp
+$${QXLSX_SOURCEPATH}xlsxzipwriter.cpp \
+$${QXLSX_SOURCEPATH}xlsxsaveoptions.cpp \
+$${QXLSX_SOURCEPATH}xlsxprogresscontrol.cpp \
+$${QXLSX_SOURCEPATH}xlsxtemplate.cpp \
+$${QXLSX_SOURCEPATH}xlsxcelliterator.cpp \
+$${QXLSX_SOURCEPATH}xlsxcellindex.cpp \
+$${QXLSX_SOURCEPATH}xlsxconditionalformatevaluator.cpp \
+$${QXLSX_SOURCEPATH}xlsxrowfilter.cpp \
+$${QXLSX_SOURCEPATH}xlsxformulaparser.cpp \
+$${QXLSX_SOURCEPATH}xlsxformulaengine.cpp \
+$${QXLSX_SOURCEPATH}xlsxformulafunctions.cpp \
+$${QXLSX_SOURCEPATH}xlsxformulacache.cpp \
+$${QXLSX_SOURCEPATH}xlsxreferenceindex.cpp \
+$${QXLSX_SOURCEPATH}xlsxrangeindex.cpp
 
 
 ########################################
@@ -17,6 +17,11 @@ class AbstractOOXmlFilePrivate
 public:
     AbstractOOXmlFilePrivate(AbstractOOXmlFile* q, AbstractOOXmlFile::CreateFlag flag);
     virtual ~AbstractOOXmlFilePrivate();
+    AbstractOOXmlFilePrivate(const AbstractOOXmlFilePrivate &other) = delete;
+    // Copies the file path, flag and relationships, but keeps q_ptr and the own
+    // relationships object, so that the derived private classes can be assigned
+    // member-wise.
+    AbstractOOXmlFilePrivate &operator=(const AbstractOOXmlFilePrivate &other);
 
 public:
     QString filePathInPackage; //such as "xl/worksheets/sheet1.xml"
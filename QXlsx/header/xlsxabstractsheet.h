@@ -242,6 +242,10 @@ To set the sheet VeryHidden use #setVisibility() method.*/
      *
      * This is equivalent to `rename(newName)`.
      *
+     * The references to the sheet in the cell formulas, defined names, data
+     * validations, conditional formattings and chart series of the workbook
+     * are updated to the new name.
+     *
      * @param sheetName new sheet name.
      * @return `true` if renaming was successful.
      *
@@ -1076,6 +1080,12 @@ protected:
      * Returns the new sheet.
      */
     virtual AbstractSheet *copy(const QString &distName, int distId) const = 0;
+    /**
+     * @brief Creates a snapshot of the current sheet in @a workbook: a sheet with
+     * the same name and id that shares the sheet data with this one until
+     * either of them is modified. Returns the new sheet.
+     */
+    virtual AbstractSheet *snapshot(Workbook *workbook) const = 0;
 
     void setType(Type type);
     int id() const;
@@ -25,6 +25,7 @@ class Worksheet;
 class Format;
 class CellFormula;
 class CellPrivate;
+struct CellOwner;
 class WorksheetPrivate;
 
 /**
@@ -37,6 +38,19 @@ class QXLSX_EXPORT Cell
 private:
     friend class Worksheet;
     friend class WorksheetPrivate;
+    friend class CellView;
+    friend class ReferenceIndex;
+    void setParent(Worksheet *parent);
+    const CellOwner *owner() const;
+    //the setters that do not notify the sheet, for the cells that it tracks itself
+    void assignValue(const QVariant &value);
+    void assignFormat(const Format &format);
+    void assignFormula(const CellFormula &formula);
+    void assignRichString(const RichString &richString);
+    void notifyModified();
+    bool toNumber(double &number) const;
+    QString toText() const;
+    void setResult(Type type, const QVariant &value);
 
 public:
     /**
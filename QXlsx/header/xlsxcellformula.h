@@ -78,6 +78,11 @@ public:
      * @return QString object. Text may be empty.
      */
     QString text() const;
+    /**
+     * @brief sets the formula text.
+     * @param text The formula text. The starting = is removed.
+     */
+    void setText(const QString &text);
     /**
      * @brief Returns the reference range of the shared, array or table formulas.
      * For normal formula this will return an invalid CellRange object.
@@ -0,0 +1,150 @@
+// xlsxcellindex.h
+
+#ifndef QXLSX_XLSXCELLINDEX_H
+#define QXLSX_XLSXCELLINDEX_H
+
+#include <QtGlobal>
+#include <QVariant>
+#include <QVector>
+
+#include <memory>
+
+#include "xlsxglobal.h"
+#include "xlsxcellrange.h"
+
+namespace QXlsx {
+
+class Worksheet;
+class CellIndexPrivate;
+
+/**
+ * @brief The CellIndex class is a lookup index of the cell values of a worksheet
+ * range, usually a key column. It is created by Worksheet::buildIndex().
+ *
+ * The index maps cell values to the rows that hold them, so that a lookup costs
+ * O(1) instead of a scan of the range (as VLOOKUP or MATCH with the exact match do).
+ * It also keeps the values sorted for the approximate and range matches.
+ *
+ * Values are compared as in Excel: numbers match numbers (dates are numbers),
+ * strings match strings and booleans match booleans, so the number 1 does not
+ * match the string "1". Blank and error cells are not indexed.
+ *
+ * ```cpp
+ * CellIndex index = reference->buildIndex(CellRange("A2:A500001"));
+ * for (int row = 2; row <= lastRow; ++row) {
+ *     int refRow = index.find(sheet->read(row, 1), CellIndex::MatchMode::CaseInsensitive);
+ *     if (refRow > 0)
+ *         sheet->write(row, 2, reference->read(refRow, 2));
+ * }
+ * ```
+ *
+ * The index tracks the modifications of the sheet cells made through the
+ * Worksheet methods: if the cells of the indexed range were modified since the
+ * index was built, the index is rebuilt on the next lookup. The modifications
+ * of the other cells do not make it stale. You can also call rebuild()
+ * explicitly. The index must not outlive its sheet.
+ *
+ * Copies of the index share the same data. The lookups may run concurrently,
+ * a stale index is then rebuilt once, but the sheet must not be modified at
+ * the same time.
+ */
+class QXLSX_EXPORT CellIndex
+{
+public:
+    /**
+     * @brief The MatchMode enum specifies how strings are compared.
+     */
+    enum class MatchMode {
+        Exact, /**< Strings match if they are equal. */
+        CaseInsensitive /**< Strings match if they are equal ignoring case, as in
+Excel's VLOOKUP and MATCH. */
+    };
+    /**
+     * @brief The ApproximateMatch enum specifies the approximate match type.
+     */
+    enum class ApproximateMatch {
+        LessOrEqual, /**< Finds the largest value that is less than or equal to
+the key, as VLOOKUP with range_lookup = TRUE or MATCH with match_type = 1. */
+        GreaterOrEqual /**< Finds the smallest value that is greater than or
+equal to the key, as MATCH with match_type = -1. */
+    };
+
+    /**
+     * @brief creates an invalid index.
+     */
+    CellIndex();
+    CellIndex(const CellIndex &other);
+    CellIndex &operator=(const CellIndex &other);
+    ~CellIndex();
+
+    /**
+     * @brief returns true if the index was created by Worksheet::buildIndex().
+     */
+    bool isValid() const;
+    /**
+     * @brief returns the indexed range.
+     */
+    CellRange range() const;
+    /**
+     * @brief returns true if the cells of the indexed range were modified since
+     * the index was built.
+     */
+    bool isStale() const;
+    /**
+     * @brief rebuilds the index from the current sheet cells.
+     */
+    void rebuild();
+
+    /**
+     * @brief returns the first row (starting from 1) of the indexed range that
+     * holds @a key or -1 if there's no such row.
+     * @param key a number, string, boolean or date.
+     * @param mode the string comparison mode.
+     */
+    int find(const QVariant &key, MatchMode mode = MatchMode::Exact) const;
+    /**
+     * @brief returns all rows of the indexed range that hold @a key in the
+     * ascending order.
+     * @param key a number, string, boolean or date.
+     * @param mode the string comparison mode.
+     */
+    QVector<int> findAll(const QVariant &key, MatchMode mode = MatchMode::Exact) const;
+    /**
+     * @brief looks up a batch of @a keys.
+     * @param keys the keys to look up.
+     * @param mode the string comparison mode.
+     * @return the list of the same size as @a keys. Each element is the first row
+     * that holds the key or -1.
+     */
+    QVector<int> find(const QVector<QVariant> &keys, MatchMode mode = MatchMode::Exact) const;
+    /**
+     * @brief finds the row with the nearest value to @a key.
+     * @param key a number, string or date. Numbers are compared with numbers, strings
+     * are compared with strings ignoring case.
+     * @param match the approximate match type.
+     * @return the first row that holds the found value or -1 if there's no such value.
+     *
+     * Unlike VLOOKUP, the indexed range does not need to be sorted.
+     */
+    int findApproximate(const QVariant &key, ApproximateMatch match = ApproximateMatch::LessOrEqual) const;
+    /**
+     * @brief returns the rows that hold values between @a low and @a high inclusive,
+     * ordered by value and then by row.
+     * @param low the lower bound, a number, string or date.
+     * @param high the upper bound of the same kind as @a low.
+     *
+     * Strings are compared ignoring case.
+     */
+    QVector<int> findRange(const QVariant &low, const QVariant &high) const;
+
+private:
+    friend class Worksheet;
+    CellIndex(const Worksheet *sheet, const CellRange &range);
+    void ensureCurrent() const;
+
+    std::shared_ptr<CellIndexPrivate> d;
+};
+
+}
+
+#endif // QXLSX_XLSXCELLINDEX_H
@@ -0,0 +1,243 @@
+// xlsxcelliterator.h
+
+#ifndef QXLSX_XLSXCELLITERATOR_H
+#define QXLSX_XLSXCELLITERATOR_H
+
+#include <QtGlobal>
+#include <QMap>
+#include <QString>
+
+#include <memory>
+#include <iterator>
+#include <cstddef>
+
+#include "xlsxglobal.h"
+#include "xlsxcell.h"
+#include "xlsxcellrange.h"
+
+namespace QXlsx {
+
+/**
+ * @brief The IteratorRange class is a pair of iterators that can be used in
+ * the range-based for loop.
+ */
+template <typename Iterator>
+class IteratorRange
+{
+public:
+    IteratorRange(Iterator begin, Iterator end) : m_begin(begin), m_end(end) {}
+    Iterator begin() const { return m_begin; }
+    Iterator end() const { return m_end; }
+    /**
+     * @brief returns true if the range has no elements.
+     */
+    bool isEmpty() const { return m_begin == m_end; }
+private:
+    Iterator m_begin;
+    Iterator m_end;
+};
+
+/**
+ * @brief The CellView class is a lightweight read-only view of a non-empty cell.
+ *
+ * CellView is yielded by the cell iterators (see RowView::cells()). It gives
+ * access to the cell position, type, typed value and style id without creating
+ * a QVariant for each cell.
+ */
+class QXLSX_EXPORT CellView
+{
+public:
+    CellView() {}
+    CellView(int row, int column, const Cell *cell) : m_row(row), m_column(column), m_cell(cell) {}
+
+    /**
+     * @brief returns the cell row (starting from 1).
+     */
+    int row() const { return m_row; }
+    /**
+     * @brief returns the cell column (starting from 1).
+     */
+    int column() const { return m_column; }
+    /**
+     * @brief returns the underlying cell.
+     */
+    const Cell *cell() const { return m_cell; }
+    /**
+     * @brief returns the cell type.
+     */
+    Cell::Type type() const;
+    /**
+     * @brief returns true if the cell holds a number (including a date-time
+     * serial number and a cached numeric formula result).
+     */
+    bool isNumber() const;
+    /**
+     * @brief returns the cell number or NaN if the cell holds no number.
+     */
+    double number() const;
+    /**
+     * @brief returns the cell value as a plain string. Numbers and booleans are
+     * converted to strings, empty cells give a null string.
+     */
+    QString text() const;
+    /**
+     * @brief returns the value of a boolean cell, false for the other cells.
+     */
+    bool boolean() const;
+    /**
+     * @brief returns true if the cell has a formula.
+     */
+    bool hasFormula() const;
+    /**
+     * @brief returns the index of the cell format in the workbook styles
+     * (the `s` attribute of the cell) or 0 if the cell has the default format.
+     */
+    int styleId() const;
+private:
+    int m_row = 0;
+    int m_column = 0;
+    const Cell *m_cell = nullptr;
+};
+
+/**
+ * @brief The CellIterator class is a forward iterator over the non-empty cells
+ * of a row in the storage (column) order.
+ */
+class QXLSX_EXPORT CellIterator
+{
+public:
+    using CellMap = QMap<int, std::shared_ptr<Cell> >;
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = CellView;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = CellView;
+
+    CellIterator() {}
+    CellIterator(int row, CellMap::const_iterator it) : m_row(row), m_it(it) {}
+
+    CellView operator*() const { return CellView(m_row, m_it.key(), m_it.value().get()); }
+    CellIterator &operator++() { ++m_it; return *this; }
+    CellIterator operator++(int) { CellIterator it = *this; ++m_it; return it; }
+    bool operator==(const CellIterator &other) const { return m_it == other.m_it; }
+    bool operator!=(const CellIterator &other) const { return m_it != other.m_it; }
+private:
+    int m_row = 0;
+    CellMap::const_iterator m_it;
+};
+
+/**
+ * @brief The RowView class is a lightweight read-only view of a worksheet row
+ * that has non-empty cells.
+ *
+ * RowView is yielded by Worksheet::rows().
+ */
+class QXLSX_EXPORT RowView
+{
+public:
+    RowView() {}
+    RowView(int row, const CellIterator::CellMap *cells, int firstColumn, int lastColumn)
+        : m_row(row), m_cells(cells), m_firstColumn(firstColumn), m_lastColumn(lastColumn) {}
+
+    /**
+     * @brief returns the row index (starting from 1).
+     */
+    int row() const { return m_row; }
+    /**
+     * @brief returns the non-empty cells of the row in the column order.
+     *
+     * ```cpp
+     * for (const RowView &row: sheet->rows()) {
+     *     for (const CellView &cell: row.cells())
+     *         qDebug() << cell.row() << cell.column() << cell.text();
+     * }
+     * ```
+     */
+    IteratorRange<CellIterator> cells() const
+    {
+        if (!m_cells) return {CellIterator(), CellIterator()};
+        return {CellIterator(m_row, m_cells->lowerBound(m_firstColumn)),
+                CellIterator(m_row, m_cells->upperBound(m_lastColumn))};
+    }
+private:
+    int m_row = 0;
+    const CellIterator::CellMap *m_cells = nullptr;
+    int m_firstColumn = 0;
+    int m_lastColumn = 0;
+};
+
+/**
+ * @brief The RowIterator class is a forward iterator over the worksheet rows
+ * that have non-empty cells within a column range.
+ */
+class QXLSX_EXPORT RowIterator
+{
+public:
+    using RowMap = QMap<int, CellIterator::CellMap>;
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = RowView;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = RowView;
+
+    RowIterator() {}
+    RowIterator(RowMap::const_iterator it, RowMap::const_iterator end, int firstColumn, int lastColumn)
+        : m_it(it), m_end(end), m_firstColumn(firstColumn), m_lastColumn(lastColumn)
+    {
+        skipEmptyRows();
+    }
+
+    RowView operator*() const { return RowView(m_it.key(), &m_it.value(), m_firstColumn, m_lastColumn); }
+    RowIterator &operator++() { ++m_it; skipEmptyRows(); return *this; }
+    RowIterator operator++(int) { RowIterator it = *this; ++(*this); return it; }
+    bool operator==(const RowIterator &other) const { return m_it == other.m_it; }
+    bool operator!=(const RowIterator &other) const { return m_it != other.m_it; }
+private:
+    void skipEmptyRows()
+    {
+        while (m_it != m_end) {
+            auto cell = m_it.value().lowerBound(m_firstColumn);
+            if (cell != m_it.value().constEnd() && cell.key() <= m_lastColumn)
+                break;
+            ++m_it;
+        }
+    }
+    RowMap::const_iterator m_it;
+    RowMap::const_iterator m_end;
+    int m_firstColumn = 0;
+    int m_lastColumn = 0;
+};
+
+/**
+ * @brief The RowBlock class is a contiguous block of worksheet rows passed to
+ * the kernel of Worksheet::parallelForEachRowBlock().
+ */
+class QXLSX_EXPORT RowBlock
+{
+public:
+    RowBlock(int index, const CellRange &range, const IteratorRange<RowIterator> &rows)
+        : m_index(index), m_range(range), m_rows(rows) {}
+
+    /**
+     * @brief returns the block index. Blocks are numbered from 0 from top to bottom.
+     */
+    int index() const { return m_index; }
+    /**
+     * @brief returns the cell range covered by the block.
+     */
+    CellRange range() const { return m_range; }
+    /**
+     * @brief returns the rows of the block that have non-empty cells.
+     */
+    IteratorRange<RowIterator> rows() const { return m_rows; }
+private:
+    int m_index;
+    CellRange m_range;
+    IteratorRange<RowIterator> m_rows;
+};
+
+}
+
+#endif // QXLSX_XLSXCELLITERATOR_H
@@ -60,6 +60,7 @@ private:
 
     Chartsheet(const QString &sheetName, int sheetId, Workbook *book, CreateFlag flag);
     Chartsheet *copy(const QString &distName, int distId) const override;
+    Chartsheet *snapshot(Workbook *workbook) const override;
 
 
 
@@ -12,6 +12,8 @@
 #include "xlsxglobal.h"
 #include "xlsxutility_p.h"
 
+#include <atomic>
+
 namespace QXlsx {
 
 //<xsd:group name="EG_ColorChoice">
@@ -442,7 +444,7 @@ private:
 
     bool isCRGB = false;
 
-    mutable bool isDirty = true;
+    mutable std::atomic<bool> isDirty {true}; //idKey() may be called from several threads
     mutable QByteArray m_key;
 #if !defined(QT_NO_DATASTREAM)
     friend QDataStream &operator<<(QDataStream &s, const Color &color);
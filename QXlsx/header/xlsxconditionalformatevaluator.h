@@ -0,0 +1,137 @@
+// xlsxconditionalformatevaluator.h
+
+#ifndef QXLSX_XLSXCONDITIONALFORMATEVALUATOR_H
+#define QXLSX_XLSXCONDITIONALFORMATEVALUATOR_H
+
+#include <QtGlobal>
+#include <QColor>
+
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include "xlsxglobal.h"
+#include "xlsxcellrange.h"
+#include "xlsxformat.h"
+
+namespace QXlsx {
+
+class Worksheet;
+class FormulaEngine;
+class ConditionalFormatEvaluatorPrivate;
+
+/**
+ * @brief The ConditionalFormatResult struct is the effect of the conditional
+ * formattings on one cell.
+ */
+struct QXLSX_EXPORT ConditionalFormatResult
+{
+    /**
+     * @brief the differential format of the matching rules. If several rules
+     * match, a property of a rule with a higher priority overrides the same
+     * property of the rules with the lower priorities.
+     */
+    Format format;
+    /**
+     * @brief the fill color of the color scale or an invalid color if no color
+     * scale applies to the cell.
+     */
+    QColor color;
+    /**
+     * @brief the length of the data bar from 0.0 to 1.0 or no value if no data
+     * bar applies to the cell.
+     */
+    std::optional<double> dataBar;
+    /**
+     * @brief the color of the data bar.
+     */
+    QColor dataBarColor;
+    /**
+     * @brief false if the data bar hides the cell value.
+     */
+    bool showValue = true;
+
+    /**
+     * @brief returns true if no rule applies to the cell.
+     */
+    bool isEmpty() const { return format.isEmpty() && !color.isValid() && !dataBar.has_value(); }
+};
+
+/**
+ * @brief The ConditionalFormatEvaluator class computes the effect of the
+ * conditional formattings of a worksheet on its cells. It is created by
+ * Worksheet::conditionalFormatEvaluator().
+ *
+ * The rules that compare a cell with the other cells of their ranges (top and
+ * bottom N, above and below the average, duplicate and unique values, color
+ * scales and data bars) use the statistics of the ranges: the sorted numbers,
+ * the average and the standard deviation, the counts of the values. The
+ * statistics are computed once per rule, so evaluating a range costs one pass
+ * over its cells.
+ *
+ * ```cpp
+ * ConditionalFormatEvaluator evaluator = sheet->conditionalFormatEvaluator();
+ * evaluator.evaluate(CellRange("A1:D100000"), [&](int row, int column, const ConditionalFormatResult &result) {
+ *     if (result.color.isValid())
+ *         paintCell(row, column, result.color);
+ * });
+ * ```
+ *
+ * The rules are read when the evaluator is created. The statistics track the
+ * modifications of the sheet cells made through the Worksheet methods: if the
+ * sheet was modified since they were computed, they are computed again on the
+ * next evaluation, together with the sheet names and the defined names that the
+ * formulas of the rules refer to. The evaluator must not outlive its sheet.
+ *
+ * The theme colors of the color scales and the data bars are not resolved.
+ */
+class QXLSX_EXPORT ConditionalFormatEvaluator
+{
+public:
+    /**
+     * @brief creates an invalid evaluator.
+     */
+    ConditionalFormatEvaluator();
+    ConditionalFormatEvaluator(const ConditionalFormatEvaluator &other);
+    ConditionalFormatEvaluator &operator=(const ConditionalFormatEvaluator &other);
+    ~ConditionalFormatEvaluator();
+
+    /**
+     * @brief returns true if the evaluator was created by
+     * Worksheet::conditionalFormatEvaluator().
+     */
+    bool isValid() const;
+    /**
+     * @brief returns true if the sheet cells were modified since the statistics
+     * of the rules were computed.
+     */
+    bool isStale() const;
+
+    /**
+     * @brief returns the effect of the conditional formattings on the cell at
+     * @a row and @a column (starting from 1).
+     */
+    ConditionalFormatResult evaluate(int row, int column) const;
+    /**
+     * @brief evaluates the cells of @a range and calls @a visit for each cell
+     * that the conditional formattings apply to, row by row.
+     * @param range the cells to evaluate.
+     * @param visit the function to call with the row, the column and the result.
+     *
+     * Only the cells covered by the ranges of the formattings are evaluated,
+     * including the empty ones (they can match the blanks rules).
+     */
+    void evaluate(const CellRange &range,
+                  const std::function<void (int row, int column, const ConditionalFormatResult &result)> &visit) const;
+
+private:
+    friend class Worksheet;
+    explicit ConditionalFormatEvaluator(const Worksheet *sheet);
+    void ensureCurrent() const;
+
+    std::shared_ptr<ConditionalFormatEvaluatorPrivate> d;
+};
+
+}
+
+#endif // QXLSX_XLSXCONDITIONALFORMATEVALUATOR_H
@@ -409,6 +409,9 @@ public:
 
 private:
     friend class Worksheet;
+    friend class WorksheetPrivate;
+    friend class ReferenceIndex;
+    friend class ConditionalFormatEvaluatorPrivate;
     friend class ::ConditionalFormattingTest;
 
 private:
@@ -17,6 +17,7 @@ class ContentTypes : public AbstractOOXmlFile
 {
 public:
     ContentTypes(CreateFlag flag);
+    ContentTypes *clone() const;
 
     void addDefault(const QString &key, const QString &value);
     void addOverride(const QString &key, const QString &value);
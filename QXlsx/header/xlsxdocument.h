@@ -8,10 +8,13 @@
 #include <QVariant>
 #include <QIODevice>
 #include <QImage>
+#include <QFuture>
 
 #include "xlsxglobal.h"
 #include "xlsxformat.h"
 #include "xlsxworksheet.h"
+#include "xlsxsaveoptions.h"
+#include "xlsxrowfilter.h"
 
 namespace QXlsx {
 
@@ -24,6 +27,7 @@ class CellReference;
 class DocumentPrivate;
 class DefinedName;
 class Chartsheet;
+class Template;
 
 /**
  * @brief The Document class provides API to handle the contents of .xlsx files.
@@ -37,6 +41,17 @@ class Chartsheet;
  * Each document has a pointer to #workbook(). The Workbook class presents methods
  * to add, delete and get sheets, to manupulate the workbook properties etc.
  *
+ * ## Thread safety
+ *
+ * The const methods of a document, its workbook, sheets, cells, formats and rich
+ * strings may be called from several threads at the same time, f.e. several
+ * threads may #read() cells of one loaded document. The lazily computed keys of
+ * formats and rich strings are generated once and published atomically.
+ * No thread may modify the document while other threads read it.
+ *
+ * Saving is not a read: #save() and #saveAs() update the package parts of the
+ * document. To save a document that other threads read, save its #snapshot()
+ * or use #saveAsync().
  */
 class QXLSX_EXPORT Document : public QObject
 {
@@ -89,27 +104,48 @@ public:
      * @param parent this object parent.
      */
     Document(QIODevice* device, QObject* parent = nullptr);
+    /**
+     * @overload
+     * @brief creates Document from the template @a tmpl.
+     *
+     * The document shares all its data with the template until it is
+     * modified, so creating it is cheap. When the document is saved, its
+     * unmodified parts are copied from the template without serializing and
+     * compressing them again.
+     * @param tmpl the template.
+     * @param parent this object parent.
+     */
+    Document(const Template &tmpl, QObject* parent = nullptr);
     ~Document();
 
     /**
      * @brief saves the current document. If no name was specified with #saveAs(),
      * saves under the default-constructed name ("Book1.xlsx").
+     * @param options the package options, f.e. compression levels.
      * @return `true` on success.
      */
-    bool save() const;
+    bool save(const SaveOptions &options = SaveOptions()) const;
     /**
      * @brief saves the current document.
      * @param name The document name. If the file @a name already exists,
      * it will be overwritten.
+     * @param options the package options, f.e. compression levels.
      * @return `true` on success.
      */
-    bool saveAs(const QString &name) const;
+    bool saveAs(const QString &name, const SaveOptions &options = SaveOptions()) const;
     /**
      * @brief writes the current document to the @a device.
+     *
+     * The package is written in one pass without seeking back, so @a device
+     * may be sequential (a socket, a pipe). Worksheets and the shared strings
+     * table are compressed and written while they are being serialized, so the
+     * first bytes reach the device early and memory usage doesn't grow with
+     * the worksheet size.
      * @param device the pointer to the (writable) device.
+     * @param options the package options, f.e. compression levels.
      * @return `true` on success.
      */
-    bool saveAs(QIODevice *device) const;
+    bool saveAs(QIODevice *device, const SaveOptions &options = SaveOptions()) const;
 
     // copy style from one xlsx file to other
     //    static bool copyStyle(const QString &from, const QString &to);
@@ -122,10 +158,94 @@ public:
     bool isLoaded() const;
     /**
      * @brief loads the document contents.
+     *
+     * If loading fails, the document contents remain unchanged.
      * @return  `true` on success.
      */
     bool load();
 
+    /**
+     * @brief loads the document contents in a background thread.
+     *
+     * The loading progress is reported with the #progressChanged() signal and
+     * with the returned future's progress value (in percents).
+     *
+     * Loading can be canceled with QFuture::cancel(). The loaded data replaces
+     * the document contents only after the whole package was read, so if
+     * loading is canceled or fails, the document contents remain unchanged.
+     *
+     * Do not access the document until the returned future is finished, and
+     * do not destroy it before that.
+     * @return the future that holds `true` if the document was successfully
+     * loaded. If the future was canceled, it holds no result.
+     */
+    QFuture<bool> loadAsync();
+    /**
+     * @brief sets the filter of rows and columns to load for the worksheet @a sheetName.
+     * @param sheetName the worksheet name.
+     * @param filter the filter. An empty filter removes the filter of the sheet.
+     *
+     * The filter is applied by the following #load() or #loadAsync(). Create the
+     * document with `loadImmediately = false` to set filters before loading.
+     * Only cells and row properties are filtered, the other sheet data (merged
+     * cells, hyperlinks etc.) are loaded as is.
+     * @sa RowFilter
+     */
+    void setRowFilter(const QString &sheetName, const RowFilter &filter);
+    /**
+     * @brief returns the filter of rows and columns to load for the worksheet
+     * @a sheetName or an empty filter if no filter was set.
+     */
+    RowFilter rowFilter(const QString &sheetName) const;
+    /**
+     * @brief removes the row filters of all worksheets.
+     */
+    void clearRowFilters();
+    /**
+     * @brief saves the current document in a background thread.
+     *
+     * The saving progress is reported with the #progressChanged() signal and
+     * with the returned future's progress value (in percents).
+     *
+     * Saving can be canceled with QFuture::cancel(). The file is replaced only
+     * if the document was saved successfully, a canceled save leaves the
+     * existing file intact.
+     *
+     * The document is saved from a snapshot taken when this method is called
+     * (see #snapshot()), so it can be modified while it is being saved. The
+     * changes made after the call are not saved. Do not destroy the document
+     * until the returned future is finished.
+     * @param name The document name. If empty, saves under the name specified
+     * in the constructor or under the default name ("Book1.xlsx").
+     * @param options the package options, f.e. compression levels.
+     * @return the future that holds `true` if the document was successfully
+     * saved. If the future was canceled, it holds no result.
+     */
+    QFuture<bool> saveAsync(const QString &name = QString(), const SaveOptions &options = SaveOptions()) const;
+    /**
+     * @brief creates a snapshot of the document.
+     *
+     * The snapshot is an independent document that has the same contents as
+     * this one at the moment of the call. Cell data, shared strings and styles
+     * are not copied: the snapshot and the document share them until one of
+     * them modifies the data, and only the modified cells and rows are copied.
+     * Creating a snapshot takes time proportional to the number of sheets and
+     * drawings, not to the number of cells.
+     *
+     * Use a snapshot to save or read a consistent state of the document in
+     * another thread while the document itself is being edited.
+     *
+     * ```cpp
+     * std::unique_ptr<Document> snapshot(doc.snapshot());
+     * auto future = QtConcurrent::run([&snapshot]() { return snapshot->saveAs("copy.xlsx"); });
+     * doc.write("A1", 1); // doesn't affect the snapshot
+     * ```
+     *
+     * @param parent the parent object of the snapshot.
+     * @return a new document. The caller takes ownership of it.
+     */
+    Document *snapshot(QObject *parent = nullptr) const;
+
 
     // TODO: remove in future versions
     /**
@@ -377,6 +497,20 @@ public:
      * chartsheets or the active sheet is a worksheet.
      */
     Chartsheet *activeChartsheet() const;
+
+Q_SIGNALS:
+    /**
+     * @brief this signal is emitted while the document is being loaded or saved.
+     *
+     * When loading, @a processed and @a total are sizes in bytes of the
+     * uncompressed package parts. When saving, they are the number of worksheet
+     * rows plus the number of other package parts.
+     *
+     * If the document is loaded or saved with #loadAsync() or #saveAsync(),
+     * the signal is emitted from a worker thread.
+     */
+    void progressChanged(qint64 processed, qint64 total);
+
 private:
     Q_DISABLE_COPY(Document) // Disables the use of copy constructors and
                              // assignment operators for the given Class.
@@ -58,6 +58,8 @@ public:
     void setObjectPicture(const QImage &img);
     bool getObjectPicture(QImage &img);
     bool removeObjectPicture();
+    QSharedPointer<MediaFile> pictureFile() const;
+    void setPictureFile(const QSharedPointer<MediaFile> &file);
 
     QSharedPointer<Chart> chart() const;
 
@@ -7,6 +7,8 @@
 #include <QMap>
 #include <QSet>
 
+#include <atomic>
+
 #include "xlsxformat.h"
 
 namespace QXlsx {
@@ -94,20 +96,22 @@ public:
     FormatPrivate(const FormatPrivate &other);
     ~FormatPrivate();
 
-    bool dirty; //The key re-generation is need.
+    //The keys are generated lazily by the const methods of Format, so that
+    //the dirty flags are atomic: see formatKey().
+    std::atomic<bool> dirty; //The key re-generation is need.
     QByteArray formatKey;
 
-    bool font_dirty;
+    std::atomic<bool> font_dirty;
     bool font_index_valid;
     QByteArray font_key;
     int font_index;
 
-    bool fill_dirty;
+    std::atomic<bool> fill_dirty;
     bool fill_index_valid;
     QByteArray fill_key;
     int fill_index;
 
-    bool border_dirty;
+    std::atomic<bool> border_dirty;
     bool border_index_valid;
     QByteArray border_key;
     int border_index;
@@ -0,0 +1,96 @@
+// xlsxformulacache_p.h
+
+#ifndef QXLSX_XLSXFORMULACACHE_P_H
+#define QXLSX_XLSXFORMULACACHE_P_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <memory>
+
+#include "xlsxformulaparser_p.h"
+
+namespace QXlsx {
+
+/*!
+ * \internal
+ * A tokenized formula. The formula text is split into the literal parts and
+ * the references between them, the references are relative to the formula cell.
+ * The sheet prefixes of the references are kept in the literal parts.
+ *
+ * The formulas that differ only in the position of the cell, like =A1*2 in B1
+ * and =A2*2 in B2, have the same relative (R1C1) form and share one template.
+ * The A1 text of the formula for any cell is produced from the tokens, and the
+ * syntax tree is parsed once for all the cells.
+ */
+class FormulaTemplate
+{
+public:
+    QString key() const { return m_key; }
+    bool isValid() const { return m_valid; }
+    int referenceCount() const { return m_references.size(); }
+    QVector<FormulaReference> references() const { return m_references; }
+    FormulaNodePtr ast() const { return m_ast; }
+    QString toA1(int row, int column) const;
+
+private:
+    friend class FormulaCache;
+
+    QString m_key; //the formula in the R1C1 notation
+    bool m_valid = false; //false if the formula could not be tokenized
+    QStringList m_literals; //one more than the references
+    QVector<FormulaReference> m_references;
+    FormulaNodePtr m_ast;
+};
+
+using FormulaTemplatePtr = std::shared_ptr<const FormulaTemplate>;
+
+/*!
+ * \internal
+ * The formula templates of a workbook. The templates are interned by their R1C1
+ * form. The recently compiled formula texts are remembered with their cells, so
+ * the cells of a shared formula get the template of the master cell without
+ * tokenizing it again.
+ *
+ * The cache is shared by the snapshots of the workbook and may be used by
+ * concurrent readers.
+ */
+class FormulaCache
+{
+public:
+    FormulaTemplatePtr compile(const QString &formula, int row, int column);
+    int count() const;
+    void clear();
+
+private:
+    struct Source
+    {
+        QString text;
+        int row;
+        int column;
+
+        bool operator==(const Source &other) const
+        {
+            return row == other.row && column == other.column && text == other.text;
+        }
+    };
+    friend uint qHash(const Source &source, uint seed)
+    {
+        return ::qHash(source.text, seed) ^ ::qHash((quint64(source.row) << 16) ^ quint64(source.column), seed);
+    }
+
+    FormulaTemplatePtr intern(const std::shared_ptr<FormulaTemplate> &formula);
+
+    mutable QMutex m_mutex;
+    QHash<QString, FormulaTemplatePtr> m_templates; //by the R1C1 form
+    QHash<Source, FormulaTemplatePtr> m_sources;
+    int m_purgeLimit = 4096;
+};
+
+}
+
+#endif // QXLSX_XLSXFORMULACACHE_P_H
@@ -0,0 +1,227 @@
+// xlsxformulaengine_p.h
+
+#ifndef QXLSX_XLSXFORMULAENGINE_P_H
+#define QXLSX_XLSXFORMULAENGINE_P_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include <QVariant>
+
+#include <functional>
+
+#include "xlsxformulaparser_p.h"
+#include "xlsxformulacache_p.h"
+#include "xlsxcellrange.h"
+#include "xlsxrangeindex_p.h"
+#include "xlsxcell.h"
+
+QT_FORWARD_DECLARE_CLASS(QThreadPool)
+
+namespace QXlsx {
+
+class Workbook;
+class Worksheet;
+class CellView;
+class FormulaEngine;
+
+/*!
+ * \internal
+ * A value computed by the formula engine. Range values are produced by references
+ * and are passed to the functions as is, other operations convert them to scalars.
+ */
+struct FormulaValue
+{
+    enum class Type {Blank, Number, String, Boolean, Error, Range};
+
+    Type type = Type::Blank;
+    double number = 0.0;
+    bool boolean = false;
+    FormulaError error = FormulaError::None;
+    QString string;
+    const Worksheet *sheet = nullptr; //for ranges
+    CellRange range;
+
+    static FormulaValue fromNumber(double number);
+    static FormulaValue fromString(const QString &string);
+    static FormulaValue fromBoolean(bool boolean);
+    static FormulaValue fromError(FormulaError error);
+    static FormulaValue fromRange(const Worksheet *sheet, const CellRange &range);
+
+    bool isError() const { return type == Type::Error; }
+    bool isRange() const { return type == Type::Range; }
+    QVariant toVariant() const;
+};
+
+/*!
+ * \internal
+ * The position of the formula being evaluated.
+ */
+struct FormulaContext
+{
+    const Worksheet *sheet = nullptr;
+    int row = 0;
+    int column = 0;
+    int depth = 0; //nesting depth of defined names
+};
+
+/*!
+ * \internal
+ * The arguments of a function call.
+ */
+struct FormulaArguments
+{
+    const FormulaEngine *engine;
+    const FormulaContext &context;
+    QVector<FormulaValue> values;
+
+    int count() const { return values.size(); }
+    bool isMissing(int index) const;
+    FormulaValue scalar(int index) const;
+    FormulaError number(int index, double &value) const;
+    FormulaError boolean(int index, bool &value) const;
+    FormulaError text(int index, QString &value) const;
+};
+
+using FormulaFunction = FormulaValue (*)(const FormulaArguments &args);
+
+struct FormulaFunctionInfo
+{
+    FormulaFunction function = nullptr;
+    int minArguments = 0;
+    int maxArguments = 255;
+    bool isVolatile = false;
+};
+
+/*!
+ * \internal
+ * Returns the table of the built-in functions keyed by upper case names.
+ * Defined in xlsxformulafunctions.cpp.
+ */
+const QHash<QString, FormulaFunctionInfo> &formulaFunctions();
+
+/*!
+ * \internal
+ * The key of a formula cell in the dependency graph.
+ */
+struct FormulaCellKey
+{
+    const Worksheet *sheet = nullptr;
+    int row = 0;
+    int column = 0;
+
+    bool operator==(const FormulaCellKey &other) const
+    {
+        return sheet == other.sheet && row == other.row && column == other.column;
+    }
+};
+
+inline uint qHash(const FormulaCellKey &key, uint seed = 0)
+{
+    return ::qHash(quintptr(key.sheet), seed) ^ ::qHash((quint64(key.row) << 16) ^ quint64(key.column), seed);
+}
+
+/*!
+ * \internal
+ * The formula calculation engine of a workbook.
+ *
+ * The engine gets the syntax trees of the formulas from the formula cache of the
+ * workbook, so the cells with the same formula in the R1C1 notation share one
+ * tree, and keeps a dependency graph of the formula cells. The worksheets report the cells
+ * modified after the last calculation, and recalculate() evaluates only the
+ * formulas that depend on them, directly or transitively. The formulas are split
+ * into levels: each formula refers only to the formulas of the previous levels,
+ * so the formulas of one level are evaluated in parallel. The results of a level
+ * are stored in the cells as the cached formula values before the next level starts.
+ */
+class FormulaEngine
+{
+public:
+    explicit FormulaEngine(Workbook *workbook);
+    ~FormulaEngine();
+
+    bool recalculate(int threads = 1);
+    QList<FormulaCellKey> circularReferences() const { return m_circular; }
+
+    FormulaValue evaluateFormula(const QString &formula, const Worksheet *sheet);
+    void prepare();
+
+    //used by the evaluation and the functions
+    FormulaValue evaluate(const FormulaNode &node, const FormulaContext &context) const;
+    FormulaValue cellValue(const Worksheet *sheet, int row, int column) const;
+    FormulaValue toScalar(const FormulaValue &value, const FormulaContext &context) const;
+    void forEachCell(const FormulaValue &range, const std::function<bool (int row, int column, const FormulaValue &value)> &visit) const;
+    bool date1904() const;
+
+    static FormulaValue cellValue(const CellView &cell);
+    static FormulaError toNumber(const FormulaValue &scalar, double &number);
+    static FormulaError toBoolean(const FormulaValue &scalar, bool &boolean);
+    static QString toText(const FormulaValue &scalar);
+    static int compare(const FormulaValue &left, const FormulaValue &right);
+
+private:
+    struct FormulaEntry
+    {
+        FormulaTemplatePtr formula;
+        FormulaNodePtr ast; //nullptr if the formula is not calculated
+        QVector<QPair<const Worksheet *, CellRange> > precedents;
+        bool isVolatile = false;
+    };
+    struct RangeDependent
+    {
+        CellRange range;
+        FormulaCellKey formula;
+    };
+    //the formulas that refer to the ranges of a sheet, indexed by the ranges
+    struct RangeDependents
+    {
+        QVector<RangeDependent> items; //by their value in the index
+        QVector<int> freeItems; //the items removed from the index
+        RangeIndex index;
+    };
+    struct NameEntry
+    {
+        int sheetId = -1;
+        FormulaNodePtr ast;
+    };
+
+    bool updateStructure();
+    void rebuild();
+    void updateFormula(const FormulaCellKey &key);
+    void addFormula(const FormulaCellKey &key, const FormulaTemplatePtr &formula);
+    void removeFormula(const FormulaCellKey &key);
+    void collectPrecedents(const FormulaNode &node, const FormulaContext &context, FormulaEntry &entry, int depth) const;
+    QVector<FormulaCellKey> dependents(const FormulaCellKey &cell) const;
+    template <typename Visit>
+    void forEachFormulaIn(const Worksheet *sheet, const CellRange &range, Visit visit) const;
+    QVector<QVector<FormulaCellKey> > levelize(const QSet<FormulaCellKey> &cone);
+    void evaluateLevel(const QVector<FormulaCellKey> &level, int threads, QThreadPool *pool);
+    void store(const FormulaCellKey &key, const FormulaValue &value);
+
+    const Worksheet *resolveSheet(const QString &name, const FormulaContext &context) const;
+    const NameEntry *resolveName(const QString &name, const FormulaContext &context) const;
+    FormulaValue evaluateFunction(const FormulaNode &node, const FormulaContext &context) const;
+    FormulaValue evaluateBinary(const FormulaNode &node, const FormulaContext &context) const;
+
+    Workbook *m_workbook;
+    bool m_built = false;
+    QList<Worksheet *> m_sheets;
+    QStringList m_sheetNames;
+    QString m_namesSignature;
+    bool m_date1904 = false;
+    QHash<QString, const Worksheet *> m_sheetsByName; //upper case names
+    QMultiHash<QString, NameEntry> m_names; //upper case names
+
+    QHash<FormulaCellKey, FormulaEntry> m_formulas;
+    QHash<const Worksheet *, QMap<int, QSet<int> > > m_formulaCells; //sheet -> row -> columns
+    QHash<FormulaCellKey, QVector<FormulaCellKey> > m_cellDependents;
+    QHash<const Worksheet *, RangeDependents> m_rangeDependents;
+    QList<FormulaCellKey> m_circular;
+};
+
+}
+
+#endif // QXLSX_XLSXFORMULAENGINE_P_H
@@ -0,0 +1,143 @@
+// xlsxformulaparser_p.h
+
+#ifndef QXLSX_XLSXFORMULAPARSER_P_H
+#define QXLSX_XLSXFORMULAPARSER_P_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+
+#include "xlsxglobal.h"
+#include "xlsxcellrange.h"
+
+namespace QXlsx {
+
+/*!
+ * \internal
+ * Formula error values.
+ */
+enum class FormulaError
+{
+    None,
+    Null, // #NULL!
+    Div0, // #DIV/0!
+    Value, // #VALUE!
+    Ref, // #REF!
+    Name, // #NAME?
+    Num, // #NUM!
+    NA // #N/A
+};
+
+QString formulaErrorToString(FormulaError error);
+FormulaError formulaErrorFromString(const QString &error);
+
+/*!
+ * \internal
+ * A cell or area reference of a formula, f.e. A1, $B$2:C10, Sheet1!A:A or 'My sheet'!1:3.
+ *
+ * In a relative reference the rows and columns without '$' are the offsets from
+ * the cell of the formula, so the same reference is valid for any formula cell.
+ * resolved() gives the absolute coordinates for a particular cell.
+ */
+struct FormulaReference
+{
+    QString sheet; //empty if the reference is to the formula sheet
+    int firstRow = 0;
+    int firstColumn = 0;
+    int lastRow = 0;
+    int lastColumn = 0;
+    bool firstRowAbsolute = false;
+    bool firstColumnAbsolute = false;
+    bool lastRowAbsolute = false;
+    bool lastColumnAbsolute = false;
+    bool wholeColumns = false; //A:C
+    bool wholeRows = false; //1:3
+    bool relative = false;
+
+    bool isCell() const { return firstRow == lastRow && firstColumn == lastColumn; }
+    bool isValid() const;
+    CellRange range() const { return CellRange(firstRow, firstColumn, lastRow, lastColumn); }
+    FormulaReference relativeTo(int row, int column) const;
+    FormulaReference resolved(int row, int column) const;
+    QString toString() const;
+    QString toR1C1() const;
+};
+
+/*!
+ * \internal
+ * A node of the formula syntax tree.
+ */
+struct FormulaNode
+{
+    enum class Kind
+    {
+        Number,
+        String,
+        Boolean,
+        Error,
+        Reference,
+        Name,
+        Unary, // -x, +x
+        Percent, // x%
+        Binary,
+        Function,
+        Missing // an omitted function argument
+    };
+    enum class Operator
+    {
+        None,
+        Add, Subtract, Multiply, Divide, Power, Concat,
+        Equal, NotEqual, Less, Greater, LessOrEqual, GreaterOrEqual,
+        Negate, Plus
+    };
+
+    Kind kind = Kind::Missing;
+    Operator op = Operator::None;
+    double number = 0.0;
+    bool boolean = false;
+    FormulaError error = FormulaError::None;
+    QString text; //string literal, defined name or function name (upper case)
+    FormulaReference reference;
+    QVector<std::shared_ptr<const FormulaNode> > children;
+};
+
+using FormulaNodePtr = std::shared_ptr<const FormulaNode>;
+
+/*!
+ * \internal
+ * The position of a reference in the formula text. The sheet prefix is not
+ * included, it takes \a sheetLength characters before \a position.
+ */
+struct FormulaReferenceSpan
+{
+    int position = 0;
+    int length = 0;
+    int sheetLength = 0;
+    FormulaReference reference;
+};
+
+/*!
+ * \internal
+ * Parses the text of a formula (with or without the leading '=') into a syntax
+ * tree. Returns nullptr if the formula has a syntax error.
+ *
+ * If the cell of the formula is given, the references of the tree are relative
+ * to it.
+ */
+class FormulaParser
+{
+public:
+    static FormulaNodePtr parse(const QString &formula, QString *errorString = nullptr);
+    static FormulaNodePtr parse(const QString &formula, int row, int column, QString *errorString = nullptr);
+    static bool findReferences(const QString &formula, QVector<FormulaReferenceSpan> &references,
+                               QString *errorString = nullptr);
+};
+
+int formulaColumnFromName(const QString &name);
+QString formulaColumnName(int column);
+
+}
+
+#endif // QXLSX_XLSXFORMULAPARSER_P_H
@@ -0,0 +1,65 @@
+// xlsxprogresscontrol_p.h
+
+#ifndef QXLSX_XLSXPROGRESSCONTROL_P_H
+#define QXLSX_XLSXPROGRESSCONTROL_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt Xlsx API.  It exists for the convenience
+// of the Qt Xlsx.  This header file may change from
+// version to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtGlobal>
+
+#include <functional>
+
+#include "xlsxglobal.h"
+
+namespace QXlsx {
+
+/*
+ * Progress reporting and cooperative cancellation of a load or save operation.
+ *
+ * The operation is split into parts (package parts or worksheets). Progress
+ * inside the part being processed is set with setPartProgress(), a processed
+ * part is accounted with finishPart(). The callback is throttled, it is
+ * invoked at most once per 1/1000 of the total.
+ *
+ * The object is owned by the thread that runs the operation, only the cancel
+ * check may be triggered from another thread.
+ */
+class ProgressControl
+{
+public:
+    using Callback = std::function<void (qint64 processed, qint64 total)>;
+    using CancelCheck = std::function<bool ()>;
+
+    explicit ProgressControl(const Callback &callback = Callback(),
+                             const CancelCheck &cancelCheck = CancelCheck());
+
+    void setTotal(qint64 total);
+    qint64 total() const;
+    void setPartProgress(qint64 processed);
+    void finishPart(qint64 size);
+    void finish();
+
+    bool isCanceled() const;
+
+private:
+    void report(qint64 processed, bool force);
+
+    Callback m_callback;
+    CancelCheck m_cancelCheck;
+    qint64 m_total = 0;
+    qint64 m_base = 0;
+    qint64 m_lastReported = -1;
+};
+
+}
+
+#endif // QXLSX_XLSXPROGRESSCONTROL_P_H
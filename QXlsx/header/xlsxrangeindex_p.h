@@ -0,0 +1,108 @@
+// xlsxrangeindex_p.h
+
+#ifndef QXLSX_XLSXRANGEINDEX_P_H
+#define QXLSX_XLSXRANGEINDEX_P_H
+
+#include <QtGlobal>
+#include <QAtomicInt>
+#include <QVector>
+
+#include "xlsxcellrange.h"
+
+namespace QXlsx {
+
+/*!
+ * \internal
+ * A spatial index of cell ranges, e.g. the merged cells or the ranges of the
+ * data validations of a sheet. Each range carries a value, like the position
+ * of its object in the list of the sheet.
+ *
+ * The ranges are kept in packed R-trees whose sizes grow by powers of two (the
+ * logarithmic method): adding ranges merges the smaller trees into a new one,
+ * like a carry in a binary counter. Adding n ranges one by one costs
+ * O(n log^2 n), adding them at once costs O(n log n), and a query visits
+ * O(log n) trees of O(log n) levels. Removed ranges are marked and dropped when
+ * their tree is merged, or when they make up half of the index.
+ *
+ * An index is invalid until it is built; insert() and remove() do nothing on
+ * an invalid index, so the owner can keep it up to date unconditionally and
+ * build it on the first query. The validity is published atomically after the
+ * trees are built, so concurrent readers may check isValid() without a lock
+ * and build the index under one. Copies of the index share the trees until
+ * either copy is modified.
+ */
+class RangeIndex
+{
+public:
+    struct Item
+    {
+        CellRange range;
+        int value;
+    };
+
+    bool isValid() const { return m_valid.loadAcquire(); }
+    int size() const { return m_size - m_removed; }
+    void reset();
+    void build(const QVector<Item> &items);
+    void insert(const CellRange &range, int value);
+    void insert(const QVector<Item> &items);
+    bool remove(const CellRange &range, int value);
+
+    QVector<Item> find(const CellRange &area) const;
+    QVector<int> values(const CellRange &area) const;
+    bool intersects(const CellRange &area) const;
+
+private:
+    struct Box
+    {
+        int firstRow;
+        int firstColumn;
+        int lastRow;
+        int lastColumn;
+
+        bool intersects(const Box &other) const
+        {
+            return firstRow <= other.lastRow && other.firstRow <= lastRow
+                    && firstColumn <= other.lastColumn && other.firstColumn <= lastColumn;
+        }
+        bool operator==(const Box &other) const
+        {
+            return firstRow == other.firstRow && firstColumn == other.firstColumn
+                    && lastRow == other.lastRow && lastColumn == other.lastColumn;
+        }
+    };
+    struct Entry
+    {
+        Box box;
+        int value;
+        bool removed;
+    };
+    //A packed R-tree. The entries are the leaf level, each box of levels[0]
+    //bounds NodeSize entries, each box of levels[i] bounds NodeSize boxes of
+    //levels[i - 1]. The last level has one box.
+    struct Tree
+    {
+        QVector<Entry> entries;
+        QVector<QVector<Box> > levels;
+        int removed = 0;
+
+        bool isEmpty() const { return entries.isEmpty(); }
+    };
+
+    static Box toBox(const CellRange &range);
+    static Tree pack(QVector<Entry> entries);
+    template <typename Visit>
+    static bool visit(const Tree &tree, const Box &area, Visit visit);
+    void add(QVector<Entry> entries);
+    void addItems(const QVector<Item> &items);
+    void compact();
+
+    QVector<Tree> m_trees; //m_trees[k] holds up to NodeSize * 2^k entries or is empty
+    int m_size = 0; //the entries, including the removed ones
+    int m_removed = 0;
+    QAtomicInt m_valid = 0;
+};
+
+}
+
+#endif // QXLSX_XLSXRANGEINDEX_P_H
@@ -0,0 +1,139 @@
+// xlsxreferenceindex_p.h
+
+#ifndef QXLSX_XLSXREFERENCEINDEX_P_H
+#define QXLSX_XLSXREFERENCEINDEX_P_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+
+#include "xlsxformulaparser_p.h"
+#include "xlsxcellrange.h"
+#include "xlsxrangeindex_p.h"
+
+namespace QXlsx {
+
+class Workbook;
+class AbstractSheet;
+class Worksheet;
+class Chart;
+class Cell;
+struct SheetShift;
+
+/*!
+ * \internal
+ * An object that refers to cells: a formula cell, a defined name, a data
+ * validation, a conditional formatting or a chart series.
+ */
+struct ReferenceSite
+{
+    enum class Kind {Cell, DefinedName, DataValidation, ConditionalFormatting, Series};
+
+    Kind kind = Kind::Cell;
+    Worksheet *sheet = nullptr; //the sheet of a cell, a data validation or a conditional formatting
+    Chart *chart = nullptr;
+    int row = 0; //of a cell
+    int column = 0;
+    int index = 0; //in the defined names, the validations or formattings of the sheet, the series of the chart
+
+    bool operator==(const ReferenceSite &other) const
+    {
+        return kind == other.kind && sheet == other.sheet && chart == other.chart
+                && row == other.row && column == other.column && index == other.index;
+    }
+};
+
+inline uint qHash(const ReferenceSite &site, uint seed = 0)
+{
+    return ::qHash(quintptr(site.sheet) ^ quintptr(site.chart), seed)
+            ^ ::qHash((quint64(site.row) << 32) ^ (quint64(site.column) << 8) ^ quint64(site.index), seed)
+            ^ uint(site.kind);
+}
+
+/*!
+ * \internal
+ * The reference index of a workbook. Maps each sheet to the objects that refer
+ * to its cells and to the areas they refer to, so renaming a sheet or shifting
+ * cells rewrites only the affected objects.
+ *
+ * The references of the cell formulas are collected from the formula templates.
+ * After the first update of a sheet, only the cells in the ranges recorded by
+ * WorksheetPrivate::cellsModified() are collected again. The references of the
+ * defined names, data validations, conditional formattings and chart series are
+ * few; they are collected on each update. The ranges of the data validations
+ * and conditional formattings are indexed as references to their own sheet.
+ * The areas referred to on each sheet are kept in spatial indexes, so finding
+ * the objects that refer to an area visits only the references near it.
+ *
+ * The cells of a shared formula are reported as the master cell, which holds
+ * the text of the whole group. The ranges of the array and data table formulas
+ * are indexed too, so shifting cells finds the formulas whose range it adjusts.
+ */
+class ReferenceIndex
+{
+public:
+    using Rewrite = std::function<bool (FormulaReference &reference)>;
+
+    explicit ReferenceIndex(Workbook *workbook);
+
+    void update();
+    QVector<ReferenceSite> sites(const AbstractSheet *target, const CellRange &area = CellRange()) const;
+    QVector<QPair<CellReference, CellRange> > masters(const Worksheet *sheet, const CellRange &area) const;
+    const AbstractSheet *resolveSheet(const QString &name, const AbstractSheet *host) const;
+
+    bool rewrite(const ReferenceSite &site, const Rewrite &rewrite);
+    void renameSheet(AbstractSheet *sheet, const QString &newName);
+    void shiftSheet(Worksheet *sheet, const SheetShift &shift);
+
+    static QString rewriteFormula(const QString &formula, const Rewrite &rewrite);
+
+private:
+    //a reference of a formula cell, or the range of an array or data table
+    //formula on its own sheet, by its value in the index of the target
+    struct CellEntry
+    {
+        Worksheet *sheet; //nullptr for a free entry
+        int row;
+        int column;
+        const AbstractSheet *target;
+        CellRange area;
+        bool master;
+    };
+    //the entries of the formula cells of a sheet, by row and column
+    using SheetCells = QMap<int, QMap<int, QVector<int> > >;
+    struct ObjectEntry
+    {
+        ReferenceSite site;
+        CellRange area;
+    };
+
+    void indexCells(Worksheet *sheet, const CellRange &range);
+    void indexCell(Worksheet *sheet, int row, int column, const Cell *cell, SheetCells &cells);
+    void removeCells(Worksheet *sheet, const CellRange &range);
+    void removeEntry(int value);
+    void clearCells();
+    void indexObjects();
+    void addFormula(const ReferenceSite &site, const QString &formula, const AbstractSheet *host);
+    ReferenceSite masterSite(const ReferenceSite &site) const;
+
+    Workbook *m_workbook;
+    QList<AbstractSheet *> m_sheets;
+    QStringList m_sheetNames;
+    QHash<QString, AbstractSheet *> m_sheetsByName; //upper case names
+    QHash<Worksheet *, SheetCells> m_cells;
+    QVector<CellEntry> m_cellEntries;
+    QVector<int> m_freeEntries;
+    QHash<const AbstractSheet *, RangeIndex> m_cellAreas; //the areas of m_cellEntries by the target
+    QHash<const AbstractSheet *, QVector<ObjectEntry> > m_objects;
+    QHash<const AbstractSheet *, RangeIndex> m_objectAreas; //the areas of m_objects by the target
+};
+
+}
+
+#endif // QXLSX_XLSXREFERENCEINDEX_P_H
@@ -38,6 +38,8 @@
 
 #include "xlsxrichstring.h"
 
+#include <atomic>
+
 namespace QXlsx {
 
 class RichStringPrivate : public QSharedData
@@ -51,8 +53,8 @@ public:
 
     QStringList fragmentTexts;
     QList<Format> fragmentFormats;
-    QByteArray _idKey;
-    bool _dirty;
+    mutable QByteArray _idKey;
+    mutable std::atomic<bool> _dirty; //idKey() may be called from several threads
 };
 
 }
@@ -0,0 +1,136 @@
+// xlsxrowfilter.h
+
+#ifndef QXLSX_XLSXROWFILTER_H
+#define QXLSX_XLSXROWFILTER_H
+
+#include "xlsxglobal.h"
+
+#include <QList>
+#include <QVariant>
+#include <QVector>
+
+namespace QXlsx {
+
+class RowFilterMatcher;
+
+/**
+ * @brief The RowFilter class specifies which rows and columns of a worksheet
+ * are loaded by Document::load().
+ *
+ * A filter consists of column predicates and a column projection. The predicates
+ * are evaluated while the sheet XML is parsed, on the raw cell values: strings
+ * are compared by their indexes in the shared strings table, numbers are parsed
+ * from the cell text. Cells of the rows that do not pass the filter and cells
+ * outside the projection are never created, so loading a filtered subset of a
+ * large sheet is proportionally faster and uses less memory.
+ *
+ * ```cpp
+ * RowFilter filter;
+ * filter.setCombination(RowFilter::Combination::Any);
+ * filter.addEquals(3, QStringLiteral("EU"));         // column C equals "EU"
+ * filter.addRange(6, 1000, qInf(), false);            // or column F > 1000
+ * filter.setColumns({1, 3, 6});                      // load only columns A, C and F
+ *
+ * Document doc("sales.xlsx", false);
+ * doc.setRowFilter(QStringLiteral("Sales"), filter);
+ * doc.load();
+ * ```
+ *
+ * The loaded rows and columns keep their original indexes. A filter with no
+ * predicates passes all rows.
+ */
+class QXLSX_EXPORT RowFilter
+{
+public:
+    /**
+     * @brief The Combination enum specifies how the predicates are combined.
+     */
+    enum class Combination
+    {
+        All, /**< A row passes if it satisfies all the predicates. */
+        Any /**< A row passes if it satisfies at least one predicate. */
+    };
+
+    RowFilter() {}
+
+    /**
+     * @brief sets how the predicates are combined. The default value is Combination::All.
+     */
+    void setCombination(Combination combination);
+    /**
+     * @brief returns how the predicates are combined.
+     */
+    Combination combination() const;
+
+    /**
+     * @brief adds the predicate "the cell in @a column equals @a value".
+     * @param column the column index (starting from 1).
+     * @param value a string, a number or a boolean. Strings are compared
+     * case-sensitively with text cells, numbers are compared with numeric cells
+     * (including dates).
+     */
+    void addEquals(int column, const QVariant &value);
+    /**
+     * @brief adds the predicate "the cell in @a column equals one of @a values".
+     * @param column the column index (starting from 1).
+     * @param values strings, numbers or booleans.
+     */
+    void addInSet(int column, const QList<QVariant> &values);
+    /**
+     * @brief adds the predicate "the cell in @a column holds a number between
+     * @a minimum and @a maximum".
+     * @param column the column index (starting from 1).
+     * @param minimum the lower bound. Use -qInf() for no lower bound.
+     * @param maximum the upper bound. Use qInf() for no upper bound.
+     * @param inclusive if true, the bounds belong to the range.
+     */
+    void addRange(int column, double minimum, double maximum, bool inclusive = true);
+    /**
+     * @brief adds the predicate "the cell in @a column is not blank".
+     * @param column the column index (starting from 1).
+     */
+    void addNotBlank(int column);
+    /**
+     * @brief removes all predicates.
+     */
+    void clearPredicates();
+
+    /**
+     * @brief sets the columns to load. Only the cells of these columns are loaded.
+     * @param columns column indexes (starting from 1). If empty, all columns are loaded.
+     *
+     * The predicates may refer to the columns that are not loaded.
+     */
+    void setColumns(const QList<int> &columns);
+    /**
+     * @brief returns the columns to load or an empty list if all columns are loaded.
+     */
+    QList<int> columns() const;
+
+    /**
+     * @brief returns true if the filter has no predicates and no projection,
+     * i.e. it passes all cells.
+     */
+    bool isEmpty() const;
+
+private:
+    friend class RowFilterMatcher;
+    struct Predicate
+    {
+        enum class Kind {InSet, Range, NotBlank};
+        Kind kind = Kind::InSet;
+        int column = 0;
+        QList<QVariant> values;
+        double minimum = 0.0;
+        double maximum = 0.0;
+        bool inclusive = true;
+    };
+
+    Combination mCombination = Combination::All;
+    QVector<Predicate> mPredicates;
+    QList<int> mColumns;
+};
+
+}
+
+#endif // QXLSX_XLSXROWFILTER_H
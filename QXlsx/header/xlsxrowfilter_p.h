@@ -0,0 +1,64 @@
+// xlsxrowfilter_p.h
+
+#ifndef QXLSX_XLSXROWFILTER_P_H
+#define QXLSX_XLSXROWFILTER_P_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+#include "xlsxrowfilter.h"
+#include "xlsxcell.h"
+
+namespace QXlsx {
+
+class SharedStrings;
+class RichString;
+
+/*!
+ * \internal
+ * Evaluates a RowFilter on the raw cell data of the sheetData element.
+ * The string predicates are compiled to the sets of shared string indexes, so
+ * the shared string cells are tested without looking up their strings.
+ */
+class RowFilterMatcher
+{
+public:
+    RowFilterMatcher(const RowFilter &filter, const SharedStrings *sharedStrings);
+
+    bool isLoaded(int column) const;
+    bool isTested(int column) const;
+
+    void beginRow();
+    void testCell(int column, Cell::Type type, const QString &value, bool hasFormula,
+                  const RichString *inlineString);
+    bool rowPasses() const;
+
+private:
+    struct CompiledPredicate
+    {
+        RowFilter::Predicate::Kind kind;
+        QSet<int> sharedStrings;
+        QSet<QString> strings;
+        QSet<double> numbers;
+        bool matchesTrue = false;
+        bool matchesFalse = false;
+        double minimum = 0.0;
+        double maximum = 0.0;
+        bool inclusive = true;
+    };
+    bool test(const CompiledPredicate &predicate, Cell::Type type, const QString &value,
+              bool hasFormula, const RichString *inlineString) const;
+
+    QVector<CompiledPredicate> m_predicates;
+    QHash<int, QVector<int> > m_columnPredicates;
+    QVector<bool> m_matched;
+    bool m_any = false;
+    QSet<int> m_columns;
+};
+
+}
+
+#endif // QXLSX_XLSXROWFILTER_P_H
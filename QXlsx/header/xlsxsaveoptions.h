@@ -0,0 +1,81 @@
+// xlsxsaveoptions.h
+
+#ifndef QXLSX_XLSXSAVEOPTIONS_H
+#define QXLSX_XLSXSAVEOPTIONS_H
+
+#include "xlsxglobal.h"
+
+#include <QHash>
+#include <QString>
+
+namespace QXlsx {
+
+/**
+ * @brief The SaveOptions class specifies how the .xlsx package is written by
+ * Document::saveAs().
+ *
+ * The package is a ZIP archive. Each part of the package (a worksheet, the
+ * shared strings table, styles, media files etc.) is stored as a separate ZIP
+ * entry, and each entry can be compressed with its own compression level.
+ *
+ * ```cpp
+ * SaveOptions options;
+ * options.setCompression(SaveOptions::Compression::Fast); // fast export
+ * options.setPartCompression("xl/sharedStrings.xml", SaveOptions::Compression::Best);
+ * doc.saveAs("report.xlsx", options);
+ * ```
+ *
+ * Zip64 extensions are written automatically when a part or the whole package
+ * exceeds 4 GB or the package contains more than 65535 parts.
+ */
+class QXLSX_EXPORT SaveOptions
+{
+public:
+    /**
+     * @brief The Compression enum specifies the compression level of a package part.
+     */
+    enum class Compression
+    {
+        Store, /**< The part is stored without compression. */
+        Fast, /**< The fastest deflate compression. */
+        Default, /**< The default deflate compression (a balance between speed and size). */
+        Best /**< The best (and the slowest) deflate compression. */
+    };
+
+    SaveOptions() {}
+
+    /**
+     * @brief sets the default compression level for all package parts.
+     * @param compression compression level.
+     *
+     * The default value is Compression::Default.
+     */
+    void setCompression(Compression compression);
+    /**
+     * @brief returns the default compression level for all package parts.
+     */
+    Compression compression() const;
+
+    /**
+     * @brief sets the compression level for a specific package part.
+     * @param partName the part path inside the package, f.e. "xl/worksheets/sheet1.xml".
+     * If @a partName ends with '/', the compression level is applied to all parts
+     * inside this folder, f.e. "xl/media/".
+     * @param compression compression level.
+     */
+    void setPartCompression(const QString &partName, Compression compression);
+    /**
+     * @brief returns the compression level that will be used for @a partName.
+     *
+     * If no compression level was set for this part or its folder, returns #compression().
+     */
+    Compression partCompression(const QString &partName) const;
+
+private:
+    Compression mCompression = Compression::Default;
+    QHash<QString, Compression> mPartCompression;
+};
+
+}
+
+#endif // QXLSX_XLSXSAVEOPTIONS_H
@@ -64,7 +64,10 @@ class  SharedStrings : public AbstractOOXmlFile
 {
 public:
     SharedStrings(CreateFlag flag);
+    SharedStrings *clone() const;
+    bool isSharedWith(const SharedStrings &other) const;
     int count() const;
+    int uniqueCount() const;
     bool isEmpty() const;
     
     int addSharedString(const QString &string);
@@ -72,6 +75,7 @@ public:
     void removeSharedString(const QString &string);
     void removeSharedString(const RichString &string);
     void incRefByStringIndex(int idx);
+    void merge(const SharedStrings &other);
 
     std::optional<int> getSharedStringIndex(const RichString &string) const;
     RichString getSharedString(int index) const;
@@ -70,10 +70,13 @@ class Styles : public AbstractOOXmlFile
 public:
     Styles(CreateFlag flag);
     ~Styles();
+    Styles *clone() const;
+    bool isSharedWith(const Styles &other) const;
     void addXfFormat(const Format &format, bool force=false);
     Format xfFormat(int idx) const;
     void addDxfFormat(const Format &format, bool force=false);
     Format dxfFormat(int idx) const;
+    static Format unregisteredFormat(const Format &format);
 
     void saveToXmlFile(QIODevice *device) const override;
     bool loadFromXmlFile(QIODevice *device) override;
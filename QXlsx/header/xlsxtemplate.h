@@ -0,0 +1,79 @@
+// xlsxtemplate.h
+
+#ifndef QXLSX_XLSXTEMPLATE_H
+#define QXLSX_XLSXTEMPLATE_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QIODevice>
+#include <QExplicitlySharedDataPointer>
+
+#include "xlsxglobal.h"
+#include "xlsxsaveoptions.h"
+
+namespace QXlsx {
+
+class TemplatePrivate;
+
+/**
+ * @brief The Template class holds a parsed .xlsx file that is used to produce
+ * many similar documents, f.e. reports.
+ *
+ * The template file is read and parsed once. The parts that the produced
+ * documents usually don't change (worksheets, the shared strings table, styles,
+ * the theme and media files) are also serialized and compressed once, when the
+ * template is created.
+ *
+ * A document created with Document(const Template &) is a copy-on-write
+ * snapshot of the template, so creating it doesn't depend on the template size.
+ * When the document is saved, the parts that were not modified since the
+ * document was created are written from the template as is, and only the
+ * modified sheets, shared strings and styles are serialized again.
+ *
+ * ```cpp
+ * Template report("template.xlsx");
+ * // for each request:
+ * Document doc(report);
+ * doc.write("B2", customerName);
+ * doc.saveAs(fileName);
+ * ```
+ *
+ * The template is immutable, so it can be shared between threads, and
+ * documents can be created from it concurrently. Template is implicitly shared:
+ * its copies are cheap.
+ */
+class QXLSX_EXPORT Template
+{
+public:
+    /**
+     * @brief creates a template from the file @a fileName.
+     * @param fileName the .xlsx file to read.
+     * @param options the options that are used to compress the template parts.
+     * A cached part is used only if a document is saved with the same compression
+     * level for this part.
+     */
+    explicit Template(const QString &fileName, const SaveOptions &options = SaveOptions());
+    /**
+     * @overload
+     * @brief creates a template from @a device.
+     * @param device the readable device to read the template from.
+     * @param options the options that are used to compress the template parts.
+     */
+    explicit Template(QIODevice *device, const SaveOptions &options = SaveOptions());
+    Template(const Template &other);
+    Template &operator=(const Template &other);
+    ~Template();
+
+    /**
+     * @brief returns `true` if the template was read successfully.
+     */
+    bool isValid() const;
+
+private:
+    friend class Document;
+    QExplicitlySharedDataPointer<TemplatePrivate> d;
+};
+
+}
+
+#endif // QXLSX_XLSXTEMPLATE_H
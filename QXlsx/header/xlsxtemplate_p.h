@@ -0,0 +1,77 @@
+// xlsxtemplate_p.h
+
+#ifndef QXLSX_XLSXTEMPLATE_P_H
+#define QXLSX_XLSXTEMPLATE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt Xlsx API.  It exists for the convenience
+// of the Qt Xlsx.  This header file may change from
+// version to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QSharedData>
+#include <QHash>
+#include <QMutex>
+
+#include <memory>
+
+#include "xlsxtemplate.h"
+#include "xlsxdocument.h"
+#include "xlsxzipwriter_p.h"
+
+namespace QXlsx {
+
+class Worksheet;
+class SharedStrings;
+class Styles;
+class Theme;
+class MediaFile;
+
+class TemplatePrivate : public QSharedData
+{
+public:
+    void init();
+
+    // These methods return the cached part if the document part was not
+    // modified since the document was created from the template, and nullptr
+    // otherwise.
+    const ZipWriter::CompressedData *worksheetPart(const Worksheet *sheet, SaveOptions::Compression compression) const;
+    const ZipWriter::CompressedData *sharedStringsPart(const SharedStrings *sharedStrings, SaveOptions::Compression compression) const;
+    const ZipWriter::CompressedData *stylesPart(const Styles *styles, SaveOptions::Compression compression) const;
+    const ZipWriter::CompressedData *themePart(const Theme *theme, SaveOptions::Compression compression) const;
+    const ZipWriter::CompressedData *mediaPart(const MediaFile *media, SaveOptions::Compression compression) const;
+
+    struct WorksheetPart
+    {
+        const Worksheet *sheet = nullptr;
+        QByteArray layout; //the part with empty sheetData
+        ZipWriter::CompressedData data;
+    };
+    struct MediaPart
+    {
+        QByteArray hashKey;
+        ZipWriter::CompressedData data;
+    };
+
+    std::unique_ptr<Document> document; //the parsed template, never modified
+    SaveOptions options;
+    mutable QMutex mutex; //serializes taking snapshots of the document
+
+    QHash<int, WorksheetPart> worksheets; //by sheet id
+    const SharedStrings *sharedStringsSource = nullptr;
+    ZipWriter::CompressedData sharedStrings;
+    const Styles *stylesSource = nullptr;
+    ZipWriter::CompressedData styles;
+    const Theme *themeSource = nullptr;
+    ZipWriter::CompressedData theme;
+    QHash<const MediaFile *, MediaPart> media;
+};
+
+}
+
+#endif // QXLSX_XLSXTEMPLATE_P_H
@@ -110,7 +110,5 @@ QString unescapeSheetName(const QString &sheetName);
 
 bool isSpaceReserveNeeded(const QString &string);
 
-QString convertSharedFormula(const QString &rootFormula, const CellReference &rootCell, const CellReference &cell);
-
 }
 #endif // XLSXUTILITY_H
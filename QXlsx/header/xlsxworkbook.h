@@ -226,11 +226,41 @@ of row R1 and column C1. */
      * This method places new sheet _at the end of sheets list_. The copy will have
      * index `sheetsCount()-1`.
      *
+     * A worksheet copy shares cells, row and column info, merges, validations and
+     * conditional formatting with the source sheet until either of them is
+     * modified, so copying a large sheet is cheap and only the modified cells
+     * and rows take additional memory.
+     *
      * @param index the sheet index (0 to #sheetsCount()-1).
      * @param newName the name of the new copy.
      * @return `true` on success.
      */
     bool copySheet(int index, const QString &newName=QString());
+    /**
+     * @brief imports a copy of @a sheet, a worksheet of another document, and
+     * gives it @a name.
+     *
+     * The new worksheet is placed _at the end of sheets list_. If @a name is empty,
+     * the name of @a sheet is used, with a number appended if this workbook
+     * already has a sheet of that name.
+     *
+     * The cells, row and column formats, merges, hyperlinks, comments, validations,
+     * conditional formatting and drawings are copied. The formats are added to the
+     * styles of this workbook once per distinct format of the source document, the
+     * strings of the sheet are added to the shared strings in one pass, and the
+     * pictures already present in this workbook are not added again, so the cost
+     * of the import is close to copying the cells.
+     *
+     * The formulas are copied as written; references to other sheets of the source
+     * document are not resolved in this workbook.
+     *
+     * @param sheet the worksheet to import. If it belongs to this workbook, it is
+     * copied as with copySheet().
+     * @param name the name of the new worksheet.
+     * @return pointer to the new worksheet or `nullptr` if a sheet named @a name
+     * already exists.
+     */
+    Worksheet *importSheet(const Worksheet &sheet, const QString &name = QString());
     /**
      * @brief moves the sheet from @a srcIndex to @a dstIndex.
      * @param srcIndex the old index.
@@ -442,6 +472,127 @@ of row R1 and column C1. */
      * The default value is `false`.
      */
     void setHtmlToRichStringEnabled(bool enable = true);
+    /**
+     * @brief returns whether equal formulas of adjacent cells are saved as
+     * shared formulas.
+     *
+     * The default value is `true`.
+     * @sa setSharedFormulasEnabled()
+     */
+    bool isSharedFormulasEnabled() const;
+    /**
+     * @brief enables saving the formulas of adjacent cells that differ only in
+     * their relative references as shared formulas.
+     *
+     * When the worksheets are saved, the runs of cells in a column (or else in
+     * a row) with the same formula in the R1C1 notation, f.e. `=B2*C2`, `=B3*C3`,
+     * ..., are written as one master formula and references to it. This makes
+     * the saved file smaller and faster to load. The cells in the worksheet are
+     * not changed.
+     *
+     * @param enable If `false`, each formula is saved as written.
+     */
+    void setSharedFormulasEnabled(bool enable = true);
+    /**
+     * @brief returns whether worksheets can be written from different threads.
+     *
+     * The default value is `false`.
+     * @sa setConcurrentWritingEnabled()
+     */
+    bool isConcurrentWritingEnabled() const;
+    /**
+     * @brief enables writing different worksheets of the workbook from different
+     * threads at the same time.
+     *
+     * In this mode each worksheet adds the strings and formats of its cells to
+     * its own registries instead of the workbook shared strings table and styles.
+     * The registries are merged into the workbook by #mergeConcurrentWrites(),
+     * which is called automatically when the document is saved, when a snapshot
+     * of the document is taken and when this mode is disabled. The sheets are merged
+     * in the workbook order, so the saved package does not depend on the timing
+     * of the writer threads.
+     *
+     * ```cpp
+     * workbook->setConcurrentWritingEnabled(true);
+     * QList<QFuture<void>> futures;
+     * for (auto sheet: sheets) // the sheets are added beforehand
+     *     futures << QtConcurrent::run([sheet]() { fillSheet(sheet); });
+     * for (auto &f: futures) f.waitForFinished();
+     * doc.saveAs("report.xlsx");
+     * ```
+     *
+     * Each worksheet must be written by one thread at a time. The threads may
+     * use the cell writing methods of Worksheet and set row and column formats.
+     * Adding and removing sheets, inserting images and charts, and changing
+     * the workbook itself must be done while no writer thread runs.
+     * Format objects may be shared between the threads.
+     *
+     * @param enable If `true`, enables the concurrent writing mode. If `false`,
+     * merges the registries and disables the mode.
+     */
+    void setConcurrentWritingEnabled(bool enable = true);
+    /**
+     * @brief merges the strings and formats written in the concurrent writing
+     * mode into the workbook shared strings table and styles.
+     *
+     * Must not be called while writer threads run.
+     * @sa setConcurrentWritingEnabled()
+     */
+    void mergeConcurrentWrites();
+    /**
+     * @brief calculates the formulas of all worksheets and stores the results
+     * as the cached values of the formula cells.
+     *
+     * The first call parses all formulas and builds the graph of their
+     * dependencies. The next calls recalculate only the formulas that depend,
+     * directly or through other formulas, on the cells modified after the
+     * previous call, and the formulas with volatile functions (TODAY(), NOW()).
+     * Adding, removing or renaming sheets and changing the defined names
+     * recalculates all formulas.
+     *
+     * ```cpp
+     * sheet->write("A1", 2);
+     * sheet->writeFormula("B1", CellFormula("A1*10"));
+     * workbook->recalculate(); // B1 = 20
+     * sheet->write("A1", 3);
+     * workbook->recalculate(); // only B1 is calculated, B1 = 30
+     * ```
+     *
+     * Numeric results are stored as numbers, text results as strings (the `str`
+     * cell type), logical results as booleans and errors as error cells. The
+     * functions that are not supported give the `#NAME?` error. The formulas
+     * that cannot be parsed (f.e. with array constants) keep their values.
+     *
+     * The formulas are calculated in levels: the formulas of a level refer only
+     * to the formulas of the previous levels, so they are independent of each
+     * other and are distributed between @a threads threads. The results of a
+     * level are stored before the next level starts. Wide models (many formulas
+     * over the same inputs) scale with the number of threads, long chains of
+     * formulas are calculated sequentially.
+     *
+     * @param threads the number of threads, including the calling one. If 0,
+     * QThread::idealThreadCount() is used.
+     * @return `false` if some formulas have circular references. These formulas
+     * and the formulas that depend on them keep their previous values. `true`
+     * otherwise.
+     *
+     * Thread safety: the workbook must not be modified while the method runs.
+     */
+    bool recalculate(int threads = 1);
+    /**
+     * @brief evaluates @a formula as if it were written in a cell of @a sheetName
+     * and returns the result.
+     * @param formula the formula text with or without the leading '='.
+     * @param sheetName the name of the worksheet used for the references without
+     * the sheet name. If empty, the active worksheet is used.
+     * @return a double, a QString or a bool value, a QString with the error
+     * (f.e. "#DIV/0!") if the formula gives an error, or an invalid QVariant if
+     * there is no such worksheet or the result is empty.
+     *
+     * The formula is not stored in the workbook. The cells are read as they are,
+     * so call #recalculate() first if the referenced formulas may be outdated.
+     */
+    QVariant evaluateFormula(const QString &formula, const QString &sheetName = QString());
     /**
      * @brief returns the default date format.
      *
@@ -678,11 +829,15 @@ private:
     friend class WorksheetPrivate;
     friend class Document;
     friend class DocumentPrivate;
+    friend class TemplatePrivate;
     friend class Cell;
     friend class FillFormat;
     friend class DrawingAnchor;
+    friend class FormulaEngine;
+    friend class ReferenceIndex;
 
     Workbook(Workbook::CreateFlag flag);
+    Workbook *snapshot() const;
 
     void saveToXmlFile(QIODevice *device) const override;
     bool loadFromXmlFile(QIODevice *device) override;
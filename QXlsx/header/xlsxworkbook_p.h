@@ -15,6 +15,11 @@
 
 namespace QXlsx {
 
+class ProgressControl;
+class FormulaEngine;
+class FormulaCache;
+class ReferenceIndex;
+
 //TODO: move out and make public
 struct WorkbookView
 {
@@ -74,6 +79,8 @@ public:
     bool strings_to_numbers_enabled{false};
     bool strings_to_hyperlinks_enabled{true};
     bool html_to_richstring_enabled{false};
+    bool shared_formulas_enabled{true};
+    bool concurrent_writing_enabled{false};
     bool readChartCashe{false};
     bool writeChartCashe{false};
 
@@ -123,6 +130,15 @@ public:
     int lastChartsheetIndex = 0;
     int lastSheetId = 0;
 
+    //Set by DocumentPrivate while the workbook is being loaded or saved
+    ProgressControl *progress = nullptr;
+    //Created by the first call of Workbook::recalculate() or Workbook::evaluateFormula()
+    std::shared_ptr<FormulaEngine> formulaEngine;
+    //The tokenized formulas, shared with the snapshots
+    std::shared_ptr<FormulaCache> formulaCache;
+    //Created by the first structural edit, f.e. renaming a sheet
+    std::shared_ptr<ReferenceIndex> referenceIndex;
+
     // workbookView
     mutable QList<WorkbookView> views;
 
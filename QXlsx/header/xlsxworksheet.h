@@ -4,9 +4,13 @@
 #define XLSXWORKSHEET_H
 
 #include <memory>
+#include <functional>
+#include <limits>
 #include <QtGlobal>
 #include <QObject>
 #include <QStringList>
+#include <QVector>
+#include <QBitArray>
 #include <QMap>
 #include <QVariant>
 #include <QPointF>
@@ -17,6 +21,9 @@
 
 #include "xlsxabstractsheet.h"
 #include "xlsxcell.h"
+#include "xlsxcelliterator.h"
+#include "xlsxcellindex.h"
+#include "xlsxconditionalformatevaluator.h"
 #include "xlsxcellrange.h"
 #include "xlsxcellreference.h"
 #include "xlsxsheetview.h"
@@ -108,6 +115,56 @@ ECMA-376 recommends `username@domain` format be used. */
     void write(QXmlStreamWriter &writer) const;
 };
 
+/**
+ * @brief The NumericColumn struct holds the numbers of one column of a cell
+ * range. It is returned by Worksheet::readNumericColumns().
+ */
+struct QXLSX_EXPORT NumericColumn
+{
+    int column = 0; /**< @brief The sheet column index (starting from 1). */
+    QVector<double> values; /**< @brief The cell values, one per range row. Cells without
+a number hold NaN. */
+    QBitArray validity; /**< @brief Bit `i` is set if `values[i]` holds the number of a cell. */
+};
+
+/**
+ * @brief The StringColumn struct holds the strings of one column of a cell
+ * range. It is returned by Worksheet::readStringColumns().
+ */
+struct QXLSX_EXPORT StringColumn
+{
+    int column = 0; /**< @brief The sheet column index (starting from 1). */
+    QVector<QString> values; /**< @brief The cell values, one per range row. Empty cells
+hold null strings. */
+    QBitArray validity; /**< @brief Bit `i` is set if `values[i]` holds the value of a cell. */
+};
+
+/**
+ * @brief The RangeStatistics struct holds the summary statistics of the numbers
+ * of a cell range or of one column of it. It is returned by Worksheet::aggregate()
+ * and Worksheet::columnStatistics().
+ *
+ * Like Excel's SUM, AVERAGE, MIN, MAX and STDEV, only numeric cells are counted.
+ * Blank, text and boolean cells are ignored. Formula cells give their cached
+ * numeric results.
+ */
+struct QXLSX_EXPORT RangeStatistics
+{
+    int column = 0; /**< @brief The sheet column index (starting from 1) or 0 if
+the statistics cover the whole range. */
+    qint64 count = 0; /**< @brief The number of numeric cells. */
+    double sum = 0.0; /**< @brief The sum of numbers (Excel's SUM). */
+    double min = std::numeric_limits<double>::quiet_NaN(); /**< @brief The minimum
+number or NaN if there are no numbers. Excel's MIN gives 0 in this case. */
+    double max = std::numeric_limits<double>::quiet_NaN(); /**< @brief The maximum
+number or NaN if there are no numbers. Excel's MAX gives 0 in this case. */
+    double mean = std::numeric_limits<double>::quiet_NaN(); /**< @brief The mean
+(Excel's AVERAGE) or NaN if there are no numbers. */
+    double stdDev = std::numeric_limits<double>::quiet_NaN(); /**< @brief The sample
+standard deviation (Excel's STDEV.S) or NaN if there are less than 2 numbers. */
+    qint64 errorCount = 0; /**< @brief The number of cells with errors. If it is not 0,
+Excel would give an error instead of the statistics. */
+};
 
 class WorksheetPrivate;
 
@@ -222,13 +279,49 @@ class QXLSX_EXPORT Worksheet : public AbstractSheet
 private:
     friend class DocumentPrivate;
     friend class Workbook;
+    friend class TemplatePrivate;
+    friend class CellIndex;
+    friend class CellIndexPrivate;
+    friend class ConditionalFormatEvaluator;
+    friend class ConditionalFormatEvaluatorPrivate;
+    friend class FormulaEngine;
+    friend class ReferenceIndex;
+    friend class Cell;
     friend class ::WorksheetTest;
     Worksheet(const QString &sheetName, int sheetId, Workbook *book, CreateFlag flag);
     Worksheet *copy(const QString &distName, int distId) const override;
+    Worksheet *snapshot(Workbook *workbook) const override;
 
 public:
     ~Worksheet();
 
+    /**
+     * @brief The Aggregate enum specifies the statistics computed by #aggregate().
+     */
+    enum Aggregate {
+        Sum = 1, /**< The sum of numbers */
+        Min = 2, /**< The minimum number */
+        Max = 4, /**< The maximum number */
+        Count = 8, /**< The number of numeric cells */
+        Mean = 16, /**< The mean of numbers */
+        StdDev = 32, /**< The sample standard deviation */
+        AllAggregates = Sum | Min | Max | Count | Mean | StdDev /**< All the statistics */
+    };
+    Q_DECLARE_FLAGS(Aggregates, Aggregate)
+
+    /**
+     * @brief The CopyOption enum specifies what #copyRange() and #moveRange() transfer.
+     */
+    enum CopyOption {
+        CopyValues = 1, /**< The cell values and formulas */
+        CopyFormats = 2, /**< The cell formats */
+        CopyMerges = 4, /**< The merged cells that lie within the range */
+        CopyHyperlinks = 8, /**< The hyperlinks */
+        CopyValidations = 16, /**< The data validations */
+        CopyAll = CopyValues | CopyFormats | CopyMerges | CopyHyperlinks | CopyValidations /**< All of the above */
+    };
+    Q_DECLARE_FLAGS(CopyOptions, CopyOption)
+
 public:
 
     /**
@@ -330,6 +423,193 @@ public:
      */
     QVariant read(int row, int column) const;
 
+    /**
+     * @brief reads the numbers of @a range into a dense row-major buffer.
+     * @param range the cell range to read.
+     * @param values buffer of at least `range.rowCount() * range.columnCount()`
+     * elements. Cells without a number (empty, string, boolean and error cells)
+     * get NaN.
+     * @param validity optional buffer of the same size. Each element is set to 1
+     * if the corresponding cell holds a number and to 0 otherwise.
+     * @return the number of numeric cells read or -1 if @a range is invalid.
+     *
+     * Unlike #read(), this method does not create a QVariant for each cell and
+     * visits only the cells that exist in the range. Formula cells give their
+     * cached results; dates are returned as serial numbers.
+     *
+     * ```cpp
+     * CellRange range("B2:F100001");
+     * QVector<double> data(range.rowCount() * range.columnCount());
+     * QVector<quint8> valid(data.size());
+     * sheet->readNumbers(range, data.data(), valid.data());
+     * ```
+     */
+    int readNumbers(const CellRange &range, double *values, quint8 *validity = nullptr) const;
+    /**
+     * @brief reads the values of @a range as strings into @a values.
+     * @param range the cell range to read.
+     * @param values the list that receives `range.rowCount() * range.columnCount()`
+     * strings in the row-major order. Empty cells give null strings, numeric and
+     * boolean cells give their values converted to strings.
+     * @return the number of non-empty cells read or -1 if @a range is invalid.
+     *
+     * Formula cells give their cached results, not the formula text.
+     */
+    int readStrings(const CellRange &range, QStringList &values) const;
+    /**
+     * @brief reads @a range column by column as numbers.
+     * @param range the cell range to read.
+     * @return a list of range.columnCount() columns. Returns an empty list if
+     * @a range is invalid.
+     * @sa readNumbers()
+     */
+    QVector<NumericColumn> readNumericColumns(const CellRange &range) const;
+    /**
+     * @brief reads @a range column by column as strings.
+     * @param range the cell range to read.
+     * @return a list of range.columnCount() columns. Returns an empty list if
+     * @a range is invalid.
+     * @sa readStrings()
+     */
+    QVector<StringColumn> readStringColumns(const CellRange &range) const;
+    /**
+     * @brief computes the summary statistics of the numbers in @a range.
+     * @param range the cell range.
+     * @param aggregates the statistics to compute. The fields of the result that
+     * are not requested keep their default values. The count and the number of
+     * errors are always computed.
+     * @return the statistics with RangeStatistics::column set to 0. Returns the
+     * default statistics if @a range is invalid.
+     *
+     * The numbers are gathered from the stored cells into dense buffers which are
+     * reduced by tight loops, so no QVariant is created per cell and empty cells
+     * cost nothing. Blank, text and boolean cells are ignored as in Excel's SUM
+     * and AVERAGE.
+     *
+     * ```cpp
+     * auto stats = sheet->aggregate(CellRange("B2:B100000"), Worksheet::Sum | Worksheet::Mean);
+     * sheet->write("B100001", stats.sum);
+     * ```
+     * @sa columnStatistics()
+     */
+    RangeStatistics aggregate(const CellRange &range, Aggregates aggregates = AllAggregates) const;
+    /**
+     * @brief computes the summary statistics of each column of @a range.
+     * @param range the cell range.
+     * @param aggregates the statistics to compute.
+     * @return a list of range.columnCount() statistics, one per column. Returns an
+     * empty list if @a range is invalid.
+     * @sa aggregate()
+     */
+    QVector<RangeStatistics> columnStatistics(const CellRange &range,
+                                              Aggregates aggregates = AllAggregates) const;
+    /**
+     * @brief builds a lookup index of the cell values of @a keyColumnRange.
+     * @param keyColumnRange the range to index, usually a single key column.
+     * If it has several columns, a key is found in any of them.
+     * @return the index or an invalid index if @a keyColumnRange is invalid.
+     *
+     * Building the index costs one pass over the range, then each lookup costs
+     * O(1) for the exact matches and O(log n) for the approximate ones. The index
+     * is rebuilt automatically on the next lookup after the sheet cells are
+     * modified with the methods of this class.
+     * @sa CellIndex
+     */
+    CellIndex buildIndex(const CellRange &keyColumnRange) const;
+
+    /**
+     * @brief returns the rows of the sheet that have non-empty cells.
+     *
+     * The rows and their cells are visited in the storage order (top to bottom,
+     * left to right), empty cells are never visited, so iterating a sparse sheet
+     * costs as much as the number of its non-empty cells.
+     *
+     * ```cpp
+     * for (const RowView &row: sheet->rows()) {
+     *     for (const CellView &cell: row.cells()) {
+     *         if (cell.isNumber())
+     *             sum += cell.number();
+     *     }
+     * }
+     * ```
+     * @note The iterators are invalidated by any modification of the sheet cells.
+     */
+    IteratorRange<RowIterator> rows() const;
+    /**
+     * @overload
+     * @brief returns the rows of @a range that have non-empty cells within @a range.
+     *
+     * RowView::cells() of each row returns only the cells within @a range.
+     * Returns an empty range if @a range is invalid.
+     */
+    IteratorRange<RowIterator> rows(const CellRange &range) const;
+
+    /**
+     * @brief runs @a kernel on contiguous row blocks of @a range in parallel.
+     * @param range the cell range to visit.
+     * @param kernel a function that is called once for each block. It may be
+     * called from several threads at the same time.
+     * @param threads the number of threads, including the calling one. If 0,
+     * QThread::idealThreadCount() is used.
+     * @return `false` if @a range is invalid, `true` otherwise.
+     *
+     * The stored rows of @a range are split into blocks with about the same
+     * number of rows. The blocks are handed out to the threads one by one, so a
+     * thread that has finished its block takes the next one, and slow blocks do not
+     * stall the other threads. The method returns when all blocks are processed.
+     *
+     * Thread safety: the kernel gets read-only access to the sheet. It may call the
+     * const methods of this sheet, its cells, CellView and Format, which only read
+     * the cell table, the styles and the shared strings. Neither the kernel nor
+     * other threads may modify the sheet or its workbook until the method returns.
+     * The kernel must not throw.
+     *
+     * ```cpp
+     * sheet->parallelForEachRowBlock(sheet->dimension(), [](const RowBlock &block) {
+     *     for (const RowView &row: block.rows())
+     *         validateRow(row);
+     * });
+     * ```
+     */
+    bool parallelForEachRowBlock(const CellRange &range, const std::function<void (const RowBlock &block)> &kernel,
+                                 int threads = 0) const;
+    /**
+     * @overload
+     * @brief runs @a kernel on contiguous row blocks of @a range in parallel and
+     * reduces the block results.
+     * @param range the cell range to visit.
+     * @param kernel a function `T kernel(const RowBlock &block)` that computes the
+     * result of one block.
+     * @param reduce a function `T reduce(const T &accumulated, const T &blockResult)`.
+     * It is called in the calling thread in the order of blocks, so the result is
+     * the same regardless of the number of threads.
+     * @param initial the initial accumulated value.
+     * @param threads the number of threads, including the calling one. If 0,
+     * QThread::idealThreadCount() is used.
+     * @return the accumulated value or @a initial if @a range is invalid.
+     *
+     * ```cpp
+     * double sum = sheet->parallelForEachRowBlock(range, [](const RowBlock &block) {
+     *     double s = 0;
+     *     for (const RowView &row: block.rows())
+     *         for (const CellView &cell: row.cells())
+     *             if (cell.isNumber()) s += cell.number();
+     *     return s;
+     * }, std::plus<double>(), 0.0);
+     * ```
+     */
+    template <typename T, typename Kernel, typename Reduce>
+    T parallelForEachRowBlock(const CellRange &range, Kernel kernel, Reduce reduce, T initial, int threads = 0) const
+    {
+        QVector<T> results;
+        runRowBlocks(range, threads,
+                     [&results](int blockCount) { results.resize(blockCount); },
+                     [&results, &kernel](const RowBlock &block) { results[block.index()] = kernel(block); });
+        for (const T &value: qAsConst(results))
+            initial = reduce(initial, value);
+        return initial;
+    }
+
     /**
      * @brief writes @a value into the cell @a ref and applies @a format.
      * @param ref the cell reference
@@ -537,6 +817,125 @@ public:
     bool writeHyperlink(const CellReference &row_column, const QUrl &url, const Format &format=Format(), const QString &display=QString(), const QString &tip=QString());
     bool writeHyperlink(int row, int column, const QUrl &url, const Format &format=Format(), const QString &display=QString(), const QString &tip=QString());
 
+    /// Bulk write methods
+    /**
+     * @brief writes @a count numbers from @a values into the row @a row, starting
+     * from the column @a firstColumn, and applies @a format to the cells.
+     * @param row row index (starting from 1).
+     * @param firstColumn index of the first column to write to (starting from 1).
+     * @param values contiguous array of at least @a count values.
+     * @param count number of values to write.
+     * @param format format to apply. If @a format is invalid, the cells keep their current formats.
+     * @return `true` on success, `false` if the range exceeds the sheet limits.
+     *
+     * The range is validated and @a format is registered once per call, so writing
+     * a row with this method is much faster than calling #writeNumeric() for each value.
+     */
+    bool writeRow(int row, int firstColumn, const double *values, int count, const Format &format=Format());
+    /**
+     * @overload
+     * @brief writes numeric @a values into the row @a row, starting from the column @a firstColumn.
+     */
+    bool writeRow(int row, int firstColumn, const QVector<double> &values, const Format &format=Format());
+    /**
+     * @overload
+     * @brief writes @a count boolean @a values into the row @a row, starting from the column @a firstColumn.
+     */
+    bool writeRow(int row, int firstColumn, const bool *values, int count, const Format &format=Format());
+    /**
+     * @overload
+     * @brief writes @a values into shared string cells of the row @a row, starting
+     * from the column @a firstColumn.
+     *
+     * Strings that contain HTML tags are written as rich strings if
+     * Workbook::isHtmlToRichStringEnabled() is true.
+     */
+    bool writeRow(int row, int firstColumn, const QStringList &values, const Format &format=Format());
+    /**
+     * @overload
+     * @brief writes date-time @a values into the row @a row, starting from the column @a firstColumn.
+     *
+     * If @a format has no date-time number format, Workbook::defaultDateFormat() is used.
+     */
+    bool writeRow(int row, int firstColumn, const QList<QDateTime> &values, const Format &format=Format());
+    /**
+     * @overload
+     * @brief writes date @a values into the row @a row, starting from the column @a firstColumn.
+     *
+     * If @a format has no date-time number format, Workbook::defaultDateFormat() is used.
+     */
+    bool writeRow(int row, int firstColumn, const QList<QDate> &values, const Format &format=Format());
+
+    /**
+     * @brief writes @a count numbers from @a values into the column @a column, starting
+     * from the row @a firstRow, and applies @a format to the cells.
+     * @param firstRow index of the first row to write to (starting from 1).
+     * @param column column index (starting from 1).
+     * @param values contiguous array of at least @a count values.
+     * @param count number of values to write.
+     * @param format format to apply. If @a format is invalid, the cells keep their current formats.
+     * @return `true` on success, `false` if the range exceeds the sheet limits.
+     *
+     * The range is validated and @a format is registered once per call.
+     */
+    bool writeColumn(int firstRow, int column, const double *values, int count, const Format &format=Format());
+    /**
+     * @overload
+     * @brief writes numeric @a values into the column @a column, starting from the row @a firstRow.
+     */
+    bool writeColumn(int firstRow, int column, const QVector<double> &values, const Format &format=Format());
+    /**
+     * @overload
+     * @brief writes @a count boolean @a values into the column @a column, starting from the row @a firstRow.
+     */
+    bool writeColumn(int firstRow, int column, const bool *values, int count, const Format &format=Format());
+    /**
+     * @overload
+     * @brief writes @a values into shared string cells of the column @a column, starting
+     * from the row @a firstRow.
+     */
+    bool writeColumn(int firstRow, int column, const QStringList &values, const Format &format=Format());
+    /**
+     * @overload
+     * @brief writes date-time @a values into the column @a column, starting from the row @a firstRow.
+     */
+    bool writeColumn(int firstRow, int column, const QList<QDateTime> &values, const Format &format=Format());
+    /**
+     * @overload
+     * @brief writes date @a values into the column @a column, starting from the row @a firstRow.
+     */
+    bool writeColumn(int firstRow, int column, const QList<QDate> &values, const Format &format=Format());
+
+    /**
+     * @brief writes a block of numbers into @a rows x @a columns cells starting from @a topLeft.
+     * @param topLeft the top left cell of the block.
+     * @param rows number of rows in the block.
+     * @param columns number of columns in the block.
+     * @param values contiguous row-major array of at least @a rows * @a columns values.
+     * @param formats either one format for the whole block or a format for each
+     * column of the block. Invalid formats keep the current formats of the cells.
+     * @return `true` on success, `false` if the block exceeds the sheet limits.
+     *
+     * ```cpp
+     * QVector<double> data(1000 * 20);
+     * // ... fill data
+     * sheet->writeBlock(CellReference(2, 1), 1000, 20, data.constData(), {numberFormat});
+     * ```
+     */
+    bool writeBlock(const CellReference &topLeft, int rows, int columns, const double *values,
+                    const QList<Format> &formats=QList<Format>());
+    /**
+     * @overload
+     * @brief writes a block of shared strings into @a rows x @a columns cells starting from @a topLeft.
+     * @param values function that returns the string for the cell (row, column).
+     * The returned view must stay valid until the next call of @a values.
+     *
+     * This method allows writing strings without collecting them into a QStringList first.
+     */
+    bool writeBlock(const CellReference &topLeft, int rows, int columns,
+                    const std::function<QStringView (int row, int column)> &values,
+                    const QList<Format> &formats=QList<Format>());
+
 
     /// Data Validation methods
     /**
@@ -683,6 +1082,16 @@ public:
      * @brief returns the count of data validations added to the worksheet.
      */
     int dataValidationsCount() const;
+    /**
+     * @brief returns the indexes of the data validations that apply to any
+     * cell of @a range, in ascending order.
+     *
+     * The ranges of the validations are kept in a spatial index, so the
+     * validations are not scanned.
+     * @param range the range of cells, e.g. `CellRange(row, column, row, column)`
+     * for one cell.
+     */
+    QList<int> dataValidationIndexes(const CellRange &range) const;
 
 
     /// Conditional formatting
@@ -734,6 +1143,30 @@ public:
      * @return `true` on success.
      */
     bool addConditionalFormatting(const ConditionalFormatting &cf);
+    /**
+     * @brief returns the indexes of the conditional formattings that apply to
+     * any cell of @a range, in ascending order.
+     *
+     * The ranges of the formattings are kept in a spatial index, so the
+     * formattings are not scanned.
+     * @param range the range of cells, e.g. `CellRange(row, column, row, column)`
+     * for one cell.
+     */
+    QList<int> conditionalFormattingIndexes(const CellRange &range) const;
+    /**
+     * @brief creates an evaluator of the conditional formattings of the sheet.
+     * @return the evaluator or an invalid evaluator if the sheet does not
+     * belong to a workbook.
+     *
+     * The evaluator computes the format, the color scale color and the data bar
+     * of each cell of the ranges of the formattings. The statistics the rules
+     * depend on (the averages, the top N thresholds, the duplicate values) are
+     * computed once per rule, so evaluating a range costs one pass over it.
+     * The formattings added or modified after the evaluator is created are not
+     * evaluated.
+     * @sa ConditionalFormatEvaluator
+     */
+    ConditionalFormatEvaluator conditionalFormatEvaluator() const;
 
     /// Direct manipulation of cells
 
@@ -745,8 +1178,19 @@ public:
      *
      * If no data or format were written into @a ref, this method returns
      * `nullptr`. Use #write() methods to implicitly create a cell.
+     *
+     * If the cell is shared with a snapshot of this worksheet (see
+     * Document::snapshot()), it is copied before being returned, so that
+     * modifying it does not affect the snapshot. Looking the cell up is not
+     * a modification: the setters of the cell tell the worksheet when the
+     * cell is modified. Use the const overload to only read the cell.
      */
-    Cell *cell(const CellReference &ref) const;
+    Cell *cell(const CellReference &ref);
+    /**
+     * @overload
+     * @brief returns a read-only cell by its reference.
+     */
+    const Cell *cell(const CellReference &ref) const;
     /**
      * @overload
      * @brief returns cell by its row and column number.
@@ -758,7 +1202,12 @@ public:
      * If no data or format were written into (@a row, @a column), this method
      * returns `nullptr`. Use #write() methods to implicitly create a cell.
      */
-    Cell *cell(int row, int column) const;
+    Cell *cell(int row, int column);
+    /**
+     * @overload
+     * @brief returns a read-only cell by its row and column number.
+     */
+    const Cell *cell(int row, int column) const;
 
     /**
      * @brief Inserts an @a image at the position @a ref.
@@ -882,19 +1331,31 @@ public:
      *
      * The first cell will retain its data, other cells will be cleared.
      * All cells will get the same @a format if a valid @a format is given.
-     * @return `true` on success.
+     * @return `true` on success, `false` if @a range is a single cell or
+     * overlaps merged cells.
      */
 
 
     /// Rows, columns and cells
 
     bool mergeCells(const CellRange &range, const Format &format=Format());
+    /**
+     * @overload
+     * @brief Merges each of @a ranges.
+     *
+     * The ranges are checked for overlaps with each other and with the merged
+     * cells at once, so merging n ranges costs O(n log n) instead of O(n^2)
+     * for n calls of mergeCells(const CellRange &, const Format &).
+     * @return `true` on success, `false` if @a ranges is empty, any of them is
+     * a single cell or the ranges overlap. Nothing is merged in that case.
+     */
+    bool mergeCells(const QList<CellRange> &ranges, const Format &format=Format());
     /**
      * @brief Un-merges a @a range of cells.
      * @param range the range to unmerge.
      * @return `true` if @a range was successfully unmerged.
-     * @note This method does not check the merged cells range for intersections with
-     * other merged cells.
+     * @note @a range must be equal to a merged range. The last merged range
+     * takes the place of @a range in mergedCells().
      */
     bool unmergeCells(const CellRange &range);
     /**
@@ -902,6 +1363,117 @@ public:
      * @return non-empty list of merged ranges if any of cells were merged.
      */
     QList<CellRange> mergedCells() const;
+    /**
+     * @overload
+     * @brief returns the merged ranges that intersect @a range.
+     *
+     * The merged ranges are kept in a spatial index, so the cost depends on
+     * the number of the ranges found, not on the number of merged ranges.
+     */
+    QList<CellRange> mergedCells(const CellRange &range) const;
+    /**
+     * @brief returns the merged range that contains @a cell.
+     * @return the merged range or an invalid range if @a cell is not merged.
+     */
+    CellRange mergedRange(const CellReference &cell) const;
+
+    /**
+     * @brief inserts @a count empty rows before @a row.
+     *
+     * The cells, comments, hyperlinks and row properties from @a row down are
+     * moved down. Merged cells, data validations, conditional formattings and
+     * the autofilter that contain @a row grow. The references to the moved cells
+     * in the formulas, defined names, data validations, conditional formattings
+     * and chart series of the whole workbook are adjusted.
+     * @param row the row index (starting from 1).
+     * @param count the number of rows to insert.
+     * @return `false` if the parameters are invalid or non-empty rows would be
+     * pushed out of the sheet, `true` otherwise.
+     */
+    bool insertRows(int row, int count = 1);
+    /**
+     * @brief removes @a count rows starting from @a row.
+     *
+     * The rows below are moved up. The merged cells and ranges that lie within the
+     * removed rows are removed, those that overlap them shrink. The references
+     * to the removed cells are replaced with `#REF!`, the references to the moved
+     * cells are adjusted in the whole workbook.
+     * @param row the row index (starting from 1).
+     * @param count the number of rows to remove.
+     * @return `false` if the parameters are invalid, `true` otherwise.
+     */
+    bool removeRows(int row, int count = 1);
+    /**
+     * @brief inserts @a count empty columns before @a column.
+     *
+     * Works like #insertRows() for the columns.
+     * @param column the column index (starting from 1).
+     * @param count the number of columns to insert.
+     * @return `false` if the parameters are invalid or non-empty columns would be
+     * pushed out of the sheet, `true` otherwise.
+     */
+    bool insertColumns(int column, int count = 1);
+    /**
+     * @brief removes @a count columns starting from @a column.
+     *
+     * Works like #removeRows() for the columns.
+     * @param column the column index (starting from 1).
+     * @param count the number of columns to remove.
+     * @return `false` if the parameters are invalid, `true` otherwise.
+     */
+    bool removeColumns(int column, int count = 1);
+
+    /**
+     * @brief copies the cells of @a source to the range that starts at @a destination.
+     *
+     * The cells are copied as they are stored: the values keep their types and
+     * the formats are not registered again. The relative references of the
+     * formulas are translated by the offset between the ranges, like in Excel.
+     * Empty cells of @a source clear the destination cells. The ranges may overlap.
+     * @param source the range to copy.
+     * @param destination the top left cell of the destination range.
+     * @param options what to copy.
+     * @return `false` if the ranges are invalid, `true` otherwise.
+     */
+    bool copyRange(const CellRange &source, const CellReference &destination, CopyOptions options = CopyAll);
+    /**
+     * @brief copies the cells of @a source to the range of @a target that starts at @a destination.
+     *
+     * @a target may belong to another document; the formats are then added to
+     * the styles of that document once per distinct format. The references without
+     * a sheet name refer to @a target after the copy.
+     * @param source the range of this sheet to copy.
+     * @param target the destination sheet.
+     * @param destination the top left cell of the destination range.
+     * @param options what to copy.
+     * @return `false` if the ranges are invalid or @a target is null, `true` otherwise.
+     */
+    bool copyRange(const CellRange &source, Worksheet *target, const CellReference &destination,
+                   CopyOptions options = CopyAll);
+    /**
+     * @brief moves the cells of @a source to the range that starts at @a destination.
+     *
+     * Unlike #copyRange(), the moved formulas keep their references. The references
+     * to the cells within @a source in the whole workbook follow the cells.
+     * @param source the range to move.
+     * @param destination the top left cell of the destination range.
+     * @param options what to move.
+     * @return `false` if the ranges are invalid, `true` otherwise.
+     */
+    bool moveRange(const CellRange &source, const CellReference &destination, CopyOptions options = CopyAll);
+    /**
+     * @brief moves the cells of @a source to the range of @a target that starts at @a destination.
+     *
+     * If @a target belongs to another document, the references to the moved cells
+     * are not adjusted.
+     * @param source the range of this sheet to move.
+     * @param target the destination sheet.
+     * @param destination the top left cell of the destination range.
+     * @param options what to move.
+     * @return `false` if the ranges are invalid or @a target is null, `true` otherwise.
+     */
+    bool moveRange(const CellRange &source, Worksheet *target, const CellReference &destination,
+                   CopyOptions options = CopyAll);
 
     bool setColumnWidth(const CellRange& range, double width);
     bool setColumnFormat(const CellRange& range, const Format &format);
@@ -2019,8 +2591,14 @@ public:
 private:
     QMap<int, double> getMaximumColumnWidths(int firstRow = 1, int lastRow = INT_MAX);
     void saveToXmlFile(QIODevice *device) const override;
+    void saveToXmlFile(QIODevice *device, bool saveSheetData) const;
+    bool runRowBlocks(const CellRange &range, int threads, const std::function<void (int blockCount)> &prepare,
+                      const std::function<void (const RowBlock &block)> &kernel) const;
     bool loadFromXmlFile(QIODevice *device) override;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(Worksheet::Aggregates)
+Q_DECLARE_OPERATORS_FOR_FLAGS(Worksheet::CopyOptions)
+
 }
 #endif // XLSXWORKSHEET_H
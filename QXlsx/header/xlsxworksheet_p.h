@@ -9,6 +9,11 @@
 #include <QVector>
 #include <QImage>
 #include <QSharedPointer>
+#include <QAtomicInt>
+#include <QSet>
+
+#include <atomic>
+#include <memory>
 
 #include <QRegularExpression>
 
@@ -19,6 +24,9 @@
 #include "xlsxconditionalformatting.h"
 #include "xlsxcellformula.h"
 #include "xlsxautofilter.h"
+#include "xlsxrowfilter.h"
+#include "xlsxformulacache_p.h"
+#include "xlsxrangeindex_p.h"
 
 class QXmlStreamWriter;
 class QXmlStreamReader;
@@ -31,6 +39,25 @@ const int XLSX_STRING_MAX = 32767;
 constexpr const double XLSX_DEFAULT_ROW_HEIGHT = 14.4;
 
 class SharedStrings;
+class ProgressControl;
+class ReferenceIndex;
+
+//The part of a sheet that its cells refer to, held by the cells instead of a
+//pointer to the sheet. The cells that the sheet shares with its copies and
+//snapshots keep it alive, so they stay valid after the sheet is deleted.
+struct CellOwner
+{
+    std::atomic<bool> date1904 {false}; //updated by Workbook::setDate1904()
+    Worksheet *sheet = nullptr; //reset when the sheet is deleted, used by the Cell setters
+};
+
+//A range of cells watched by a cache built from them, such as a CellIndex.
+//The revision is incremented when the cells of the range are modified.
+struct CellRangeWatch
+{
+    CellRange range;
+    quint64 revision = 0;
+};
 
 struct XlsxHyperlinkData
 {
@@ -96,6 +123,19 @@ struct XlsxRowInfo
     }
 };
 
+//The data of a c element of sheetData, read before the cell is created
+struct XlsxRawCell
+{
+    int row = -1;
+    int column = -1;
+    int styleIndex = -1;
+    Cell::Type type = Cell::Type::Custom;
+    QString value; //text of the v element
+    bool hasValue = false;
+    std::optional<CellFormula> formula;
+    std::optional<RichString> inlineString;
+};
+
 //TODO: convert to explicitly shareable to reduce memory
 struct XlsxColumnInfo
 {
@@ -117,6 +157,24 @@ struct XlsxColumnInfo
     std::optional<bool> collapsed;
 };
 
+//A structural edit of a sheet: count rows (columns) inserted before first,
+//or -count rows (columns) removed starting from first
+struct SheetShift
+{
+    bool rows = true;
+    int first = 1;
+    int count = 0;
+
+    int end() const { return count < 0 ? first - count : first; } //the first row (column) that is moved
+    int limit() const { return rows ? XLSX_ROW_MAX : XLSX_COLUMN_MAX; }
+    CellRange area() const;
+    bool adjust(int &from, int &to) const;
+    bool adjust(CellRange &range) const;
+    bool adjust(FormulaReference &reference) const;
+    bool splits(int from, int to) const;
+    bool splits(const FormulaReference &reference, const CellRange &cells) const;
+};
+
 class WorksheetPrivate : public AbstractSheetPrivate
 {
     Q_DECLARE_PUBLIC(Worksheet)
@@ -131,12 +189,50 @@ public:
     bool addRowToDimensions(int row);
     bool addColumnToDimensions(int column);
     Format cellFormat(int row, int col) const;
+    Cell *ownedCell(int row, int col);
+    Cell *detachedCell(int row, int col);
+    void cellModifiedInPlace();
+    void setCell(int row, int column, std::shared_ptr<Cell> cell);
+    void recordChange(int row, int column);
+    void cellsModified(const CellRange &range = CellRange());
+    std::shared_ptr<const CellRangeWatch> watchRange(const CellRange &range) const;
+    QString formulaText(int row, int column, const Cell *cell) const;
+    FormulaTemplatePtr formulaTemplate(int row, int column, const Cell *cell) const;
+    void setFormulaResult(int row, int column, Cell::Type type, const QVariant &value);
+    XlsxRowInfo *detachedRowInfo(int row);
+    bool sharesSheetDataWith(const WorksheetPrivate &other) const;
+    bool shiftCells(const SheetShift &shift);
+    bool splitSharedFormulas(const Worksheet *target, const SheetShift &shift, const ReferenceIndex *index);
+    void unshareFormula(int sharedIndex);
+    bool unshareFormulas(const CellRange &range);
+    bool copyCells(const CellRange &source, Worksheet *target, const CellReference &destination,
+                   Worksheet::CopyOptions options, bool move);
+    void removeCells(const CellRange &range);
+    void clearCells(const CellRange &range, Worksheet::CopyOptions options);
+    void importData();
+    const RangeIndex &mergeIndex() const;
+    const RangeIndex &validationIndex() const;
+    const RangeIndex &formattingIndex() const;
+    void invalidateRangeIndexes();
+    template <typename CreateCell>
+    bool writeCells(int firstRow, int firstColumn, int rows, int columns,
+                    const QList<Format> &formats, bool dateTime, CreateCell createCell);
+    bool writeNumbers(int firstRow, int firstColumn, int rows, int columns, const double *values,
+                      const QList<Format> &formats, bool dateTime = false);
+    bool writeBools(int firstRow, int firstColumn, int rows, int columns, const bool *values,
+                    const QList<Format> &formats);
+    bool writeStrings(int firstRow, int firstColumn, int rows, int columns,
+                      const std::function<QStringView (int row, int column)> &values,
+                      const QList<Format> &formats);
+    template <typename Visit>
+    void forEachCell(const CellRange &range, Visit visit) const;
     QString generateDimensionString() const;
     QMap<int, QString> calculateSpans() const;
     void validateDimension();
 
     void saveXmlSheetData(QXmlStreamWriter &writer) const;
-    void saveXmlCellData(QXmlStreamWriter &writer, int row, int col, std::shared_ptr<Cell> cell) const;
+    void saveXmlCellData(QXmlStreamWriter &writer, int row, int col, std::shared_ptr<Cell> cell,
+                         const CellFormula &formula) const;
     void saveXmlMergeCells(QXmlStreamWriter &writer) const;
     void saveXmlHyperlinks(QXmlStreamWriter &writer) const;
     void saveXmlDataValidations(QXmlStreamWriter &writer) const;
@@ -146,20 +242,40 @@ public:
     void loadXmlMergeCells(QXmlStreamReader &reader);
     void loadXmlDataValidations(QXmlStreamReader &reader);
     void loadXmlHyperlinks(QXmlStreamReader &reader);
-    void loadXmlCell(QXmlStreamReader &reader);
+    void readXmlCell(QXmlStreamReader &reader, XlsxRawCell &raw);
+    std::shared_ptr<Cell> createLoadedCell(const XlsxRawCell &raw);
 
     bool isColumnRangeValid(int colFirst, int colLast) const;
     QList<QPair<int,int>> getIntervals() const;
 
     SharedStrings *sharedStrings() const;
+    SharedStrings *stringRegistry();
+    void registerFormat(const Format &format);
+    void mergeWriterRegistries();
+    ProgressControl *progress() const;
 
 public:
     QMap<int, QMap<int, std::shared_ptr<Cell> > > cellTable;
+    quint64 cellRevision = 0; //incremented on each modification of cellTable
+    std::shared_ptr<CellOwner> cellOwner; //of the cells created for this sheet
+    //the ranges watched by the cell indexes of the sheet, see cellsModified()
+    mutable QVector<std::weak_ptr<CellRangeWatch> > rangeWatches;
+    //The cells modified since the last calculation, recorded for the formula engine
+    //(see Workbook::recalculate()). Keys are (row << 32 | column).
+    bool trackChanges = false;
+    bool changesOverflow = false;
+    QSet<quint64> changedCells;
+    //The ranges modified since the last update of the reference index of the
+    //workbook (see ReferenceIndex::update()), recorded by cellsModified().
+    bool trackReferences = false;
+    bool referencesOverflow = false;
+    QVector<CellRange> referenceChanges;
 
     QMap<int, QMap<int, QString> > comments;
     QMap<int, QMap<int, QSharedPointer<XlsxHyperlinkData> > > urlTable;
     QList<CellRange> merges;
     QMap<int, QSharedPointer<XlsxRowInfo> > rowsInfo;
+    mutable QAtomicInt rowsInfoShared = 0; //row infos are shared with a snapshot, set by const snapshot()
     QMap<int, XlsxColumnInfo> colsInfo;
 
     std::optional<bool> disableValidationPrompts; //default = false;
@@ -168,6 +284,15 @@ public:
     QList<DataValidation> dataValidationsList;
     QList<ConditionalFormatting> conditionalFormattingList;
 
+    //Spatial indexes of merges, dataValidationsList and conditionalFormattingList,
+    //built on the first query. The values are the positions in the lists. Adding
+    //or removing a merged range or appending a rule updates the index; the other
+    //modifications of the lists call invalidateRangeIndexes(). The lazy builds
+    //are serialized, so concurrent const queries are safe.
+    mutable RangeIndex mergesIndex;
+    mutable RangeIndex validationsIndex;
+    mutable RangeIndex formattingsIndex;
+
     QMap<int, CellFormula> sharedFormulaMap; // shared formula map
 
     CellRange dimension;
@@ -178,8 +303,16 @@ public:
     QList<ProtectedRange> protectedRanges;
 
 
+    //Registries of the sheet writer in the concurrent writing mode (see
+    //Workbook::setConcurrentWritingEnabled()). They are merged into the
+    //workbook shared strings and styles by mergeWriterRegistries().
+    std::shared_ptr<SharedStrings> writerStrings;
+    QList<Format> writerFormats;
+    QSet<QByteArray> writerFormatKeys;
+
     QRegularExpression urlPattern {QStringLiteral("^([fh]tt?ps?://)|(mailto:)|(file://)")};
     std::optional<bool> fullCalcOnLoad;
+    RowFilter loadFilter; //applied to the next load of sheetData, see Document::setRowFilter()
 private:
 
     static double calculateColWidth(int characters);
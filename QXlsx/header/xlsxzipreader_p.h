@@ -24,12 +24,14 @@ public:
     bool exists() const;
     QStringList filePaths() const;
     QByteArray fileData(const QString &fileName) const;
+    qint64 totalSize() const;
 
 private:
     Q_DISABLE_COPY(ZipReader)
     void init();
     QScopedPointer<QZipReader> m_reader;
     QStringList m_filePaths;
+    qint64 m_totalSize = 0;
 };
 
 }
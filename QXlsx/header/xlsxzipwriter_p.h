@@ -6,27 +6,105 @@
 #include <QtGlobal>
 #include <QString>
 #include <QIODevice>
+#include <QList>
 
-#include "xlsxglobal.h"
+#include <memory>
+#include <functional>
 
-class QZipWriter;
+#include "xlsxglobal.h"
+#include "xlsxsaveoptions.h"
 
 namespace QXlsx {
 
+class ZipDeflater;
+
+/*
+ * Writes ZIP archives.
+ *
+ * Each entry is compressed with the level that SaveOptions::partCompression()
+ * returns for its path. Entries that are added as a whole have their sizes and
+ * CRC in the local header. Entries that are written with beginFile(), writeData()
+ * and endFile() are streamed: their sizes and CRC follow the data in a data
+ * descriptor, so the writer never seeks back and the device may be sequential.
+ * addFile() with a write function streams whatever the function writes into
+ * its QIODevice argument, compressing it in chunks as it goes.
+ *
+ * The compressed data of a streamed entry is held in memory until it exceeds
+ * a few megabytes. An entry that ends before that is written as a whole, with
+ * its sizes in the local header, so the parts of small packages need no Zip64
+ * records. The sizes of a larger streamed entry are unknown when its local
+ * header is written, so the header has a Zip64 extra field and the data
+ * descriptor has 8 byte sizes, as APPNOTE 4.3.9.2 requires for entries that
+ * may exceed 4 GB. The other entries and the central directory get Zip64
+ * records only when they need them.
+ *
+ * Data that is written into many packages can be compressed once with compress()
+ * and then added with addCompressedFile().
+ */
 class ZipWriter
 {
 public:
-    explicit ZipWriter(const QString &filePath);
-    explicit ZipWriter(QIODevice *device);
+    struct CompressedData
+    {
+        QByteArray data;
+        SaveOptions::Compression compression = SaveOptions::Compression::Default;
+        quint16 method = 0;
+        quint32 crc = 0;
+        quint64 uncompressedSize = 0;
+    };
+
+    static CompressedData compress(const QByteArray &data, SaveOptions::Compression compression);
+
+    explicit ZipWriter(const QString &filePath, const SaveOptions &options = SaveOptions());
+    explicit ZipWriter(QIODevice *device, const SaveOptions &options = SaveOptions());
     ~ZipWriter();
 
     void addFile(const QString &filePath, QIODevice *device);
     void addFile(const QString &filePath, const QByteArray &data);
+    void addFile(const QString &filePath, const std::function<void (QIODevice *)> &writeFunc);
+    void addCompressedFile(const QString &filePath, const CompressedData &data);
+
+    bool beginFile(const QString &filePath);
+    bool writeData(const char *data, qint64 size);
+    bool writeData(const QByteArray &data);
+    bool endFile();
+
     bool error() const;
     void close();
 
 private:
-    QZipWriter *m_writer;
+    struct Entry
+    {
+        QByteArray name;
+        quint16 flags = 0;
+        quint16 method = 0;
+        quint32 crc = 0;
+        quint64 compressedSize = 0;
+        quint64 uncompressedSize = 0;
+        quint64 offset = 0;
+    };
+
+    void init();
+    Entry createEntry(const QString &filePath) const;
+    bool writeRaw(const QByteArray &data);
+    bool writeLocalHeader(const Entry &entry);
+    bool writeEntryData(const QByteArray &data);
+    bool writeCentralDirectory();
+
+    QIODevice *m_device;
+    bool m_ownDevice;
+    SaveOptions m_options;
+    QList<Entry> m_entries;
+    Entry m_current; //the entry being streamed
+    QByteArray m_pending; //the data of m_current while its local header is not written
+    bool m_headerWritten;
+    std::unique_ptr<ZipDeflater> m_deflater;
+    bool m_streaming;
+    quint64 m_offset;
+    quint16 m_dosTime;
+    quint16 m_dosDate;
+    bool m_error;
+    bool m_closed;
 };
 
 }
@@ -21,6 +21,16 @@ AbstractOOXmlFilePrivate::~AbstractOOXmlFilePrivate()
     delete relationships;
 }
 
+AbstractOOXmlFilePrivate &AbstractOOXmlFilePrivate::operator=(const AbstractOOXmlFilePrivate &other)
+{
+    if (this != &other) {
+        filePathInPackage = other.filePathInPackage;
+        *relationships = *other.relationships;
+        flag = other.flag;
+    }
+    return *this;
+}
+
 AbstractOOXmlFile::AbstractOOXmlFile(CreateFlag flag)
     :d_ptr(new AbstractOOXmlFilePrivate(this, flag))
 {
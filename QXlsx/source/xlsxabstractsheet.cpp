@@ -8,6 +8,8 @@
 #include "xlsxabstractsheet.h"
 #include "xlsxabstractsheet_p.h"
 #include "xlsxworkbook.h"
+#include "xlsxworkbook_p.h"
+#include "xlsxreferenceindex_p.h"
 #include "xlsxutility_p.h"
 #include <QDebug>
 
@@ -145,6 +147,12 @@ bool AbstractSheet::rename(const QString &sheetName)
             return false;
     }
 
+    //the formulas, defined names, validations, formattings and charts follow the sheet
+    auto book_d = d->workbook->d_func();
+    if (!book_d->referenceIndex)
+        book_d->referenceIndex = std::make_shared<ReferenceIndex>(d->workbook);
+    book_d->referenceIndex->renameSheet(this, name);
+
     d->name = name;
     return true;
 }
@@ -13,6 +13,7 @@
 #include "xlsxformat_p.h"
 #include "xlsxutility_p.h"
 #include "xlsxworksheet.h"
+#include "xlsxworksheet_p.h"
 #include "xlsxworkbook.h"
 #include "xlsxsharedstrings_p.h"
 
@@ -25,7 +26,7 @@ public:
     CellPrivate(Cell *p);
     CellPrivate(const CellPrivate * const cp);
 public:
-    Worksheet *parent;
+    std::shared_ptr<CellOwner> owner;
     Cell *q_ptr;
 public:
     Cell::Type cellType;
@@ -43,7 +44,7 @@ CellPrivate::CellPrivate(Cell *p) :
 }
 
 CellPrivate::CellPrivate(const CellPrivate * const cp)
-    : parent(cp->parent)
+    : owner(cp->owner)
     , cellType(cp->cellType)
     , value(cp->value)
     , formula(cp->formula)
@@ -65,7 +66,8 @@ Cell::Cell(const QVariant &data,
     d_ptr->value = data;
     d_ptr->cellType = type;
     d_ptr->format = format;
-    d_ptr->parent = parent;
+    if (parent)
+        d_ptr->owner = parent->d_func()->cellOwner;
     d_ptr->styleNumber = styleIndex;
     d_ptr->richString = richString;
 }
@@ -74,9 +76,9 @@ Cell::Cell(const Cell * const cell, Worksheet *parent):
     d_ptr(new CellPrivate(cell->d_ptr))
 {
     d_ptr->q_ptr = this;
-    d_ptr->parent = parent;
-    if (d_ptr->cellType == Cell::Type::SharedString)
-        d_ptr->parent->workbook()->sharedStrings()->addSharedString(d_ptr->richString);
+    d_ptr->owner = parent ? parent->d_func()->cellOwner : nullptr;
+    if (parent && d_ptr->cellType == Cell::Type::SharedString)
+        parent->workbook()->sharedStrings()->addSharedString(d_ptr->richString);
 }
 
 Cell::~Cell()
@@ -85,6 +87,38 @@ Cell::~Cell()
         delete d_ptr;
 }
 
+/*!
+ * \internal
+ * Makes \a parent the owner of the cell. The cell holds the owner of the sheet,
+ * not the sheet: the cells that are shared between a worksheet and its copies
+ * and snapshots keep the owner of the sheet they were created in, which stays
+ * valid after that sheet is deleted.
+ */
+void Cell::setParent(Worksheet *parent)
+{
+    Q_D(Cell);
+    d->owner = parent ? parent->d_func()->cellOwner : nullptr;
+}
+
+const CellOwner *Cell::owner() const
+{
+    Q_D(const Cell);
+    return d->owner.get();
+}
+
+/*!
+ * \internal
+ * Tells the sheet of the cell that the cell was modified through the public
+ * setters. The sheet code modifies its cells with the assign methods instead
+ * and records the modified positions itself.
+ */
+void Cell::notifyModified()
+{
+    Q_D(Cell);
+    if (d->owner && d->owner->sheet)
+        d->owner->sheet->d_func()->cellModifiedInPlace();
+}
+
 Cell::Type Cell::type() const
 {
     Q_D(const Cell);
@@ -99,6 +133,57 @@ QVariant Cell::value() const
     return d->value;
 }
 
+/*!
+ * \internal
+ * Converts the stored value of a numeric cell to \a number. Returns false if the
+ * cell is not numeric (a string, boolean or error cell) or has no value.
+ * Numbers loaded from cells without the type attribute are stored as strings and
+ * are parsed here. Dates are returned as serial numbers.
+ */
+bool Cell::toNumber(double &number) const
+{
+    Q_D(const Cell);
+    switch (d->cellType) {
+        case Type::Number:
+        case Type::Date:
+        case Type::Custom: {
+            bool ok = false;
+            number = d->value.toDouble(&ok);
+            return ok;
+        }
+        default: break;
+    }
+    return false;
+}
+
+/*!
+ * \internal
+ * Returns the stored value as a plain string. Inline strings that are stored
+ * only as rich strings are converted to plain text.
+ */
+QString Cell::toText() const
+{
+    Q_D(const Cell);
+    if (!d->value.isValid() && d->cellType == Type::InlineString)
+        return d->richString.toPlainString();
+    return d->value.toString();
+}
+
+/*!
+ * \internal
+ * Stores the calculated result of the cell formula. Numeric results of date
+ * cells keep the date type, string results are stored as the Formula type
+ * (t="str").
+ */
+void Cell::setResult(Type type, const QVariant &value)
+{
+    Q_D(Cell);
+    if (!(type == Type::Number && d->cellType == Type::Date))
+        d->cellType = type;
+    d->value = value;
+    d->richString = RichString();
+}
+
 QVariant Cell::readValue() const
 {
     Q_D(const Cell);
@@ -217,6 +302,12 @@ QVariant Cell::readValue() const
 }
 
 void Cell::setValue(const QVariant &value)
+{
+    assignValue(value);
+    notifyModified();
+}
+
+void Cell::assignValue(const QVariant &value)
 {
     Q_D(Cell);
     d->value = value;
@@ -230,6 +321,12 @@ Format Cell::format() const
 }
 
 void Cell::setFormat(const Format &format)
+{
+    assignFormat(format);
+    notifyModified();
+}
+
+void Cell::assignFormat(const Format &format)
 {
     Q_D(Cell);
     d->format = format;
@@ -250,6 +347,12 @@ CellFormula Cell::formula() const
 }
 
 void Cell::setFormula(const CellFormula &formula)
+{
+    assignFormula(formula);
+    notifyModified();
+}
+
+void Cell::assignFormula(const CellFormula &formula)
 {
     Q_D(Cell);
     d->formula = formula;
@@ -294,7 +397,7 @@ QVariant Cell::dateTime() const
 
     QVariant ret;
     double dValue = d->value.toDouble();
-    bool isDate1904 = d->parent->workbook()->date1904().value_or(false);
+    bool isDate1904 = d->owner ? d->owner->date1904.load(std::memory_order_relaxed) : false;
     ret = datetimeFromNumber(dValue, isDate1904);
     return ret;
 }
@@ -320,6 +423,12 @@ RichString Cell::richString() const
 }
 
 void Cell::setRichString(const RichString &richString)
+{
+    assignRichString(richString);
+    notifyModified();
+}
+
+void Cell::assignRichString(const RichString &richString)
 {
     Q_D(Cell);
     d->richString = richString;
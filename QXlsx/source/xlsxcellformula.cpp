@@ -112,6 +112,12 @@ QString CellFormula::text() const
     return d ? d->formula : QString();
 }
 
+void CellFormula::setText(const QString &text)
+{
+    if (!d) d = new CellFormulaPrivate;
+    d->formula = text.startsWith(QLatin1String("=")) ? text.mid(1) : text;
+}
+
 CellRange CellFormula::reference() const
 {
     return d ? d->reference : CellRange();
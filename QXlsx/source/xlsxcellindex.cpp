@@ -0,0 +1,357 @@
+// xlsxcellindex.cpp
+
+#include <QtGlobal>
+#include <QtNumeric>
+#include <QHash>
+#include <QDateTime>
+#include <QDate>
+#include <QTime>
+#include <QMutex>
+
+#include <algorithm>
+#include <atomic>
+
+#include "xlsxcellindex.h"
+#include "xlsxworksheet.h"
+#include "xlsxworksheet_p.h"
+#include "xlsxworkbook.h"
+#include "xlsxutility_p.h"
+
+namespace QXlsx {
+
+class CellIndexPrivate
+{
+public:
+    //the list of rows that hold the same key, stored as a chain of entries
+    struct Chain
+    {
+        int first = -1;
+        int last = -1;
+    };
+    struct Key
+    {
+        enum class Kind {None, Number, Text, Boolean};
+        Kind kind = Kind::None;
+        double number = 0.0;
+        QString text;
+        bool boolean = false;
+    };
+
+    void build();
+    void append(Chain &chain, int row);
+    int first(const Chain *chain) const;
+    QVector<int> all(const Chain *chain) const;
+    const Chain *chain(const Key &key, CellIndex::MatchMode mode) const;
+    Key toKey(const QVariant &value) const;
+
+    const Worksheet *sheet = nullptr;
+    CellRange range;
+    std::shared_ptr<const CellRangeWatch> watch;
+    std::atomic<quint64> revision {0}; //of the watch when the index was built
+    QMutex mutex; //serializes the builds
+
+    QVector<int> rows; //entry -> sheet row
+    QVector<int> next; //entry -> next entry of the same chain or -1
+    QHash<double, Chain> numbers;
+    QHash<QString, Chain> texts;
+    QHash<QString, Chain> foldedTexts;
+    Chain trues;
+    Chain falses;
+    QVector<QPair<double, int> > sortedNumbers;
+    QVector<QPair<QString, int> > sortedTexts; //case folded strings
+};
+
+void CellIndexPrivate::append(Chain &chain, int row)
+{
+    const int entry = rows.size();
+    rows.append(row);
+    next.append(-1);
+    if (chain.last >= 0)
+        next[chain.last] = entry;
+    else
+        chain.first = entry;
+    chain.last = entry;
+}
+
+int CellIndexPrivate::first(const Chain *chain) const
+{
+    return chain ? rows.at(chain->first) : -1;
+}
+
+QVector<int> CellIndexPrivate::all(const Chain *chain) const
+{
+    QVector<int> result;
+    if (!chain) return result;
+    for (int entry = chain->first; entry >= 0; entry = next.at(entry)) {
+        //a row may hold the key in several columns
+        if (result.isEmpty() || result.last() != rows.at(entry))
+            result.append(rows.at(entry));
+    }
+    return result;
+}
+
+const CellIndexPrivate::Chain *CellIndexPrivate::chain(const Key &key, CellIndex::MatchMode mode) const
+{
+    QHash<double, Chain>::const_iterator numberIt;
+    QHash<QString, Chain>::const_iterator textIt;
+    switch (key.kind) {
+        case Key::Kind::Number:
+            numberIt = numbers.constFind(key.number);
+            return numberIt == numbers.constEnd() ? nullptr : &numberIt.value();
+        case Key::Kind::Text:
+            if (mode == CellIndex::MatchMode::CaseInsensitive) {
+                textIt = foldedTexts.constFind(key.text.toCaseFolded());
+                return textIt == foldedTexts.constEnd() ? nullptr : &textIt.value();
+            }
+            textIt = texts.constFind(key.text);
+            return textIt == texts.constEnd() ? nullptr : &textIt.value();
+        case Key::Kind::Boolean: {
+            const Chain &c = key.boolean ? trues : falses;
+            return c.first >= 0 ? &c : nullptr;
+        }
+        default: break;
+    }
+    return nullptr;
+}
+
+CellIndexPrivate::Key CellIndexPrivate::toKey(const QVariant &value) const
+{
+    Key key;
+    const bool is1904 = sheet && sheet->workbook() && sheet->workbook()->date1904().value_or(false);
+    switch (value.userType()) {
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+        case QMetaType::Double:
+        case QMetaType::Float:
+            key.kind = Key::Kind::Number;
+            key.number = value.toDouble();
+            break;
+        case QMetaType::QDateTime:
+            key.kind = Key::Kind::Number;
+            key.number = datetimeToNumber(value.toDateTime(), is1904);
+            break;
+        case QMetaType::QDate:
+            key.kind = Key::Kind::Number;
+            key.number = datetimeToNumber(value.toDate().startOfDay(), is1904);
+            break;
+        case QMetaType::QTime:
+            key.kind = Key::Kind::Number;
+            key.number = timeToNumber(value.toTime());
+            break;
+        case QMetaType::Bool:
+            key.kind = Key::Kind::Boolean;
+            key.boolean = value.toBool();
+            break;
+        case QMetaType::QString:
+            key.kind = Key::Kind::Text;
+            key.text = value.toString();
+            break;
+        default:
+            if (value.canConvert<QString>() && !value.isNull()) {
+                key.kind = Key::Kind::Text;
+                key.text = value.toString();
+            }
+            break;
+    }
+    if (key.kind == Key::Kind::Number) {
+        if (qIsNaN(key.number))
+            key.kind = Key::Kind::None;
+        key.number += 0.0; //-0.0 and 0.0 must have the same hash
+    }
+    return key;
+}
+
+void CellIndexPrivate::build()
+{
+    rows.clear();
+    next.clear();
+    numbers.clear();
+    texts.clear();
+    foldedTexts.clear();
+    trues = Chain();
+    falses = Chain();
+    sortedNumbers.clear();
+    sortedTexts.clear();
+    if (!sheet) return;
+
+    const quint64 current = watch->revision;
+    for (const RowView &row: sheet->rows(range)) {
+        for (const CellView &cell: row.cells()) {
+            const int r = row.row();
+            if (cell.isNumber()) {
+                const double number = cell.number() + 0.0;
+                append(numbers[number], r);
+                sortedNumbers.append(qMakePair(number, r));
+            }
+            else if (cell.type() == Cell::Type::Boolean) {
+                append(cell.boolean() ? trues : falses, r);
+            }
+            else if (cell.type() != Cell::Type::Error) {
+                const QString text = cell.text();
+                if (text.isEmpty()) continue;
+                const QString folded = text.toCaseFolded();
+                append(texts[text], r);
+                append(foldedTexts[folded], r);
+                sortedTexts.append(qMakePair(folded, r));
+            }
+        }
+    }
+    std::sort(sortedNumbers.begin(), sortedNumbers.end());
+    std::sort(sortedTexts.begin(), sortedTexts.end());
+    revision.store(current, std::memory_order_release);
+}
+
+CellIndex::CellIndex()
+{
+
+}
+
+CellIndex::CellIndex(const Worksheet *sheet, const CellRange &range)
+    : d(std::make_shared<CellIndexPrivate>())
+{
+    d->sheet = sheet;
+    d->range = range;
+    d->watch = sheet->d_func()->watchRange(range);
+    d->build();
+}
+
+CellIndex::CellIndex(const CellIndex &other) : d(other.d)
+{
+
+}
+
+CellIndex &CellIndex::operator=(const CellIndex &other)
+{
+    d = other.d;
+    return *this;
+}
+
+CellIndex::~CellIndex()
+{
+
+}
+
+bool CellIndex::isValid() const
+{
+    return d && d->sheet;
+}
+
+CellRange CellIndex::range() const
+{
+    return d ? d->range : CellRange();
+}
+
+bool CellIndex::isStale() const
+{
+    return isValid() && d->revision.load(std::memory_order_acquire) != d->watch->revision;
+}
+
+void CellIndex::rebuild()
+{
+    if (!isValid()) return;
+    QMutexLocker locker(&d->mutex);
+    d->build();
+}
+
+/*!
+ * \internal
+ * Rebuilds the index if the cells of the indexed range were modified since the
+ * last build. Concurrent lookups of a stale index wait for one of them to
+ * rebuild it; the lookups of a current index take no lock.
+ */
+void CellIndex::ensureCurrent() const
+{
+    if (isStale()) {
+        QMutexLocker locker(&d->mutex);
+        if (isStale())
+            d->build();
+    }
+}
+
+int CellIndex::find(const QVariant &key, MatchMode mode) const
+{
+    if (!isValid()) return -1;
+    ensureCurrent();
+    return d->first(d->chain(d->toKey(key), mode));
+}
+
+QVector<int> CellIndex::findAll(const QVariant &key, MatchMode mode) const
+{
+    if (!isValid()) return {};
+    ensureCurrent();
+    return d->all(d->chain(d->toKey(key), mode));
+}
+
+QVector<int> CellIndex::find(const QVector<QVariant> &keys, MatchMode mode) const
+{
+    QVector<int> result(keys.size(), -1);
+    if (!isValid()) return result;
+    ensureCurrent();
+    for (int i = 0; i < keys.size(); ++i)
+        result[i] = d->first(d->chain(d->toKey(keys.at(i)), mode));
+    return result;
+}
+
+/*!
+ * \internal
+ * Returns the first row that holds the value nearest to \a key in the sorted
+ * list of (value, row) pairs.
+ */
+template <typename T>
+static int nearestRow(const QVector<QPair<T, int> > &sorted, const T &key, CellIndex::ApproximateMatch match)
+{
+    if (match == CellIndex::ApproximateMatch::LessOrEqual) {
+        auto it = std::upper_bound(sorted.cbegin(), sorted.cend(), key,
+                                   [](const T &k, const QPair<T, int> &p) { return k < p.first; });
+        if (it == sorted.cbegin()) return -1;
+        const T &value = (it - 1)->first;
+        //the first row of the run of equal values
+        it = std::lower_bound(sorted.cbegin(), it, value,
+                              [](const QPair<T, int> &p, const T &k) { return p.first < k; });
+        return it->second;
+    }
+    auto it = std::lower_bound(sorted.cbegin(), sorted.cend(), key,
+                               [](const QPair<T, int> &p, const T &k) { return p.first < k; });
+    return it == sorted.cend() ? -1 : it->second;
+}
+
+template <typename T>
+static QVector<int> rowsBetween(const QVector<QPair<T, int> > &sorted, const T &low, const T &high)
+{
+    QVector<int> result;
+    auto it = std::lower_bound(sorted.cbegin(), sorted.cend(), low,
+                               [](const QPair<T, int> &p, const T &k) { return p.first < k; });
+    for (; it != sorted.cend() && !(high < it->first); ++it)
+        result.append(it->second);
+    return result;
+}
+
+int CellIndex::findApproximate(const QVariant &key, ApproximateMatch match) const
+{
+    if (!isValid()) return -1;
+    ensureCurrent();
+    const auto k = d->toKey(key);
+    if (k.kind == CellIndexPrivate::Key::Kind::Number)
+        return nearestRow(d->sortedNumbers, k.number, match);
+    if (k.kind == CellIndexPrivate::Key::Kind::Text)
+        return nearestRow(d->sortedTexts, k.text.toCaseFolded(), match);
+    return -1;
+}
+
+QVector<int> CellIndex::findRange(const QVariant &low, const QVariant &high) const
+{
+    if (!isValid()) return {};
+    ensureCurrent();
+    const auto l = d->toKey(low);
+    const auto h = d->toKey(high);
+    if (l.kind != h.kind) return {};
+    if (l.kind == CellIndexPrivate::Key::Kind::Number)
+        return rowsBetween(d->sortedNumbers, l.number, h.number);
+    if (l.kind == CellIndexPrivate::Key::Kind::Text)
+        return rowsBetween(d->sortedTexts, l.text.toCaseFolded(), h.text.toCaseFolded());
+    return {};
+}
+
+}
@@ -0,0 +1,55 @@
+// xlsxcelliterator.cpp
+
+#include <QtGlobal>
+#include <QtNumeric>
+
+#include "xlsxcelliterator.h"
+#include "xlsxformat.h"
+
+namespace QXlsx {
+
+Cell::Type CellView::type() const
+{
+    return m_cell ? m_cell->type() : Cell::Type::Custom;
+}
+
+bool CellView::isNumber() const
+{
+    double value;
+    return m_cell && m_cell->toNumber(value);
+}
+
+double CellView::number() const
+{
+    double value;
+    if (m_cell && m_cell->toNumber(value))
+        return value;
+    return qQNaN();
+}
+
+QString CellView::text() const
+{
+    return m_cell ? m_cell->toText() : QString();
+}
+
+bool CellView::boolean() const
+{
+    if (m_cell && m_cell->type() == Cell::Type::Boolean)
+        return m_cell->value().toBool();
+    return false;
+}
+
+bool CellView::hasFormula() const
+{
+    return m_cell && m_cell->hasFormula();
+}
+
+int CellView::styleId() const
+{
+    if (!m_cell)
+        return 0;
+    const Format format = m_cell->format();
+    return format.xfIndexValid() ? format.xfIndex() : 0;
+}
+
+}
@@ -72,6 +72,29 @@ Chartsheet *Chartsheet::copy(const QString &distName, int distId) const
     return sheet;
 }
 
+/*!
+ * \internal
+ */
+Chartsheet *Chartsheet::snapshot(Workbook *workbook) const
+{
+    Q_D(const Chartsheet);
+    Chartsheet *sheet = new Chartsheet(d->name, d->id, workbook, F_NewFromScratch);
+    ChartsheetPrivate *sheet_d = sheet->d_func();
+
+    *sheet_d->chart = *d->chart;
+    sheet_d->sheetState = d->sheetState;
+    sheet_d->headerFooter = d->headerFooter;
+    sheet_d->pageMargins = d->pageMargins;
+    sheet_d->pageSetup = d->pageSetup;
+    sheet_d->pictureFile = d->pictureFile;
+    sheet_d->sheetProtection = d->sheetProtection;
+    sheet_d->sheetViews = d->sheetViews;
+    sheet_d->extLst = d->extLst;
+    sheet_d->sheetProperties = d->sheetProperties;
+
+    return sheet;
+}
+
 std::optional<bool> Chartsheet::zoomToFit() const
 {
     Q_D(const Chartsheet);
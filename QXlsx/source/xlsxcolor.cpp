@@ -5,6 +5,7 @@
 #include <QXmlStreamWriter>
 #include <QDebug>
 #include <QtMath>
+#include <QMutex>
 
 #include "xlsxcolor.h"
 #include "xlsxutility_p.h"
@@ -43,7 +44,7 @@ Color::Color(const char *colorName): type_{Type::Preset}
 }
 
 Color::Color(const Color &other) : type_{other.type_}, val{other.val}, tr{other.tr},
-    lastColor{other.lastColor}, isCRGB{other.isCRGB}, isDirty{other.isDirty}, m_key{other.m_key}
+    lastColor{other.lastColor}, isCRGB{other.isCRGB}, isDirty{other.isDirty.load(std::memory_order_acquire)}, m_key{isDirty ? QByteArray() : other.m_key}
 {
 
 }
@@ -56,8 +57,9 @@ Color &Color::operator=(const Color &other)
         tr = other.tr;
         lastColor = other.lastColor;
         isCRGB = other.isCRGB;
-        isDirty = other.isDirty;
-        m_key = other.m_key;
+        const bool dirty = other.isDirty.load(std::memory_order_acquire);
+        m_key = dirty ? QByteArray() : other.m_key;
+        isDirty = dirty;
     }
     return *this;
 }
@@ -1052,13 +1054,17 @@ ColorTransform::operator QVariant() const
 
 QByteArray Color::idKey() const
 {
-    if (isDirty) {
-        QByteArray bytes;
-        QXmlStreamWriter w(&bytes);
-        write(w);
-
-        m_key = bytes;
-        isDirty = false;
+    if (isDirty.load(std::memory_order_acquire)) {
+        static QMutex mutex;
+        QMutexLocker locker(&mutex);
+        if (isDirty.load(std::memory_order_relaxed)) {
+            QByteArray bytes;
+            QXmlStreamWriter w(&bytes);
+            write(w);
+
+            m_key = bytes;
+            isDirty.store(false, std::memory_order_release);
+        }
     }
 
     return m_key;
@@ -0,0 +1,724 @@
+// xlsxconditionalformatevaluator.cpp
+
+#include <QtGlobal>
+#include <QHash>
+#include <QDate>
+#include <QDateTime>
+#include <QTime>
+#include <QVector>
+
+#include <algorithm>
+#include <cmath>
+
+#include "xlsxconditionalformatevaluator.h"
+#include "xlsxconditionalformatting.h"
+#include "xlsxconditionalformatting_p.h"
+#include "xlsxformat_p.h"
+#include "xlsxformulaengine_p.h"
+#include "xlsxworksheet.h"
+#include "xlsxworksheet_p.h"
+#include "xlsxworkbook.h"
+#include "xlsxutility_p.h"
+
+namespace QXlsx {
+
+namespace {
+
+CellRange intersected(const CellRange &a, const CellRange &b)
+{
+    const CellRange range(qMax(a.firstRow(), b.firstRow()), qMax(a.firstColumn(), b.firstColumn()),
+                          qMin(a.lastRow(), b.lastRow()), qMin(a.lastColumn(), b.lastColumn()));
+    return range.firstRow() <= range.lastRow() && range.firstColumn() <= range.lastColumn()
+            ? range : CellRange();
+}
+
+/*!
+ * \internal
+ * Adds the properties of \a source missing in \a target.
+ */
+void mergeFormat(Format &target, const Format &source)
+{
+    if (source.isEmpty())
+        return;
+    if (target.isEmpty()) {
+        target = source;
+        return;
+    }
+    for (int id = FormatPrivate::P_STARTID; id < FormatPrivate::P_ENDID; ++id) {
+        if (source.hasProperty(id) && !target.hasProperty(id))
+            target.setProperty(id, source.property(id));
+    }
+}
+
+QColor interpolate(const QColor &a, const QColor &b, double fraction)
+{
+    auto mix = [fraction](double x, double y) { return x + (y - x) * fraction; };
+    return QColor::fromRgbF(mix(a.redF(), b.redF()), mix(a.greenF(), b.greenF()),
+                            mix(a.blueF(), b.blueF()), mix(a.alphaF(), b.alphaF()));
+}
+
+}
+
+class ConditionalFormatEvaluatorPrivate
+{
+public:
+    enum class Kind {
+        CellIs, Expression, ContainsText, NotContainsText, BeginsWith, EndsWith, TimePeriod,
+        Duplicate, Unique, Blanks, NoBlanks, Errors, NoErrors, Top, Average, ColorScale, DataBar,
+        Unsupported
+    };
+    //a threshold of a color scale or a data bar
+    struct ValueObject
+    {
+        ConditionalFormatting::ValueObjectType type = ConditionalFormatting::ValueObjectType::Min;
+        QString value;
+        double number = 0.0; //resolved by the statistics
+    };
+    struct Rule
+    {
+        int formatting = 0; //the index of the formatting in the sheet
+        int priority = 0;
+        QList<CellRange> ranges;
+        Kind kind = Kind::Unsupported;
+        bool stopIfTrue = false;
+        Format format;
+
+        QString op; //the operator of cellIs or the period of timePeriod
+        QString text; //case folded
+        FormulaNodePtr formula1; //relative to the anchor cell
+        FormulaNodePtr formula2;
+        int anchorRow = 1; //the top left cell of the first range
+        int anchorColumn = 1;
+
+        int rank = 10;
+        bool percent = false;
+        bool bottom = false;
+        bool above = true;
+        bool equalAverage = false;
+        int stdDev = 0;
+
+        QVector<ValueObject> values;
+        QVector<QColor> colors;
+        bool showValue = true;
+
+        //the statistics of the ranges
+        bool ready = false; //false if the rule can't match, e.g. its ranges have no numbers
+        QVector<double> numbers; //sorted
+        double threshold = 0.0; //of top10 and aboveAverage
+        double firstDay = 0.0; //of timePeriod
+        double lastDay = 0.0;
+        QHash<QString, int> counts; //of duplicateValues and uniqueValues
+
+        bool contains(int row, int column) const
+        {
+            for (const CellRange &range : ranges) {
+                if (range.contains(row, column))
+                    return true;
+            }
+            return false;
+        }
+    };
+
+    void readRules();
+    void build();
+    void buildStatistics(Rule &rule);
+    void buildPeriod(Rule &rule, const QDate &today);
+    FormulaValue evaluateFormula(const FormulaNode &formula, int row, int column) const;
+    bool matches(const Rule &rule, int row, int column, const FormulaValue &value) const;
+    ConditionalFormatResult evaluateCell(const QVector<const Rule *> &rules, int row, int column,
+                                         const FormulaValue &value) const;
+    static QString valueKey(const FormulaValue &value);
+
+    const Worksheet *sheet = nullptr;
+    std::shared_ptr<FormulaEngine> engine;
+    quint64 revision = 0;
+    QVector<Rule> rules; //ordered by priority
+    QVector<QList<CellRange> > formattingRanges; //the ranges of each formatting of the sheet
+};
+
+/*!
+ * \internal
+ * Reads the rules of the conditional formattings of the sheet and orders them
+ * by priority. The formulas are parsed once per rule.
+ */
+void ConditionalFormatEvaluatorPrivate::readRules()
+{
+    static const QHash<QString, Kind> kinds {
+        {QStringLiteral("cellIs"), Kind::CellIs},
+        {QStringLiteral("expression"), Kind::Expression},
+        {QStringLiteral("containsText"), Kind::ContainsText},
+        {QStringLiteral("notContainsText"), Kind::NotContainsText},
+        {QStringLiteral("beginsWith"), Kind::BeginsWith},
+        {QStringLiteral("endsWith"), Kind::EndsWith},
+        {QStringLiteral("timePeriod"), Kind::TimePeriod},
+        {QStringLiteral("duplicateValues"), Kind::Duplicate},
+        {QStringLiteral("uniqueValues"), Kind::Unique},
+        {QStringLiteral("containsBlanks"), Kind::Blanks},
+        {QStringLiteral("notContainsBlanks"), Kind::NoBlanks},
+        {QStringLiteral("containsErrors"), Kind::Errors},
+        {QStringLiteral("notContainsErrors"), Kind::NoErrors},
+        {QStringLiteral("top10"), Kind::Top},
+        {QStringLiteral("aboveAverage"), Kind::Average},
+        {QStringLiteral("colorScale"), Kind::ColorScale},
+        {QStringLiteral("dataBar"), Kind::DataBar}
+    };
+
+    const auto &formattings = sheet->d_func()->conditionalFormattingList;
+    for (int i = 0; i < formattings.size(); ++i) {
+        const ConditionalFormatting &formatting = formattings.at(i);
+        formattingRanges.append(formatting.ranges());
+        if (!formatting.d || formatting.ranges().isEmpty())
+            continue;
+        for (const auto &data : qAsConst(formatting.d->cfRules)) {
+            const auto &attrs = data->attrs;
+            Rule rule;
+            rule.formatting = i;
+            rule.priority = data->priority;
+            rule.ranges = formatting.ranges();
+            rule.kind = kinds.value(attrs.value(XlsxCfRuleData::A_type).toString(), Kind::Unsupported);
+            rule.stopIfTrue = attrs.value(XlsxCfRuleData::A_stopIfTrue).toBool();
+            rule.format = data->dxfFormat;
+            rule.anchorRow = rule.ranges.first().firstRow();
+            rule.anchorColumn = rule.ranges.first().firstColumn();
+
+            if (rule.kind == Kind::TimePeriod)
+                rule.op = attrs.value(XlsxCfRuleData::A_timePeriod).toString();
+            else
+                rule.op = attrs.value(XlsxCfRuleData::A_operator).toString();
+            rule.text = attrs.value(XlsxCfRuleData::A_text).toString().toCaseFolded();
+            auto it = attrs.constFind(XlsxCfRuleData::A_formula1);
+            if (it != attrs.constEnd())
+                rule.formula1 = FormulaParser::parse(it.value().toString(), rule.anchorRow, rule.anchorColumn);
+            it = attrs.constFind(XlsxCfRuleData::A_formula2);
+            if (it != attrs.constEnd())
+                rule.formula2 = FormulaParser::parse(it.value().toString(), rule.anchorRow, rule.anchorColumn);
+
+            rule.rank = attrs.value(XlsxCfRuleData::A_rank, 10).toInt();
+            rule.percent = attrs.value(XlsxCfRuleData::A_percent).toBool();
+            rule.bottom = attrs.value(XlsxCfRuleData::A_bottom).toBool();
+            rule.above = attrs.value(XlsxCfRuleData::A_aboveAverage, true).toBool();
+            rule.equalAverage = attrs.value(XlsxCfRuleData::A_equalAverage).toBool();
+            rule.stdDev = attrs.value(XlsxCfRuleData::A_stdDev).toInt();
+
+            if (rule.kind == Kind::ColorScale || rule.kind == Kind::DataBar) {
+                const int count = rule.kind == Kind::DataBar ? 2 : 3;
+                for (int k = 0; k < count; ++k) {
+                    it = attrs.constFind(XlsxCfRuleData::A_cfvo1 + k);
+                    if (it == attrs.constEnd())
+                        break;
+                    const XlsxCfVoData cfvo = it.value().value<XlsxCfVoData>();
+                    rule.values.append(ValueObject {cfvo.type, cfvo.value, 0.0});
+                }
+                for (int k = 0; k < count; ++k) {
+                    it = attrs.constFind(XlsxCfRuleData::A_color1 + k);
+                    if (it == attrs.constEnd())
+                        break;
+                    rule.colors.append(it.value().value<Color>().transformed());
+                }
+                rule.showValue = !attrs.value(XlsxCfRuleData::A_hideData).toBool();
+                if (rule.values.size() < 2 || rule.colors.isEmpty()
+                    || (rule.kind == Kind::ColorScale && rule.colors.size() < rule.values.size()))
+                    rule.kind = Kind::Unsupported;
+            }
+            rules.append(rule);
+        }
+    }
+    std::stable_sort(rules.begin(), rules.end(), [](const Rule &a, const Rule &b) {
+        return a.priority < b.priority;
+    });
+}
+
+/*!
+ * \internal
+ * Computes the statistics of the rules from the current sheet cells.
+ */
+void ConditionalFormatEvaluatorPrivate::build()
+{
+    revision = sheet->d_func()->cellRevision;
+    engine->prepare();
+    const QDate today = QDate::currentDate();
+    for (Rule &rule : rules) {
+        switch (rule.kind) {
+            case Kind::Duplicate:
+            case Kind::Unique:
+            case Kind::Top:
+            case Kind::Average:
+            case Kind::ColorScale:
+            case Kind::DataBar:
+                buildStatistics(rule);
+                break;
+            case Kind::TimePeriod:
+                buildPeriod(rule, today);
+                break;
+            default:
+                rule.ready = true;
+                break;
+        }
+    }
+}
+
+/*!
+ * \internal
+ * Collects the values of the ranges of \a rule in one pass and derives the
+ * thresholds the cells are compared with.
+ */
+void ConditionalFormatEvaluatorPrivate::buildStatistics(Rule &rule)
+{
+    const bool counting = rule.kind == Kind::Duplicate || rule.kind == Kind::Unique;
+    rule.numbers.clear();
+    rule.counts.clear();
+    for (const CellRange &range : qAsConst(rule.ranges)) {
+        engine->forEachCell(FormulaValue::fromRange(sheet, range), [&](int, int, const FormulaValue &value) {
+            if (counting) {
+                const QString key = valueKey(value);
+                if (!key.isNull())
+                    ++rule.counts[key];
+            }
+            else if (value.type == FormulaValue::Type::Number) {
+                rule.numbers.append(value.number);
+            }
+            return true;
+        });
+    }
+    std::sort(rule.numbers.begin(), rule.numbers.end());
+
+    const auto &numbers = rule.numbers;
+    const int count = numbers.size();
+    rule.ready = counting || count > 0;
+    if (!rule.ready)
+        return;
+
+    if (rule.kind == Kind::Top) {
+        int n = rule.percent ? int(std::floor(double(count) * rule.rank / 100.0)) : rule.rank;
+        n = qBound(1, n, count);
+        rule.threshold = rule.bottom ? numbers.at(n - 1) : numbers.at(count - n);
+    }
+    else if (rule.kind == Kind::Average) {
+        double sum = 0.0;
+        for (double number : numbers)
+            sum += number;
+        const double mean = sum / count;
+        double squares = 0.0;
+        for (double number : numbers)
+            squares += (number - mean) * (number - mean);
+        const double deviation = std::sqrt(squares / count) * rule.stdDev;
+        rule.threshold = rule.above ? mean + deviation : mean - deviation;
+    }
+    else if (rule.kind == Kind::ColorScale || rule.kind == Kind::DataBar) {
+        const double low = numbers.first();
+        const double high = numbers.last();
+        for (ValueObject &object : rule.values) {
+            const double parameter = object.value.toDouble();
+            switch (object.type) {
+                case ConditionalFormatting::ValueObjectType::Min:
+                    object.number = low;
+                    break;
+                case ConditionalFormatting::ValueObjectType::Max:
+                    object.number = high;
+                    break;
+                case ConditionalFormatting::ValueObjectType::Percent:
+                    object.number = low + (high - low) * parameter / 100.0;
+                    break;
+                case ConditionalFormatting::ValueObjectType::Percentile: {
+                    //PERCENTILE.INC
+                    const double position = qBound(0.0, parameter / 100.0, 1.0) * (count - 1);
+                    const int index = int(std::floor(position));
+                    object.number = index + 1 < count
+                            ? numbers.at(index) + (position - index) * (numbers.at(index + 1) - numbers.at(index))
+                            : numbers.at(index);
+                    break;
+                }
+                case ConditionalFormatting::ValueObjectType::Num:
+                case ConditionalFormatting::ValueObjectType::Formula: {
+                    bool ok = false;
+                    object.number = object.value.toDouble(&ok);
+                    if (ok)
+                        break;
+                    const FormulaNodePtr formula = FormulaParser::parse(object.value, rule.anchorRow, rule.anchorColumn);
+                    if (!formula || FormulaEngine::toNumber(evaluateFormula(*formula, rule.anchorRow, rule.anchorColumn),
+                                                            object.number) != FormulaError::None)
+                        rule.ready = false;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * \internal
+ * Computes the first and the last day of the time period of \a rule as date
+ * serial numbers. The weeks start on Sunday.
+ */
+void ConditionalFormatEvaluatorPrivate::buildPeriod(Rule &rule, const QDate &today)
+{
+    const bool is1904 = sheet->workbook() && sheet->workbook()->date1904().value_or(false);
+    auto serial = [is1904](const QDate &date) {
+        return datetimeToNumber(QDateTime(date, QTime(0, 0)), is1904);
+    };
+    const QDate month(today.year(), today.month(), 1);
+    const QDate week = today.addDays(-(today.dayOfWeek() % 7));
+
+    rule.ready = true;
+    QDate first;
+    QDate last;
+    if (rule.op == QLatin1String("today")) {
+        first = last = today;
+    } else if (rule.op == QLatin1String("yesterday")) {
+        first = last = today.addDays(-1);
+    } else if (rule.op == QLatin1String("tomorrow")) {
+        first = last = today.addDays(1);
+    } else if (rule.op == QLatin1String("last7Days")) {
+        first = today.addDays(-6);
+        last = today;
+    } else if (rule.op == QLatin1String("thisWeek")) {
+        first = week;
+        last = week.addDays(6);
+    } else if (rule.op == QLatin1String("lastWeek")) {
+        first = week.addDays(-7);
+        last = week.addDays(-1);
+    } else if (rule.op == QLatin1String("nextWeek")) {
+        first = week.addDays(7);
+        last = week.addDays(13);
+    } else if (rule.op == QLatin1String("thisMonth")) {
+        first = month;
+        last = month.addMonths(1).addDays(-1);
+    } else if (rule.op == QLatin1String("lastMonth")) {
+        first = month.addMonths(-1);
+        last = month.addDays(-1);
+    } else if (rule.op == QLatin1String("nextMonth")) {
+        first = month.addMonths(1);
+        last = month.addMonths(2).addDays(-1);
+    } else {
+        rule.ready = false;
+        return;
+    }
+    rule.firstDay = serial(first);
+    rule.lastDay = serial(last);
+}
+
+FormulaValue ConditionalFormatEvaluatorPrivate::evaluateFormula(const FormulaNode &formula, int row, int column) const
+{
+    FormulaContext context;
+    context.sheet = sheet;
+    context.row = row;
+    context.column = column;
+    return engine->toScalar(engine->evaluate(formula, context), context);
+}
+
+/*!
+ * \internal
+ * Returns a key of \a value that is equal for the values Excel considers
+ * duplicates, or a null string for the blanks and the errors.
+ */
+QString ConditionalFormatEvaluatorPrivate::valueKey(const FormulaValue &value)
+{
+    switch (value.type) {
+        case FormulaValue::Type::Number:
+            return QStringLiteral("n") + QString::number(value.number + 0.0, 'g', 17);
+        case FormulaValue::Type::String:
+            return QStringLiteral("s") + value.string.toCaseFolded();
+        case FormulaValue::Type::Boolean:
+            return value.boolean ? QStringLiteral("b1") : QStringLiteral("b0");
+        default: break;
+    }
+    return QString();
+}
+
+/*!
+ * \internal
+ * Returns true if the cell at \a row and \a column with \a value matches the
+ * highlighting \a rule.
+ */
+bool ConditionalFormatEvaluatorPrivate::matches(const Rule &rule, int row, int column, const FormulaValue &value) const
+{
+    if (!rule.ready)
+        return false;
+    const bool isNumber = value.type == FormulaValue::Type::Number;
+    const bool isBlank = value.type == FormulaValue::Type::Blank
+            || (value.type == FormulaValue::Type::String && value.string.trimmed().isEmpty());
+
+    switch (rule.kind) {
+        case Kind::CellIs: {
+            if (value.isError() || !rule.formula1)
+                return false;
+            FormulaValue first = evaluateFormula(*rule.formula1, row, column);
+            if (first.isError())
+                return false;
+            if (rule.op == QLatin1String("between") || rule.op == QLatin1String("notBetween")) {
+                if (!rule.formula2)
+                    return false;
+                FormulaValue second = evaluateFormula(*rule.formula2, row, column);
+                if (second.isError())
+                    return false;
+                if (FormulaEngine::compare(first, second) > 0)
+                    std::swap(first, second);
+                const bool between = FormulaEngine::compare(value, first) >= 0
+                        && FormulaEngine::compare(value, second) <= 0;
+                return rule.op == QLatin1String("between") ? between : !between;
+            }
+            const int result = FormulaEngine::compare(value, first);
+            if (rule.op == QLatin1String("lessThan")) return result < 0;
+            if (rule.op == QLatin1String("lessThanOrEqual")) return result <= 0;
+            if (rule.op == QLatin1String("equal")) return result == 0;
+            if (rule.op == QLatin1String("notEqual")) return result != 0;
+            if (rule.op == QLatin1String("greaterThanOrEqual")) return result >= 0;
+            if (rule.op == QLatin1String("greaterThan")) return result > 0;
+            return false;
+        }
+        case Kind::Expression: {
+            if (!rule.formula1)
+                return false;
+            bool result = false;
+            return FormulaEngine::toBoolean(evaluateFormula(*rule.formula1, row, column), result)
+                    == FormulaError::None && result;
+        }
+        case Kind::ContainsText:
+            return !value.isError() && FormulaEngine::toText(value).toCaseFolded().contains(rule.text);
+        case Kind::NotContainsText:
+            return value.isError() || !FormulaEngine::toText(value).toCaseFolded().contains(rule.text);
+        case Kind::BeginsWith:
+            return !value.isError() && FormulaEngine::toText(value).toCaseFolded().startsWith(rule.text);
+        case Kind::EndsWith:
+            return !value.isError() && FormulaEngine::toText(value).toCaseFolded().endsWith(rule.text);
+        case Kind::TimePeriod: {
+            if (!isNumber)
+                return false;
+            const double day = std::floor(value.number);
+            return day >= rule.firstDay && day <= rule.lastDay;
+        }
+        case Kind::Duplicate:
+        case Kind::Unique: {
+            const QString key = valueKey(value);
+            if (key.isNull())
+                return false;
+            const int count = rule.counts.value(key);
+            return rule.kind == Kind::Duplicate ? count > 1 : count == 1;
+        }
+        case Kind::Blanks:
+            return isBlank;
+        case Kind::NoBlanks:
+            return !isBlank && !value.isError();
+        case Kind::Errors:
+            return value.isError();
+        case Kind::NoErrors:
+            return !value.isError();
+        case Kind::Top:
+            return isNumber && (rule.bottom ? value.number <= rule.threshold : value.number >= rule.threshold);
+        case Kind::Average:
+            if (!isNumber)
+                return false;
+            if (rule.above)
+                return rule.equalAverage ? value.number >= rule.threshold : value.number > rule.threshold;
+            return rule.equalAverage ? value.number <= rule.threshold : value.number < rule.threshold;
+        default: break;
+    }
+    return false;
+}
+
+/*!
+ * \internal
+ * Applies \a rules, ordered by priority, to the cell at \a row and \a column
+ * with \a value. A rule with stopIfTrue that applies to the cell stops the
+ * rules with the lower priorities, the first color scale and the first data
+ * bar win.
+ */
+ConditionalFormatResult ConditionalFormatEvaluatorPrivate::evaluateCell(const QVector<const Rule *> &rules,
+                                                                        int row, int column,
+                                                                        const FormulaValue &value) const
+{
+    ConditionalFormatResult result;
+    for (const Rule *rule : rules) {
+        if (!rule->contains(row, column))
+            continue;
+
+        bool applied = false;
+        if (rule->kind == Kind::ColorScale || rule->kind == Kind::DataBar) {
+            if (!rule->ready || value.type != FormulaValue::Type::Number)
+                continue;
+            const double number = value.number;
+            const auto &values = rule->values;
+            if (rule->kind == Kind::ColorScale) {
+                if (!result.color.isValid()) {
+                    result.color = rule->colors.last();
+                    if (number <= values.first().number) {
+                        result.color = rule->colors.first();
+                    } else {
+                        for (int k = 1; k < values.size(); ++k) {
+                            if (number > values.at(k).number)
+                                continue;
+                            const double low = values.at(k - 1).number;
+                            const double high = values.at(k).number;
+                            result.color = interpolate(rule->colors.at(k - 1), rule->colors.at(k),
+                                                       high > low ? (number - low) / (high - low) : 1.0);
+                            break;
+                        }
+                    }
+                }
+            } else if (!result.dataBar.has_value()) {
+                const double low = values.at(0).number;
+                const double high = values.at(1).number;
+                const double fraction = high > low ? (number - low) / (high - low) : (number >= high ? 1.0 : 0.0);
+                result.dataBar = qBound(0.0, fraction, 1.0);
+                result.dataBarColor = rule->colors.first();
+                result.showValue = rule->showValue;
+            }
+            applied = true;
+        } else if (matches(*rule, row, column, value)) {
+            mergeFormat(result.format, rule->format);
+            applied = true;
+        }
+        if (applied && rule->stopIfTrue)
+            break;
+    }
+    return result;
+}
+
+ConditionalFormatEvaluator::ConditionalFormatEvaluator()
+{
+
+}
+
+/*!
+ * \internal
+ * The evaluator has its own formula engine, so creating it does not modify the
+ * workbook and its evaluations do not share state with Workbook::recalculate().
+ */
+ConditionalFormatEvaluator::ConditionalFormatEvaluator(const Worksheet *sheet)
+    : d(std::make_shared<ConditionalFormatEvaluatorPrivate>())
+{
+    d->sheet = sheet;
+    d->engine = std::make_shared<FormulaEngine>(sheet->d_func()->workbook);
+    d->readRules();
+    d->build();
+}
+
+ConditionalFormatEvaluator::ConditionalFormatEvaluator(const ConditionalFormatEvaluator &other) : d(other.d)
+{
+
+}
+
+ConditionalFormatEvaluator &ConditionalFormatEvaluator::operator=(const ConditionalFormatEvaluator &other)
+{
+    d = other.d;
+    return *this;
+}
+
+ConditionalFormatEvaluator::~ConditionalFormatEvaluator()
+{
+
+}
+
+bool ConditionalFormatEvaluator::isValid() const
+{
+    return d && d->sheet;
+}
+
+bool ConditionalFormatEvaluator::isStale() const
+{
+    return isValid() && d->revision != d->sheet->d_func()->cellRevision;
+}
+
+/*!
+ * \internal
+ * Computes the statistics again if the sheet cells were modified. The sheets and
+ * the defined names are read by the engine in build() only, so the evaluation
+ * of a cell does not depend on the size of the workbook.
+ */
+void ConditionalFormatEvaluator::ensureCurrent() const
+{
+    if (isStale())
+        d->build();
+}
+
+ConditionalFormatResult ConditionalFormatEvaluator::evaluate(int row, int column) const
+{
+    if (!isValid() || row < 1 || column < 1)
+        return ConditionalFormatResult();
+    ensureCurrent();
+
+    const QList<int> formattings = d->sheet->conditionalFormattingIndexes(CellRange(row, column, row, column));
+    QVector<const ConditionalFormatEvaluatorPrivate::Rule *> rules;
+    for (const auto &rule : qAsConst(d->rules)) {
+        if (formattings.contains(rule.formatting))
+            rules.append(&rule);
+    }
+    if (rules.isEmpty())
+        return ConditionalFormatResult();
+    return d->evaluateCell(rules, row, column, d->engine->cellValue(d->sheet, row, column));
+}
+
+void ConditionalFormatEvaluator::evaluate(const CellRange &range,
+                                          const std::function<void (int, int, const ConditionalFormatResult &)> &visit) const
+{
+    if (!isValid() || !range.isValid())
+        return;
+    ensureCurrent();
+
+    //the rules and the areas of the formattings that apply to the range
+    const QList<int> formattings = d->sheet->conditionalFormattingIndexes(range);
+    QVector<const ConditionalFormatEvaluatorPrivate::Rule *> rules;
+    for (const auto &rule : qAsConst(d->rules)) {
+        if (std::binary_search(formattings.cbegin(), formattings.cend(), rule.formatting))
+            rules.append(&rule);
+    }
+    QVector<CellRange> areas;
+    for (int formatting : formattings) {
+        for (const CellRange &formattingRange : d->formattingRanges.value(formatting)) {
+            const CellRange area = intersected(formattingRange, range);
+            if (area.isValid())
+                areas.append(area);
+        }
+    }
+    if (rules.isEmpty() || areas.isEmpty())
+        return;
+    CellRange bounds = areas.first();
+    for (const CellRange &area : qAsConst(areas)) {
+        bounds = CellRange(qMin(bounds.firstRow(), area.firstRow()), qMin(bounds.firstColumn(), area.firstColumn()),
+                           qMax(bounds.lastRow(), area.lastRow()), qMax(bounds.lastColumn(), area.lastColumn()));
+    }
+
+    //walk the rows of the bounds, reading the non-empty cells of each row once
+    QVector<FormulaValue> values(bounds.columnCount());
+    QVector<int> filled;
+    QVector<QPair<int, int> > spans;
+    const auto rows = d->sheet->rows(bounds);
+    auto rowIt = rows.begin();
+    for (int row = bounds.firstRow(); row <= bounds.lastRow(); ++row) {
+        spans.clear();
+        for (const CellRange &area : qAsConst(areas)) {
+            if (row >= area.firstRow() && row <= area.lastRow())
+                spans.append(qMakePair(area.firstColumn(), area.lastColumn()));
+        }
+        if (spans.isEmpty())
+            continue;
+        std::sort(spans.begin(), spans.end());
+
+        while (rowIt != rows.end() && (*rowIt).row() < row)
+            ++rowIt;
+        if (rowIt != rows.end() && (*rowIt).row() == row) {
+            for (const CellView &cell : (*rowIt).cells()) {
+                const int index = cell.column() - bounds.firstColumn();
+                values[index] = FormulaEngine::cellValue(cell);
+                filled.append(index);
+            }
+        }
+
+        int next = bounds.firstColumn(); //the first column not evaluated yet
+        for (const auto &span : qAsConst(spans)) {
+            for (int column = qMax(next, span.first); column <= span.second; ++column) {
+                const ConditionalFormatResult result = d->evaluateCell(rules, row, column,
+                                                                       values.at(column - bounds.firstColumn()));
+                if (!result.isEmpty())
+                    visit(row, column, result);
+            }
+            next = qMax(next, span.second + 1);
+        }
+
+        for (int index : qAsConst(filled))
+            values[index] = FormulaValue();
+        filled.clear();
+    }
+}
+
+}
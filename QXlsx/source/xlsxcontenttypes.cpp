@@ -8,6 +8,7 @@
 #include <QDebug>
 
 #include "xlsxcontenttypes_p.h"
+#include "xlsxabstractooxmlfile_p.h"
 
 namespace QXlsx {
 
@@ -21,6 +22,15 @@ ContentTypes::ContentTypes(CreateFlag flag)
     m_defaults.insert(QStringLiteral("xml"), QStringLiteral("application/xml"));
 }
 
+ContentTypes *ContentTypes::clone() const
+{
+    auto copy = new ContentTypes(F_NewFromScratch);
+    *copy->d_ptr = *d_ptr;
+    copy->m_defaults = m_defaults;
+    copy->m_overrides = m_overrides;
+    return copy;
+}
+
 void ContentTypes::addDefault(const QString &key, const QString &value)
 {
     m_defaults.insert(key, value);
@@ -13,6 +13,7 @@
 #include "xlsxdocument.h"
 #include "xlsxworkbook.h"
 #include "xlsxworksheet.h"
+#include "xlsxworksheet_p.h"
 #include "xlsxchartsheet.h"
 #include "xlsxcontenttypes_p.h"
 #include "xlsxrelationships_p.h"
@@ -28,6 +29,12 @@
 #include "xlsxchart.h"
 #include "xlsxzipreader_p.h"
 #include "xlsxzipwriter_p.h"
+#include "xlsxprogresscontrol_p.h"
+#include "xlsxtemplate_p.h"
+
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QFutureInterface>
 
 /*
     From Wikipedia: The Open Packaging Conventions (OPC) is a
@@ -73,8 +80,15 @@ public:
     DocumentPrivate(Document *p);
     void init();
 
-    bool loadPackage(QIODevice *device);
-    bool savePackage(QIODevice *device) const;
+    bool loadPackage(QIODevice *device, ProgressControl *progress = nullptr);
+    bool savePackage(QIODevice *device, const SaveOptions &options, ProgressControl *progress = nullptr) const;
+    bool loadFile(const QString &name, ProgressControl *progress);
+    bool saveFile(const QString &name, const SaveOptions &options, ProgressControl *progress) const;
+
+    void assignSnapshot(const DocumentPrivate *other);
+
+    ProgressControl::Callback progressCallback(QFutureInterface<bool> *future = nullptr) const;
+    QFuture<bool> runAsync(const std::function<bool (ProgressControl *)> &task) const;
 
     // copy style from one xlsx file to other
     //    static bool copyStyle(const QString &from, const QString &to);
@@ -90,7 +104,28 @@ public:
     QSharedPointer<Workbook> workbook;
     std::shared_ptr<ContentTypes> contentTypes;
     bool isLoad;
+
+    QExplicitlySharedDataPointer<TemplatePrivate> templateData; //set if the document was created from a template
+    QMap<QString, RowFilter> rowFilters; //worksheet name -> filter applied on loading
+};
+
+namespace {
+// Makes the worksheets of a workbook report progress while it is saved.
+class ProgressScope
+{
+public:
+    ProgressScope(WorkbookPrivate *workbook, ProgressControl *progress) : m_workbook(workbook)
+    {
+        m_workbook->progress = progress;
+    }
+    ~ProgressScope()
+    {
+        m_workbook->progress = nullptr;
+    }
+private:
+    WorkbookPrivate *m_workbook;
 };
+}
 
 namespace xlsxDocumentCpp {
     std::string copyTag(const std::string &sFrom, const std::string &sTo, const std::string &tag) {
@@ -198,23 +233,36 @@ void DocumentPrivate::init()
         workbook = QSharedPointer<Workbook>(new Workbook(Workbook::F_NewFromScratch));
 }
 
-bool DocumentPrivate::loadPackage(QIODevice *device)
+bool DocumentPrivate::loadPackage(QIODevice *device, ProgressControl *progress)
 {
-    Q_Q(Document);
     ZipReader zipReader(device);
     QStringList filePaths = zipReader.filePaths();
 
+    if (progress)
+        progress->setTotal(zipReader.totalSize());
+    auto fileData = [&zipReader, progress](const QString &path) {
+        const QByteArray data = zipReader.fileData(path);
+        if (progress)
+            progress->finishPart(data.size());
+        return data;
+    };
+
+    //The package is loaded into new objects, the document contents are
+    //replaced only if the whole package was loaded.
+
     //Load the Content_Types file
     if (!filePaths.contains(QLatin1String("[Content_Types].xml")))
         return false;
-    contentTypes = std::make_shared<ContentTypes>(ContentTypes::F_LoadFromExists);
-    contentTypes->loadFromXmlData(zipReader.fileData(QStringLiteral("[Content_Types].xml")));
+    auto newContentTypes = std::make_shared<ContentTypes>(ContentTypes::F_LoadFromExists);
+    newContentTypes->loadFromXmlData(fileData(QStringLiteral("[Content_Types].xml")));
 
     //Load root rels file
     if (!filePaths.contains(QLatin1String("_rels/.rels")))
         return false;
     Relationships rootRels;
-    rootRels.loadFromXmlData(zipReader.fileData(QStringLiteral("_rels/.rels")));
+    rootRels.loadFromXmlData(fileData(QStringLiteral("_rels/.rels")));
+
+    QMap<Document::Metadata, QVariant> newMetadata;
 
     //load core properties
     QList<XlsxRelationship> rels_core = rootRels.packageRelationships(QStringLiteral("/metadata/core-properties"));
@@ -224,8 +272,8 @@ bool DocumentPrivate::loadPackage(QIODevice *device)
         QString docPropsCore_Name = rels_core[0].target;
 
         DocPropsCore props(DocPropsCore::F_LoadFromExists);
-        props.loadFromXmlData(zipReader.fileData(docPropsCore_Name));
-        metadata.insert(props.properties());
+        props.loadFromXmlData(fileData(docPropsCore_Name));
+        newMetadata.insert(props.properties());
     }
 
     //load extended properties
@@ -236,13 +284,13 @@ bool DocumentPrivate::loadPackage(QIODevice *device)
         QString docPropsApp_Name = rels_app[0].target;
 
         DocPropsApp docPropsApp(DocPropsApp::F_LoadFromExists);
-        docPropsApp.loadFromXmlData(zipReader.fileData(docPropsApp_Name));
-        metadata.insert(docPropsApp.properties());
+        docPropsApp.loadFromXmlData(fileData(docPropsApp_Name));
+        newMetadata.insert(docPropsApp.properties());
     }
 
     //load workbook now, Get the workbook file path from the root rels file
     //In normal case, this should be "xl/workbook.xml"
-    workbook = QSharedPointer<Workbook>(new Workbook(Workbook::F_LoadFromExists));
+    auto newWorkbook = QSharedPointer<Workbook>(new Workbook(Workbook::F_LoadFromExists));
     QList<XlsxRelationship> rels_xl = rootRels.documentRelationships(QStringLiteral("/officeDocument"));
     if (rels_xl.isEmpty())
         return false;
@@ -251,12 +299,12 @@ bool DocumentPrivate::loadPackage(QIODevice *device)
     const QString xlworkbook_Dir = parts.first();
     const QString relFilePath = getRelFilePath(xlworkbook_Path);
 
-    workbook->relationships()->loadFromXmlData( zipReader.fileData(relFilePath) );
-    workbook->setFilePath(xlworkbook_Path);
-    workbook->loadFromXmlData(zipReader.fileData(xlworkbook_Path));
+    newWorkbook->relationships()->loadFromXmlData( fileData(relFilePath) );
+    newWorkbook->setFilePath(xlworkbook_Path);
+    newWorkbook->loadFromXmlData(fileData(xlworkbook_Path));
 
     //load styles
-    QList<XlsxRelationship> rels_styles = workbook->relationships()->documentRelationships(QStringLiteral("/styles"));
+    QList<XlsxRelationship> rels_styles = newWorkbook->relationships()->documentRelationships(QStringLiteral("/styles"));
     if (!rels_styles.isEmpty()) {
         //In normal case this should be styles.xml which in xl
         QString name = rels_styles[0].target;
@@ -273,94 +321,130 @@ bool DocumentPrivate::loadPackage(QIODevice *device)
         }
 
         QSharedPointer<Styles> styles (new Styles(Styles::F_LoadFromExists));
-        styles->loadFromXmlData(zipReader.fileData(path));
-        workbook->d_func()->styles = styles;
+        styles->loadFromXmlData(fileData(path));
+        newWorkbook->d_func()->styles = styles;
     }
 
     //load sharedStrings
-    QList<XlsxRelationship> rels_sharedStrings = workbook->relationships()->documentRelationships(QStringLiteral("/sharedStrings"));
+    QList<XlsxRelationship> rels_sharedStrings = newWorkbook->relationships()->documentRelationships(QStringLiteral("/sharedStrings"));
     if (!rels_sharedStrings.isEmpty()) {
         //In normal case this should be sharedStrings.xml which in xl
         QString name = rels_sharedStrings[0].target;
         QString path = xlworkbook_Dir + QLatin1String("/") + name;
-        workbook->d_func()->sharedStrings->loadFromXmlData(zipReader.fileData(path));
+        newWorkbook->d_func()->sharedStrings->loadFromXmlData(fileData(path));
     }
 
     //load theme
-    QList<XlsxRelationship> rels_theme = workbook->relationships()->documentRelationships(QStringLiteral("/theme"));
+    QList<XlsxRelationship> rels_theme = newWorkbook->relationships()->documentRelationships(QStringLiteral("/theme"));
     if (!rels_theme.isEmpty()) {
         //In normal case this should be theme/theme1.xml which in xl
         QString name = rels_theme[0].target;
         QString path = xlworkbook_Dir + QLatin1String("/") + name;
-        workbook->theme()->loadFromXmlData(zipReader.fileData(path));
+        newWorkbook->theme()->loadFromXmlData(fileData(path));
     }
 
+    if (progress && progress->isCanceled())
+        return false;
+
     //load sheets
-    for (int i=0; i<workbook->sheetsCount(); ++i) {
-        AbstractSheet *sheet = workbook->sheet(i);
+    newWorkbook->d_func()->progress = progress;
+    for (int i=0; i<newWorkbook->sheetsCount(); ++i) {
+        AbstractSheet *sheet = newWorkbook->sheet(i);
         QString strFilePath = sheet->filePath();
         QString rel_path = getRelFilePath(strFilePath);
         //If the .rel file exists, load it.
         if (zipReader.filePaths().contains(rel_path))
-            sheet->relationships()->loadFromXmlData(zipReader.fileData(rel_path));
-        sheet->loadFromXmlData(zipReader.fileData(sheet->filePath()));
+            sheet->relationships()->loadFromXmlData(fileData(rel_path));
+        if (sheet->type() == AbstractSheet::Type::Worksheet) {
+            auto filter = rowFilters.constFind(sheet->name());
+            if (filter != rowFilters.constEnd())
+                static_cast<Worksheet *>(sheet)->d_func()->loadFilter = filter.value();
+        }
+        //sheets report progress while parsing, so account them afterwards
+        const QByteArray sheetData = zipReader.fileData(sheet->filePath());
+        const bool loaded = sheet->loadFromXmlData(sheetData);
+        if (progress) {
+            if (!loaded && progress->isCanceled()) {
+                newWorkbook->d_func()->progress = nullptr;
+                return false;
+            }
+            progress->finishPart(sheetData.size());
+        }
     }
+    newWorkbook->d_func()->progress = nullptr;
 
     //load external links
-    for (int i=0; i<workbook->d_func()->externalLinks.count(); ++i) {
-        SimpleOOXmlFile *link = workbook->d_func()->externalLinks[i].data();
+    for (int i=0; i<newWorkbook->d_func()->externalLinks.count(); ++i) {
+        SimpleOOXmlFile *link = newWorkbook->d_func()->externalLinks[i].data();
         QString rel_path = getRelFilePath(link->filePath());
         //If the .rel file exists, load it.
         if (zipReader.filePaths().contains(rel_path))
-            link->relationships()->loadFromXmlData(zipReader.fileData(rel_path));
-        link->loadFromXmlData(zipReader.fileData(link->filePath()));
+            link->relationships()->loadFromXmlData(fileData(rel_path));
+        link->loadFromXmlData(fileData(link->filePath()));
     }
 
     //load drawings
-    for (int i=0; i<workbook->drawings().size(); ++i) {
-        Drawing *drawing = workbook->drawings()[i];
+    for (int i=0; i<newWorkbook->drawings().size(); ++i) {
+        Drawing *drawing = newWorkbook->drawings()[i];
         QString rel_path = getRelFilePath(drawing->filePath());
         if (zipReader.filePaths().contains(rel_path))
-            drawing->relationships()->loadFromXmlData(zipReader.fileData(rel_path));
-        drawing->loadFromXmlData(zipReader.fileData(drawing->filePath()));
+            drawing->relationships()->loadFromXmlData(fileData(rel_path));
+        drawing->loadFromXmlData(fileData(drawing->filePath()));
     }
 
     //load charts
-    auto chartFileToLoad = workbook->chartFiles();
+    auto chartFileToLoad = newWorkbook->chartFiles();
     for (int i=0; i<chartFileToLoad.size(); ++i) {
         QSharedPointer<Chart> cf = chartFileToLoad[i].lock();
         QString rel_path = getRelFilePath(cf->filePath());
         if (zipReader.filePaths().contains(rel_path))
-            cf->relationships()->loadFromXmlData(zipReader.fileData(rel_path));
-        cf->loadFromXmlData(zipReader.fileData(cf->filePath()));
+            cf->relationships()->loadFromXmlData(fileData(rel_path));
+        cf->loadFromXmlData(fileData(cf->filePath()));
 
         //relations
-        cf->loadMediaFiles(workbook.get());
+        cf->loadMediaFiles(newWorkbook.get());
     }
 
     //load media files
-    const auto mediaFileToLoad = workbook->mediaFiles();
+    const auto mediaFileToLoad = newWorkbook->mediaFiles();
     for (const auto &mf : mediaFileToLoad) {
         if (auto media = mf.lock()) {
             const QString path = media->fileName();
             const QString suffix = path.mid(path.lastIndexOf(QLatin1Char('.'))+1);
-            media->set(zipReader.fileData(path), suffix);
+            media->set(fileData(path), suffix);
         }
     }
 
+    if (progress) {
+        if (progress->isCanceled())
+            return false;
+        progress->finish();
+    }
+
+    contentTypes = newContentTypes;
+    metadata.insert(newMetadata);
+    workbook = newWorkbook;
     isLoad = true; 
     return true;
 }
 
-bool DocumentPrivate::savePackage(QIODevice *device) const
+bool DocumentPrivate::savePackage(QIODevice *device, const SaveOptions &options, ProgressControl *progress) const
 {
     Q_Q(const Document);
 
-    ZipWriter zipWriter(device);
+    ZipWriter zipWriter(device, options);
     if (zipWriter.error())
         return false;
 
+    ProgressScope progressScope(workbook->d_func(), progress);
+    auto partSaved = [progress](qint64 size = 1) {
+        if (progress)
+            progress->finishPart(size);
+        return !progress || !progress->isCanceled();
+    };
+
     contentTypes->clearOverrides();
+    workbook->mergeConcurrentWrites();
 
     DocPropsApp docPropsApp(DocPropsApp::F_NewFromScratch);
     DocPropsCore docPropsCore(DocPropsCore::F_NewFromScratch);
@@ -370,17 +454,42 @@ bool DocumentPrivate::savePackage(QIODevice *device) const
     if (!worksheets.isEmpty())
         docPropsApp.addHeadingPair(QStringLiteral("Worksheets"), worksheets.size());
 
+    if (progress) {
+        //worksheets are accounted by rows, other parts count as one row
+        qint64 total = workbook->sheetsCount() + workbook->d_func()->externalLinks.count()
+                       + workbook->drawings().size() + workbook->chartFiles().size()
+                       + workbook->mediaFiles().size() + 10;
+        for (const auto &sheet : qAsConst(worksheets)) {
+            const CellRange dimension = static_cast<Worksheet *>(sheet.data())->dimension();
+            if (dimension.isValid())
+                total += dimension.rowCount();
+        }
+        progress->setTotal(total);
+    }
+
     for (int i = 0 ; i < worksheets.size(); ++i)
     {
         QSharedPointer<AbstractSheet> sheet = worksheets[i];
         contentTypes->addWorksheetName(QStringLiteral("sheet%1").arg(i+1));
         docPropsApp.addPartTitle(sheet->name());
 
-        zipWriter.addFile(QStringLiteral("xl/worksheets/sheet%1.xml").arg(i+1), sheet->saveToXmlData());
+        // worksheets can be huge, so stream them instead of building in memory
+        const QString path = QStringLiteral("xl/worksheets/sheet%1.xml").arg(i+1);
+        const ZipWriter::CompressedData *cached = templateData
+                ? templateData->worksheetPart(static_cast<Worksheet *>(sheet.data()), options.partCompression(path))
+                : nullptr;
+        if (cached)
+            zipWriter.addCompressedFile(path, *cached);
+        else
+            zipWriter.addFile(path, [&sheet](QIODevice *device){ sheet->saveToXmlFile(device); });
 
         Relationships *rel = sheet->relationships();
         if (!rel->isEmpty())
             zipWriter.addFile(QStringLiteral("xl/worksheets/_rels/sheet%1.xml.rels").arg(i+1), rel->saveToXmlData());
+
+        const CellRange dimension = static_cast<Worksheet *>(sheet.data())->dimension();
+        if (!partSaved(1 + (dimension.isValid() ? dimension.rowCount() : 0)))
+            return false;
     }
 
     //save chartsheet xml files
@@ -397,6 +506,8 @@ bool DocumentPrivate::savePackage(QIODevice *device) const
         Relationships *rel = sheet->relationships();
         if (!rel->isEmpty())
             zipWriter.addFile(QStringLiteral("xl/chartsheets/_rels/sheet%1.xml.rels").arg(i+1), rel->saveToXmlData());
+        if (!partSaved())
+            return false;
     }
 
     // save external links xml files
@@ -409,12 +520,14 @@ bool DocumentPrivate::savePackage(QIODevice *device) const
         Relationships *rel = link->relationships();
         if (!rel->isEmpty())
             zipWriter.addFile(QStringLiteral("xl/externalLinks/_rels/externalLink%1.xml.rels").arg(i+1), rel->saveToXmlData());
+        partSaved();
     }
 
     // save workbook xml file
     contentTypes->addWorkbook();
     zipWriter.addFile(QStringLiteral("xl/workbook.xml"), workbook->saveToXmlData());
     zipWriter.addFile(QStringLiteral("xl/_rels/workbook.xml.rels"), workbook->relationships()->saveToXmlData());
+    partSaved(2);
 
     // save drawing xml files
     for (int i=0; i<workbook->drawings().size(); ++i)
@@ -425,6 +538,7 @@ bool DocumentPrivate::savePackage(QIODevice *device) const
         zipWriter.addFile(QStringLiteral("xl/drawings/drawing%1.xml").arg(i+1), drawing->saveToXmlData());
         if (!drawing->relationships()->isEmpty())
             zipWriter.addFile(QStringLiteral("xl/drawings/_rels/drawing%1.xml.rels").arg(i+1), drawing->relationships()->saveToXmlData());
+        partSaved();
     }
 
     // save docProps app/core xml file
@@ -437,24 +551,48 @@ bool DocumentPrivate::savePackage(QIODevice *device) const
     contentTypes->addDocPropCore();
     zipWriter.addFile(QStringLiteral("docProps/app.xml"), docPropsApp.saveToXmlData());
     zipWriter.addFile(QStringLiteral("docProps/core.xml"), docPropsCore.saveToXmlData());
+    partSaved(2);
 
     // save sharedStrings xml file
     if (!workbook->sharedStrings()->isEmpty()) {
         contentTypes->addSharedString();
-        zipWriter.addFile(QStringLiteral("xl/sharedStrings.xml"), workbook->sharedStrings()->saveToXmlData());
+        auto sharedStrings = workbook->sharedStrings();
+        const QString path = QStringLiteral("xl/sharedStrings.xml");
+        if (auto cached = templateData ? templateData->sharedStringsPart(sharedStrings, options.partCompression(path)) : nullptr)
+            zipWriter.addCompressedFile(path, *cached);
+        else
+            zipWriter.addFile(path, [sharedStrings](QIODevice *device){ sharedStrings->saveToXmlFile(device); });
     }
+    if (!partSaved())
+        return false;
+
+    const QString stylesPath = QStringLiteral("xl/styles.xml");
+    const QString calcChainPath = QStringLiteral("xl/calcChain.xml");
+    auto cachedStyles = templateData ? templateData->stylesPart(workbook->styles(), options.partCompression(stylesPath)) : nullptr;
+    const QByteArray stylesData = cachedStyles ? QByteArray() : workbook->styles()->saveToXmlData();
 
     // save calc chain [dev16]
     contentTypes->addCalcChain();
-    zipWriter.addFile(QStringLiteral("xl/calcChain.xml"), workbook->styles()->saveToXmlData());
+    if (cachedStyles && options.partCompression(calcChainPath) == cachedStyles->compression)
+        zipWriter.addCompressedFile(calcChainPath, *cachedStyles);
+    else
+        zipWriter.addFile(calcChainPath, cachedStyles ? workbook->styles()->saveToXmlData() : stylesData);
 
     // save styles xml file
     contentTypes->addStyles();
-    zipWriter.addFile(QStringLiteral("xl/styles.xml"), workbook->styles()->saveToXmlData());
+    if (cachedStyles)
+        zipWriter.addCompressedFile(stylesPath, *cachedStyles);
+    else
+        zipWriter.addFile(stylesPath, stylesData);
 
     // save theme xml file
     contentTypes->addTheme();
-    zipWriter.addFile(QStringLiteral("xl/theme/theme1.xml"), workbook->theme()->saveToXmlData());
+    const QString themePath = QStringLiteral("xl/theme/theme1.xml");
+    if (auto cached = templateData ? templateData->themePart(workbook->theme(), options.partCompression(themePath)) : nullptr)
+        zipWriter.addCompressedFile(themePath, *cached);
+    else
+        zipWriter.addFile(themePath, workbook->theme()->saveToXmlData());
+    partSaved(3);
 
     // save chart xml files
     auto chartFiles = workbook->chartFiles();
@@ -467,6 +605,7 @@ bool DocumentPrivate::savePackage(QIODevice *device) const
 
         if (auto rel = cf->relationships(); rel && !rel->isEmpty())
             zipWriter.addFile(QStringLiteral("xl/charts/_rels/chart%1.xml.rels").arg(i+1), rel->saveToXmlData());
+        partSaved();
     }
 
     // save media files
@@ -476,8 +615,13 @@ bool DocumentPrivate::savePackage(QIODevice *device) const
             if (!mf->mimeType().isEmpty())
                 contentTypes->addDefault(mf->suffix(), mf->mimeType());
 
-            zipWriter.addFile(QStringLiteral("xl/media/image%1.%2").arg(i+1).arg(mf->suffix()), mf->contents());
+            const QString path = QStringLiteral("xl/media/image%1.%2").arg(i+1).arg(mf->suffix());
+            if (auto cached = templateData ? templateData->mediaPart(mf.data(), options.partCompression(path)) : nullptr)
+                zipWriter.addCompressedFile(path, *cached);
+            else
+                zipWriter.addFile(path, mf->contents());
         }
+        partSaved();
     }
 
     // save root .rels xml file
@@ -491,7 +635,79 @@ bool DocumentPrivate::savePackage(QIODevice *device) const
     zipWriter.addFile(QStringLiteral("[Content_Types].xml"), contentTypes->saveToXmlData());
     zipWriter.close();
 
-    return true;
+    if (progress) {
+        if (progress->isCanceled())
+            return false;
+        progress->finish();
+    }
+    return !zipWriter.error();
+}
+
+bool DocumentPrivate::loadFile(const QString &name, ProgressControl *progress)
+{
+    if (QFile::exists(name)) {
+        QFile xlsx(name);
+        if (xlsx.open(QFile::ReadOnly))
+            return loadPackage(&xlsx, progress);
+    }
+    return false;
+}
+
+bool DocumentPrivate::saveFile(const QString &name, const SaveOptions &options, ProgressControl *progress) const
+{
+    //the existing file is replaced only if the document was saved successfully
+    QSaveFile file(name);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    if (!savePackage(&file, options, progress)) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+/*!
+ * \internal
+ * Makes this document a copy-on-write snapshot of \a other.
+ */
+void DocumentPrivate::assignSnapshot(const DocumentPrivate *other)
+{
+    documentProperties = other->documentProperties;
+    metadata = other->metadata;
+    //the snapshot must not share the registries of the concurrent writers
+    other->workbook->mergeConcurrentWrites();
+    workbook = QSharedPointer<Workbook>(other->workbook->snapshot());
+    contentTypes.reset(other->contentTypes->clone());
+    isLoad = other->isLoad;
+    templateData = other->templateData;
+}
+
+ProgressControl::Callback DocumentPrivate::progressCallback(QFutureInterface<bool> *future) const
+{
+    Document *q = q_ptr;
+    return [q, future](qint64 processed, qint64 total) {
+        if (future && total > 0)
+            future->setProgressValue(int(processed * 100 / total));
+        Q_EMIT q->progressChanged(processed, total);
+    };
+}
+
+QFuture<bool> DocumentPrivate::runAsync(const std::function<bool (ProgressControl *)> &task) const
+{
+    auto future = std::make_shared<QFutureInterface<bool> >();
+    future->setProgressRange(0, 100);
+    future->reportStarted();
+
+    QThreadPool::globalInstance()->start([this, future, task]() {
+        ProgressControl progress(progressCallback(future.get()),
+                                 [future]() { return future->isCanceled(); });
+        const bool ok = task(&progress);
+        if (!future->isCanceled())
+            future->reportResult(ok);
+        future->reportFinished();
+    });
+
+    return future->future();
 }
 
 //bool DocumentPrivate::copyStyle(const QString &from, const QString &to)
@@ -595,6 +811,20 @@ Document::Document(QIODevice *device, QObject *parent) :
     d_ptr->init();
 }
 
+Document::Document(const Template &tmpl, QObject *parent) :
+    QObject(parent), d_ptr(new DocumentPrivate(this))
+{
+    if (tmpl.isValid()) {
+        const TemplatePrivate *template_d = tmpl.d.data();
+        {
+            QMutexLocker locker(&template_d->mutex);
+            d_ptr->assignSnapshot(template_d->document->d_func());
+        }
+        d_ptr->templateData = tmpl.d;
+    }
+    d_ptr->init();
+}
+
 bool Document::write(const CellReference &row_column, const QVariant &value, const Format &format)
 {
     if (Worksheet *sheet = activeWorksheet())
@@ -766,26 +996,48 @@ QStringList Document::sheetNames() const
     return d->workbook->sheetNames();
 }
 
-bool Document::save() const
+bool Document::save(const SaveOptions &options) const
 {
     Q_D(const Document);
     QString name = d->packageName.isEmpty() ? d->defaultPackageName : d->packageName;
 
-    return saveAs(name);
+    return saveAs(name, options);
 }
 
-bool Document::saveAs(const QString &name) const
+bool Document::saveAs(const QString &name, const SaveOptions &options) const
 {
-    QFile file(name);
-    if (file.open(QIODevice::WriteOnly))
-        return saveAs(&file);
-    return false;
+    Q_D(const Document);
+    ProgressControl progress(d->progressCallback());
+    return d->saveFile(name, options, &progress);
+}
+
+bool Document::saveAs(QIODevice *device, const SaveOptions &options) const
+{
+    Q_D(const Document);
+    ProgressControl progress(d->progressCallback());
+    return d->savePackage(device, options, &progress);
 }
 
-bool Document::saveAs(QIODevice *device) const
+QFuture<bool> Document::saveAsync(const QString &name, const SaveOptions &options) const
 {
     Q_D(const Document);
-    return d->savePackage(device);
+    QString fileName = name;
+    if (fileName.isEmpty())
+        fileName = d->packageName.isEmpty() ? d->defaultPackageName : d->packageName;
+
+    std::shared_ptr<Document> snapshot(this->snapshot());
+    return d->runAsync([snapshot, fileName, options](ProgressControl *progress) {
+        return snapshot->d_func()->saveFile(fileName, options, progress);
+    });
+}
+
+Document *Document::snapshot(QObject *parent) const
+{
+    Q_D(const Document);
+    auto doc = new Document(parent);
+    doc->d_func()->assignSnapshot(d);
+    doc->d_func()->packageName = d->packageName;
+    return doc;
 }
 
 bool Document::isLoaded() const
@@ -796,13 +1048,38 @@ bool Document::isLoaded() const
 
 bool Document::load()
 {
-    if (QFile::exists(d_ptr->packageName)) {
-        QFile xlsx(d_ptr->packageName);
-        if (xlsx.open(QFile::ReadOnly)) {
-            return d_ptr->loadPackage(&xlsx);
-        }
-    }
-    return false;
+    Q_D(Document);
+    ProgressControl progress(d->progressCallback());
+    return d->loadFile(d->packageName, &progress);
+}
+
+QFuture<bool> Document::loadAsync()
+{
+    Q_D(Document);
+    return d->runAsync([d](ProgressControl *progress) {
+        return d->loadFile(d->packageName, progress);
+    });
+}
+
+void Document::setRowFilter(const QString &sheetName, const RowFilter &filter)
+{
+    Q_D(Document);
+    if (filter.isEmpty())
+        d->rowFilters.remove(sheetName);
+    else
+        d->rowFilters.insert(sheetName, filter);
+}
+
+RowFilter Document::rowFilter(const QString &sheetName) const
+{
+    Q_D(const Document);
+    return d->rowFilters.value(sheetName);
+}
+
+void Document::clearRowFilters()
+{
+    Q_D(Document);
+    d->rowFilters.clear();
 }
 
 //bool Document::copyStyle(const QString &from, const QString &to) {
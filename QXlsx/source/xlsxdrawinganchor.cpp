@@ -138,6 +138,21 @@ bool DrawingAnchor::removeObjectPicture()
     return false;
 }
 
+QSharedPointer<MediaFile> DrawingAnchor::pictureFile() const
+{
+    return m_pictureFile;
+}
+
+/*!
+ * \internal
+ * Replaces the media of the picture, e.g. by an equal media file of the
+ * workbook the drawing was copied to. \a file must be added to the workbook.
+ */
+void DrawingAnchor::setPictureFile(const QSharedPointer<MediaFile> &file)
+{
+    m_pictureFile = file;
+}
+
 QSharedPointer<Chart> DrawingAnchor::chart() const
 {
     return m_chartFile;
@@ -3,6 +3,7 @@
 #include <QtGlobal>
 #include <QDataStream>
 #include <QDebug>
+#include <QMutex>
 
 #include "xlsxformat.h"
 #include "xlsxformat_p.h"
@@ -11,6 +12,27 @@
 
 namespace QXlsx {
 
+/*
+ * The format keys are generated lazily by the const methods of Format, and
+ * formats share their data, so several threads that read one document may
+ * ask for the same key at the same time. The key is generated under a mutex
+ * and published by clearing the atomic dirty flag, so that the readers of an
+ * already generated key take no lock.
+ */
+template <typename Generate>
+static QByteArray cachedKey(std::atomic<bool> &dirty, QByteArray &key, Generate generate)
+{
+    if (dirty.load(std::memory_order_acquire)) {
+        static QMutex mutex;
+        QMutexLocker locker(&mutex);
+        if (dirty.load(std::memory_order_relaxed)) {
+            key = generate();
+            dirty.store(false, std::memory_order_release);
+        }
+    }
+    return key;
+}
+
 FormatPrivate::FormatPrivate()
     : dirty(true)
     , font_dirty(true), font_index_valid(false), font_index(0)
@@ -22,12 +44,14 @@ FormatPrivate::FormatPrivate()
 {
 }
 
+//The keys of \a other may be being generated by another thread, so that they
+//are copied only if they are already published.
 FormatPrivate::FormatPrivate(const FormatPrivate &other)
     : QSharedData(other)
-    , dirty(other.dirty), formatKey(other.formatKey)
-    , font_dirty(other.font_dirty), font_index_valid(other.font_index_valid), font_key(other.font_key), font_index(other.font_index)
-    , fill_dirty(other.fill_dirty), fill_index_valid(other.fill_index_valid), fill_key(other.fill_key), fill_index(other.fill_index)
-    , border_dirty(other.border_dirty), border_index_valid(other.border_index_valid), border_key(other.border_key), border_index(other.border_index)
+    , dirty(other.dirty.load(std::memory_order_acquire)), formatKey(dirty ? QByteArray() : other.formatKey)
+    , font_dirty(other.font_dirty.load(std::memory_order_acquire)), font_index_valid(other.font_index_valid), font_key(font_dirty ? QByteArray() : other.font_key), font_index(other.font_index)
+    , fill_dirty(other.fill_dirty.load(std::memory_order_acquire)), fill_index_valid(other.fill_index_valid), fill_key(fill_dirty ? QByteArray() : other.fill_key), fill_index(other.fill_index)
+    , border_dirty(other.border_dirty.load(std::memory_order_acquire)), border_index_valid(other.border_index_valid), border_key(border_dirty ? QByteArray() : other.border_key), border_index(other.border_index)
     , xf_index(other.xf_index), xf_indexValid(other.xf_indexValid)
     , is_dxf_fomat(other.is_dxf_fomat), dxf_index(other.dxf_index), dxf_indexValid(other.dxf_indexValid)
     , theme(other.theme)
@@ -397,7 +421,7 @@ QByteArray Format::fontKey() const
     if (isEmpty())
         return QByteArray();
 
-    if (d->font_dirty) {
+    return cachedKey(d->font_dirty, d->font_key, [this]() {
         QByteArray key;
         QDataStream stream(&key, QIODevice::WriteOnly);
         for (int i=FormatPrivate::P_Font_STARTID; i<FormatPrivate::P_Font_ENDID; ++i) {
@@ -405,12 +429,8 @@ QByteArray Format::fontKey() const
             if (it != d->properties.constEnd())
                 stream << i << it.value();
         };
-
-        const_cast<Format*>(this)->d->font_key = key;
-        const_cast<Format*>(this)->d->font_dirty = false;
-    }
-
-    return d->font_key;
+        return key;
+    });
 }
 
 /*!
@@ -806,7 +826,7 @@ QByteArray Format::borderKey() const
     if (isEmpty())
         return QByteArray();
 
-    if (d->border_dirty) {
+    return cachedKey(d->border_dirty, d->border_key, [this]() {
         QByteArray key;
         QDataStream stream(&key, QIODevice::WriteOnly);
         for (int i=FormatPrivate::P_Border_STARTID; i<FormatPrivate::P_Border_ENDID; ++i) {
@@ -814,12 +834,8 @@ QByteArray Format::borderKey() const
             if (it != d->properties.constEnd())
                 stream << i << it.value();
         };
-
-        const_cast<Format*>(this)->d->border_key = key;
-        const_cast<Format*>(this)->d->border_dirty = false;
-    }
-
-    return d->border_key;
+        return key;
+    });
 }
 
 /*!
@@ -927,7 +943,7 @@ QByteArray Format::fillKey() const
     if (isEmpty())
         return QByteArray();
 
-    if (d->fill_dirty) {
+    return cachedKey(d->fill_dirty, d->fill_key, [this]() {
         QByteArray key;
         QDataStream stream(&key, QIODevice::WriteOnly);
         for (int i=FormatPrivate::P_Fill_STARTID; i<FormatPrivate::P_Fill_ENDID; ++i) {
@@ -935,12 +951,8 @@ QByteArray Format::fillKey() const
             if (it != d->properties.constEnd())
                 stream << i << it.value();
         };
-
-        const_cast<Format*>(this)->d->fill_key = key;
-        const_cast<Format*>(this)->d->fill_dirty = false;
-    }
-
-    return d->fill_key;
+        return key;
+    });
 }
 
 /*!
@@ -1055,7 +1067,7 @@ QByteArray Format::formatKey() const
     if (isEmpty())
         return QByteArray();
 
-    if (d->dirty) {
+    return cachedKey(d->dirty, d->formatKey, [this]() {
         QByteArray key;
         QDataStream stream(&key, QIODevice::WriteOnly);
 
@@ -1064,12 +1076,8 @@ QByteArray Format::formatKey() const
             i.next();
             stream<<i.key()<<i.value();
         }
-
-        d->formatKey = key;
-        d->dirty = false;
-    }
-
-    return d->formatKey;
+        return key;
+    });
 }
 
 /*!
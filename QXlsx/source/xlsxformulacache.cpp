@@ -0,0 +1,132 @@
+// xlsxformulacache.cpp
+
+#include <QtGlobal>
+#include <QMutexLocker>
+
+#include "xlsxformulacache_p.h"
+
+namespace QXlsx {
+
+namespace {
+//the remembered texts are dropped when there are more of them
+const int MaxSources = 65536;
+}
+
+/*!
+ * \internal
+ * Returns the text of the formula (without the leading '=') in the cell at
+ * (\a row, \a column). References that fall outside the sheet become #REF!.
+ */
+QString FormulaTemplate::toA1(int row, int column) const
+{
+    QString text = m_literals.value(0);
+    for (int i = 0; i < m_references.size(); ++i) {
+        FormulaReference reference = m_references.at(i).resolved(row, column);
+        reference.sheet.clear();
+        text += reference.isValid() ? reference.toString() : formulaErrorToString(FormulaError::Ref);
+        text += m_literals.at(i + 1);
+    }
+    return text;
+}
+
+/*!
+ * \internal
+ * Returns the template of \a formula written in the cell at (\a row, \a column).
+ * The formula is tokenized only if it has not been compiled for this cell
+ * recently, and parsed only if no formula with the same R1C1 form is known.
+ */
+FormulaTemplatePtr FormulaCache::compile(const QString &formula, int row, int column)
+{
+    const Source source {formula, row, column};
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_sources.constFind(source);
+        if (it != m_sources.constEnd())
+            return it.value();
+    }
+
+    auto compiled = std::make_shared<FormulaTemplate>();
+    QVector<FormulaReferenceSpan> spans;
+    if (FormulaParser::findReferences(formula, spans)) {
+        compiled->m_valid = true;
+        int position = 0;
+        for (const FormulaReferenceSpan &span: qAsConst(spans)) {
+            //the sheet prefix stays in the literal part
+            const FormulaReference reference = span.reference.relativeTo(row, column);
+            FormulaReference area = reference;
+            area.sheet.clear();
+            const QString literal = formula.mid(position, span.position - position);
+            compiled->m_literals << literal;
+            compiled->m_references << reference;
+            compiled->m_key += literal + area.toR1C1();
+            position = span.position + span.length;
+        }
+        compiled->m_literals << formula.mid(position);
+        compiled->m_key += compiled->m_literals.last();
+    }
+    else {
+        //kept as is for every cell; the marker keeps the key apart from the R1C1 forms
+        compiled->m_literals << formula;
+        compiled->m_key = QLatin1Char('\x01') + formula;
+    }
+
+    FormulaTemplatePtr result;
+    {
+        QMutexLocker locker(&m_mutex);
+        result = m_templates.value(compiled->m_key);
+    }
+    if (!result) {
+        if (compiled->m_valid)
+            compiled->m_ast = FormulaParser::parse(formula, row, column);
+        result = intern(compiled);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (m_sources.size() >= MaxSources)
+        m_sources.clear();
+    m_sources.insert(source, result);
+    return result;
+}
+
+/*!
+ * \internal
+ * Adds \a formula to the templates unless another thread has added an equal
+ * one meanwhile. The templates used only by the cache are dropped when their
+ * number doubles.
+ */
+FormulaTemplatePtr FormulaCache::intern(const std::shared_ptr<FormulaTemplate> &formula)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_templates.constFind(formula->m_key);
+    if (it != m_templates.constEnd())
+        return it.value();
+
+    if (m_templates.size() >= m_purgeLimit) {
+        m_sources.clear();
+        for (auto t = m_templates.begin(); t != m_templates.end();) {
+            if (t.value().use_count() == 1)
+                t = m_templates.erase(t);
+            else
+                ++t;
+        }
+        m_purgeLimit = qMax(4096, m_templates.size() * 2);
+    }
+    m_templates.insert(formula->m_key, formula);
+    return formula;
+}
+
+int FormulaCache::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_templates.size();
+}
+
+void FormulaCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_templates.clear();
+    m_sources.clear();
+    m_purgeLimit = 4096;
+}
+
+}
@@ -0,0 +1,972 @@
+// xlsxformulaengine.cpp
+
+#include <QtGlobal>
+#include <QLocale>
+#include <QThread>
+#include <QThreadPool>
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+#include "xlsxformulaengine_p.h"
+#include "xlsxworkbook.h"
+#include "xlsxworkbook_p.h"
+#include "xlsxworksheet.h"
+#include "xlsxworksheet_p.h"
+#include "xlsxcelliterator.h"
+
+namespace QXlsx {
+
+namespace {
+
+const int MaxNameDepth = 32;
+
+FormulaValue valueOfCell(const CellView &cell)
+{
+    switch (cell.type()) {
+        case Cell::Type::Boolean:
+            return FormulaValue::fromBoolean(cell.boolean());
+        case Cell::Type::Error: {
+            const FormulaError error = formulaErrorFromString(cell.text());
+            return FormulaValue::fromError(error == FormulaError::None ? FormulaError::Value : error);
+        }
+        case Cell::Type::SharedString:
+        case Cell::Type::InlineString:
+        case Cell::Type::Formula:
+            return FormulaValue::fromString(cell.text());
+        default: break;
+    }
+    if (cell.isNumber())
+        return FormulaValue::fromNumber(cell.number());
+    const QString text = cell.text();
+    if (text.isEmpty())
+        return FormulaValue();
+    return FormulaValue::fromString(text);
+}
+
+}
+
+FormulaValue FormulaValue::fromNumber(double number)
+{
+    if (!std::isfinite(number))
+        return fromError(FormulaError::Num);
+    FormulaValue value;
+    value.type = Type::Number;
+    value.number = number;
+    return value;
+}
+
+FormulaValue FormulaValue::fromString(const QString &string)
+{
+    FormulaValue value;
+    value.type = Type::String;
+    value.string = string;
+    return value;
+}
+
+FormulaValue FormulaValue::fromBoolean(bool boolean)
+{
+    FormulaValue value;
+    value.type = Type::Boolean;
+    value.boolean = boolean;
+    return value;
+}
+
+FormulaValue FormulaValue::fromError(FormulaError error)
+{
+    FormulaValue value;
+    value.type = Type::Error;
+    value.error = error;
+    return value;
+}
+
+FormulaValue FormulaValue::fromRange(const Worksheet *sheet, const CellRange &range)
+{
+    FormulaValue value;
+    value.type = Type::Range;
+    value.sheet = sheet;
+    value.range = range;
+    return value;
+}
+
+QVariant FormulaValue::toVariant() const
+{
+    switch (type) {
+        case Type::Number: return number;
+        case Type::String: return string;
+        case Type::Boolean: return boolean;
+        case Type::Error: return formulaErrorToString(error);
+        default: break;
+    }
+    return QVariant();
+}
+
+bool FormulaArguments::isMissing(int index) const
+{
+    return index >= values.size() || values.at(index).type == FormulaValue::Type::Blank;
+}
+
+FormulaValue FormulaArguments::scalar(int index) const
+{
+    if (index >= values.size()) return FormulaValue();
+    return engine->toScalar(values.at(index), context);
+}
+
+FormulaError FormulaArguments::number(int index, double &value) const
+{
+    return FormulaEngine::toNumber(scalar(index), value);
+}
+
+FormulaError FormulaArguments::boolean(int index, bool &value) const
+{
+    return FormulaEngine::toBoolean(scalar(index), value);
+}
+
+FormulaError FormulaArguments::text(int index, QString &value) const
+{
+    const FormulaValue v = scalar(index);
+    if (v.isError()) return v.error;
+    value = FormulaEngine::toText(v);
+    return FormulaError::None;
+}
+
+FormulaEngine::FormulaEngine(Workbook *workbook)
+    : m_workbook(workbook)
+{
+
+}
+
+FormulaEngine::~FormulaEngine()
+{
+
+}
+
+/*!
+ * \internal
+ * Calculates the formulas affected by the changes since the last call using
+ * \a threads threads (QThread::idealThreadCount() if 0).
+ * Returns false if some formulas have circular references.
+ */
+bool FormulaEngine::recalculate(int threads)
+{
+    QSet<FormulaCellKey> dirty;
+    bool full = updateStructure() || !m_built;
+    if (!full) {
+        for (Worksheet *sheet: qAsConst(m_sheets)) {
+            if (sheet->d_func()->changesOverflow)
+                full = true;
+        }
+    }
+
+    if (full) {
+        rebuild();
+        for (auto it = m_formulas.constBegin(); it != m_formulas.constEnd(); ++it)
+            dirty.insert(it.key());
+    }
+    else {
+        //update the graph and collect the formulas that depend on the changed cells
+        QVector<FormulaCellKey> queue;
+        for (Worksheet *sheet: qAsConst(m_sheets)) {
+            auto d = sheet->d_func();
+            for (quint64 key: qAsConst(d->changedCells)) {
+                const FormulaCellKey cell {sheet, int(key >> 32), int(key & 0xffffffff)};
+                updateFormula(cell);
+                queue.append(cell);
+            }
+            d->changedCells.clear();
+        }
+        for (auto it = m_formulas.constBegin(); it != m_formulas.constEnd(); ++it) {
+            if (it.value().isVolatile)
+                queue.append(it.key());
+        }
+
+        QSet<FormulaCellKey> visited;
+        while (!queue.isEmpty()) {
+            const FormulaCellKey cell = queue.takeLast();
+            if (visited.contains(cell)) continue;
+            visited.insert(cell);
+            if (m_formulas.contains(cell))
+                dirty.insert(cell);
+            for (const FormulaCellKey &dependent: dependents(cell)) {
+                if (!visited.contains(dependent))
+                    queue.append(dependent);
+            }
+        }
+    }
+
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    threads = qMax(1, threads);
+    const auto levels = levelize(dirty);
+    //one pool for all levels, so its threads are started once and reused
+    std::unique_ptr<QThreadPool> pool;
+    if (threads > 1 && !levels.isEmpty()) {
+        pool.reset(new QThreadPool);
+        pool->setMaxThreadCount(threads - 1);
+    }
+    for (const auto &level: levels)
+        evaluateLevel(level, threads, pool.get());
+    return m_circular.isEmpty();
+}
+
+FormulaValue FormulaEngine::evaluateFormula(const QString &formula, const Worksheet *sheet)
+{
+    prepare();
+
+    const FormulaNodePtr ast = FormulaParser::parse(formula);
+    if (!ast)
+        return FormulaValue::fromError(FormulaError::Name);
+    FormulaContext context;
+    context.sheet = sheet;
+    return toScalar(evaluate(*ast, context), context);
+}
+
+/*!
+ * \internal
+ * Reads the sheets and the defined names of the workbook, so the syntax trees
+ * evaluated with evaluate() resolve them. The graph is rebuilt on the next
+ * recalculation if they have changed.
+ */
+void FormulaEngine::prepare()
+{
+    if (updateStructure())
+        m_built = false;
+}
+
+/*!
+ * \internal
+ * Reads the sheets and the defined names of the workbook. Returns true if they
+ * have changed since the last call, so the graph must be rebuilt.
+ */
+bool FormulaEngine::updateStructure()
+{
+    const QList<Worksheet *> sheets = m_workbook->worksheets();
+    QStringList sheetNames;
+    for (Worksheet *sheet: sheets)
+        sheetNames << sheet->name();
+
+    QString signature;
+    const auto &definedNames = m_workbook->d_func()->definedNamesList;
+    for (const DefinedName &name: definedNames)
+        signature += name.name + QLatin1Char('\x1f') + QString::number(name.sheetId) + QLatin1Char('\x1f')
+                + name.formula + QLatin1Char('\x1e');
+    const bool date1904 = m_workbook->date1904().value_or(false);
+
+    if (sheets == m_sheets && sheetNames == m_sheetNames && signature == m_namesSignature
+        && date1904 == m_date1904 && !m_sheetsByName.isEmpty())
+        return false;
+
+    m_sheets = sheets;
+    m_sheetNames = sheetNames;
+    m_namesSignature = signature;
+    m_date1904 = date1904;
+    m_sheetsByName.clear();
+    for (Worksheet *sheet: sheets)
+        m_sheetsByName.insert(sheet->name().toUpper(), sheet);
+    m_names.clear();
+    for (const DefinedName &name: definedNames) {
+        NameEntry entry;
+        entry.sheetId = name.sheetId;
+        entry.ast = FormulaParser::parse(name.formula);
+        m_names.insert(name.name.toUpper(), entry);
+    }
+    return true;
+}
+
+/*!
+ * \internal
+ * Parses all formulas of the workbook and starts tracking the changes of the cells.
+ */
+void FormulaEngine::rebuild()
+{
+    m_formulas.clear();
+    m_formulaCells.clear();
+    m_cellDependents.clear();
+    m_rangeDependents.clear();
+
+    for (Worksheet *sheet: qAsConst(m_sheets)) {
+        auto d = sheet->d_func();
+        for (auto rowIt = d->cellTable.constBegin(); rowIt != d->cellTable.constEnd(); ++rowIt) {
+            for (auto it = rowIt.value().constBegin(); it != rowIt.value().constEnd(); ++it) {
+                const Cell *cell = it.value().get();
+                if (cell->hasFormula())
+                    addFormula({sheet, rowIt.key(), it.key()}, d->formulaTemplate(rowIt.key(), it.key(), cell));
+            }
+        }
+        d->changedCells.clear();
+        d->changesOverflow = false;
+        d->trackChanges = true;
+    }
+    m_built = true;
+}
+
+/*!
+ * \internal
+ * Updates the graph after the change of the cell \a key.
+ */
+void FormulaEngine::updateFormula(const FormulaCellKey &key)
+{
+    auto d = key.sheet->d_func();
+    const Cell *cell = key.sheet->cell(key.row, key.column);
+    const bool hasFormula = cell && cell->hasFormula();
+    //the templates are interned, so the same formula in the same cell gives the same template
+    const FormulaTemplatePtr formula = hasFormula ? d->formulaTemplate(key.row, key.column, cell) : nullptr;
+
+    auto it = m_formulas.constFind(key);
+    if (it != m_formulas.constEnd()) {
+        if (hasFormula && it.value().formula == formula)
+            return;
+        removeFormula(key);
+    }
+    if (hasFormula)
+        addFormula(key, formula);
+}
+
+void FormulaEngine::addFormula(const FormulaCellKey &key, const FormulaTemplatePtr &formula)
+{
+    FormulaEntry entry;
+    entry.formula = formula;
+    //data table formulas are calculated by Excel only
+    const Cell *cell = key.sheet->cell(key.row, key.column);
+    if (cell->formula().type().value_or(CellFormula::Type::Normal) != CellFormula::Type::DataTable)
+        entry.ast = formula->ast();
+    if (entry.ast) {
+        FormulaContext context;
+        context.sheet = key.sheet;
+        context.row = key.row;
+        context.column = key.column;
+        collectPrecedents(*entry.ast, context, entry, 0);
+    }
+
+    for (const auto &precedent: qAsConst(entry.precedents)) {
+        const CellRange &range = precedent.second;
+        if (range.rowCount() == 1 && range.columnCount() == 1)
+            m_cellDependents[{precedent.first, range.firstRow(), range.firstColumn()}].append(key);
+        else {
+            RangeDependents &dependents = m_rangeDependents[precedent.first];
+            if (!dependents.index.isValid())
+                dependents.index.build({});
+            int item = dependents.items.size();
+            if (dependents.freeItems.isEmpty())
+                dependents.items.append({range, key});
+            else {
+                item = dependents.freeItems.takeLast();
+                dependents.items[item] = {range, key};
+            }
+            dependents.index.insert(range, item);
+        }
+    }
+    m_formulas.insert(key, entry);
+    m_formulaCells[key.sheet][key.row].insert(key.column);
+}
+
+void FormulaEngine::removeFormula(const FormulaCellKey &key)
+{
+    auto it = m_formulas.find(key);
+    if (it == m_formulas.end())
+        return;
+
+    for (const auto &precedent: qAsConst(it.value().precedents)) {
+        const CellRange &range = precedent.second;
+        if (range.rowCount() == 1 && range.columnCount() == 1) {
+            const FormulaCellKey cell {precedent.first, range.firstRow(), range.firstColumn()};
+            auto dependentsIt = m_cellDependents.find(cell);
+            if (dependentsIt != m_cellDependents.end()) {
+                dependentsIt.value().removeAll(key);
+                if (dependentsIt.value().isEmpty())
+                    m_cellDependents.erase(dependentsIt);
+            }
+        }
+        else {
+            RangeDependents &dependents = m_rangeDependents[precedent.first];
+            for (const RangeIndex::Item &item: dependents.index.find(range)) {
+                if (item.range == range && dependents.items.at(item.value).formula == key) {
+                    dependents.index.remove(range, item.value);
+                    dependents.freeItems.append(item.value);
+                    break;
+                }
+            }
+        }
+    }
+    m_formulas.erase(it);
+    auto &rows = m_formulaCells[key.sheet];
+    auto rowIt = rows.find(key.row);
+    if (rowIt != rows.end()) {
+        rowIt.value().remove(key.column);
+        if (rowIt.value().isEmpty())
+            rows.erase(rowIt);
+    }
+}
+
+void FormulaEngine::collectPrecedents(const FormulaNode &node, const FormulaContext &context,
+                                      FormulaEntry &entry, int depth) const
+{
+    switch (node.kind) {
+        case FormulaNode::Kind::Reference:
+            if (const Worksheet *sheet = resolveSheet(node.reference.sheet, context)) {
+                const FormulaReference reference = node.reference.resolved(context.row, context.column);
+                if (reference.isValid())
+                    entry.precedents.append({sheet, reference.range()});
+            }
+            break;
+        case FormulaNode::Kind::Name:
+            if (depth < MaxNameDepth) {
+                const NameEntry *name = resolveName(node.text, context);
+                if (name && name->ast)
+                    collectPrecedents(*name->ast, context, entry, depth + 1);
+            }
+            break;
+        case FormulaNode::Kind::Function: {
+            const auto &functions = formulaFunctions();
+            auto it = functions.constFind(node.text);
+            if (it != functions.constEnd() && it.value().isVolatile)
+                entry.isVolatile = true;
+            break;
+        }
+        default: break;
+    }
+    for (const auto &child: node.children)
+        collectPrecedents(*child, context, entry, depth);
+}
+
+/*!
+ * \internal
+ * Returns the formulas that refer to \a cell.
+ */
+QVector<FormulaCellKey> FormulaEngine::dependents(const FormulaCellKey &cell) const
+{
+    QVector<FormulaCellKey> result = m_cellDependents.value(cell);
+    auto it = m_rangeDependents.constFind(cell.sheet);
+    if (it != m_rangeDependents.constEnd()) {
+        //the ranges that contain the cell, found in the spatial index
+        const CellRange area(cell.row, cell.column, cell.row, cell.column);
+        for (int item: it.value().index.values(area))
+            result.append(it.value().items.at(item).formula);
+    }
+    return result;
+}
+
+/*!
+ * \internal
+ * Calls \a visit(key) for each formula cell of \a range.
+ */
+template <typename Visit>
+void FormulaEngine::forEachFormulaIn(const Worksheet *sheet, const CellRange &range, Visit visit) const
+{
+    auto sheetIt = m_formulaCells.constFind(sheet);
+    if (sheetIt == m_formulaCells.constEnd())
+        return;
+    const auto &rows = sheetIt.value();
+    const auto end = rows.upperBound(range.lastRow());
+    for (auto it = rows.lowerBound(range.firstRow()); it != end; ++it) {
+        const QSet<int> &columns = it.value();
+        if (range.columnCount() < columns.size()) {
+            for (int column = range.firstColumn(); column <= range.lastColumn(); ++column) {
+                if (columns.contains(column))
+                    visit(FormulaCellKey {sheet, it.key(), column});
+            }
+        }
+        else {
+            for (int column: columns) {
+                if (column >= range.firstColumn() && column <= range.lastColumn())
+                    visit(FormulaCellKey {sheet, it.key(), column});
+            }
+        }
+    }
+}
+
+/*!
+ * \internal
+ * Splits the formulas of \a cone into levels (Kahn's algorithm): the formulas
+ * of a level refer only to the formulas of the previous levels and to the
+ * formulas outside of the cone, so they can be evaluated in any order. The
+ * formulas that are left out have circular references or depend on them; they
+ * are stored in m_circular.
+ */
+QVector<QVector<FormulaCellKey> > FormulaEngine::levelize(const QSet<FormulaCellKey> &cone)
+{
+    QHash<FormulaCellKey, int> inDegree;
+    QHash<FormulaCellKey, QVector<FormulaCellKey> > successors;
+    inDegree.reserve(cone.size());
+    for (const FormulaCellKey &key: cone)
+        inDegree.insert(key, 0);
+    //the edges are found from the precedents of each formula, which is cheaper
+    //than scanning the range dependents of each cell of the cone
+    for (const FormulaCellKey &key: cone) {
+        int &degree = inDegree[key];
+        const auto &precedents = m_formulas.constFind(key).value().precedents;
+        for (const auto &precedent: precedents) {
+            forEachFormulaIn(precedent.first, precedent.second, [&](const FormulaCellKey &formula) {
+                if (!cone.contains(formula)) return;
+                successors[formula].append(key);
+                ++degree;
+            });
+        }
+    }
+
+    QVector<QVector<FormulaCellKey> > levels;
+    QVector<FormulaCellKey> level;
+    for (auto it = inDegree.constBegin(); it != inDegree.constEnd(); ++it) {
+        if (it.value() == 0)
+            level.append(it.key());
+    }
+    int ordered = 0;
+    while (!level.isEmpty()) {
+        ordered += level.size();
+        QVector<FormulaCellKey> next;
+        for (const FormulaCellKey &key: qAsConst(level)) {
+            auto it = successors.constFind(key);
+            if (it == successors.constEnd()) continue;
+            for (const FormulaCellKey &successor: it.value()) {
+                if (--inDegree[successor] == 0)
+                    next.append(successor);
+            }
+        }
+        levels.append(level);
+        level = next;
+    }
+
+    m_circular.clear();
+    if (ordered < cone.size()) {
+        for (auto it = inDegree.constBegin(); it != inDegree.constEnd(); ++it) {
+            if (it.value() > 0)
+                m_circular.append(it.key());
+        }
+    }
+    return levels;
+}
+
+/*!
+ * \internal
+ * Evaluates the formulas of \a level and stores the results. The formulas are
+ * handed out to the calling thread and \a threads - 1 threads of \a pool in small
+ * chunks, so a thread that has finished its chunk takes the next one. The evaluation
+ * only reads the cells, and the results are buffered and stored by the calling
+ * thread after all threads have finished.
+ */
+void FormulaEngine::evaluateLevel(const QVector<FormulaCellKey> &level, int threads, QThreadPool *pool)
+{
+    const int count = level.size();
+    QVector<FormulaNodePtr> asts(count);
+    for (int i = 0; i < count; ++i)
+        asts[i] = m_formulas.constFind(level.at(i)).value().ast;
+    QVector<FormulaValue> results(count);
+
+    //several chunks per thread keep the threads busy if some formulas are slower
+    const int minChunk = 16;
+    const int chunk = qMax(minChunk, count / (threads * 8) + 1);
+    const int chunkCount = (count + chunk - 1) / chunk;
+    std::atomic<int> nextChunk {0};
+    auto work = [&]() {
+        for (int index = nextChunk++; index < chunkCount; index = nextChunk++) {
+            const int last = qMin(count, (index + 1) * chunk);
+            for (int i = index * chunk; i < last; ++i) {
+                if (!asts.at(i)) continue;
+                const FormulaCellKey &key = level.at(i);
+                FormulaContext context;
+                context.sheet = key.sheet;
+                context.row = key.row;
+                context.column = key.column;
+                results[i] = toScalar(evaluate(*asts.at(i), context), context);
+            }
+        }
+    };
+
+    threads = qMin(threads, chunkCount);
+    if (threads <= 1 || !pool)
+        work();
+    else {
+        for (int i = 1; i < threads; ++i)
+            pool->start(work);
+        work();
+        pool->waitForDone();
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (asts.at(i))
+            store(level.at(i), results.at(i));
+    }
+}
+
+void FormulaEngine::store(const FormulaCellKey &key, const FormulaValue &value)
+{
+    auto d = const_cast<Worksheet *>(key.sheet)->d_func();
+    switch (value.type) {
+        case FormulaValue::Type::Number:
+            d->setFormulaResult(key.row, key.column, Cell::Type::Number, value.number);
+            break;
+        case FormulaValue::Type::String:
+            d->setFormulaResult(key.row, key.column, Cell::Type::Formula, value.string);
+            break;
+        case FormulaValue::Type::Boolean:
+            d->setFormulaResult(key.row, key.column, Cell::Type::Boolean, value.boolean);
+            break;
+        case FormulaValue::Type::Error:
+            d->setFormulaResult(key.row, key.column, Cell::Type::Error, formulaErrorToString(value.error));
+            break;
+        default: //a reference to an empty cell gives 0
+            d->setFormulaResult(key.row, key.column, Cell::Type::Number, 0.0);
+    }
+}
+
+const Worksheet *FormulaEngine::resolveSheet(const QString &name, const FormulaContext &context) const
+{
+    if (name.isEmpty())
+        return context.sheet;
+    return m_sheetsByName.value(name.toUpper());
+}
+
+/*!
+ * \internal
+ * Returns the defined name visible from the sheet of \a context: the name local
+ * to the sheet, or the global name.
+ */
+const FormulaEngine::NameEntry *FormulaEngine::resolveName(const QString &name, const FormulaContext &context) const
+{
+    const NameEntry *global = nullptr;
+    const int sheetId = context.sheet ? context.sheet->id() : -1;
+    for (auto it = m_names.constFind(name.toUpper()); it != m_names.constEnd() && it.key() == name.toUpper(); ++it) {
+        if (it.value().sheetId == sheetId && sheetId != -1)
+            return &it.value();
+        if (it.value().sheetId == -1)
+            global = &it.value();
+    }
+    return global;
+}
+
+bool FormulaEngine::date1904() const
+{
+    return m_date1904;
+}
+
+FormulaValue FormulaEngine::cellValue(const Worksheet *sheet, int row, int column) const
+{
+    const Cell *cell = sheet->cell(row, column);
+    if (!cell)
+        return FormulaValue();
+    return valueOfCell(CellView(row, column, cell));
+}
+
+FormulaValue FormulaEngine::cellValue(const CellView &cell)
+{
+    return valueOfCell(cell);
+}
+
+/*!
+ * \internal
+ * Converts \a value to a single value. A range gives the value of its only cell
+ * or the cell in the row or column of the formula (implicit intersection).
+ */
+FormulaValue FormulaEngine::toScalar(const FormulaValue &value, const FormulaContext &context) const
+{
+    if (!value.isRange())
+        return value;
+    const CellRange &range = value.range;
+    if (range.rowCount() == 1 && range.columnCount() == 1)
+        return cellValue(value.sheet, range.firstRow(), range.firstColumn());
+    if (range.columnCount() == 1 && context.row >= range.firstRow() && context.row <= range.lastRow())
+        return cellValue(value.sheet, context.row, range.firstColumn());
+    if (range.rowCount() == 1 && context.column >= range.firstColumn() && context.column <= range.lastColumn())
+        return cellValue(value.sheet, range.firstRow(), context.column);
+    return FormulaValue::fromError(FormulaError::Value);
+}
+
+/*!
+ * \internal
+ * Calls \a visit(row, column, value) for each non-empty cell of the \a range value
+ * until \a visit returns false. A value that is not a range is visited as is.
+ */
+void FormulaEngine::forEachCell(const FormulaValue &range,
+                                const std::function<bool (int, int, const FormulaValue &)> &visit) const
+{
+    if (!range.isRange()) {
+        visit(0, 0, range);
+        return;
+    }
+    for (const RowView &row: range.sheet->rows(range.range)) {
+        for (const CellView &cell: row.cells()) {
+            if (!visit(cell.row(), cell.column(), valueOfCell(cell)))
+                return;
+        }
+    }
+}
+
+FormulaValue FormulaEngine::evaluate(const FormulaNode &node, const FormulaContext &context) const
+{
+    switch (node.kind) {
+        case FormulaNode::Kind::Number:
+            return FormulaValue::fromNumber(node.number);
+        case FormulaNode::Kind::String:
+            return FormulaValue::fromString(node.text);
+        case FormulaNode::Kind::Boolean:
+            return FormulaValue::fromBoolean(node.boolean);
+        case FormulaNode::Kind::Error:
+            return FormulaValue::fromError(node.error);
+        case FormulaNode::Kind::Reference: {
+            const Worksheet *sheet = resolveSheet(node.reference.sheet, context);
+            const FormulaReference reference = node.reference.resolved(context.row, context.column);
+            if (!sheet || !reference.isValid())
+                return FormulaValue::fromError(FormulaError::Ref);
+            return FormulaValue::fromRange(sheet, reference.range());
+        }
+        case FormulaNode::Kind::Name: {
+            const NameEntry *name = context.depth < MaxNameDepth ? resolveName(node.text, context) : nullptr;
+            if (!name)
+                return FormulaValue::fromError(FormulaError::Name);
+            if (!name->ast)
+                return FormulaValue::fromError(FormulaError::Ref);
+            FormulaContext nameContext = context;
+            ++nameContext.depth;
+            return evaluate(*name->ast, nameContext);
+        }
+        case FormulaNode::Kind::Unary: {
+            const FormulaValue value = toScalar(evaluate(*node.children.at(0), context), context);
+            if (node.op == FormulaNode::Operator::Plus)
+                return value;
+            double number;
+            const FormulaError error = toNumber(value, number);
+            if (error != FormulaError::None)
+                return FormulaValue::fromError(error);
+            return FormulaValue::fromNumber(-number);
+        }
+        case FormulaNode::Kind::Percent: {
+            double number;
+            const FormulaError error = toNumber(toScalar(evaluate(*node.children.at(0), context), context), number);
+            if (error != FormulaError::None)
+                return FormulaValue::fromError(error);
+            return FormulaValue::fromNumber(number / 100.0);
+        }
+        case FormulaNode::Kind::Binary:
+            return evaluateBinary(node, context);
+        case FormulaNode::Kind::Function:
+            return evaluateFunction(node, context);
+        case FormulaNode::Kind::Missing:
+            break;
+    }
+    return FormulaValue();
+}
+
+FormulaValue FormulaEngine::evaluateBinary(const FormulaNode &node, const FormulaContext &context) const
+{
+    using Operator = FormulaNode::Operator;
+
+    const FormulaValue left = toScalar(evaluate(*node.children.at(0), context), context);
+    const FormulaValue right = toScalar(evaluate(*node.children.at(1), context), context);
+    if (left.isError()) return left;
+    if (right.isError()) return right;
+
+    switch (node.op) {
+        case Operator::Concat:
+            return FormulaValue::fromString(toText(left) + toText(right));
+        case Operator::Equal: return FormulaValue::fromBoolean(compare(left, right) == 0);
+        case Operator::NotEqual: return FormulaValue::fromBoolean(compare(left, right) != 0);
+        case Operator::Less: return FormulaValue::fromBoolean(compare(left, right) < 0);
+        case Operator::Greater: return FormulaValue::fromBoolean(compare(left, right) > 0);
+        case Operator::LessOrEqual: return FormulaValue::fromBoolean(compare(left, right) <= 0);
+        case Operator::GreaterOrEqual: return FormulaValue::fromBoolean(compare(left, right) >= 0);
+        default: break;
+    }
+
+    double a, b;
+    FormulaError error = toNumber(left, a);
+    if (error == FormulaError::None)
+        error = toNumber(right, b);
+    if (error != FormulaError::None)
+        return FormulaValue::fromError(error);
+
+    switch (node.op) {
+        case Operator::Add: return FormulaValue::fromNumber(a + b);
+        case Operator::Subtract: return FormulaValue::fromNumber(a - b);
+        case Operator::Multiply: return FormulaValue::fromNumber(a * b);
+        case Operator::Divide:
+            if (b == 0.0)
+                return FormulaValue::fromError(FormulaError::Div0);
+            return FormulaValue::fromNumber(a / b);
+        case Operator::Power:
+            if (a == 0.0 && b == 0.0)
+                return FormulaValue::fromError(FormulaError::Num);
+            if (a == 0.0 && b < 0.0)
+                return FormulaValue::fromError(FormulaError::Div0);
+            return FormulaValue::fromNumber(std::pow(a, b));
+        default: break;
+    }
+    return FormulaValue::fromError(FormulaError::Value);
+}
+
+/*!
+ * \internal
+ * Calls the function of \a node. IF, IFERROR, IFNA and CHOOSE evaluate only
+ * the arguments they return, the other functions get all arguments evaluated.
+ * References are passed to the functions as ranges.
+ */
+FormulaValue FormulaEngine::evaluateFunction(const FormulaNode &node, const FormulaContext &context) const
+{
+    const auto &functions = formulaFunctions();
+    auto it = functions.constFind(node.text);
+    if (it == functions.constEnd())
+        return FormulaValue::fromError(FormulaError::Name);
+    const FormulaFunctionInfo &info = it.value();
+    const int count = node.children.size();
+    if (count < info.minArguments || count > info.maxArguments)
+        return FormulaValue::fromError(FormulaError::Value);
+
+    if (!info.function) {
+        const FormulaValue first = toScalar(evaluate(*node.children.at(0), context), context);
+        if (node.text == QLatin1String("IF")) {
+            if (first.isError()) return first;
+            bool condition;
+            const FormulaError error = toBoolean(first, condition);
+            if (error != FormulaError::None)
+                return FormulaValue::fromError(error);
+            const int index = condition ? 1 : 2;
+            if (index >= count)
+                return FormulaValue::fromBoolean(false);
+            return evaluate(*node.children.at(index), context);
+        }
+        if (node.text == QLatin1String("IFERROR")) {
+            if (first.isError())
+                return evaluate(*node.children.at(1), context);
+            return first;
+        }
+        if (node.text == QLatin1String("IFNA")) {
+            if (first.isError() && first.error == FormulaError::NA)
+                return evaluate(*node.children.at(1), context);
+            return first;
+        }
+        if (node.text == QLatin1String("CHOOSE")) {
+            double number;
+            const FormulaError error = toNumber(first, number);
+            if (error != FormulaError::None)
+                return FormulaValue::fromError(error);
+            const int index = int(std::trunc(number));
+            if (index < 1 || index >= count)
+                return FormulaValue::fromError(FormulaError::Value);
+            return evaluate(*node.children.at(index), context);
+        }
+        return FormulaValue::fromError(FormulaError::Name);
+    }
+
+    FormulaArguments args {this, context, {}};
+    args.values.reserve(count);
+    for (const auto &child: node.children)
+        args.values.append(evaluate(*child, context));
+    return info.function(args);
+}
+
+/*!
+ * \internal
+ * Converts a single value to a number: blanks give 0, booleans give 1 or 0,
+ * strings are parsed. Returns the error if the value cannot be converted.
+ */
+FormulaError FormulaEngine::toNumber(const FormulaValue &scalar, double &number)
+{
+    switch (scalar.type) {
+        case FormulaValue::Type::Blank: number = 0.0; return FormulaError::None;
+        case FormulaValue::Type::Number: number = scalar.number; return FormulaError::None;
+        case FormulaValue::Type::Boolean: number = scalar.boolean ? 1.0 : 0.0; return FormulaError::None;
+        case FormulaValue::Type::Error: return scalar.error;
+        case FormulaValue::Type::String: {
+            QString text = scalar.string.trimmed();
+            bool percent = false;
+            if (text.endsWith(QLatin1Char('%'))) {
+                percent = true;
+                text.chop(1);
+            }
+            bool ok = false;
+            number = QLocale::c().toDouble(text, &ok);
+            if (!ok) return FormulaError::Value;
+            if (percent) number /= 100.0;
+            return FormulaError::None;
+        }
+        default: break;
+    }
+    return FormulaError::Value;
+}
+
+FormulaError FormulaEngine::toBoolean(const FormulaValue &scalar, bool &boolean)
+{
+    switch (scalar.type) {
+        case FormulaValue::Type::Blank: boolean = false; return FormulaError::None;
+        case FormulaValue::Type::Number: boolean = scalar.number != 0.0; return FormulaError::None;
+        case FormulaValue::Type::Boolean: boolean = scalar.boolean; return FormulaError::None;
+        case FormulaValue::Type::Error: return scalar.error;
+        case FormulaValue::Type::String:
+            if (scalar.string.compare(QLatin1String("TRUE"), Qt::CaseInsensitive) == 0) {
+                boolean = true;
+                return FormulaError::None;
+            }
+            if (scalar.string.compare(QLatin1String("FALSE"), Qt::CaseInsensitive) == 0) {
+                boolean = false;
+                return FormulaError::None;
+            }
+            break;
+        default: break;
+    }
+    return FormulaError::Value;
+}
+
+QString FormulaEngine::toText(const FormulaValue &scalar)
+{
+    switch (scalar.type) {
+        case FormulaValue::Type::Number:
+            return QString::number(scalar.number, 'g', 15).toUpper();
+        case FormulaValue::Type::String:
+            return scalar.string;
+        case FormulaValue::Type::Boolean:
+            return scalar.boolean ? QStringLiteral("TRUE") : QStringLiteral("FALSE");
+        case FormulaValue::Type::Error:
+            return formulaErrorToString(scalar.error);
+        default: break;
+    }
+    return QString();
+}
+
+/*!
+ * \internal
+ * Compares two single values as Excel does: numbers are less than strings, and
+ * strings are less than booleans. Strings are compared case-insensitively, a blank
+ * value is equal to 0, an empty string and FALSE.
+ */
+int FormulaEngine::compare(const FormulaValue &left, const FormulaValue &right)
+{
+    auto rank = [](FormulaValue::Type type) {
+        switch (type) {
+            case FormulaValue::Type::Number: return 0;
+            case FormulaValue::Type::String: return 1;
+            case FormulaValue::Type::Boolean: return 2;
+            default: break;
+        }
+        return 3;
+    };
+    auto blankAs = [](FormulaValue::Type type) {
+        switch (type) {
+            case FormulaValue::Type::Number: return FormulaValue::fromNumber(0.0);
+            case FormulaValue::Type::Boolean: return FormulaValue::fromBoolean(false);
+            default: break;
+        }
+        return FormulaValue::fromString(QString());
+    };
+
+    if (left.type == FormulaValue::Type::Blank && right.type == FormulaValue::Type::Blank)
+        return 0;
+    const FormulaValue a = left.type == FormulaValue::Type::Blank ? blankAs(right.type) : left;
+    const FormulaValue b = right.type == FormulaValue::Type::Blank ? blankAs(left.type) : right;
+    if (rank(a.type) != rank(b.type))
+        return rank(a.type) < rank(b.type) ? -1 : 1;
+
+    switch (a.type) {
+        case FormulaValue::Type::Number:
+            return a.number < b.number ? -1 : (a.number > b.number ? 1 : 0);
+        case FormulaValue::Type::String: {
+            const int result = a.string.compare(b.string, Qt::CaseInsensitive);
+            return result < 0 ? -1 : (result > 0 ? 1 : 0);
+        }
+        case FormulaValue::Type::Boolean:
+            return int(a.boolean) - int(b.boolean);
+        default: break;
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,1338 @@
+// xlsxformulafunctions.cpp
+
+#include <QtGlobal>
+#include <QDate>
+#include <QDateTime>
+#include <QRegularExpression>
+
+#include <algorithm>
+#include <cmath>
+
+#include "xlsxformulaengine_p.h"
+#include "xlsxworksheet.h"
+
+namespace QXlsx {
+
+namespace {
+
+using Type = FormulaValue::Type;
+
+FormulaValue errorValue(FormulaError error)
+{
+    return FormulaValue::fromError(error);
+}
+
+/*
+ * Calls visit(number) for each number of the arguments starting from first,
+ * as SUM does: the numbers of the ranges (text and booleans in the ranges are
+ * ignored), and the numbers, booleans and numeric strings given directly.
+ * Returns the first error met.
+ */
+template <typename Visit>
+FormulaError forEachNumber(const FormulaArguments &args, int first, Visit visit)
+{
+    for (int i = first; i < args.count(); ++i) {
+        const FormulaValue &value = args.values.at(i);
+        if (value.isRange()) {
+            FormulaError error = FormulaError::None;
+            args.engine->forEachCell(value, [&](int, int, const FormulaValue &cell) {
+                if (cell.isError()) {
+                    error = cell.error;
+                    return false;
+                }
+                if (cell.type == Type::Number)
+                    visit(cell.number);
+                return true;
+            });
+            if (error != FormulaError::None)
+                return error;
+        }
+        else if (value.type != Type::Blank) {
+            double number;
+            const FormulaError error = FormulaEngine::toNumber(value, number);
+            if (error != FormulaError::None)
+                return error;
+            visit(number);
+        }
+    }
+    return FormulaError::None;
+}
+
+FormulaError collectNumbers(const FormulaArguments &args, int first, QVector<double> &numbers)
+{
+    return forEachNumber(args, first, [&numbers](double number) { numbers.append(number); });
+}
+
+CellRange rangeOf(const FormulaValue &value)
+{
+    return value.isRange() ? value.range : CellRange(1, 1, 1, 1);
+}
+
+//Rounds the value normalized to 15 significant digits, so that 2.675 is rounded to 2.68
+double roundHalfAway(double value, int digits)
+{
+    const double factor = std::pow(10.0, digits);
+    const double scaled = QString::number(value * factor, 'g', 15).toDouble();
+    return std::round(scaled) / factor;
+}
+
+//Converts the Excel wildcards (*, ? and ~ escapes) to a regular expression
+QString wildcardToRegExp(const QString &pattern)
+{
+    QString regexp;
+    for (int i = 0; i < pattern.size(); ++i) {
+        const QChar ch = pattern.at(i);
+        if (ch == QLatin1Char('~') && i + 1 < pattern.size()) {
+            regexp += QRegularExpression::escape(pattern.at(++i));
+            continue;
+        }
+        if (ch == QLatin1Char('*')) regexp += QLatin1String(".*");
+        else if (ch == QLatin1Char('?')) regexp += QLatin1Char('.');
+        else regexp += QRegularExpression::escape(ch);
+    }
+    return regexp;
+}
+
+QRegularExpression wildcardPattern(const QString &pattern)
+{
+    return QRegularExpression(QLatin1String("\\A(?:") + wildcardToRegExp(pattern) + QLatin1String(")\\z"),
+                              QRegularExpression::CaseInsensitiveOption
+                              | QRegularExpression::DotMatchesEverythingOption);
+}
+
+bool hasWildcards(const QString &text)
+{
+    return text.contains(QLatin1Char('*')) || text.contains(QLatin1Char('?')) || text.contains(QLatin1Char('~'));
+}
+
+/*
+ * A criterion of COUNTIF, SUMIF and the other conditional functions,
+ * f.e. 10, ">=10", "<>apple", "a*".
+ */
+struct Criterion
+{
+    FormulaNode::Operator op = FormulaNode::Operator::Equal;
+    FormulaValue value; //a blank value for "=" and "<>"
+    bool wildcard = false;
+    QRegularExpression pattern;
+
+    explicit Criterion(const FormulaValue &criterion = FormulaValue())
+    {
+        if (criterion.type != Type::String) {
+            value = criterion.type == Type::Blank ? FormulaValue::fromNumber(0.0) : criterion;
+            return;
+        }
+        static const struct {const char *text; FormulaNode::Operator op;} operators[] = {
+            {"<=", FormulaNode::Operator::LessOrEqual},
+            {">=", FormulaNode::Operator::GreaterOrEqual},
+            {"<>", FormulaNode::Operator::NotEqual},
+            {"<", FormulaNode::Operator::Less},
+            {">", FormulaNode::Operator::Greater},
+            {"=", FormulaNode::Operator::Equal},
+        };
+        QString text = criterion.string;
+        for (const auto &o: operators) {
+            if (text.startsWith(QLatin1String(o.text))) {
+                op = o.op;
+                text.remove(0, int(qstrlen(o.text)));
+                break;
+            }
+        }
+        if (text.isEmpty())
+            return;
+
+        double number;
+        if (FormulaEngine::toNumber(FormulaValue::fromString(text), number) == FormulaError::None)
+            value = FormulaValue::fromNumber(number);
+        else if (text.compare(QLatin1String("TRUE"), Qt::CaseInsensitive) == 0)
+            value = FormulaValue::fromBoolean(true);
+        else if (text.compare(QLatin1String("FALSE"), Qt::CaseInsensitive) == 0)
+            value = FormulaValue::fromBoolean(false);
+        else if (text.startsWith(QLatin1Char('#')) && formulaErrorFromString(text) != FormulaError::None)
+            value = FormulaValue::fromError(formulaErrorFromString(text));
+        else {
+            value = FormulaValue::fromString(text);
+            if ((op == FormulaNode::Operator::Equal || op == FormulaNode::Operator::NotEqual) && hasWildcards(text)) {
+                wildcard = true;
+                pattern = wildcardPattern(text);
+            }
+        }
+    }
+
+    bool matches(const FormulaValue &cell) const
+    {
+        using Operator = FormulaNode::Operator;
+        if (value.type == Type::Blank) {
+            const bool empty = cell.type == Type::Blank || (cell.type == Type::String && cell.string.isEmpty());
+            if (op == Operator::Equal) return empty;
+            if (op == Operator::NotEqual) return !empty;
+            return false;
+        }
+        if (cell.type != value.type)
+            return op == Operator::NotEqual;
+
+        int result = 0;
+        if (wildcard)
+            result = pattern.match(cell.string).hasMatch() ? 0 : 1;
+        else if (value.type == Type::Error)
+            result = cell.error == value.error ? 0 : 1;
+        else
+            result = FormulaEngine::compare(cell, value);
+        switch (op) {
+            case Operator::Equal: return result == 0;
+            case Operator::NotEqual: return result != 0;
+            case Operator::Less: return result < 0;
+            case Operator::Greater: return result > 0;
+            case Operator::LessOrEqual: return result <= 0;
+            case Operator::GreaterOrEqual: return result >= 0;
+            default: break;
+        }
+        return false;
+    }
+};
+
+/*
+ * Calls visit(rowOffset, columnOffset) for each position where the values of all
+ * condition ranges match their criteria. The positions are relative to the top left
+ * cells of the ranges. If the criteria do not match blank cells, only the non-empty
+ * cells of the first range are visited. Otherwise the area of the ranges that holds
+ * data is visited, and the matching positions outside of it are only counted in
+ * blankMatches.
+ */
+template <typename Visit>
+void forEachMatch(const FormulaArguments &args, const QVector<QPair<FormulaValue, Criterion> > &conditions,
+                  const QVector<FormulaValue> &otherRanges, qint64 *blankMatches, Visit visit)
+{
+    const FormulaEngine *engine = args.engine;
+    const CellRange shape = rangeOf(conditions.first().first);
+    auto valueAt = [engine](const FormulaValue &range, int rowOffset, int columnOffset) {
+        if (!range.isRange())
+            return rowOffset == 0 && columnOffset == 0 ? range : FormulaValue();
+        return engine->cellValue(range.sheet, range.range.firstRow() + rowOffset,
+                                 range.range.firstColumn() + columnOffset);
+    };
+    auto matchesAt = [&](int rowOffset, int columnOffset, int skip) {
+        for (int i = 0; i < conditions.size(); ++i) {
+            if (i == skip) continue;
+            if (!conditions.at(i).second.matches(valueAt(conditions.at(i).first, rowOffset, columnOffset)))
+                return false;
+        }
+        return true;
+    };
+
+    bool blankMatch = true;
+    for (const auto &condition: conditions)
+        blankMatch = blankMatch && condition.second.matches(FormulaValue());
+    if (blankMatches)
+        *blankMatches = 0;
+
+    if (!blankMatch) {
+        const FormulaValue &first = conditions.first().first;
+        engine->forEachCell(first, [&](int row, int column, const FormulaValue &value) {
+            const int rowOffset = first.isRange() ? row - shape.firstRow() : 0;
+            const int columnOffset = first.isRange() ? column - shape.firstColumn() : 0;
+            if (conditions.first().second.matches(value) && matchesAt(rowOffset, columnOffset, 0))
+                visit(rowOffset, columnOffset);
+            return true;
+        });
+        return;
+    }
+
+    //the offsets of the area that holds data in any of the ranges
+    int top = shape.rowCount(), left = shape.columnCount(), bottom = -1, right = -1;
+    auto addArea = [&](const FormulaValue &range) {
+        if (!range.isRange()) {
+            top = left = 0;
+            bottom = std::max(bottom, 0);
+            right = std::max(right, 0);
+            return;
+        }
+        const CellRange dimension = range.sheet->dimension();
+        if (!dimension.isValid()) return;
+        const CellRange &r = range.range;
+        top = std::min(top, std::max(dimension.firstRow(), r.firstRow()) - r.firstRow());
+        left = std::min(left, std::max(dimension.firstColumn(), r.firstColumn()) - r.firstColumn());
+        bottom = std::max(bottom, std::min(dimension.lastRow(), r.lastRow()) - r.firstRow());
+        right = std::max(right, std::min(dimension.lastColumn(), r.lastColumn()) - r.firstColumn());
+    };
+    for (const auto &condition: conditions)
+        addArea(condition.first);
+    for (const FormulaValue &range: otherRanges)
+        addArea(range);
+    bottom = std::min(bottom, shape.rowCount() - 1);
+    right = std::min(right, shape.columnCount() - 1);
+
+    qint64 area = 0;
+    for (int row = top; row <= bottom; ++row) {
+        for (int column = left; column <= right; ++column) {
+            ++area;
+            if (matchesAt(row, column, -1))
+                visit(row, column);
+        }
+    }
+    if (blankMatches)
+        *blankMatches = qint64(shape.rowCount()) * shape.columnCount() - area;
+}
+
+FormulaError readConditions(const FormulaArguments &args, int first,
+                            QVector<QPair<FormulaValue, Criterion> > &conditions)
+{
+    const CellRange shape = rangeOf(args.values.at(first));
+    for (int i = first; i + 1 < args.count(); i += 2) {
+        const FormulaValue &range = args.values.at(i);
+        if (range.isError())
+            return range.error;
+        const CellRange r = rangeOf(range);
+        if (r.rowCount() != shape.rowCount() || r.columnCount() != shape.columnCount())
+            return FormulaError::Value;
+        conditions.append({range, Criterion(args.scalar(i + 1))});
+    }
+    return FormulaError::None;
+}
+
+FormulaValue conditionalAggregate(const FormulaArguments &args, int sumIndex, int conditionsIndex, bool average)
+{
+    if ((args.count() - conditionsIndex) % 2 != 0)
+        return errorValue(FormulaError::Value);
+    QVector<QPair<FormulaValue, Criterion> > conditions;
+    FormulaError error = readConditions(args, conditionsIndex, conditions);
+    if (error != FormulaError::None)
+        return errorValue(error);
+
+    FormulaValue sumRange = sumIndex >= 0 && !args.isMissing(sumIndex) ? args.values.at(sumIndex)
+                                                                         : conditions.first().first;
+    if (sumRange.isError())
+        return sumRange;
+    const FormulaEngine *engine = args.engine;
+    double sum = 0.0;
+    qint64 count = 0;
+    forEachMatch(args, conditions, {sumRange}, nullptr, [&](int row, int column) {
+        FormulaValue value = sumRange;
+        if (sumRange.isRange())
+            value = engine->cellValue(sumRange.sheet, sumRange.range.firstRow() + row,
+                                      sumRange.range.firstColumn() + column);
+        if (value.isError()) {
+            if (error == FormulaError::None) error = value.error;
+            return;
+        }
+        if (value.type == Type::Number) {
+            sum += value.number;
+            ++count;
+        }
+    });
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (average) {
+        if (count == 0)
+            return errorValue(FormulaError::Div0);
+        return FormulaValue::fromNumber(sum / count);
+    }
+    return FormulaValue::fromNumber(sum);
+}
+
+FormulaValue conditionalCount(const FormulaArguments &args)
+{
+    if (args.count() % 2 != 0)
+        return errorValue(FormulaError::Value);
+    QVector<QPair<FormulaValue, Criterion> > conditions;
+    const FormulaError error = readConditions(args, 0, conditions);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    qint64 count = 0, blankCount = 0;
+    forEachMatch(args, conditions, {}, &blankCount, [&count](int, int) { ++count; });
+    return FormulaValue::fromNumber(double(count + blankCount));
+}
+
+FormulaValue variance(const FormulaArguments &args, bool sample, bool squareRoot)
+{
+    QVector<double> numbers;
+    const FormulaError error = collectNumbers(args, 0, numbers);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    const int n = numbers.size();
+    if (n < (sample ? 2 : 1))
+        return errorValue(FormulaError::Div0);
+    double mean = 0.0;
+    for (double number: qAsConst(numbers))
+        mean += number;
+    mean /= n;
+    double sum = 0.0;
+    for (double number: qAsConst(numbers))
+        sum += (number - mean) * (number - mean);
+    const double result = sum / (sample ? n - 1 : n);
+    return FormulaValue::fromNumber(squareRoot ? std::sqrt(result) : result);
+}
+
+FormulaValue kth(const FormulaArguments &args, bool largest)
+{
+    QVector<double> numbers;
+    const FormulaArguments values {args.engine, args.context, {args.values.at(0)}};
+    FormulaError error = collectNumbers(values, 0, numbers);
+    double k = 0;
+    if (error == FormulaError::None)
+        error = args.number(1, k);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    const int index = int(std::ceil(k));
+    if (index < 1 || index > numbers.size())
+        return errorValue(FormulaError::Num);
+    if (largest)
+        std::nth_element(numbers.begin(), numbers.begin() + index - 1, numbers.end(), std::greater<double>());
+    else
+        std::nth_element(numbers.begin(), numbers.begin() + index - 1, numbers.end());
+    return FormulaValue::fromNumber(numbers.at(index - 1));
+}
+
+//Unary math functions
+template <double (*Function)(double)>
+FormulaValue unaryMath(const FormulaArguments &args)
+{
+    double x;
+    const FormulaError error = args.number(0, x);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    return FormulaValue::fromNumber(Function(x));
+}
+
+double sign(double x) { return x > 0 ? 1.0 : (x < 0 ? -1.0 : 0.0); }
+double floorValue(double x) { return std::floor(x); }
+double absValue(double x) { return std::fabs(x); }
+double expValue(double x) { return std::exp(x); }
+
+FormulaValue roundFunction(const FormulaArguments &args, int mode) //0 - round, 1 - up, -1 - down
+{
+    double x, digits = 0;
+    FormulaError error = args.number(0, x);
+    if (error == FormulaError::None && !args.isMissing(1))
+        error = args.number(1, digits);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    const int d = int(std::trunc(digits));
+    if (mode == 0)
+        return FormulaValue::fromNumber(roundHalfAway(x, d));
+    const double factor = std::pow(10.0, d);
+    const double scaled = QString::number(x * factor, 'g', 15).toDouble();
+    const double rounded = mode > 0 ? (scaled < 0 ? std::floor(scaled) : std::ceil(scaled)) : std::trunc(scaled);
+    return FormulaValue::fromNumber(rounded / factor);
+}
+
+FormulaValue multiple(const FormulaArguments &args, bool ceiling)
+{
+    double x, significance = 1.0;
+    FormulaError error = args.number(0, x);
+    if (error == FormulaError::None && !args.isMissing(1))
+        error = args.number(1, significance);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (significance == 0.0)
+        return ceiling ? FormulaValue::fromNumber(0.0) : errorValue(FormulaError::Div0);
+    if (x > 0 && significance < 0)
+        return errorValue(FormulaError::Num);
+    const double q = QString::number(x / significance, 'g', 15).toDouble();
+    return FormulaValue::fromNumber((ceiling ? std::ceil(q) : std::floor(q)) * significance);
+}
+
+//Dates are calculated from the day numbers to avoid the time zone shifts
+QDate epoch(bool date1904)
+{
+    return date1904 ? QDate(1904, 1, 1) : QDate(1899, 12, 31);
+}
+
+double serialFromDate(const QDate &date, bool date1904)
+{
+    const qint64 days = epoch(date1904).daysTo(date);
+    //Excel treats 1900 as a leap year
+    return double(!date1904 && days > 59 ? days + 1 : days);
+}
+
+FormulaError dateFromSerial(const FormulaArguments &args, QDate &date)
+{
+    double serial;
+    const FormulaError error = args.number(0, serial);
+    if (error != FormulaError::None)
+        return error;
+    if (serial < 0)
+        return FormulaError::Num;
+    qint64 days = qint64(std::floor(serial));
+    const bool date1904 = args.engine->date1904();
+    if (!date1904 && days > 60)
+        --days;
+    date = epoch(date1904).addDays(days);
+    return FormulaError::None;
+}
+
+/*
+ * Finds key in a row or a column of cells. Mode 0 finds an equal value (with
+ * wildcards for strings), mode 1 the largest value less than or equal to key and
+ * mode -1 the smallest value greater than or equal to key; the values are
+ * expected to be sorted accordingly. Returns the offset of the found cell or -1.
+ */
+int lookup(const FormulaEngine *engine, const FormulaValue &key, const Worksheet *sheet,
+           const CellRange &vector, int mode)
+{
+    const bool byRow = vector.rowCount() == 1;
+    auto rank = [](Type type) { return type == Type::Blank ? Type::Number : type; };
+    const bool wildcard = mode == 0 && key.type == Type::String && hasWildcards(key.string);
+    const QRegularExpression pattern = wildcard ? wildcardPattern(key.string) : QRegularExpression();
+
+    int found = -1;
+    engine->forEachCell(FormulaValue::fromRange(sheet, vector), [&](int row, int column, const FormulaValue &value) {
+        const int offset = byRow ? column - vector.firstColumn() : row - vector.firstRow();
+        if (rank(value.type) != rank(key.type))
+            return true;
+        if (mode == 0) {
+            const bool equal = wildcard ? pattern.match(value.string).hasMatch()
+                                        : FormulaEngine::compare(value, key) == 0;
+            if (equal) found = offset;
+            return !equal;
+        }
+        const int result = FormulaEngine::compare(value, key);
+        if ((mode > 0 && result <= 0) || (mode < 0 && result >= 0)) {
+            found = offset;
+            return result != 0;
+        }
+        return false;
+    });
+    return found;
+}
+
+FormulaValue tableLookup(const FormulaArguments &args, bool vertical)
+{
+    const FormulaValue key = args.scalar(0);
+    if (key.isError())
+        return key;
+    const FormulaValue &table = args.values.at(1);
+    if (!table.isRange())
+        return errorValue(table.isError() ? table.error : FormulaError::Value);
+    double index;
+    bool approximate = true;
+    FormulaError error = args.number(2, index);
+    if (error == FormulaError::None && !args.isMissing(3))
+        error = args.boolean(3, approximate);
+    if (error != FormulaError::None)
+        return errorValue(error);
+
+    const CellRange &range = table.range;
+    const int i = int(std::trunc(index));
+    if (i < 1)
+        return errorValue(FormulaError::Value);
+    if (i > (vertical ? range.columnCount() : range.rowCount()))
+        return errorValue(FormulaError::Ref);
+    const CellRange vector = vertical ? CellRange(range.firstRow(), range.firstColumn(), range.lastRow(), range.firstColumn())
+                                      : CellRange(range.firstRow(), range.firstColumn(), range.firstRow(), range.lastColumn());
+    const int offset = lookup(args.engine, key, table.sheet, vector, approximate ? 1 : 0);
+    if (offset < 0)
+        return errorValue(FormulaError::NA);
+    if (vertical)
+        return args.engine->cellValue(table.sheet, range.firstRow() + offset, range.firstColumn() + i - 1);
+    return args.engine->cellValue(table.sheet, range.firstRow() + i - 1, range.firstColumn() + offset);
+}
+
+// Math and statistics
+
+FormulaValue fnSum(const FormulaArguments &args)
+{
+    double sum = 0.0;
+    const FormulaError error = forEachNumber(args, 0, [&sum](double number) { sum += number; });
+    return error != FormulaError::None ? errorValue(error) : FormulaValue::fromNumber(sum);
+}
+
+FormulaValue fnProduct(const FormulaArguments &args)
+{
+    double product = 1.0;
+    bool any = false;
+    const FormulaError error = forEachNumber(args, 0, [&](double number) { product *= number; any = true; });
+    if (error != FormulaError::None)
+        return errorValue(error);
+    return FormulaValue::fromNumber(any ? product : 0.0);
+}
+
+FormulaValue fnAverage(const FormulaArguments &args)
+{
+    double sum = 0.0;
+    qint64 count = 0;
+    const FormulaError error = forEachNumber(args, 0, [&](double number) { sum += number; ++count; });
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (count == 0)
+        return errorValue(FormulaError::Div0);
+    return FormulaValue::fromNumber(sum / count);
+}
+
+FormulaValue fnMin(const FormulaArguments &args)
+{
+    double result = qInf();
+    const FormulaError error = forEachNumber(args, 0, [&result](double number) { result = std::min(result, number); });
+    if (error != FormulaError::None)
+        return errorValue(error);
+    return FormulaValue::fromNumber(std::isinf(result) ? 0.0 : result);
+}
+
+FormulaValue fnMax(const FormulaArguments &args)
+{
+    double result = -qInf();
+    const FormulaError error = forEachNumber(args, 0, [&result](double number) { result = std::max(result, number); });
+    if (error != FormulaError::None)
+        return errorValue(error);
+    return FormulaValue::fromNumber(std::isinf(result) ? 0.0 : result);
+}
+
+FormulaValue fnCount(const FormulaArguments &args)
+{
+    qint64 count = 0;
+    for (const FormulaValue &value: args.values) {
+        if (value.isRange()) {
+            args.engine->forEachCell(value, [&count](int, int, const FormulaValue &cell) {
+                if (cell.type == Type::Number) ++count;
+                return true;
+            });
+        }
+        else {
+            double number;
+            if (value.type != Type::Blank && value.type != Type::Error
+                && FormulaEngine::toNumber(value, number) == FormulaError::None)
+                ++count;
+        }
+    }
+    return FormulaValue::fromNumber(double(count));
+}
+
+FormulaValue fnCountA(const FormulaArguments &args)
+{
+    qint64 count = 0;
+    for (const FormulaValue &value: args.values) {
+        if (value.isRange()) {
+            args.engine->forEachCell(value, [&count](int, int, const FormulaValue &cell) {
+                if (cell.type != Type::Blank) ++count;
+                return true;
+            });
+        }
+        else if (value.type != Type::Blank)
+            ++count;
+    }
+    return FormulaValue::fromNumber(double(count));
+}
+
+FormulaValue fnCountBlank(const FormulaArguments &args)
+{
+    const FormulaValue &value = args.values.at(0);
+    if (!value.isRange())
+        return errorValue(FormulaError::Value);
+    qint64 filled = 0;
+    args.engine->forEachCell(value, [&filled](int, int, const FormulaValue &cell) {
+        if (cell.type != Type::Blank && !(cell.type == Type::String && cell.string.isEmpty())) ++filled;
+        return true;
+    });
+    return FormulaValue::fromNumber(double(qint64(value.range.rowCount()) * value.range.columnCount() - filled));
+}
+
+FormulaValue fnMedian(const FormulaArguments &args)
+{
+    QVector<double> numbers;
+    const FormulaError error = collectNumbers(args, 0, numbers);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (numbers.isEmpty())
+        return errorValue(FormulaError::Num);
+    std::sort(numbers.begin(), numbers.end());
+    const int n = numbers.size();
+    return FormulaValue::fromNumber(n % 2 ? numbers.at(n / 2) : (numbers.at(n / 2 - 1) + numbers.at(n / 2)) / 2.0);
+}
+
+FormulaValue fnStdev(const FormulaArguments &args) { return variance(args, true, true); }
+FormulaValue fnStdevP(const FormulaArguments &args) { return variance(args, false, true); }
+FormulaValue fnVar(const FormulaArguments &args) { return variance(args, true, false); }
+FormulaValue fnVarP(const FormulaArguments &args) { return variance(args, false, false); }
+FormulaValue fnLarge(const FormulaArguments &args) { return kth(args, true); }
+FormulaValue fnSmall(const FormulaArguments &args) { return kth(args, false); }
+
+FormulaValue fnRound(const FormulaArguments &args) { return roundFunction(args, 0); }
+FormulaValue fnRoundUp(const FormulaArguments &args) { return roundFunction(args, 1); }
+FormulaValue fnRoundDown(const FormulaArguments &args) { return roundFunction(args, -1); }
+FormulaValue fnTrunc(const FormulaArguments &args) { return roundFunction(args, -1); }
+FormulaValue fnCeiling(const FormulaArguments &args) { return multiple(args, true); }
+FormulaValue fnFloor(const FormulaArguments &args) { return multiple(args, false); }
+
+FormulaValue fnMod(const FormulaArguments &args)
+{
+    double a, b;
+    FormulaError error = args.number(0, a);
+    if (error == FormulaError::None)
+        error = args.number(1, b);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (b == 0.0)
+        return errorValue(FormulaError::Div0);
+    return FormulaValue::fromNumber(a - b * std::floor(a / b));
+}
+
+FormulaValue fnPower(const FormulaArguments &args)
+{
+    double a, b;
+    FormulaError error = args.number(0, a);
+    if (error == FormulaError::None)
+        error = args.number(1, b);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (a == 0.0 && b == 0.0)
+        return errorValue(FormulaError::Num);
+    if (a == 0.0 && b < 0.0)
+        return errorValue(FormulaError::Div0);
+    return FormulaValue::fromNumber(std::pow(a, b));
+}
+
+FormulaValue fnSqrt(const FormulaArguments &args)
+{
+    double x;
+    const FormulaError error = args.number(0, x);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (x < 0)
+        return errorValue(FormulaError::Num);
+    return FormulaValue::fromNumber(std::sqrt(x));
+}
+
+FormulaValue fnLn(const FormulaArguments &args)
+{
+    double x;
+    const FormulaError error = args.number(0, x);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (x <= 0)
+        return errorValue(FormulaError::Num);
+    return FormulaValue::fromNumber(std::log(x));
+}
+
+FormulaValue fnLog(const FormulaArguments &args)
+{
+    double x, base = 10.0;
+    FormulaError error = args.number(0, x);
+    if (error == FormulaError::None && !args.isMissing(1))
+        error = args.number(1, base);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (x <= 0 || base <= 0)
+        return errorValue(FormulaError::Num);
+    if (base == 1.0)
+        return errorValue(FormulaError::Div0);
+    return FormulaValue::fromNumber(std::log(x) / std::log(base));
+}
+
+FormulaValue fnPi(const FormulaArguments &)
+{
+    return FormulaValue::fromNumber(3.14159265358979323846);
+}
+
+FormulaValue fnSumProduct(const FormulaArguments &args)
+{
+    const CellRange shape = rangeOf(args.values.at(0));
+    for (const FormulaValue &value: args.values) {
+        if (value.isError())
+            return value;
+        const CellRange r = rangeOf(value);
+        if (r.rowCount() != shape.rowCount() || r.columnCount() != shape.columnCount())
+            return errorValue(FormulaError::Value);
+    }
+
+    const FormulaValue &first = args.values.at(0);
+    double sum = 0.0;
+    FormulaError error = FormulaError::None;
+    args.engine->forEachCell(first, [&](int row, int column, const FormulaValue &cell) {
+        const int rowOffset = first.isRange() ? row - shape.firstRow() : 0;
+        const int columnOffset = first.isRange() ? column - shape.firstColumn() : 0;
+        if (cell.isError()) {
+            error = cell.error;
+            return false;
+        }
+        double product = cell.type == Type::Number ? cell.number : 0.0;
+        for (int i = 1; i < args.count() && product != 0.0; ++i) {
+            const FormulaValue &other = args.values.at(i);
+            const FormulaValue value = other.isRange()
+                    ? args.engine->cellValue(other.sheet, other.range.firstRow() + rowOffset,
+                                             other.range.firstColumn() + columnOffset)
+                    : other;
+            if (value.isError()) {
+                error = value.error;
+                return false;
+            }
+            product *= value.type == Type::Number ? value.number : 0.0;
+        }
+        sum += product;
+        return true;
+    });
+    if (error != FormulaError::None)
+        return errorValue(error);
+    return FormulaValue::fromNumber(sum);
+}
+
+FormulaValue fnSumIf(const FormulaArguments &args) { return conditionalAggregate(args, 2, 0, false); }
+FormulaValue fnAverageIf(const FormulaArguments &args) { return conditionalAggregate(args, 2, 0, true); }
+FormulaValue fnSumIfs(const FormulaArguments &args) { return conditionalAggregate(args, 0, 1, false); }
+FormulaValue fnAverageIfs(const FormulaArguments &args) { return conditionalAggregate(args, 0, 1, true); }
+FormulaValue fnCountIf(const FormulaArguments &args) { return conditionalCount(args); }
+FormulaValue fnCountIfs(const FormulaArguments &args) { return conditionalCount(args); }
+
+// Logical
+
+FormulaValue logical(const FormulaArguments &args, bool all)
+{
+    bool any = false;
+    bool result = all;
+    for (const FormulaValue &value: args.values) {
+        if (value.isRange()) {
+            FormulaError error = FormulaError::None;
+            args.engine->forEachCell(value, [&](int, int, const FormulaValue &cell) {
+                if (cell.isError()) {
+                    error = cell.error;
+                    return false;
+                }
+                if (cell.type == Type::Number || cell.type == Type::Boolean) {
+                    const bool b = cell.type == Type::Number ? cell.number != 0.0 : cell.boolean;
+                    result = all ? result && b : result || b;
+                    any = true;
+                }
+                return true;
+            });
+            if (error != FormulaError::None)
+                return errorValue(error);
+        }
+        else if (value.type != Type::Blank) {
+            bool b;
+            const FormulaError error = FormulaEngine::toBoolean(value, b);
+            if (error != FormulaError::None)
+                return errorValue(error);
+            result = all ? result && b : result || b;
+            any = true;
+        }
+    }
+    if (!any)
+        return errorValue(FormulaError::Value);
+    return FormulaValue::fromBoolean(result);
+}
+
+FormulaValue fnAnd(const FormulaArguments &args) { return logical(args, true); }
+FormulaValue fnOr(const FormulaArguments &args) { return logical(args, false); }
+
+FormulaValue fnNot(const FormulaArguments &args)
+{
+    bool b;
+    const FormulaError error = args.boolean(0, b);
+    return error != FormulaError::None ? errorValue(error) : FormulaValue::fromBoolean(!b);
+}
+
+FormulaValue fnTrue(const FormulaArguments &) { return FormulaValue::fromBoolean(true); }
+FormulaValue fnFalse(const FormulaArguments &) { return FormulaValue::fromBoolean(false); }
+FormulaValue fnNA(const FormulaArguments &) { return errorValue(FormulaError::NA); }
+
+FormulaValue fnIsBlank(const FormulaArguments &args) { return FormulaValue::fromBoolean(args.scalar(0).type == Type::Blank); }
+FormulaValue fnIsNumber(const FormulaArguments &args) { return FormulaValue::fromBoolean(args.scalar(0).type == Type::Number); }
+FormulaValue fnIsText(const FormulaArguments &args) { return FormulaValue::fromBoolean(args.scalar(0).type == Type::String); }
+FormulaValue fnIsLogical(const FormulaArguments &args) { return FormulaValue::fromBoolean(args.scalar(0).type == Type::Boolean); }
+FormulaValue fnIsError(const FormulaArguments &args) { return FormulaValue::fromBoolean(args.scalar(0).isError()); }
+
+FormulaValue fnIsErr(const FormulaArguments &args)
+{
+    const FormulaValue value = args.scalar(0);
+    return FormulaValue::fromBoolean(value.isError() && value.error != FormulaError::NA);
+}
+
+FormulaValue fnIsNA(const FormulaArguments &args)
+{
+    const FormulaValue value = args.scalar(0);
+    return FormulaValue::fromBoolean(value.isError() && value.error == FormulaError::NA);
+}
+
+// Lookup and reference
+
+FormulaValue fnVLookup(const FormulaArguments &args) { return tableLookup(args, true); }
+FormulaValue fnHLookup(const FormulaArguments &args) { return tableLookup(args, false); }
+
+FormulaValue fnMatch(const FormulaArguments &args)
+{
+    const FormulaValue key = args.scalar(0);
+    if (key.isError())
+        return key;
+    const FormulaValue &range = args.values.at(1);
+    if (!range.isRange() || (range.range.rowCount() != 1 && range.range.columnCount() != 1))
+        return errorValue(FormulaError::NA);
+    double type = 1.0;
+    if (!args.isMissing(2)) {
+        const FormulaError error = args.number(2, type);
+        if (error != FormulaError::None)
+            return errorValue(error);
+    }
+    const int offset = lookup(args.engine, key, range.sheet, range.range, type > 0 ? 1 : (type < 0 ? -1 : 0));
+    if (offset < 0)
+        return errorValue(FormulaError::NA);
+    return FormulaValue::fromNumber(offset + 1);
+}
+
+FormulaValue fnIndex(const FormulaArguments &args)
+{
+    const FormulaValue &range = args.values.at(0);
+    if (!range.isRange())
+        return errorValue(range.isError() ? range.error : FormulaError::Value);
+    double rowIndex = 0, columnIndex = 0;
+    FormulaError error = args.number(1, rowIndex);
+    if (error == FormulaError::None && !args.isMissing(2))
+        error = args.number(2, columnIndex);
+    if (error != FormulaError::None)
+        return errorValue(error);
+
+    const CellRange &r = range.range;
+    int row = int(std::trunc(rowIndex));
+    int column = int(std::trunc(columnIndex));
+    //INDEX(row_vector, n) selects the column
+    if (r.rowCount() == 1 && args.count() < 3) {
+        column = row;
+        row = 1;
+    }
+    if (row < 0 || column < 0 || row > r.rowCount() || column > r.columnCount())
+        return errorValue(FormulaError::Ref);
+    const int firstRow = row == 0 ? r.firstRow() : r.firstRow() + row - 1;
+    const int lastRow = row == 0 ? r.lastRow() : firstRow;
+    const int firstColumn = column == 0 ? r.firstColumn() : r.firstColumn() + column - 1;
+    const int lastColumn = column == 0 ? r.lastColumn() : firstColumn;
+    return FormulaValue::fromRange(range.sheet, CellRange(firstRow, firstColumn, lastRow, lastColumn));
+}
+
+FormulaValue fnRow(const FormulaArguments &args)
+{
+    if (args.isMissing(0))
+        return FormulaValue::fromNumber(args.context.row);
+    const FormulaValue &value = args.values.at(0);
+    if (!value.isRange())
+        return errorValue(FormulaError::Value);
+    return FormulaValue::fromNumber(value.range.firstRow());
+}
+
+FormulaValue fnColumn(const FormulaArguments &args)
+{
+    if (args.isMissing(0))
+        return FormulaValue::fromNumber(args.context.column);
+    const FormulaValue &value = args.values.at(0);
+    if (!value.isRange())
+        return errorValue(FormulaError::Value);
+    return FormulaValue::fromNumber(value.range.firstColumn());
+}
+
+FormulaValue fnRows(const FormulaArguments &args)
+{
+    const FormulaValue &value = args.values.at(0);
+    if (value.isError()) return value;
+    return FormulaValue::fromNumber(rangeOf(value).rowCount());
+}
+
+FormulaValue fnColumns(const FormulaArguments &args)
+{
+    const FormulaValue &value = args.values.at(0);
+    if (value.isError()) return value;
+    return FormulaValue::fromNumber(rangeOf(value).columnCount());
+}
+
+// Text
+
+FormulaValue fnConcatenate(const FormulaArguments &args)
+{
+    QString result;
+    for (int i = 0; i < args.count(); ++i) {
+        QString text;
+        const FormulaError error = args.text(i, text);
+        if (error != FormulaError::None)
+            return errorValue(error);
+        result += text;
+    }
+    return FormulaValue::fromString(result);
+}
+
+//Joins the texts of all arguments, including the cells of ranges
+FormulaError joinTexts(const FormulaArguments &args, int first, const QString &delimiter, bool ignoreEmpty,
+                       QString &result)
+{
+    bool firstText = true;
+    auto append = [&](const QString &text) {
+        if (ignoreEmpty && text.isEmpty()) return;
+        if (!firstText) result += delimiter;
+        result += text;
+        firstText = false;
+    };
+    for (int i = first; i < args.count(); ++i) {
+        const FormulaValue &value = args.values.at(i);
+        if (value.isError())
+            return value.error;
+        if (!value.isRange()) {
+            append(FormulaEngine::toText(value));
+            continue;
+        }
+        FormulaError error = FormulaError::None;
+        args.engine->forEachCell(value, [&](int, int, const FormulaValue &cell) {
+            if (cell.isError()) {
+                error = cell.error;
+                return false;
+            }
+            append(FormulaEngine::toText(cell));
+            return true;
+        });
+        if (error != FormulaError::None)
+            return error;
+    }
+    return FormulaError::None;
+}
+
+FormulaValue fnConcat(const FormulaArguments &args)
+{
+    QString result;
+    const FormulaError error = joinTexts(args, 0, QString(), true, result);
+    return error != FormulaError::None ? errorValue(error) : FormulaValue::fromString(result);
+}
+
+FormulaValue fnTextJoin(const FormulaArguments &args)
+{
+    QString delimiter, result;
+    bool ignoreEmpty = true;
+    FormulaError error = args.text(0, delimiter);
+    if (error == FormulaError::None)
+        error = args.boolean(1, ignoreEmpty);
+    if (error == FormulaError::None)
+        error = joinTexts(args, 2, delimiter, ignoreEmpty, result);
+    return error != FormulaError::None ? errorValue(error) : FormulaValue::fromString(result);
+}
+
+FormulaValue leftOrRight(const FormulaArguments &args, bool left)
+{
+    QString text;
+    double count = 1.0;
+    FormulaError error = args.text(0, text);
+    if (error == FormulaError::None && !args.isMissing(1))
+        error = args.number(1, count);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (count < 0)
+        return errorValue(FormulaError::Value);
+    const int n = int(std::min<double>(count, text.size()));
+    return FormulaValue::fromString(left ? text.left(n) : text.right(n));
+}
+
+FormulaValue fnLeft(const FormulaArguments &args) { return leftOrRight(args, true); }
+FormulaValue fnRight(const FormulaArguments &args) { return leftOrRight(args, false); }
+
+FormulaValue fnMid(const FormulaArguments &args)
+{
+    QString text;
+    double start, count;
+    FormulaError error = args.text(0, text);
+    if (error == FormulaError::None)
+        error = args.number(1, start);
+    if (error == FormulaError::None)
+        error = args.number(2, count);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (start < 1 || count < 0)
+        return errorValue(FormulaError::Value);
+    if (start > text.size())
+        return FormulaValue::fromString(QString());
+    return FormulaValue::fromString(text.mid(int(start) - 1, int(std::min<double>(count, text.size()))));
+}
+
+FormulaValue fnLen(const FormulaArguments &args)
+{
+    QString text;
+    const FormulaError error = args.text(0, text);
+    return error != FormulaError::None ? errorValue(error) : FormulaValue::fromNumber(text.size());
+}
+
+FormulaValue fnUpper(const FormulaArguments &args)
+{
+    QString text;
+    const FormulaError error = args.text(0, text);
+    return error != FormulaError::None ? errorValue(error) : FormulaValue::fromString(text.toUpper());
+}
+
+FormulaValue fnLower(const FormulaArguments &args)
+{
+    QString text;
+    const FormulaError error = args.text(0, text);
+    return error != FormulaError::None ? errorValue(error) : FormulaValue::fromString(text.toLower());
+}
+
+FormulaValue fnTrim(const FormulaArguments &args)
+{
+    QString text;
+    const FormulaError error = args.text(0, text);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    //only the space character is trimmed, the inner spaces are collapsed
+    QString result;
+    result.reserve(text.size());
+    bool space = false;
+    for (QChar ch: qAsConst(text)) {
+        if (ch == QLatin1Char(' ')) {
+            space = true;
+            continue;
+        }
+        if (space && !result.isEmpty())
+            result += QLatin1Char(' ');
+        space = false;
+        result += ch;
+    }
+    return FormulaValue::fromString(result);
+}
+
+FormulaValue fnValue(const FormulaArguments &args)
+{
+    const FormulaValue value = args.scalar(0);
+    if (value.type == Type::Boolean)
+        return errorValue(FormulaError::Value);
+    double number;
+    const FormulaError error = FormulaEngine::toNumber(value, number);
+    return error != FormulaError::None ? errorValue(error) : FormulaValue::fromNumber(number);
+}
+
+FormulaValue findText(const FormulaArguments &args, bool search)
+{
+    QString what, text;
+    double start = 1.0;
+    FormulaError error = args.text(0, what);
+    if (error == FormulaError::None)
+        error = args.text(1, text);
+    if (error == FormulaError::None && !args.isMissing(2))
+        error = args.number(2, start);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (start < 1 || start > text.size() + 1)
+        return errorValue(FormulaError::Value);
+
+    int index = -1;
+    if (search && hasWildcards(what)) {
+        //the pattern may match anywhere after the start position
+        const QRegularExpression re(wildcardToRegExp(what), QRegularExpression::CaseInsensitiveOption
+                                    | QRegularExpression::DotMatchesEverythingOption);
+        const auto match = re.match(text, int(start) - 1);
+        if (match.hasMatch()) index = match.capturedStart();
+    }
+    else
+        index = text.indexOf(what, int(start) - 1, search ? Qt::CaseInsensitive : Qt::CaseSensitive);
+    if (index < 0)
+        return errorValue(FormulaError::Value);
+    return FormulaValue::fromNumber(index + 1);
+}
+
+FormulaValue fnFind(const FormulaArguments &args) { return findText(args, false); }
+FormulaValue fnSearch(const FormulaArguments &args) { return findText(args, true); }
+
+FormulaValue fnSubstitute(const FormulaArguments &args)
+{
+    QString text, oldText, newText;
+    double instance = 0;
+    FormulaError error = args.text(0, text);
+    if (error == FormulaError::None)
+        error = args.text(1, oldText);
+    if (error == FormulaError::None)
+        error = args.text(2, newText);
+    if (error == FormulaError::None && !args.isMissing(3))
+        error = args.number(3, instance);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (oldText.isEmpty())
+        return FormulaValue::fromString(text);
+    if (args.isMissing(3))
+        return FormulaValue::fromString(text.replace(oldText, newText));
+    if (instance < 1)
+        return errorValue(FormulaError::Value);
+
+    int index = -1;
+    for (int i = 0; i < int(instance); ++i) {
+        index = text.indexOf(oldText, index + 1);
+        if (index < 0)
+            return FormulaValue::fromString(text);
+    }
+    return FormulaValue::fromString(text.replace(index, oldText.size(), newText));
+}
+
+FormulaValue fnRept(const FormulaArguments &args)
+{
+    QString text;
+    double count;
+    FormulaError error = args.text(0, text);
+    if (error == FormulaError::None)
+        error = args.number(1, count);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    if (count < 0 || text.size() * count > 32767)
+        return errorValue(FormulaError::Value);
+    return FormulaValue::fromString(text.repeated(int(count)));
+}
+
+FormulaValue fnExact(const FormulaArguments &args)
+{
+    QString a, b;
+    FormulaError error = args.text(0, a);
+    if (error == FormulaError::None)
+        error = args.text(1, b);
+    return error != FormulaError::None ? errorValue(error) : FormulaValue::fromBoolean(a == b);
+}
+
+// Date and time
+
+FormulaValue fnDate(const FormulaArguments &args)
+{
+    double year, month, day;
+    FormulaError error = args.number(0, year);
+    if (error == FormulaError::None)
+        error = args.number(1, month);
+    if (error == FormulaError::None)
+        error = args.number(2, day);
+    if (error != FormulaError::None)
+        return errorValue(error);
+    int y = int(std::trunc(year));
+    if (y < 1900)
+        y += 1900;
+    if (y < 1900 || y > 9999)
+        return errorValue(FormulaError::Num);
+    const QDate date = QDate(y, 1, 1).addMonths(int(std::trunc(month)) - 1).addDays(qint64(std::trunc(day)) - 1);
+    const double serial = serialFromDate(date, args.engine->date1904());
+    if (serial < 0)
+        return errorValue(FormulaError::Num);
+    return FormulaValue::fromNumber(serial);
+}
+
+FormulaValue fnYear(const FormulaArguments &args)
+{
+    QDate date;
+    const FormulaError error = dateFromSerial(args, date);
+    return error != FormulaError::None ? errorValue(error) : FormulaValue::fromNumber(date.year());
+}
+
+FormulaValue fnMonth(const FormulaArguments &args)
+{
+    QDate date;
+    const FormulaError error = dateFromSerial(args, date);
+    return error != FormulaError::None ? errorValue(error) : FormulaValue::fromNumber(date.month());
+}
+
+FormulaValue fnDay(const FormulaArguments &args)
+{
+    QDate date;
+    const FormulaError error = dateFromSerial(args, date);
+    return error != FormulaError::None ? errorValue(error) : FormulaValue::fromNumber(date.day());
+}
+
+FormulaValue fnToday(const FormulaArguments &args)
+{
+    return FormulaValue::fromNumber(serialFromDate(QDate::currentDate(), args.engine->date1904()));
+}
+
+FormulaValue fnNow(const FormulaArguments &args)
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    return FormulaValue::fromNumber(serialFromDate(now.date(), args.engine->date1904())
+                                    + now.time().msecsSinceStartOfDay() / 86400000.0);
+}
+
+}
+
+const QHash<QString, FormulaFunctionInfo> &formulaFunctions()
+{
+    static const QHash<QString, FormulaFunctionInfo> functions {
+        //evaluated by FormulaEngine::evaluateFunction()
+        {QStringLiteral("IF"), {nullptr, 2, 3}},
+        {QStringLiteral("IFERROR"), {nullptr, 2, 2}},
+        {QStringLiteral("IFNA"), {nullptr, 2, 2}},
+        {QStringLiteral("CHOOSE"), {nullptr, 2, 255}},
+
+        {QStringLiteral("SUM"), {fnSum, 1, 255}},
+        {QStringLiteral("PRODUCT"), {fnProduct, 1, 255}},
+        {QStringLiteral("AVERAGE"), {fnAverage, 1, 255}},
+        {QStringLiteral("MIN"), {fnMin, 1, 255}},
+        {QStringLiteral("MAX"), {fnMax, 1, 255}},
+        {QStringLiteral("COUNT"), {fnCount, 1, 255}},
+        {QStringLiteral("COUNTA"), {fnCountA, 1, 255}},
+        {QStringLiteral("COUNTBLANK"), {fnCountBlank, 1, 1}},
+        {QStringLiteral("MEDIAN"), {fnMedian, 1, 255}},
+        {QStringLiteral("STDEV"), {fnStdev, 1, 255}},
+        {QStringLiteral("STDEV.S"), {fnStdev, 1, 255}},
+        {QStringLiteral("STDEVP"), {fnStdevP, 1, 255}},
+        {QStringLiteral("STDEV.P"), {fnStdevP, 1, 255}},
+        {QStringLiteral("VAR"), {fnVar, 1, 255}},
+        {QStringLiteral("VAR.S"), {fnVar, 1, 255}},
+        {QStringLiteral("VARP"), {fnVarP, 1, 255}},
+        {QStringLiteral("VAR.P"), {fnVarP, 1, 255}},
+        {QStringLiteral("LARGE"), {fnLarge, 2, 2}},
+        {QStringLiteral("SMALL"), {fnSmall, 2, 2}},
+        {QStringLiteral("SUMPRODUCT"), {fnSumProduct, 1, 255}},
+        {QStringLiteral("SUMIF"), {fnSumIf, 2, 3}},
+        {QStringLiteral("SUMIFS"), {fnSumIfs, 3, 255}},
+        {QStringLiteral("COUNTIF"), {fnCountIf, 2, 2}},
+        {QStringLiteral("COUNTIFS"), {fnCountIfs, 2, 255}},
+        {QStringLiteral("AVERAGEIF"), {fnAverageIf, 2, 3}},
+        {QStringLiteral("AVERAGEIFS"), {fnAverageIfs, 3, 255}},
+
+        {QStringLiteral("ABS"), {unaryMath<absValue>, 1, 1}},
+        {QStringLiteral("INT"), {unaryMath<floorValue>, 1, 1}},
+        {QStringLiteral("SIGN"), {unaryMath<sign>, 1, 1}},
+        {QStringLiteral("EXP"), {unaryMath<expValue>, 1, 1}},
+        {QStringLiteral("ROUND"), {fnRound, 2, 2}},
+        {QStringLiteral("ROUNDUP"), {fnRoundUp, 2, 2}},
+        {QStringLiteral("ROUNDDOWN"), {fnRoundDown, 2, 2}},
+        {QStringLiteral("TRUNC"), {fnTrunc, 1, 2}},
+        {QStringLiteral("CEILING"), {fnCeiling, 1, 2}},
+        {QStringLiteral("FLOOR"), {fnFloor, 1, 2}},
+        {QStringLiteral("MOD"), {fnMod, 2, 2}},
+        {QStringLiteral("POWER"), {fnPower, 2, 2}},
+        {QStringLiteral("SQRT"), {fnSqrt, 1, 1}},
+        {QStringLiteral("LN"), {fnLn, 1, 1}},
+        {QStringLiteral("LOG"), {fnLog, 1, 2}},
+        {QStringLiteral("LOG10"), {fnLog, 1, 1}},
+        {QStringLiteral("PI"), {fnPi, 0, 0}},
+
+        {QStringLiteral("AND"), {fnAnd, 1, 255}},
+        {QStringLiteral("OR"), {fnOr, 1, 255}},
+        {QStringLiteral("NOT"), {fnNot, 1, 1}},
+        {QStringLiteral("TRUE"), {fnTrue, 0, 0}},
+        {QStringLiteral("FALSE"), {fnFalse, 0, 0}},
+        {QStringLiteral("NA"), {fnNA, 0, 0}},
+        {QStringLiteral("ISBLANK"), {fnIsBlank, 1, 1}},
+        {QStringLiteral("ISNUMBER"), {fnIsNumber, 1, 1}},
+        {QStringLiteral("ISTEXT"), {fnIsText, 1, 1}},
+        {QStringLiteral("ISLOGICAL"), {fnIsLogical, 1, 1}},
+        {QStringLiteral("ISERROR"), {fnIsError, 1, 1}},
+        {QStringLiteral("ISERR"), {fnIsErr, 1, 1}},
+        {QStringLiteral("ISNA"), {fnIsNA, 1, 1}},
+
+        {QStringLiteral("VLOOKUP"), {fnVLookup, 3, 4}},
+        {QStringLiteral("HLOOKUP"), {fnHLookup, 3, 4}},
+        {QStringLiteral("MATCH"), {fnMatch, 2, 3}},
+        {QStringLiteral("INDEX"), {fnIndex, 2, 3}},
+        {QStringLiteral("ROW"), {fnRow, 0, 1}},
+        {QStringLiteral("COLUMN"), {fnColumn, 0, 1}},
+        {QStringLiteral("ROWS"), {fnRows, 1, 1}},
+        {QStringLiteral("COLUMNS"), {fnColumns, 1, 1}},
+
+        {QStringLiteral("CONCATENATE"), {fnConcatenate, 1, 255}},
+        {QStringLiteral("CONCAT"), {fnConcat, 1, 255}},
+        {QStringLiteral("TEXTJOIN"), {fnTextJoin, 3, 255}},
+        {QStringLiteral("LEFT"), {fnLeft, 1, 2}},
+        {QStringLiteral("RIGHT"), {fnRight, 1, 2}},
+        {QStringLiteral("MID"), {fnMid, 3, 3}},
+        {QStringLiteral("LEN"), {fnLen, 1, 1}},
+        {QStringLiteral("UPPER"), {fnUpper, 1, 1}},
+        {QStringLiteral("LOWER"), {fnLower, 1, 1}},
+        {QStringLiteral("TRIM"), {fnTrim, 1, 1}},
+        {QStringLiteral("VALUE"), {fnValue, 1, 1}},
+        {QStringLiteral("FIND"), {fnFind, 2, 3}},
+        {QStringLiteral("SEARCH"), {fnSearch, 2, 3}},
+        {QStringLiteral("SUBSTITUTE"), {fnSubstitute, 3, 4}},
+        {QStringLiteral("REPT"), {fnRept, 2, 2}},
+        {QStringLiteral("EXACT"), {fnExact, 2, 2}},
+
+        {QStringLiteral("DATE"), {fnDate, 3, 3}},
+        {QStringLiteral("YEAR"), {fnYear, 1, 1}},
+        {QStringLiteral("MONTH"), {fnMonth, 1, 1}},
+        {QStringLiteral("DAY"), {fnDay, 1, 1}},
+        {QStringLiteral("TODAY"), {fnToday, 0, 0, true}},
+        {QStringLiteral("NOW"), {fnNow, 0, 0, true}},
+    };
+    return functions;
+}
+
+}
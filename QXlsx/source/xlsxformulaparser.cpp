@@ -0,0 +1,768 @@
+// xlsxformulaparser.cpp
+
+#include <QtGlobal>
+
+#include <algorithm>
+
+#include "xlsxformulaparser_p.h"
+#include "xlsxworksheet_p.h"
+#include "xlsxutility_p.h"
+
+namespace QXlsx {
+
+namespace {
+
+const struct {
+    FormulaError error;
+    const char *text;
+} formulaErrors[] = {
+    {FormulaError::Null, "#NULL!"},
+    {FormulaError::Div0, "#DIV/0!"},
+    {FormulaError::Value, "#VALUE!"},
+    {FormulaError::Ref, "#REF!"},
+    {FormulaError::Name, "#NAME?"},
+    {FormulaError::Num, "#NUM!"},
+    {FormulaError::NA, "#N/A"},
+};
+
+struct Token
+{
+    enum class Type {Number, String, Boolean, Error, Reference, Name, Function, Operator, Open, Close, Comma, Array, End};
+    Type type = Type::End;
+    int position = 0; //the area of a reference in the formula text, without the sheet prefix
+    int length = 0;
+    int sheetLength = 0;
+    double number = 0.0;
+    bool boolean = false;
+    FormulaError error = FormulaError::None;
+    QString text;
+    FormulaReference reference;
+};
+
+bool isNameChar(QChar ch)
+{
+    return ch.isLetterOrNumber() || ch == QLatin1Char('_') || ch == QLatin1Char('.')
+            || ch == QLatin1Char('\\') || ch == QLatin1Char('?');
+}
+
+bool isAsciiLetter(QChar ch)
+{
+    return (ch >= QLatin1Char('A') && ch <= QLatin1Char('Z')) || (ch >= QLatin1Char('a') && ch <= QLatin1Char('z'));
+}
+
+bool isDigit(QChar ch)
+{
+    return ch >= QLatin1Char('0') && ch <= QLatin1Char('9');
+}
+
+class Lexer
+{
+public:
+    explicit Lexer(const QString &formula) : m_s(formula) {}
+    bool tokenize(QVector<Token> &tokens, QString *errorString);
+
+private:
+    QChar at(int pos) const { return pos < m_s.size() ? m_s.at(pos) : QChar(); }
+    bool readColumn(int &pos, int &column, bool &absolute) const;
+    bool readRow(int &pos, int &row, bool &absolute) const;
+    bool readArea(int &pos, FormulaReference &ref) const;
+    bool readSheetPrefix(int &pos, QString &sheet) const;
+    bool isAreaEnd(int pos) const;
+
+    const QString &m_s;
+};
+
+bool Lexer::readColumn(int &pos, int &column, bool &absolute) const
+{
+    int p = pos;
+    absolute = at(p) == QLatin1Char('$');
+    if (absolute) ++p;
+    const int start = p;
+    while (isAsciiLetter(at(p)) && p - start < 4) ++p;
+    if (p == start || p - start > 3) return false;
+    column = formulaColumnFromName(m_s.mid(start, p - start));
+    if (column < 1 || column > XLSX_COLUMN_MAX) return false;
+    pos = p;
+    return true;
+}
+
+bool Lexer::readRow(int &pos, int &row, bool &absolute) const
+{
+    int p = pos;
+    absolute = at(p) == QLatin1Char('$');
+    if (absolute) ++p;
+    const int start = p;
+    while (isDigit(at(p)) && p - start < 8) ++p;
+    if (p == start || p - start > 7) return false;
+    row = m_s.mid(start, p - start).toInt();
+    if (row < 1 || row > XLSX_ROW_MAX) return false;
+    pos = p;
+    return true;
+}
+
+bool Lexer::isAreaEnd(int pos) const
+{
+    const QChar ch = at(pos);
+    return ch.isNull() || !(isNameChar(ch) || ch == QLatin1Char('(') || ch == QLatin1Char('!')
+                            || ch == QLatin1Char('$'));
+}
+
+bool Lexer::readArea(int &pos, FormulaReference &ref) const
+{
+    //A1 or A1:B2
+    int p = pos;
+    if (readColumn(p, ref.firstColumn, ref.firstColumnAbsolute)
+            && readRow(p, ref.firstRow, ref.firstRowAbsolute)) {
+        ref.lastRow = ref.firstRow;
+        ref.lastColumn = ref.firstColumn;
+        ref.lastRowAbsolute = ref.firstRowAbsolute;
+        ref.lastColumnAbsolute = ref.firstColumnAbsolute;
+        if (at(p) == QLatin1Char(':')) {
+            int p2 = p + 1;
+            if (readColumn(p2, ref.lastColumn, ref.lastColumnAbsolute)
+                    && readRow(p2, ref.lastRow, ref.lastRowAbsolute))
+                p = p2;
+            else
+                return false;
+        }
+        if (!isAreaEnd(p)) return false;
+    }
+    else {
+        //A:C
+        p = pos;
+        if (readColumn(p, ref.firstColumn, ref.firstColumnAbsolute) && at(p) == QLatin1Char(':')) {
+            ++p;
+            if (!readColumn(p, ref.lastColumn, ref.lastColumnAbsolute) || !isAreaEnd(p))
+                return false;
+            ref.wholeColumns = true;
+            ref.firstRow = 1;
+            ref.lastRow = XLSX_ROW_MAX;
+        }
+        else {
+            //1:3
+            p = pos;
+            if (!readRow(p, ref.firstRow, ref.firstRowAbsolute) || at(p) != QLatin1Char(':'))
+                return false;
+            ++p;
+            if (!readRow(p, ref.lastRow, ref.lastRowAbsolute) || !isAreaEnd(p))
+                return false;
+            ref.wholeRows = true;
+            ref.firstColumn = 1;
+            ref.lastColumn = XLSX_COLUMN_MAX;
+        }
+    }
+    if (ref.firstRow > ref.lastRow) {
+        std::swap(ref.firstRow, ref.lastRow);
+        std::swap(ref.firstRowAbsolute, ref.lastRowAbsolute);
+    }
+    if (ref.firstColumn > ref.lastColumn) {
+        std::swap(ref.firstColumn, ref.lastColumn);
+        std::swap(ref.firstColumnAbsolute, ref.lastColumnAbsolute);
+    }
+    pos = p;
+    return true;
+}
+
+bool Lexer::readSheetPrefix(int &pos, QString &sheet) const
+{
+    int p = pos;
+    QString name;
+    if (at(p) == QLatin1Char('\'')) {
+        ++p;
+        while (p < m_s.size()) {
+            if (at(p) == QLatin1Char('\'')) {
+                if (at(p + 1) != QLatin1Char('\'')) break;
+                ++p;
+            }
+            name.append(at(p));
+            ++p;
+        }
+        if (at(p) != QLatin1Char('\'')) return false;
+        ++p;
+    }
+    else {
+        const int start = p;
+        while (isNameChar(at(p)) || at(p) == QLatin1Char('[') || at(p) == QLatin1Char(']')) ++p;
+        name = m_s.mid(start, p - start);
+    }
+    if (name.isEmpty() || at(p) != QLatin1Char('!')) return false;
+    sheet = name;
+    pos = p + 1;
+    return true;
+}
+
+bool Lexer::tokenize(QVector<Token> &tokens, QString *errorString)
+{
+    auto fail = [errorString](const QString &message) {
+        if (errorString) *errorString = message;
+        return false;
+    };
+
+    int i = 0;
+    while (i < m_s.size()) {
+        const QChar ch = m_s.at(i);
+        Token token;
+        if (ch.isSpace()) {
+            ++i;
+            continue;
+        }
+        if (ch == QLatin1Char('"')) {
+            ++i;
+            while (true) {
+                if (i >= m_s.size()) return fail(QStringLiteral("Unterminated string"));
+                if (m_s.at(i) == QLatin1Char('"')) {
+                    if (at(i + 1) != QLatin1Char('"')) break;
+                    ++i;
+                }
+                token.text.append(m_s.at(i));
+                ++i;
+            }
+            ++i;
+            token.type = Token::Type::String;
+        }
+        else if (ch == QLatin1Char('#')) {
+            for (const auto &e: formulaErrors) {
+                const QLatin1String text(e.text);
+                if (m_s.mid(i, text.size()).compare(text, Qt::CaseInsensitive) == 0) {
+                    token.type = Token::Type::Error;
+                    token.error = e.error;
+                    i += text.size();
+                    break;
+                }
+            }
+            if (token.type != Token::Type::Error)
+                return fail(QStringLiteral("Unknown error literal at %1").arg(i));
+        }
+        else if (ch == QLatin1Char('{')) {
+            //kept as a single token, so the references around it are still found
+            int p = i + 1;
+            bool quoted = false;
+            while (p < m_s.size() && (quoted || m_s.at(p) != QLatin1Char('}'))) {
+                if (m_s.at(p) == QLatin1Char('"')) quoted = !quoted;
+                ++p;
+            }
+            if (p >= m_s.size()) return fail(QStringLiteral("Unterminated array constant"));
+            token.type = Token::Type::Array;
+            i = p + 1;
+        }
+        else if (isDigit(ch) || (ch == QLatin1Char('.') && isDigit(at(i + 1)))) {
+            int p = i;
+            if (readArea(p, token.reference) && token.reference.wholeRows) {
+                token.type = Token::Type::Reference;
+                token.position = i;
+                token.length = p - i;
+                i = p;
+            }
+            else {
+                token.reference = FormulaReference();
+                p = i;
+                while (isDigit(at(p))) ++p;
+                if (at(p) == QLatin1Char('.')) {
+                    ++p;
+                    while (isDigit(at(p))) ++p;
+                }
+                if ((at(p) == QLatin1Char('e') || at(p) == QLatin1Char('E'))
+                        && (isDigit(at(p + 1)) || ((at(p + 1) == QLatin1Char('+') || at(p + 1) == QLatin1Char('-'))
+                                                   && isDigit(at(p + 2))))) {
+                    p += 2;
+                    while (isDigit(at(p))) ++p;
+                }
+                bool ok = false;
+                token.number = m_s.mid(i, p - i).toDouble(&ok);
+                if (!ok) return fail(QStringLiteral("Invalid number at %1").arg(i));
+                token.type = Token::Type::Number;
+                i = p;
+            }
+        }
+        else if (isNameChar(ch) || ch == QLatin1Char('$') || ch == QLatin1Char('\'') || ch == QLatin1Char('[')) {
+            int p = i;
+            QString sheet;
+            const bool hasSheet = readSheetPrefix(p, sheet);
+            int areaEnd = p;
+            FormulaReference ref;
+            if (readArea(areaEnd, ref)) {
+                ref.sheet = sheet;
+                token.type = Token::Type::Reference;
+                token.reference = ref;
+                token.position = p;
+                token.length = areaEnd - p;
+                token.sheetLength = p - i;
+                i = areaEnd;
+            }
+            else {
+                //a name, a function or a boolean; the sheet prefix of a name is ignored
+                if (!hasSheet) p = i;
+                const int start = p;
+                while (isNameChar(at(p))) ++p;
+                if (p == start) return fail(QStringLiteral("Unexpected character at %1").arg(p));
+                QString name = m_s.mid(start, p - start);
+                int next = p;
+                while (at(next).isSpace()) ++next;
+                if (at(next) == QLatin1Char('(')) {
+                    name = name.toUpper();
+                    if (name.startsWith(QLatin1String("_XLFN."))) name = name.mid(6);
+                    if (name.startsWith(QLatin1String("_XLWS."))) name = name.mid(6);
+                    token.type = Token::Type::Function;
+                    token.text = name;
+                    p = next + 1;
+                }
+                else if (name.compare(QLatin1String("TRUE"), Qt::CaseInsensitive) == 0
+                         || name.compare(QLatin1String("FALSE"), Qt::CaseInsensitive) == 0) {
+                    token.type = Token::Type::Boolean;
+                    token.boolean = name.compare(QLatin1String("TRUE"), Qt::CaseInsensitive) == 0;
+                }
+                else {
+                    token.type = Token::Type::Name;
+                    token.text = name;
+                }
+                i = p;
+            }
+        }
+        else if (ch == QLatin1Char('<')) {
+            token.type = Token::Type::Operator;
+            if (at(i + 1) == QLatin1Char('=') || at(i + 1) == QLatin1Char('>')) {
+                token.text = m_s.mid(i, 2);
+                i += 2;
+            }
+            else {
+                token.text = ch;
+                ++i;
+            }
+        }
+        else if (ch == QLatin1Char('>')) {
+            token.type = Token::Type::Operator;
+            if (at(i + 1) == QLatin1Char('=')) {
+                token.text = m_s.mid(i, 2);
+                i += 2;
+            }
+            else {
+                token.text = ch;
+                ++i;
+            }
+        }
+        else if (QStringLiteral("+-*/^&=%").contains(ch)) {
+            token.type = Token::Type::Operator;
+            token.text = ch;
+            ++i;
+        }
+        else if (ch == QLatin1Char('(')) {
+            token.type = Token::Type::Open;
+            ++i;
+        }
+        else if (ch == QLatin1Char(')')) {
+            token.type = Token::Type::Close;
+            ++i;
+        }
+        else if (ch == QLatin1Char(',') || ch == QLatin1Char(';')) {
+            token.type = Token::Type::Comma;
+            ++i;
+        }
+        else
+            return fail(QStringLiteral("Unexpected character at %1").arg(i));
+
+        tokens.append(token);
+    }
+    tokens.append(Token());
+    return true;
+}
+
+class Parser
+{
+public:
+    explicit Parser(const QVector<Token> &tokens) : m_tokens(tokens) {}
+
+    FormulaNodePtr parse(QString *errorString)
+    {
+        auto node = parseComparison();
+        if (node && peek().type != Token::Type::End)
+            node = fail(QStringLiteral("Unexpected token"));
+        if (!node && errorString)
+            *errorString = m_error;
+        return node;
+    }
+
+private:
+    const Token &peek() const { return m_tokens.at(m_pos); }
+    bool isOperator(const char *op) const
+    {
+        return peek().type == Token::Type::Operator && peek().text == QLatin1String(op);
+    }
+    FormulaNodePtr fail(const QString &message)
+    {
+        if (m_error.isEmpty()) m_error = message;
+        return nullptr;
+    }
+    static FormulaNodePtr binary(FormulaNode::Operator op, const FormulaNodePtr &left, const FormulaNodePtr &right)
+    {
+        auto node = std::make_shared<FormulaNode>();
+        node->kind = FormulaNode::Kind::Binary;
+        node->op = op;
+        node->children = {left, right};
+        return node;
+    }
+
+    FormulaNodePtr parseComparison();
+    FormulaNodePtr parseConcat();
+    FormulaNodePtr parseAdditive();
+    FormulaNodePtr parseMultiplicative();
+    FormulaNodePtr parsePower();
+    FormulaNodePtr parseUnary();
+    FormulaNodePtr parsePercent();
+    FormulaNodePtr parsePrimary();
+
+    const QVector<Token> &m_tokens;
+    int m_pos = 0;
+    QString m_error;
+};
+
+FormulaNodePtr Parser::parseComparison()
+{
+    auto left = parseConcat();
+    while (left && peek().type == Token::Type::Operator) {
+        FormulaNode::Operator op;
+        const QString &text = peek().text;
+        if (text == QLatin1String("=")) op = FormulaNode::Operator::Equal;
+        else if (text == QLatin1String("<>")) op = FormulaNode::Operator::NotEqual;
+        else if (text == QLatin1String("<")) op = FormulaNode::Operator::Less;
+        else if (text == QLatin1String(">")) op = FormulaNode::Operator::Greater;
+        else if (text == QLatin1String("<=")) op = FormulaNode::Operator::LessOrEqual;
+        else if (text == QLatin1String(">=")) op = FormulaNode::Operator::GreaterOrEqual;
+        else break;
+        ++m_pos;
+        auto right = parseConcat();
+        if (!right) return nullptr;
+        left = binary(op, left, right);
+    }
+    return left;
+}
+
+FormulaNodePtr Parser::parseConcat()
+{
+    auto left = parseAdditive();
+    while (left && isOperator("&")) {
+        ++m_pos;
+        auto right = parseAdditive();
+        if (!right) return nullptr;
+        left = binary(FormulaNode::Operator::Concat, left, right);
+    }
+    return left;
+}
+
+FormulaNodePtr Parser::parseAdditive()
+{
+    auto left = parseMultiplicative();
+    while (left && (isOperator("+") || isOperator("-"))) {
+        const auto op = isOperator("+") ? FormulaNode::Operator::Add : FormulaNode::Operator::Subtract;
+        ++m_pos;
+        auto right = parseMultiplicative();
+        if (!right) return nullptr;
+        left = binary(op, left, right);
+    }
+    return left;
+}
+
+FormulaNodePtr Parser::parseMultiplicative()
+{
+    auto left = parsePower();
+    while (left && (isOperator("*") || isOperator("/"))) {
+        const auto op = isOperator("*") ? FormulaNode::Operator::Multiply : FormulaNode::Operator::Divide;
+        ++m_pos;
+        auto right = parsePower();
+        if (!right) return nullptr;
+        left = binary(op, left, right);
+    }
+    return left;
+}
+
+FormulaNodePtr Parser::parsePower()
+{
+    auto left = parseUnary();
+    while (left && isOperator("^")) {
+        ++m_pos;
+        auto right = parseUnary();
+        if (!right) return nullptr;
+        left = binary(FormulaNode::Operator::Power, left, right);
+    }
+    return left;
+}
+
+FormulaNodePtr Parser::parseUnary()
+{
+    //in Excel the negation has a higher precedence than ^, so -2^2 = 4
+    if (isOperator("-") || isOperator("+")) {
+        const auto op = isOperator("-") ? FormulaNode::Operator::Negate : FormulaNode::Operator::Plus;
+        ++m_pos;
+        auto operand = parseUnary();
+        if (!operand) return nullptr;
+        auto node = std::make_shared<FormulaNode>();
+        node->kind = FormulaNode::Kind::Unary;
+        node->op = op;
+        node->children = {operand};
+        return node;
+    }
+    return parsePercent();
+}
+
+FormulaNodePtr Parser::parsePercent()
+{
+    auto operand = parsePrimary();
+    while (operand && isOperator("%")) {
+        ++m_pos;
+        auto node = std::make_shared<FormulaNode>();
+        node->kind = FormulaNode::Kind::Percent;
+        node->children = {operand};
+        operand = node;
+    }
+    return operand;
+}
+
+FormulaNodePtr Parser::parsePrimary()
+{
+    const Token &token = peek();
+    auto node = std::make_shared<FormulaNode>();
+    switch (token.type) {
+        case Token::Type::Number:
+            node->kind = FormulaNode::Kind::Number;
+            node->number = token.number;
+            break;
+        case Token::Type::String:
+            node->kind = FormulaNode::Kind::String;
+            node->text = token.text;
+            break;
+        case Token::Type::Boolean:
+            node->kind = FormulaNode::Kind::Boolean;
+            node->boolean = token.boolean;
+            break;
+        case Token::Type::Error:
+            node->kind = FormulaNode::Kind::Error;
+            node->error = token.error;
+            break;
+        case Token::Type::Reference:
+            node->kind = FormulaNode::Kind::Reference;
+            node->reference = token.reference;
+            break;
+        case Token::Type::Name:
+            node->kind = FormulaNode::Kind::Name;
+            node->text = token.text;
+            break;
+        case Token::Type::Open: {
+            ++m_pos;
+            auto inner = parseComparison();
+            if (!inner) return nullptr;
+            if (peek().type != Token::Type::Close) return fail(QStringLiteral("Missing ')'"));
+            ++m_pos;
+            return inner;
+        }
+        case Token::Type::Array:
+            return fail(QStringLiteral("Array constants are not supported"));
+        case Token::Type::Function: {
+            node->kind = FormulaNode::Kind::Function;
+            node->text = token.text;
+            ++m_pos;
+            if (peek().type == Token::Type::Close) {
+                ++m_pos;
+                return node;
+            }
+            while (true) {
+                if (peek().type == Token::Type::Comma || peek().type == Token::Type::Close)
+                    node->children.append(std::make_shared<FormulaNode>()); //missing argument
+                else {
+                    auto arg = parseComparison();
+                    if (!arg) return nullptr;
+                    node->children.append(arg);
+                }
+                if (peek().type == Token::Type::Comma) {
+                    ++m_pos;
+                    continue;
+                }
+                if (peek().type == Token::Type::Close) {
+                    ++m_pos;
+                    return node;
+                }
+                return fail(QStringLiteral("Missing ')' in the call of %1").arg(node->text));
+            }
+        }
+        default:
+            return fail(QStringLiteral("Unexpected token"));
+    }
+    ++m_pos;
+    return node;
+}
+
+}
+
+QString formulaErrorToString(FormulaError error)
+{
+    for (const auto &e: formulaErrors) {
+        if (e.error == error)
+            return QLatin1String(e.text);
+    }
+    return QString();
+}
+
+FormulaError formulaErrorFromString(const QString &error)
+{
+    for (const auto &e: formulaErrors) {
+        if (error.compare(QLatin1String(e.text), Qt::CaseInsensitive) == 0)
+            return e.error;
+    }
+    return FormulaError::None;
+}
+
+int formulaColumnFromName(const QString &name)
+{
+    int column = 0;
+    for (QChar ch: name)
+        column = column * 26 + (ch.toUpper().unicode() - 'A' + 1);
+    return column;
+}
+
+QString formulaColumnName(int column)
+{
+    QString name;
+    while (column > 0) {
+        const int modulo = (column - 1) % 26;
+        name.prepend(QLatin1Char(char('A' + modulo)));
+        column = (column - modulo) / 26;
+    }
+    return name;
+}
+
+QString FormulaReference::toString() const
+{
+    QString result;
+    if (!sheet.isEmpty())
+        result = escapeSheetName(sheet) + QLatin1Char('!');
+    auto column = [](int c, bool absolute) {
+        return (absolute ? QStringLiteral("$") : QString()) + formulaColumnName(c);
+    };
+    auto row = [](int r, bool absolute) {
+        return (absolute ? QStringLiteral("$") : QString()) + QString::number(r);
+    };
+    if (wholeColumns)
+        return result + column(firstColumn, firstColumnAbsolute) + QLatin1Char(':') + column(lastColumn, lastColumnAbsolute);
+    if (wholeRows)
+        return result + row(firstRow, firstRowAbsolute) + QLatin1Char(':') + row(lastRow, lastRowAbsolute);
+    result += column(firstColumn, firstColumnAbsolute) + row(firstRow, firstRowAbsolute);
+    if (!isCell() || firstRowAbsolute != lastRowAbsolute || firstColumnAbsolute != lastColumnAbsolute)
+        result += QLatin1Char(':') + column(lastColumn, lastColumnAbsolute) + row(lastRow, lastRowAbsolute);
+    return result;
+}
+
+FormulaReference FormulaReference::relativeTo(int row, int column) const
+{
+    FormulaReference ref = *this;
+    if (relative)
+        return ref;
+    if (!wholeColumns) {
+        if (!firstRowAbsolute) ref.firstRow -= row;
+        if (!lastRowAbsolute) ref.lastRow -= row;
+    }
+    if (!wholeRows) {
+        if (!firstColumnAbsolute) ref.firstColumn -= column;
+        if (!lastColumnAbsolute) ref.lastColumn -= column;
+    }
+    ref.relative = true;
+    return ref;
+}
+
+FormulaReference FormulaReference::resolved(int row, int column) const
+{
+    FormulaReference ref = *this;
+    if (!relative)
+        return ref;
+    if (!wholeColumns) {
+        if (!firstRowAbsolute) ref.firstRow += row;
+        if (!lastRowAbsolute) ref.lastRow += row;
+    }
+    if (!wholeRows) {
+        if (!firstColumnAbsolute) ref.firstColumn += column;
+        if (!lastColumnAbsolute) ref.lastColumn += column;
+    }
+    ref.relative = false;
+    if (ref.firstRow > ref.lastRow) {
+        std::swap(ref.firstRow, ref.lastRow);
+        std::swap(ref.firstRowAbsolute, ref.lastRowAbsolute);
+    }
+    if (ref.firstColumn > ref.lastColumn) {
+        std::swap(ref.firstColumn, ref.lastColumn);
+        std::swap(ref.firstColumnAbsolute, ref.lastColumnAbsolute);
+    }
+    return ref;
+}
+
+bool FormulaReference::isValid() const
+{
+    return !relative && firstRow >= 1 && lastRow <= XLSX_ROW_MAX
+            && firstColumn >= 1 && lastColumn <= XLSX_COLUMN_MAX;
+}
+
+QString FormulaReference::toR1C1() const
+{
+    //the offsets of a reference that is not relative are counted from A1
+    auto part = [this](QChar prefix, int value, bool absolute) {
+        if (absolute)
+            return prefix + QString::number(value);
+        const int offset = relative ? value : value - 1;
+        return offset ? prefix + QLatin1Char('[') + QString::number(offset) + QLatin1Char(']') : QString(prefix);
+    };
+    QString result;
+    if (!sheet.isEmpty())
+        result = escapeSheetName(sheet) + QLatin1Char('!');
+    if (wholeColumns)
+        return result + part(QLatin1Char('C'), firstColumn, firstColumnAbsolute) + QLatin1Char(':')
+                + part(QLatin1Char('C'), lastColumn, lastColumnAbsolute);
+    if (wholeRows)
+        return result + part(QLatin1Char('R'), firstRow, firstRowAbsolute) + QLatin1Char(':')
+                + part(QLatin1Char('R'), lastRow, lastRowAbsolute);
+    result += part(QLatin1Char('R'), firstRow, firstRowAbsolute) + part(QLatin1Char('C'), firstColumn, firstColumnAbsolute);
+    if (!isCell() || firstRowAbsolute != lastRowAbsolute || firstColumnAbsolute != lastColumnAbsolute)
+        result += QLatin1Char(':') + part(QLatin1Char('R'), lastRow, lastRowAbsolute)
+                + part(QLatin1Char('C'), lastColumn, lastColumnAbsolute);
+    return result;
+}
+
+FormulaNodePtr FormulaParser::parse(const QString &formula, QString *errorString)
+{
+    return parse(formula, 0, 0, errorString);
+}
+
+FormulaNodePtr FormulaParser::parse(const QString &formula, int row, int column, QString *errorString)
+{
+    QString text = formula.trimmed();
+    if (text.startsWith(QLatin1Char('=')))
+        text.remove(0, 1);
+    if (text.isEmpty()) {
+        if (errorString) *errorString = QStringLiteral("Empty formula");
+        return nullptr;
+    }
+
+    QVector<Token> tokens;
+    Lexer lexer(text);
+    if (!lexer.tokenize(tokens, errorString))
+        return nullptr;
+    if (row > 0 && column > 0) {
+        for (Token &token: tokens) {
+            if (token.type == Token::Type::Reference)
+                token.reference = token.reference.relativeTo(row, column);
+        }
+    }
+    Parser parser(tokens);
+    return parser.parse(errorString);
+}
+
+bool FormulaParser::findReferences(const QString &formula, QVector<FormulaReferenceSpan> &references,
+                                   QString *errorString)
+{
+    QVector<Token> tokens;
+    Lexer lexer(formula);
+    if (!lexer.tokenize(tokens, errorString))
+        return false;
+    for (const Token &token: qAsConst(tokens)) {
+        if (token.type == Token::Type::Reference)
+            references.append({token.position, token.length, token.sheetLength, token.reference});
+    }
+    return true;
+}
+
+}
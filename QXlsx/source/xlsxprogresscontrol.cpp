@@ -0,0 +1,64 @@
+// xlsxprogresscontrol.cpp
+
+#include "xlsxprogresscontrol_p.h"
+
+namespace QXlsx {
+
+ProgressControl::ProgressControl(const Callback &callback, const CancelCheck &cancelCheck)
+    : m_callback(callback), m_cancelCheck(cancelCheck)
+{
+}
+
+void ProgressControl::setTotal(qint64 total)
+{
+    m_total = total;
+    m_base = 0;
+    m_lastReported = -1;
+    report(0, true);
+}
+
+qint64 ProgressControl::total() const
+{
+    return m_total;
+}
+
+void ProgressControl::setPartProgress(qint64 processed)
+{
+    report(m_base + processed, false);
+}
+
+void ProgressControl::finishPart(qint64 size)
+{
+    m_base += size;
+    report(m_base, false);
+}
+
+void ProgressControl::finish()
+{
+    m_base = m_total;
+    report(m_total, true);
+}
+
+bool ProgressControl::isCanceled() const
+{
+    return m_cancelCheck && m_cancelCheck();
+}
+
+void ProgressControl::report(qint64 processed, bool force)
+{
+    if (!m_callback)
+        return;
+    if (m_total > 0)
+        processed = qMin(processed, m_total);
+
+    const qint64 step = qMax<qint64>(m_total / 1000, 1);
+    if (!force && m_lastReported >= 0 && processed - m_lastReported < step)
+        return;
+    if (processed == m_lastReported)
+        return;
+
+    m_lastReported = processed;
+    m_callback(processed, m_total);
+}
+
+}
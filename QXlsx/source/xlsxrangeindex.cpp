@@ -0,0 +1,291 @@
+// xlsxrangeindex.cpp
+
+#include <QtGlobal>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <cmath>
+
+#include "xlsxrangeindex_p.h"
+
+namespace QXlsx {
+
+namespace {
+//the children of a node of the trees
+const int NodeSize = 16;
+}
+
+RangeIndex::Box RangeIndex::toBox(const CellRange &range)
+{
+    return Box {range.firstRow(), range.firstColumn(), range.lastRow(), range.lastColumn()};
+}
+
+/*!
+ * \internal
+ * Calls \a visit for the entries of \a tree that intersect \a area, until it
+ * returns false. Returns false if the visit was stopped.
+ */
+template <typename Visit>
+bool RangeIndex::visit(const Tree &tree, const Box &area, Visit visit)
+{
+    if (tree.isEmpty() || !tree.levels.last().first().intersects(area))
+        return true;
+
+    //the nodes to visit, as the level and the position in the level
+    QVarLengthArray<QPair<int, int>, 64> stack;
+    stack.append(qMakePair(tree.levels.size() - 1, 0));
+    while (!stack.isEmpty()) {
+        const QPair<int, int> node = stack.last();
+        stack.removeLast();
+        const int first = node.second * NodeSize;
+        if (node.first == 0) {
+            const int last = qMin(tree.entries.size(), first + NodeSize);
+            for (int i = first; i < last; ++i) {
+                const Entry &entry = tree.entries.at(i);
+                if (!entry.removed && entry.box.intersects(area) && !visit(entry))
+                    return false;
+            }
+            continue;
+        }
+        const QVector<Box> &children = tree.levels.at(node.first - 1);
+        const int last = qMin(children.size(), first + NodeSize);
+        for (int i = first; i < last; ++i) {
+            if (children.at(i).intersects(area))
+                stack.append(qMakePair(node.first - 1, i));
+        }
+    }
+    return true;
+}
+
+/*!
+ * \internal
+ * Drops the ranges and makes the index invalid.
+ */
+void RangeIndex::reset()
+{
+    m_valid.storeRelease(0);
+    m_trees.clear();
+    m_size = 0;
+    m_removed = 0;
+}
+
+/*!
+ * \internal
+ * Replaces the ranges of the index by \a items and makes the index valid.
+ */
+void RangeIndex::build(const QVector<Item> &items)
+{
+    reset();
+    addItems(items);
+    m_valid.storeRelease(1);
+}
+
+void RangeIndex::insert(const CellRange &range, int value)
+{
+    if (isValid() && range.isValid())
+        add(QVector<Entry> {Entry {toBox(range), value, false}});
+}
+
+void RangeIndex::insert(const QVector<Item> &items)
+{
+    if (isValid())
+        addItems(items);
+}
+
+void RangeIndex::addItems(const QVector<Item> &items)
+{
+    QVector<Entry> entries;
+    entries.reserve(items.size());
+    for (const Item &item : items) {
+        if (item.range.isValid())
+            entries.append(Entry {toBox(item.range), item.value, false});
+    }
+    if (!entries.isEmpty())
+        add(std::move(entries));
+}
+
+/*!
+ * \internal
+ * Removes one range equal to \a range with \a value. Returns false if there is
+ * no such range.
+ */
+bool RangeIndex::remove(const CellRange &range, int value)
+{
+    if (!isValid() || !range.isValid())
+        return false;
+    const Box box = toBox(range);
+    for (int k = 0; k < m_trees.size(); ++k) {
+        const Tree &tree = m_trees.at(k);
+        int found = -1;
+        visit(tree, box, [&](const Entry &entry) {
+            if (!(entry.box == box) || entry.value != value)
+                return true;
+            found = int(&entry - tree.entries.constData());
+            return false;
+        });
+        if (found < 0)
+            continue;
+
+        Tree &modified = m_trees[k];
+        modified.entries[found].removed = true;
+        ++modified.removed;
+        ++m_removed;
+        if (m_removed * 2 > m_size)
+            compact();
+        return true;
+    }
+    return false;
+}
+
+/*!
+ * \internal
+ * Returns the ranges that intersect \a area, in no particular order.
+ */
+QVector<RangeIndex::Item> RangeIndex::find(const CellRange &area) const
+{
+    QVector<Item> items;
+    if (!area.isValid())
+        return items;
+    const Box box = toBox(area);
+    for (const Tree &tree : m_trees) {
+        visit(tree, box, [&items](const Entry &entry) {
+            items.append(Item {CellRange(entry.box.firstRow, entry.box.firstColumn,
+                                         entry.box.lastRow, entry.box.lastColumn), entry.value});
+            return true;
+        });
+    }
+    return items;
+}
+
+/*!
+ * \internal
+ * Returns the distinct values of the ranges that intersect \a area, in
+ * ascending order.
+ */
+QVector<int> RangeIndex::values(const CellRange &area) const
+{
+    QVector<int> values;
+    if (!area.isValid())
+        return values;
+    const Box box = toBox(area);
+    for (const Tree &tree : m_trees) {
+        visit(tree, box, [&values](const Entry &entry) {
+            values.append(entry.value);
+            return true;
+        });
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    return values;
+}
+
+bool RangeIndex::intersects(const CellRange &area) const
+{
+    if (!area.isValid())
+        return false;
+    const Box box = toBox(area);
+    for (const Tree &tree : m_trees) {
+        if (!visit(tree, box, [](const Entry &) { return false; }))
+            return true;
+    }
+    return false;
+}
+
+/*!
+ * \internal
+ * Packs \a entries into a tree with the sort-tile-recursive order: the
+ * entries are sorted by the row of their center and cut into slices, each
+ * slice is sorted by the column, so the nodes bound compact areas.
+ */
+RangeIndex::Tree RangeIndex::pack(QVector<Entry> entries)
+{
+    const int count = entries.size();
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return qint64(a.box.firstRow) + a.box.lastRow < qint64(b.box.firstRow) + b.box.lastRow;
+    });
+    const int leaves = (count + NodeSize - 1) / NodeSize;
+    const int sliceSize = NodeSize * qMax(1, int(std::ceil(std::sqrt(double(leaves)))));
+    for (int first = 0; first < count; first += sliceSize) {
+        std::sort(entries.begin() + first, entries.begin() + qMin(count, first + sliceSize),
+                  [](const Entry &a, const Entry &b) {
+            return qint64(a.box.firstColumn) + a.box.lastColumn < qint64(b.box.firstColumn) + b.box.lastColumn;
+        });
+    }
+
+    auto bounds = [](int size, auto boxAt) {
+        QVector<Box> boxes;
+        boxes.reserve((size + NodeSize - 1) / NodeSize);
+        for (int first = 0; first < size; first += NodeSize) {
+            Box box = boxAt(first);
+            for (int i = first + 1; i < qMin(size, first + NodeSize); ++i) {
+                const Box &other = boxAt(i);
+                box.firstRow = qMin(box.firstRow, other.firstRow);
+                box.firstColumn = qMin(box.firstColumn, other.firstColumn);
+                box.lastRow = qMax(box.lastRow, other.lastRow);
+                box.lastColumn = qMax(box.lastColumn, other.lastColumn);
+            }
+            boxes.append(box);
+        }
+        return boxes;
+    };
+
+    Tree tree;
+    tree.entries = std::move(entries);
+    tree.levels.append(bounds(count, [&tree](int i) { return tree.entries.at(i).box; }));
+    while (tree.levels.last().size() > 1) {
+        const QVector<Box> children = tree.levels.last();
+        tree.levels.append(bounds(children.size(), [&children](int i) { return children.at(i); }));
+    }
+    return tree;
+}
+
+/*!
+ * \internal
+ * Adds \a entries as a new tree. The smaller trees are merged into it until
+ * it fits an empty slot, so there are O(log n) trees.
+ */
+void RangeIndex::add(QVector<Entry> entries)
+{
+    m_size += entries.size();
+    for (int k = 0;; ++k) {
+        if (k == m_trees.size())
+            m_trees.append(Tree());
+        Tree &tree = m_trees[k];
+        if (!tree.isEmpty()) {
+            for (const Entry &entry : qAsConst(tree.entries)) {
+                if (!entry.removed)
+                    entries.append(entry);
+            }
+            m_size -= tree.removed;
+            m_removed -= tree.removed;
+            tree = Tree();
+        }
+        if (entries.size() <= (qint64(NodeSize) << k)) {
+            tree = pack(std::move(entries));
+            return;
+        }
+    }
+}
+
+/*!
+ * \internal
+ * Drops the removed entries by packing the remaining ones into one tree.
+ */
+void RangeIndex::compact()
+{
+    QVector<Entry> entries;
+    entries.reserve(m_size - m_removed);
+    for (const Tree &tree : qAsConst(m_trees)) {
+        for (const Entry &entry : tree.entries) {
+            if (!entry.removed)
+                entries.append(entry);
+        }
+    }
+    m_trees.clear();
+    m_size = 0;
+    m_removed = 0;
+    if (!entries.isEmpty())
+        add(std::move(entries));
+}
+
+}
@@ -0,0 +1,608 @@
+// xlsxreferenceindex.cpp
+
+#include <QtGlobal>
+#include <QSet>
+
+#include "xlsxreferenceindex_p.h"
+#include "xlsxformulacache_p.h"
+#include "xlsxworkbook.h"
+#include "xlsxworkbook_p.h"
+#include "xlsxworksheet.h"
+#include "xlsxworksheet_p.h"
+#include "xlsxconditionalformatting.h"
+#include "xlsxconditionalformatting_p.h"
+#include "xlsxchart.h"
+#include "xlsxseries.h"
+#include "xlsxutility_p.h"
+
+namespace QXlsx {
+
+namespace {
+
+const XlsxCfRuleData::Attribute ruleFormulas[] = {
+    XlsxCfRuleData::A_formula1, XlsxCfRuleData::A_formula2, XlsxCfRuleData::A_formula3
+};
+
+}
+
+ReferenceIndex::ReferenceIndex(Workbook *workbook)
+    : m_workbook(workbook)
+{
+
+}
+
+/*!
+ * \internal
+ * Brings the index up to date with the workbook. The formula cells of a sheet
+ * are collected again only in the ranges modified since the last update; all
+ * of them are collected again if the sheets have been added, removed or renamed
+ * other than by renameSheet().
+ */
+void ReferenceIndex::update()
+{
+    QList<AbstractSheet *> sheets;
+    QStringList sheetNames;
+    for (const auto &sheet: qAsConst(m_workbook->d_func()->sheets)) {
+        sheets << sheet.data();
+        sheetNames << sheet->name();
+    }
+    if (sheets != m_sheets || sheetNames != m_sheetNames) {
+        m_sheets = sheets;
+        m_sheetNames = sheetNames;
+        m_sheetsByName.clear();
+        for (AbstractSheet *sheet: qAsConst(m_sheets))
+            m_sheetsByName.insert(sheet->name().toUpper(), sheet);
+        clearCells();
+    }
+
+    for (AbstractSheet *sheet: qAsConst(m_sheets)) {
+        if (sheet->type() != AbstractSheet::Type::Worksheet)
+            continue;
+        Worksheet *worksheet = static_cast<Worksheet *>(sheet);
+        auto d = worksheet->d_func();
+        if (!m_cells.contains(worksheet) || d->referencesOverflow) {
+            removeCells(worksheet, CellRange());
+            indexCells(worksheet, CellRange());
+        }
+        else {
+            for (const CellRange &range: qAsConst(d->referenceChanges)) {
+                removeCells(worksheet, range);
+                indexCells(worksheet, range);
+            }
+        }
+        d->trackReferences = true;
+        d->referencesOverflow = false;
+        d->referenceChanges.clear();
+    }
+    indexObjects();
+}
+
+/*!
+ * \internal
+ * Returns the sheet referred to by \a name from \a host. An empty name refers
+ * to the host itself.
+ */
+const AbstractSheet *ReferenceIndex::resolveSheet(const QString &name, const AbstractSheet *host) const
+{
+    if (name.isEmpty())
+        return host;
+    return m_sheetsByName.value(name.toUpper());
+}
+
+/*!
+ * \internal
+ * Collects the references of the formula cells of \a sheet in \a range, or of
+ * all of them if \a range is invalid.
+ */
+void ReferenceIndex::indexCells(Worksheet *sheet, const CellRange &range)
+{
+    SheetCells &cells = m_cells[sheet];
+    const bool all = !range.isValid();
+    //the const table is not detached from the snapshots
+    const auto &table = sheet->d_func()->cellTable;
+    auto rowIt = all ? table.constBegin() : table.lowerBound(range.firstRow());
+    for (; rowIt != table.constEnd() && (all || rowIt.key() <= range.lastRow()); ++rowIt) {
+        const auto &row = rowIt.value();
+        auto it = all ? row.constBegin() : row.lowerBound(range.firstColumn());
+        for (; it != row.constEnd() && (all || it.key() <= range.lastColumn()); ++it) {
+            if (it.value()->hasFormula())
+                indexCell(sheet, rowIt.key(), it.key(), it.value().get(), cells);
+        }
+    }
+}
+
+void ReferenceIndex::indexCell(Worksheet *sheet, int row, int column, const Cell *cell, SheetCells &cells)
+{
+    auto add = [&](const AbstractSheet *target, const CellRange &area, bool master) {
+        const CellEntry entry {sheet, row, column, target, area, master};
+        int value = m_cellEntries.size();
+        if (m_freeEntries.isEmpty())
+            m_cellEntries.append(entry);
+        else {
+            value = m_freeEntries.takeLast();
+            m_cellEntries[value] = entry;
+        }
+        RangeIndex &areas = m_cellAreas[target];
+        if (!areas.isValid())
+            areas.build({});
+        areas.insert(entry.area, value);
+        cells[row][column].append(value);
+    };
+
+    const CellFormula cellFormula = cell->formula();
+    const auto type = cellFormula.type().value_or(CellFormula::Type::Normal);
+    if ((type == CellFormula::Type::Array || type == CellFormula::Type::DataTable)
+        && cellFormula.reference().isValid())
+        add(sheet, cellFormula.reference(), true);
+
+    //the references are taken from the template, so a shared formula is tokenized once
+    const FormulaTemplatePtr formula = sheet->d_func()->formulaTemplate(row, column, cell);
+    const QVector<FormulaReference> references = formula->references();
+    for (const FormulaReference &reference: references) {
+        const FormulaReference resolved = reference.resolved(row, column);
+        if (!resolved.isValid())
+            continue;
+        if (const AbstractSheet *target = resolveSheet(resolved.sheet, sheet))
+            add(target, resolved.range(), false);
+    }
+}
+
+/*!
+ * \internal
+ * Drops the references of the cells of \a sheet in \a range, or of all of them
+ * if \a range is invalid.
+ */
+void ReferenceIndex::removeCells(Worksheet *sheet, const CellRange &range)
+{
+    auto cellsIt = m_cells.find(sheet);
+    if (cellsIt == m_cells.end())
+        return;
+    SheetCells &cells = cellsIt.value();
+    const bool all = !range.isValid();
+    auto rowIt = all ? cells.begin() : cells.lowerBound(range.firstRow());
+    while (rowIt != cells.end() && (all || rowIt.key() <= range.lastRow())) {
+        auto it = all ? rowIt->begin() : rowIt->lowerBound(range.firstColumn());
+        while (it != rowIt->end() && (all || it.key() <= range.lastColumn())) {
+            for (int value: qAsConst(it.value()))
+                removeEntry(value);
+            it = rowIt->erase(it);
+        }
+        if (rowIt->isEmpty())
+            rowIt = cells.erase(rowIt);
+        else
+            ++rowIt;
+    }
+}
+
+void ReferenceIndex::removeEntry(int value)
+{
+    CellEntry &entry = m_cellEntries[value];
+    m_cellAreas[entry.target].remove(entry.area, value);
+    entry.sheet = nullptr;
+    m_freeEntries.append(value);
+}
+
+void ReferenceIndex::clearCells()
+{
+    m_cells.clear();
+    m_cellEntries.clear();
+    m_freeEntries.clear();
+    m_cellAreas.clear();
+}
+
+void ReferenceIndex::indexObjects()
+{
+    m_objects.clear();
+
+    const auto &names = m_workbook->d_func()->definedNamesList;
+    for (int i = 0; i < names.size(); ++i) {
+        ReferenceSite site;
+        site.kind = ReferenceSite::Kind::DefinedName;
+        site.index = i;
+        addFormula(site, names.at(i).formula, nullptr);
+    }
+
+    for (AbstractSheet *sheet: qAsConst(m_sheets)) {
+        if (sheet->type() != AbstractSheet::Type::Worksheet)
+            continue;
+        Worksheet *worksheet = static_cast<Worksheet *>(sheet);
+        auto d = worksheet->d_func();
+        for (int i = 0; i < d->dataValidationsList.size(); ++i) {
+            const DataValidation &validation = d->dataValidationsList.at(i);
+            const ReferenceSite site {ReferenceSite::Kind::DataValidation, worksheet, nullptr, 0, 0, i};
+            const auto ranges = validation.ranges();
+            for (const CellRange &range: ranges)
+                m_objects[worksheet].append({site, range});
+            addFormula(site, validation.formula1(), worksheet);
+            addFormula(site, validation.formula2(), worksheet);
+        }
+        for (int i = 0; i < d->conditionalFormattingList.size(); ++i) {
+            const ConditionalFormatting &formatting = d->conditionalFormattingList.at(i);
+            const ReferenceSite site {ReferenceSite::Kind::ConditionalFormatting, worksheet, nullptr, 0, 0, i};
+            const auto ranges = formatting.ranges();
+            for (const CellRange &range: ranges)
+                m_objects[worksheet].append({site, range});
+            for (const auto &rule: qAsConst(formatting.d->cfRules)) {
+                for (auto attribute: ruleFormulas) {
+                    auto it = rule->attrs.constFind(attribute);
+                    if (it != rule->attrs.constEnd())
+                        addFormula(site, it.value().toString(), worksheet);
+                }
+            }
+        }
+    }
+
+    const auto charts = m_workbook->d_func()->chartFiles;
+    for (const auto &file: charts) {
+        auto chart = file.lock();
+        if (!chart)
+            continue;
+        for (int i = 0; i < chart->seriesCount(); ++i) {
+            const Series *series = chart->series(i);
+            if (!series)
+                continue;
+            const ReferenceSite site {ReferenceSite::Kind::Series, nullptr, chart.data(), 0, 0, i};
+            addFormula(site, series->categorySource().reference, nullptr);
+            addFormula(site, series->valueSource().reference, nullptr);
+            addFormula(site, series->bubbleSizeSource().reference, nullptr);
+        }
+    }
+
+    m_objectAreas.clear();
+    for (auto it = m_objects.constBegin(); it != m_objects.constEnd(); ++it) {
+        QVector<RangeIndex::Item> items;
+        items.reserve(it->size());
+        for (int i = 0; i < it->size(); ++i)
+            items.append(RangeIndex::Item {it->at(i).area, i});
+        m_objectAreas[it.key()].build(items);
+    }
+}
+
+void ReferenceIndex::addFormula(const ReferenceSite &site, const QString &formula, const AbstractSheet *host)
+{
+    if (formula.isEmpty())
+        return;
+    QVector<FormulaReferenceSpan> spans;
+    if (!FormulaParser::findReferences(formula, spans))
+        return;
+    for (const FormulaReferenceSpan &span: qAsConst(spans)) {
+        if (const AbstractSheet *target = resolveSheet(span.reference.sheet, host))
+            m_objects[target].append({site, span.reference.range()});
+    }
+}
+
+/*!
+ * \internal
+ * Returns the objects that refer to the cells of \a target, or only to the cells
+ * in \a area if it is valid. Each object is returned once.
+ */
+QVector<ReferenceSite> ReferenceIndex::sites(const AbstractSheet *target, const CellRange &area) const
+{
+    QVector<ReferenceSite> result;
+    QSet<ReferenceSite> seen;
+    auto add = [&](const ReferenceSite &site) {
+        if (!seen.contains(site)) {
+            seen.insert(site);
+            result.append(site);
+        }
+    };
+
+    const CellRange query = area.isValid() ? area : CellRange(1, 1, XLSX_ROW_MAX, XLSX_COLUMN_MAX);
+    auto cells = m_cellAreas.constFind(target);
+    if (cells != m_cellAreas.constEnd()) {
+        for (int value: cells->values(query)) {
+            const CellEntry &entry = m_cellEntries.at(value);
+            if (!entry.master)
+                add(masterSite({ReferenceSite::Kind::Cell, entry.sheet, nullptr, entry.row, entry.column, 0}));
+        }
+    }
+    auto objects = m_objectAreas.constFind(target);
+    if (objects != m_objectAreas.constEnd()) {
+        const QVector<ObjectEntry> entries = m_objects.value(target);
+        for (int value: objects->values(query))
+            add(entries.at(value).site);
+    }
+    return result;
+}
+
+/*!
+ * \internal
+ * Returns the masters of the array and data table formulas of \a sheet whose
+ * ranges intersect \a area, with their ranges.
+ */
+QVector<QPair<CellReference, CellRange> > ReferenceIndex::masters(const Worksheet *sheet, const CellRange &area) const
+{
+    QVector<QPair<CellReference, CellRange> > result;
+    auto cells = m_cellAreas.constFind(sheet);
+    if (cells == m_cellAreas.constEnd())
+        return result;
+    for (const RangeIndex::Item &item: cells->find(area)) {
+        const CellEntry &entry = m_cellEntries.at(item.value);
+        if (entry.master)
+            result.append(qMakePair(CellReference(entry.row, entry.column), entry.area));
+    }
+    return result;
+}
+
+/*!
+ * \internal
+ * The cells of a shared formula have no text of their own, their references
+ * are rewritten in the master cell.
+ */
+ReferenceSite ReferenceIndex::masterSite(const ReferenceSite &site) const
+{
+    const Cell *cell = site.sheet->cell(site.row, site.column);
+    if (!cell)
+        return site;
+    const CellFormula formula = cell->formula();
+    if (formula.type().value_or(CellFormula::Type::Normal) != CellFormula::Type::Shared || !formula.text().isEmpty())
+        return site;
+    const CellFormula master = site.sheet->d_func()->sharedFormulaMap.value(formula.sharedIndex().value_or(-1));
+    const CellReference topLeft = master.reference().topLeft();
+    if (!topLeft.isValid())
+        return site;
+    ReferenceSite result = site;
+    result.row = topLeft.row();
+    result.column = topLeft.column();
+    return result;
+}
+
+/*!
+ * \internal
+ * Rewrites the references of \a formula. \a rewrite gets each reference with the
+ * coordinates as written and the sheet name as written, or empty, and returns
+ * true if it has changed the reference. Changed references that fall outside
+ * the sheet are written as #REF!.
+ */
+QString ReferenceIndex::rewriteFormula(const QString &formula, const Rewrite &rewrite)
+{
+    QVector<FormulaReferenceSpan> spans;
+    if (formula.isEmpty() || !FormulaParser::findReferences(formula, spans))
+        return formula;
+
+    QString result;
+    int position = 0;
+    for (const FormulaReferenceSpan &span: qAsConst(spans)) {
+        FormulaReference reference = span.reference;
+        if (!rewrite(reference))
+            continue;
+        const int start = span.position - span.sheetLength;
+        result += formula.mid(position, start - position);
+        if (reference.isValid())
+            result += reference.toString();
+        else {
+            if (!reference.sheet.isEmpty())
+                result += escapeSheetName(reference.sheet) + QLatin1Char('!');
+            result += formulaErrorToString(FormulaError::Ref);
+        }
+        position = span.position + span.length;
+    }
+    if (position == 0)
+        return formula;
+    result += formula.mid(position);
+    return result;
+}
+
+/*!
+ * \internal
+ * Rewrites the formulas of \a site. Returns true if any of them has changed.
+ */
+bool ReferenceIndex::rewrite(const ReferenceSite &site, const Rewrite &rewrite)
+{
+    bool changed = false;
+    auto apply = [&](const QString &formula) {
+        const QString text = rewriteFormula(formula, rewrite);
+        if (text != formula)
+            changed = true;
+        return text;
+    };
+
+    switch (site.kind) {
+        case ReferenceSite::Kind::Cell: {
+            auto d = site.sheet->d_func();
+            const Cell *cell = site.sheet->cell(site.row, site.column);
+            if (!cell || !cell->hasFormula() || cell->formula().text().isEmpty())
+                break;
+            CellFormula formula = cell->formula();
+            const QString text = apply(formula.text());
+            if (!changed)
+                break;
+            formula.setText(text);
+            d->detachedCell(site.row, site.column)->assignFormula(formula);
+            //the other cells of a shared formula take the text from the map
+            if (formula.type().value_or(CellFormula::Type::Normal) == CellFormula::Type::Shared) {
+                auto it = d->sharedFormulaMap.find(formula.sharedIndex().value_or(-1));
+                if (it != d->sharedFormulaMap.end()) {
+                    it->setText(text);
+                    //their references are collected again
+                    d->cellsModified(it->reference());
+                }
+            }
+            break;
+        }
+        case ReferenceSite::Kind::DefinedName: {
+            auto &names = m_workbook->d_func()->definedNamesList;
+            if (site.index < names.size())
+                names[site.index].formula = apply(names.at(site.index).formula);
+            break;
+        }
+        case ReferenceSite::Kind::DataValidation: {
+            auto &validations = site.sheet->d_func()->dataValidationsList;
+            if (site.index >= validations.size())
+                break;
+            const DataValidation &validation = validations.at(site.index);
+            const QString formula1 = apply(validation.formula1());
+            const QString formula2 = apply(validation.formula2());
+            if (changed) {
+                validations[site.index].setFormula1(formula1);
+                validations[site.index].setFormula2(formula2);
+            }
+            break;
+        }
+        case ReferenceSite::Kind::ConditionalFormatting: {
+            auto &formattings = site.sheet->d_func()->conditionalFormattingList;
+            if (site.index >= formattings.size())
+                break;
+            const auto rules = formattings.at(site.index).d->cfRules;
+            for (int i = 0; i < rules.size(); ++i) {
+                //the rules are shared with the copies of the formatting
+                std::shared_ptr<XlsxCfRuleData> rule;
+                for (auto attribute: ruleFormulas) {
+                    auto it = rules.at(i)->attrs.constFind(attribute);
+                    if (it == rules.at(i)->attrs.constEnd())
+                        continue;
+                    const QString formula = it.value().toString();
+                    const QString text = rewriteFormula(formula, rewrite);
+                    if (text == formula)
+                        continue;
+                    if (!rule)
+                        rule = std::make_shared<XlsxCfRuleData>(*rules.at(i));
+                    rule->attrs[attribute] = text;
+                }
+                if (rule) {
+                    formattings[site.index].d->cfRules[i] = rule;
+                    changed = true;
+                }
+            }
+            break;
+        }
+        case ReferenceSite::Kind::Series: {
+            Series *series = site.chart->series(site.index);
+            if (!series)
+                break;
+            DataSource category = series->categorySource();
+            DataSource value = series->valueSource();
+            DataSource bubbleSize = series->bubbleSizeSource();
+            category.reference = apply(category.reference);
+            value.reference = apply(value.reference);
+            bubbleSize.reference = apply(bubbleSize.reference);
+            if (changed) {
+                series->setCategoryData(category);
+                series->setValueData(value);
+                series->setBubbleSizeData(bubbleSize);
+            }
+            break;
+        }
+    }
+    return changed;
+}
+
+/*!
+ * \internal
+ * Replaces the name of \a sheet with \a newName in all references to it. Only
+ * the objects that refer to the sheet are rewritten. The areas of the references
+ * do not change, so the index stays valid.
+ */
+void ReferenceIndex::renameSheet(AbstractSheet *sheet, const QString &newName)
+{
+    update();
+
+    const auto targets = sites(sheet);
+    for (const ReferenceSite &site: targets) {
+        rewrite(site, [this, sheet, &newName](FormulaReference &reference) {
+            if (reference.sheet.isEmpty() || resolveSheet(reference.sheet, nullptr) != sheet)
+                return false;
+            reference.sheet = newName;
+            return true;
+        });
+    }
+
+    //the rewritten cells need not be collected again
+    for (auto it = m_cells.constBegin(); it != m_cells.constEnd(); ++it) {
+        auto d = it.key()->d_func();
+        d->referencesOverflow = false;
+        d->referenceChanges.clear();
+    }
+    const int index = m_sheets.indexOf(sheet);
+    if (index >= 0) {
+        m_sheetsByName.remove(m_sheetNames.at(index).toUpper());
+        m_sheetNames[index] = newName;
+        m_sheetsByName.insert(newName.toUpper(), sheet);
+    }
+}
+
+/*!
+ * \internal
+ * Applies \a shift to the references after the rows or columns of \a sheet have
+ * been shifted and the references to them rewritten: the formula cells of the
+ * sheet are moved, the areas on the sheet are adjusted. Only the moved cells and
+ * the areas that reach the shifted rows or columns are visited.
+ */
+void ReferenceIndex::shiftSheet(Worksheet *sheet, const SheetShift &shift)
+{
+    //1. the formula cells
+    auto cellsIt = m_cells.find(sheet);
+    if (cellsIt != m_cells.end()) {
+        SheetCells &cells = cellsIt.value();
+        if (shift.rows) {
+            QVector<QPair<int, QMap<int, QVector<int> > > > moved;
+            for (auto rowIt = cells.lowerBound(shift.first); rowIt != cells.end(); rowIt = cells.erase(rowIt)) {
+                const int row = rowIt.key() + shift.count;
+                const bool removed = rowIt.key() < shift.end() || row > shift.limit();
+                for (auto it = rowIt->constBegin(); it != rowIt->constEnd(); ++it) {
+                    for (int value: it.value()) {
+                        if (removed)
+                            removeEntry(value);
+                        else
+                            m_cellEntries[value].row = row;
+                    }
+                }
+                if (!removed)
+                    moved.append(qMakePair(row, rowIt.value()));
+            }
+            for (const auto &entry: qAsConst(moved))
+                cells.insert(cells.constEnd(), entry.first, entry.second);
+        }
+        else {
+            for (auto rowIt = cells.begin(); rowIt != cells.end();) {
+                QVector<QPair<int, QVector<int> > > moved;
+                for (auto it = rowIt->lowerBound(shift.first); it != rowIt->end(); it = rowIt->erase(it)) {
+                    const int column = it.key() + shift.count;
+                    const bool removed = it.key() < shift.end() || column > shift.limit();
+                    for (int value: qAsConst(it.value())) {
+                        if (removed)
+                            removeEntry(value);
+                        else
+                            m_cellEntries[value].column = column;
+                    }
+                    if (!removed)
+                        moved.append(qMakePair(column, it.value()));
+                }
+                for (const auto &entry: qAsConst(moved))
+                    rowIt->insert(rowIt->constEnd(), entry.first, entry.second);
+                if (rowIt->isEmpty())
+                    rowIt = cells.erase(rowIt);
+                else
+                    ++rowIt;
+            }
+        }
+    }
+
+    //2. the areas on the sheet, whole columns (rows) do not move with rows (columns)
+    auto areasIt = m_cellAreas.find(sheet);
+    if (areasIt == m_cellAreas.end())
+        return;
+    const QVector<RangeIndex::Item> items = areasIt->find(shift.area());
+    for (const RangeIndex::Item &item: items) {
+        CellRange area = item.range;
+        if (shift.rows ? area.firstRow() == 1 && area.lastRow() == XLSX_ROW_MAX
+                       : area.firstColumn() == 1 && area.lastColumn() == XLSX_COLUMN_MAX)
+            continue;
+        if (!shift.adjust(area)) {
+            //the reference is written as #REF!
+            const CellEntry &entry = m_cellEntries.at(item.value);
+            QVector<int> &values = m_cells[entry.sheet][entry.row][entry.column];
+            values.removeOne(item.value);
+            removeEntry(item.value);
+            continue;
+        }
+        if (area == item.range)
+            continue;
+        RangeIndex &areas = m_cellAreas[sheet];
+        areas.remove(item.range, item.value);
+        areas.insert(area, item.value);
+        m_cellEntries[item.value].area = area;
+    }
+}
+
+}
@@ -2,6 +2,7 @@
 
 #include <QtGlobal>
 #include <QDebug>
+#include <QMutex>
 #include <QTextDocument>
 #include <QTextFragment>
 
@@ -22,7 +23,7 @@ RichStringPrivate::RichStringPrivate()
 RichStringPrivate::RichStringPrivate(const RichStringPrivate &other)
     :QSharedData(other), fragmentTexts(other.fragmentTexts)
     ,fragmentFormats(other.fragmentFormats)
-    , _idKey(other.idKey()), _dirty(other._dirty)
+    , _idKey(other.idKey()), _dirty(other._dirty.load())
 {
 
 }
@@ -382,24 +383,29 @@ Format RichString::fragmentFormat(int index) const
  */
 QByteArray RichStringPrivate::idKey() const
 {
-    if (_dirty) {
-        RichStringPrivate *rs = const_cast<RichStringPrivate *>(this);
-        QByteArray bytes;
-        if (fragmentTexts.size() == 1) {
-            bytes = fragmentTexts[0].toUtf8();
-        } else {
-            //Generate a hash value base on QByteArray ?
-            bytes.append("@@QtXlsxRichString=");
-            for (int i=0; i<fragmentTexts.size(); ++i) {
-                bytes.append("@Text");
-                bytes.append(fragmentTexts[i].toUtf8());
-                bytes.append("@Format");
-                if (fragmentFormats[i].hasFontData())
-                    bytes.append(fragmentFormats[i].fontKey());
+    //The key is generated once under a mutex and published by clearing the
+    //atomic flag, so that concurrent readers of a shared string are safe.
+    if (_dirty.load(std::memory_order_acquire)) {
+        static QMutex mutex;
+        QMutexLocker locker(&mutex);
+        if (_dirty.load(std::memory_order_relaxed)) {
+            QByteArray bytes;
+            if (fragmentTexts.size() == 1) {
+                bytes = fragmentTexts[0].toUtf8();
+            } else {
+                //Generate a hash value base on QByteArray ?
+                bytes.append("@@QtXlsxRichString=");
+                for (int i=0; i<fragmentTexts.size(); ++i) {
+                    bytes.append("@Text");
+                    bytes.append(fragmentTexts[i].toUtf8());
+                    bytes.append("@Format");
+                    if (fragmentFormats[i].hasFontData())
+                        bytes.append(fragmentFormats[i].fontKey());
+                }
             }
+            _idKey = bytes;
+            _dirty.store(false, std::memory_order_release);
         }
-        rs->_idKey = bytes;
-        rs->_dirty = false;
     }
 
     return _idKey;
@@ -0,0 +1,188 @@
+// xlsxrowfilter.cpp
+
+#include <QtGlobal>
+
+#include "xlsxrowfilter.h"
+#include "xlsxrowfilter_p.h"
+#include "xlsxsharedstrings_p.h"
+#include "xlsxrichstring.h"
+
+namespace QXlsx {
+
+void RowFilter::setCombination(Combination combination)
+{
+    mCombination = combination;
+}
+
+RowFilter::Combination RowFilter::combination() const
+{
+    return mCombination;
+}
+
+void RowFilter::addEquals(int column, const QVariant &value)
+{
+    addInSet(column, {value});
+}
+
+void RowFilter::addInSet(int column, const QList<QVariant> &values)
+{
+    Predicate p;
+    p.kind = Predicate::Kind::InSet;
+    p.column = column;
+    p.values = values;
+    mPredicates.append(p);
+}
+
+void RowFilter::addRange(int column, double minimum, double maximum, bool inclusive)
+{
+    Predicate p;
+    p.kind = Predicate::Kind::Range;
+    p.column = column;
+    p.minimum = minimum;
+    p.maximum = maximum;
+    p.inclusive = inclusive;
+    mPredicates.append(p);
+}
+
+void RowFilter::addNotBlank(int column)
+{
+    Predicate p;
+    p.kind = Predicate::Kind::NotBlank;
+    p.column = column;
+    mPredicates.append(p);
+}
+
+void RowFilter::clearPredicates()
+{
+    mPredicates.clear();
+}
+
+void RowFilter::setColumns(const QList<int> &columns)
+{
+    mColumns = columns;
+}
+
+QList<int> RowFilter::columns() const
+{
+    return mColumns;
+}
+
+bool RowFilter::isEmpty() const
+{
+    return mPredicates.isEmpty() && mColumns.isEmpty();
+}
+
+RowFilterMatcher::RowFilterMatcher(const RowFilter &filter, const SharedStrings *sharedStrings)
+    : m_any(filter.mCombination == RowFilter::Combination::Any)
+{
+    for (int column: filter.mColumns)
+        m_columns.insert(column);
+
+    for (const auto &p: filter.mPredicates) {
+        CompiledPredicate c;
+        c.kind = p.kind;
+        c.minimum = p.minimum;
+        c.maximum = p.maximum;
+        c.inclusive = p.inclusive;
+        for (const QVariant &value: p.values) {
+            switch (value.userType()) {
+                case QMetaType::QString: c.strings.insert(value.toString()); break;
+                case QMetaType::Bool: (value.toBool() ? c.matchesTrue : c.matchesFalse) = true; break;
+                default: {
+                    bool ok = false;
+                    const double number = value.toDouble(&ok);
+                    if (ok) c.numbers.insert(number + 0.0);
+                    else c.strings.insert(value.toString());
+                }
+            }
+        }
+        //compile the strings to the shared string indexes
+        if (!c.strings.isEmpty() && sharedStrings) {
+            for (int i = 0; i < sharedStrings->uniqueCount(); ++i) {
+                if (c.strings.contains(sharedStrings->getSharedString(i).toPlainString()))
+                    c.sharedStrings.insert(i);
+            }
+        }
+        m_columnPredicates[p.column].append(m_predicates.size());
+        m_predicates.append(c);
+    }
+    m_matched.resize(m_predicates.size());
+}
+
+bool RowFilterMatcher::isLoaded(int column) const
+{
+    return m_columns.isEmpty() || m_columns.contains(column);
+}
+
+bool RowFilterMatcher::isTested(int column) const
+{
+    return m_columnPredicates.contains(column);
+}
+
+void RowFilterMatcher::beginRow()
+{
+    m_matched.fill(false);
+}
+
+void RowFilterMatcher::testCell(int column, Cell::Type type, const QString &value, bool hasFormula,
+                                const RichString *inlineString)
+{
+    const auto it = m_columnPredicates.constFind(column);
+    if (it == m_columnPredicates.constEnd()) return;
+    for (int index: it.value()) {
+        if (test(m_predicates.at(index), type, value, hasFormula, inlineString))
+            m_matched[index] = true;
+    }
+}
+
+bool RowFilterMatcher::rowPasses() const
+{
+    if (m_predicates.isEmpty()) return true;
+    for (bool matched: m_matched) {
+        if (m_any && matched) return true;
+        if (!m_any && !matched) return false;
+    }
+    return !m_any;
+}
+
+bool RowFilterMatcher::test(const CompiledPredicate &predicate, Cell::Type type, const QString &value,
+                            bool hasFormula, const RichString *inlineString) const
+{
+    using Kind = RowFilter::Predicate::Kind;
+
+    switch (type) {
+        case Cell::Type::SharedString: {
+            if (predicate.kind == Kind::NotBlank) return true;
+            bool ok = false;
+            const int index = value.toInt(&ok);
+            return predicate.kind == Kind::InSet && ok && predicate.sharedStrings.contains(index);
+        }
+        case Cell::Type::InlineString:
+        case Cell::Type::Formula: { //a string result of a formula
+            const QString text = inlineString ? inlineString->toPlainString() : value;
+            if (predicate.kind == Kind::NotBlank) return !text.isEmpty() || hasFormula;
+            return predicate.kind == Kind::InSet && predicate.strings.contains(text);
+        }
+        case Cell::Type::Boolean:
+            if (predicate.kind == Kind::NotBlank) return !value.isEmpty() || hasFormula;
+            if (predicate.kind != Kind::InSet || value.isEmpty()) return false;
+            return (value == QLatin1String("1") || value == QLatin1String("true"))
+                    ? predicate.matchesTrue : predicate.matchesFalse;
+        case Cell::Type::Error:
+            return predicate.kind == Kind::NotBlank;
+        default: break;
+    }
+
+    //numeric cells
+    if (predicate.kind == Kind::NotBlank) return !value.isEmpty() || hasFormula;
+    bool ok = false;
+    const double number = value.toDouble(&ok);
+    if (!ok) return false;
+    if (predicate.kind == Kind::InSet)
+        return predicate.numbers.contains(number + 0.0);
+    if (predicate.inclusive)
+        return number >= predicate.minimum && number <= predicate.maximum;
+    return number > predicate.minimum && number < predicate.maximum;
+}
+
+}
@@ -0,0 +1,39 @@
+// xlsxsaveoptions.cpp
+
+#include "xlsxsaveoptions.h"
+
+namespace QXlsx {
+
+void SaveOptions::setCompression(Compression compression)
+{
+    mCompression = compression;
+}
+
+SaveOptions::Compression SaveOptions::compression() const
+{
+    return mCompression;
+}
+
+void SaveOptions::setPartCompression(const QString &partName, Compression compression)
+{
+    mPartCompression.insert(partName, compression);
+}
+
+SaveOptions::Compression SaveOptions::partCompression(const QString &partName) const
+{
+    auto it = mPartCompression.constFind(partName);
+    if (it != mPartCompression.constEnd())
+        return it.value();
+
+    //check folders, from the deepest one
+    int slash = partName.lastIndexOf(QLatin1Char('/'));
+    while (slash >= 0) {
+        it = mPartCompression.constFind(partName.left(slash + 1));
+        if (it != mPartCompression.constEnd())
+            return it.value();
+        slash = slash > 0 ? partName.lastIndexOf(QLatin1Char('/'), slash - 1) : -1;
+    }
+    return mCompression;
+}
+
+}
@@ -10,6 +10,7 @@
 
 #include "xlsxrichstring.h"
 #include "xlsxsharedstrings_p.h"
+#include "xlsxabstractooxmlfile_p.h"
 #include "xlsxutility_p.h"
 #include "xlsxformat_p.h"
 #include "xlsxcolor.h"
@@ -30,11 +31,46 @@ SharedStrings::SharedStrings(CreateFlag flag)
     m_stringCount = 0;
 }
 
+/*!
+ * \internal
+ * Returns a copy of the table. The string containers are implicitly shared,
+ * so the copy is cheap until either table is modified.
+ */
+SharedStrings *SharedStrings::clone() const
+{
+    auto copy = new SharedStrings(F_NewFromScratch);
+    *copy->d_ptr = *d_ptr;
+    copy->m_stringTable = m_stringTable;
+    copy->m_stringList = m_stringList;
+    copy->m_stringCount = m_stringCount;
+    return copy;
+}
+
+/*!
+ * \internal
+ * Returns true if this table is a clone of \a other (or vice versa) and
+ * neither of them was modified since.
+ */
+bool SharedStrings::isSharedWith(const SharedStrings &other) const
+{
+    return m_stringList.isSharedWith(other.m_stringList) && m_stringCount == other.m_stringCount;
+}
+
 int SharedStrings::count() const
 {
     return m_stringCount;
 }
 
+/*!
+ * \internal
+ * Returns the number of the distinct strings, the valid indexes of
+ * getSharedString(). Unlike count(), it includes the loaded strings.
+ */
+int SharedStrings::uniqueCount() const
+{
+    return m_stringList.size();
+}
+
 bool SharedStrings::isEmpty() const
 {
     return m_stringList.isEmpty();
@@ -61,6 +97,27 @@ int SharedStrings::addSharedString(const RichString &string)
     return index;
 }
 
+/*!
+ * \internal
+ * Adds the strings of \a other with their reference counts. The strings that
+ * this table does not have yet are appended in the order of \a other.
+ */
+void SharedStrings::merge(const SharedStrings &other)
+{
+    for (const auto &string : other.m_stringList) {
+        const int count = other.m_stringTable.value(string).count;
+        m_stringCount += count;
+
+        auto it = m_stringTable.find(string);
+        if (it != m_stringTable.end()) {
+            it->count += count;
+            continue;
+        }
+        m_stringTable[string] = XlsxSharedStringInfo(m_stringList.size(), count);
+        m_stringList.append(string);
+    }
+}
+
 void SharedStrings::incRefByStringIndex(int idx)
 {
     if (idx <0 || idx >= m_stringList.size()) {
@@ -11,6 +11,7 @@
 
 #include "xlsxglobal.h"
 #include "xlsxstyles_p.h"
+#include "xlsxabstractooxmlfile_p.h"
 #include "xlsxformat_p.h"
 #include "xlsxutility_p.h"
 #include "xlsxcolor.h"
@@ -71,6 +72,75 @@ Styles::~Styles()
 {
 }
 
+/*!
+ * \internal
+ * Returns a copy of the styles. The format containers are implicitly shared,
+ * so the copy is cheap until either object is modified.
+ */
+Styles *Styles::clone() const
+{
+    auto copy = new Styles(F_NewFromScratch);
+    *copy->d_ptr = *d_ptr;
+    copy->m_builtinNumFmtsHash = m_builtinNumFmtsHash;
+    copy->m_customNumFmtIdMap = m_customNumFmtIdMap;
+    copy->m_customNumFmtsHash = m_customNumFmtsHash;
+    copy->m_nextCustomNumFmtId = m_nextCustomNumFmtId;
+    copy->m_fontsList = m_fontsList;
+    copy->m_fillsList = m_fillsList;
+    copy->m_bordersList = m_bordersList;
+    copy->m_fontsHash = m_fontsHash;
+    copy->m_fillsHash = m_fillsHash;
+    copy->m_bordersHash = m_bordersHash;
+    copy->m_indexedColors = m_indexedColors;
+    copy->m_isIndexedColorsDefault = m_isIndexedColorsDefault;
+    copy->m_xf_formatsList = m_xf_formatsList;
+    copy->m_xf_formatsHash = m_xf_formatsHash;
+    copy->m_dxf_formatsList = m_dxf_formatsList;
+    copy->m_dxf_formatsHash = m_dxf_formatsHash;
+    copy->m_emptyFormatAdded = m_emptyFormatAdded;
+    return copy;
+}
+
+/*!
+ * \internal
+ * Returns true if these styles are a clone of \a other (or vice versa) and
+ * neither of them was modified since.
+ */
+bool Styles::isSharedWith(const Styles &other) const
+{
+    return m_xf_formatsList.isSharedWith(other.m_xf_formatsList)
+            && m_dxf_formatsList.isSharedWith(other.m_dxf_formatsList)
+            && m_fontsList.isSharedWith(other.m_fontsList)
+            && m_fillsList.isSharedWith(other.m_fillsList)
+            && m_bordersList.isSharedWith(other.m_bordersList)
+            && m_customNumFmtIdMap.isSharedWith(other.m_customNumFmtIdMap)
+            && m_indexedColors.isSharedWith(other.m_indexedColors)
+            && m_isIndexedColorsDefault == other.m_isIndexedColorsDefault;
+}
+
+/*!
+ * \internal
+ * Returns a copy of \a format without the font, fill, border and xf indexes of
+ * the styles it was added to, so it can be added to the styles of another
+ * workbook. The id of a custom number format is dropped as well; fixNumFmt()
+ * finds or assigns one by the format code.
+ */
+Format Styles::unregisteredFormat(const Format &format)
+{
+    if (!format.isValid())
+        return format;
+
+    Format result;
+    result.d = new FormatPrivate;
+    result.d->properties = format.d->properties;
+    result.d->theme = format.d->theme;
+    auto it = result.d->properties.find(FormatPrivate::P_NumFmt_Id);
+    if (it != result.d->properties.end() && it.value().toInt() >= 164
+        && result.d->properties.contains(FormatPrivate::P_NumFmt_FormatCode))
+        result.d->properties.erase(it);
+    return result;
+}
+
 Format Styles::xfFormat(int idx) const
 {
     if (idx <0 || idx >= m_xf_formatsList.size())
@@ -0,0 +1,149 @@
+// xlsxtemplate.cpp
+
+#include <QBuffer>
+
+#include "xlsxtemplate.h"
+#include "xlsxtemplate_p.h"
+#include "xlsxworkbook.h"
+#include "xlsxworkbook_p.h"
+#include "xlsxworksheet.h"
+#include "xlsxworksheet_p.h"
+#include "xlsxsharedstrings_p.h"
+#include "xlsxstyles_p.h"
+#include "xlsxtheme_p.h"
+#include "xlsxmediafile_p.h"
+
+namespace QXlsx {
+
+namespace {
+QByteArray worksheetLayout(const Worksheet *sheet)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    sheet->saveToXmlFile(&buffer, false);
+    return data;
+}
+}
+
+/*!
+ * \internal
+ * Serializes and compresses the template parts. The part names must match the
+ * ones DocumentPrivate::savePackage() uses.
+ */
+void TemplatePrivate::init()
+{
+    Workbook *book = document->workbook();
+
+    const auto sheets = book->getSheetsByType(AbstractSheet::Type::Worksheet);
+    for (int i = 0; i < sheets.size(); ++i) {
+        const auto sheet = static_cast<const Worksheet *>(sheets[i].data());
+        const QString path = QStringLiteral("xl/worksheets/sheet%1.xml").arg(i+1);
+
+        WorksheetPart part;
+        part.sheet = sheet;
+        part.layout = worksheetLayout(sheet);
+        part.data = ZipWriter::compress(sheet->saveToXmlData(), options.partCompression(path));
+        worksheets.insert(sheet->d_func()->id, part);
+    }
+
+    sharedStringsSource = book->sharedStrings();
+    sharedStrings = ZipWriter::compress(sharedStringsSource->saveToXmlData(),
+                                        options.partCompression(QStringLiteral("xl/sharedStrings.xml")));
+    stylesSource = book->styles();
+    styles = ZipWriter::compress(stylesSource->saveToXmlData(),
+                                 options.partCompression(QStringLiteral("xl/styles.xml")));
+    themeSource = book->theme();
+    theme = ZipWriter::compress(themeSource->saveToXmlData(),
+                                options.partCompression(QStringLiteral("xl/theme/theme1.xml")));
+
+    const auto mediaFiles = book->mediaFiles();
+    for (int i = 0; i < mediaFiles.size(); ++i) {
+        if (auto mf = mediaFiles[i].lock()) {
+            const QString path = QStringLiteral("xl/media/image%1.%2").arg(i+1).arg(mf->suffix());
+            media.insert(mf.data(), {mf->hashKey(), ZipWriter::compress(mf->contents(), options.partCompression(path))});
+        }
+    }
+}
+
+const ZipWriter::CompressedData *TemplatePrivate::worksheetPart(const Worksheet *sheet, SaveOptions::Compression compression) const
+{
+    auto it = worksheets.constFind(sheet->d_func()->id);
+    if (it == worksheets.constEnd() || it->data.compression != compression)
+        return nullptr;
+    if (!sheet->d_func()->sharesSheetDataWith(*it->sheet->d_func()))
+        return nullptr;
+    //the cells are intact, now check the rest of the sheet
+    if (worksheetLayout(sheet) != it->layout)
+        return nullptr;
+    return &it->data;
+}
+
+const ZipWriter::CompressedData *TemplatePrivate::sharedStringsPart(const SharedStrings *sharedStrings, SaveOptions::Compression compression) const
+{
+    if (this->sharedStrings.compression != compression || !sharedStrings->isSharedWith(*sharedStringsSource))
+        return nullptr;
+    return &this->sharedStrings;
+}
+
+const ZipWriter::CompressedData *TemplatePrivate::stylesPart(const Styles *styles, SaveOptions::Compression compression) const
+{
+    if (this->styles.compression != compression || !styles->isSharedWith(*stylesSource))
+        return nullptr;
+    return &this->styles;
+}
+
+const ZipWriter::CompressedData *TemplatePrivate::themePart(const Theme *theme, SaveOptions::Compression compression) const
+{
+    //the theme is not modified after loading, so the instances share it
+    if (this->theme.compression != compression || theme != themeSource)
+        return nullptr;
+    return &this->theme;
+}
+
+const ZipWriter::CompressedData *TemplatePrivate::mediaPart(const MediaFile *media, SaveOptions::Compression compression) const
+{
+    auto it = this->media.constFind(media);
+    if (it == this->media.constEnd() || it->data.compression != compression || it->hashKey != media->hashKey())
+        return nullptr;
+    return &it->data;
+}
+
+Template::Template(const QString &fileName, const SaveOptions &options)
+    : d(new TemplatePrivate)
+{
+    d->options = options;
+    d->document.reset(new Document(fileName));
+    if (d->document->isLoaded())
+        d->init();
+}
+
+Template::Template(QIODevice *device, const SaveOptions &options)
+    : d(new TemplatePrivate)
+{
+    d->options = options;
+    d->document.reset(new Document(device));
+    if (d->document->isLoaded())
+        d->init();
+}
+
+Template::Template(const Template &other) : d(other.d)
+{
+}
+
+Template &Template::operator=(const Template &other)
+{
+    d = other.d;
+    return *this;
+}
+
+Template::~Template()
+{
+}
+
+bool Template::isValid() const
+{
+    return d->document->isLoaded();
+}
+
+}
@@ -10,6 +10,8 @@
 
 #include "xlsxchart.h"
 #include "xlsxchartsheet.h"
+#include "xlsxformulacache_p.h"
+#include "xlsxformulaengine_p.h"
 #include "xlsxmediafile_p.h"
 #include "xlsxsharedstrings_p.h"
 #include "xlsxstyles_p.h"
@@ -17,6 +19,7 @@
 #include "xlsxworkbook.h"
 #include "xlsxworkbook_p.h"
 #include "xlsxworksheet.h"
+#include "xlsxworksheet_p.h"
 
 namespace QXlsx {
 
@@ -26,6 +29,7 @@ WorkbookPrivate::WorkbookPrivate(Workbook *q, Workbook::CreateFlag flag)
     sharedStrings = QSharedPointer<SharedStrings>(new SharedStrings(flag));
     styles = QSharedPointer<Styles>(new Styles(flag));
     theme = QSharedPointer<Theme>(new Theme(flag));
+    formulaCache = std::make_shared<FormulaCache>();
 
     defaultDateFormat = QStringLiteral("yyyy-mm-dd");
     table_count = 0;
@@ -93,6 +97,10 @@ void Workbook::setDate1904(bool date1904)
 {
     Q_D(Workbook);
     d->date1904 = date1904;
+    //the cells read the date system through the owners of their sheets
+    const auto sheets = worksheets();
+    for (Worksheet *sheet : sheets)
+        sheet->d_func()->cellOwner->date1904 = date1904;
 }
 
 void Workbook::setStringsToNumbersEnabled(bool enable)
@@ -131,6 +139,65 @@ bool Workbook::isHtmlToRichStringEnabled() const
     return d->html_to_richstring_enabled;
 }
 
+void Workbook::setSharedFormulasEnabled(bool enable)
+{
+    Q_D(Workbook);
+    d->shared_formulas_enabled = enable;
+}
+
+bool Workbook::isSharedFormulasEnabled() const
+{
+    Q_D(const Workbook);
+    return d->shared_formulas_enabled;
+}
+
+bool Workbook::isConcurrentWritingEnabled() const
+{
+    Q_D(const Workbook);
+    return d->concurrent_writing_enabled;
+}
+
+void Workbook::setConcurrentWritingEnabled(bool enable)
+{
+    Q_D(Workbook);
+    if (!enable)
+        mergeConcurrentWrites();
+    d->concurrent_writing_enabled = enable;
+}
+
+void Workbook::mergeConcurrentWrites()
+{
+    Q_D(Workbook);
+    for (const auto &sheet : qAsConst(d->sheets)) {
+        if (sheet->type() == AbstractSheet::Type::Worksheet)
+            static_cast<Worksheet *>(sheet.data())->d_func()->mergeWriterRegistries();
+    }
+}
+
+bool Workbook::recalculate(int threads)
+{
+    Q_D(Workbook);
+    if (!d->formulaEngine)
+        d->formulaEngine = std::make_shared<FormulaEngine>(this);
+    return d->formulaEngine->recalculate(threads);
+}
+
+QVariant Workbook::evaluateFormula(const QString &formula, const QString &sheetName)
+{
+    Q_D(Workbook);
+    const Worksheet *worksheet = activeWorksheet();
+    if (!sheetName.isEmpty()) {
+        AbstractSheet *st = sheet(sheetName);
+        worksheet = st && st->type() == AbstractSheet::Type::Worksheet ? static_cast<Worksheet *>(st) : nullptr;
+    }
+    if (!worksheet)
+        return QVariant();
+
+    if (!d->formulaEngine)
+        d->formulaEngine = std::make_shared<FormulaEngine>(this);
+    return d->formulaEngine->evaluateFormula(formula, worksheet).toVariant();
+}
+
 QString Workbook::defaultDateFormat() const
 {
     Q_D(const Workbook);
@@ -517,8 +584,9 @@ AbstractSheet *Workbook::activeSheet() const
     Q_D(const Workbook);
     if (d->sheets.isEmpty())
         const_cast<Workbook *>(this)->addSheet();
-    if (d->views.isEmpty()) d->views << WorkbookView{};
-    return d->sheets[d->views.last().activeTab.value_or(0)].data();
+    //do not add a default view here: const access must not modify the workbook
+    const int index = d->views.isEmpty() ? 0 : d->views.last().activeTab.value_or(0);
+    return d->sheets[index].data();
 }
 Worksheet *Workbook::activeWorksheet() const
 {
@@ -629,6 +697,69 @@ bool Workbook::copySheet(int index, const QString &newName)
     return true; // #162
 }
 
+Worksheet *Workbook::importSheet(const Worksheet &sheet, const QString &name)
+{
+    Q_D(Workbook);
+    QString sheetName = createSafeSheetName(name);
+    if (!sheetName.isEmpty()) {
+        if (this->sheet(sheetName))
+            return nullptr;
+    }
+    else {
+        sheetName = sheet.name();
+        int copy_index = 1;
+        while (this->sheet(sheetName))
+            sheetName = QStringLiteral("%1(%2)").arg(sheet.name()).arg(++copy_index);
+    }
+
+    ++d->lastSheetId;
+    const bool sameBook = sheet.d_func()->workbook == this;
+    //the snapshot shares the sheet data with the source until they are imported
+    Worksheet *imported = sameBook ? sheet.copy(sheetName, d->lastSheetId) : sheet.snapshot(this);
+    if (!sameBook) {
+        WorksheetPrivate *imported_d = imported->d_func();
+        imported_d->name = sheetName;
+        imported_d->id = d->lastSheetId;
+        imported_d->filePathInPackage.clear();
+        imported_d->sheetProperties.codeName.clear();
+        imported_d->importData();
+    }
+    d->sheets.append(QSharedPointer<AbstractSheet>(imported));
+    return imported;
+}
+
+/*!
+ * \internal
+ * Creates a snapshot of the workbook: an independent workbook that shares the
+ * sheet data, shared strings and styles with this one until either of them
+ * is modified. The cost is proportional to the number of sheets and drawing
+ * anchors, not to the number of cells.
+ */
+Workbook *Workbook::snapshot() const
+{
+    Q_D(const Workbook);
+    auto book = new Workbook(d->flag);
+    WorkbookPrivate *book_d = book->d_func();
+
+    //The workbook properties are values or implicitly shared containers.
+    //The parts owned by the workbook are replaced below.
+    *book_d = *d;
+    book_d->progress = nullptr;
+    book_d->formulaEngine.reset();
+    book_d->referenceIndex.reset();
+    book_d->sharedStrings = QSharedPointer<SharedStrings>(d->sharedStrings->clone());
+    book_d->styles = QSharedPointer<Styles>(d->styles->clone());
+    //the theme and external links are not modified after loading, so they are shared
+
+    //charts are registered again while the sheet drawings are copied
+    book_d->chartFiles.clear();
+    book_d->sheets.clear();
+    for (const auto &sheet : qAsConst(d->sheets))
+        book_d->sheets.append(QSharedPointer<AbstractSheet>(sheet->snapshot(book)));
+
+    return book;
+}
+
 int Workbook::sheetsCount() const
 {
     Q_D(const Workbook);
@@ -771,7 +902,8 @@ void Workbook::saveToXmlFile(QIODevice *device) const
     d->protection.write(writer);
     // 5. bookViews
     writer.writeStartElement(QStringLiteral("bookViews"));
-    if (d->views.isEmpty()) d->views << WorkbookView{};
+    if (d->views.isEmpty())
+        WorkbookView{}.write(writer);
     for (const auto &view: qAsConst(d->views))
         view.write(writer);
     writer.writeEndElement(); //bookViews
@@ -978,6 +1110,8 @@ bool Workbook::loadFromXmlFile(QIODevice *device)
                 d->protection.read(reader);
             else if (reader.name() == QLatin1String("workbookPr")) {
                 parseAttributeBool(attributes, QLatin1String("date1904"), d->date1904);
+                if (d->date1904.has_value())
+                    setDate1904(d->date1904.value());
                 if (attributes.hasAttribute(QLatin1String("showObjects"))) {
                     ShowObjects so;
                     fromString(attributes.value(QLatin1String("showObjects")).toString(), so);
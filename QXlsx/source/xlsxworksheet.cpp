@@ -17,14 +17,23 @@
 #include <QMapIterator>
 #include <QMap>
 #include <QFontMetricsF>
+#include <QtNumeric>
+#include <QThread>
+#include <QThreadPool>
+#include <QMutex>
 
 #include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <vector>
 
 #include "xlsxrichstring.h"
 #include "xlsxcellreference.h"
 #include "xlsxworksheet.h"
 #include "xlsxworksheet_p.h"
 #include "xlsxworkbook.h"
+#include "xlsxworkbook_p.h"
+#include "xlsxprogresscontrol_p.h"
 #include "xlsxformat.h"
 #include "xlsxutility_p.h"
 #include "xlsxsharedstrings_p.h"
@@ -34,14 +43,17 @@
 #include "xlsxcellrange.h"
 #include "xlsxconditionalformatting_p.h"
 #include "xlsxdrawinganchor_p.h"
+#include "xlsxmediafile_p.h"
 #include "xlsxchart.h"
 #include "xlsxcellformula.h"
 #include "xlsxmain.h"
+#include "xlsxrowfilter_p.h"
+#include "xlsxreferenceindex_p.h"
 
 namespace QXlsx {
 
 WorksheetPrivate::WorksheetPrivate(Worksheet *p, Worksheet::CreateFlag flag) : AbstractSheetPrivate(p, flag)
-
+    , cellOwner(std::make_shared<CellOwner>())
 {
 }
 
@@ -150,6 +162,8 @@ Worksheet::Worksheet(const QString &name, int id, Workbook *workbook, CreateFlag
 {
     if (!workbook) //For unit test propose only. Ignore the memery leak.
         d_func()->workbook = new Workbook(flag);
+    d_func()->cellOwner->date1904 = d_func()->workbook->date1904().value_or(false);
+    d_func()->cellOwner->sheet = this;
 }
 
 /*!
@@ -161,57 +175,67 @@ Worksheet::Worksheet(const QString &name, int id, Workbook *workbook, CreateFlag
 Worksheet *Worksheet::copy(const QString &distName, int distId) const
 {
     Q_D(const Worksheet);
-    Worksheet *sheet = new Worksheet(distName, distId, d->workbook, F_NewFromScratch);
+    //the copy shares the sheet data with this sheet until either is modified
+    Worksheet *sheet = snapshot(d->workbook);
+    WorksheetPrivate *sheet_d = sheet->d_func();
+
+    sheet_d->name = distName;
+    sheet_d->id = distId;
+    sheet_d->filePathInPackage.clear();
+    sheet_d->sheetProperties.codeName.clear();
+
+    return sheet;
+}
+
+/*!
+ * \internal
+ *
+ * Make a snapshot of this sheet in \a workbook.
+ */
+Worksheet *Worksheet::snapshot(Workbook *workbook) const
+{
+    Q_D(const Worksheet);
+    Worksheet *sheet = new Worksheet(d->name, d->id, workbook, F_NewFromScratch);
     WorksheetPrivate *sheet_d = sheet->d_func();
 
-    sheet_d->dimension = d->dimension;
+    //All the sheet data are values or implicitly shared containers, so the
+    //assignment does not copy cells. Cells and row infos are detached on write.
+    //The shared cells keep the owner of this sheet.
+    const std::shared_ptr<CellOwner> owner = sheet_d->cellOwner;
+    *sheet_d = *d;
+    sheet_d->workbook = workbook;
+    sheet_d->cellOwner = owner;
+    sheet_d->drawing.reset();
     if (d->drawing) {
         sheet_d->drawing = std::make_shared<Drawing>(sheet, F_NewFromScratch);
         for (auto anchor: qAsConst(d->drawing->anchors)) {
             anchor->copyTo(sheet_d->drawing.get());
         }
     }
-    sheet_d->sheetState = d->sheetState;
-    sheet_d->type = d->type;
-    sheet_d->headerFooter = d->headerFooter;
-    sheet_d->pageMargins = d->pageMargins;
-    sheet_d->pageSetup = d->pageSetup;
-    sheet_d->pictureFile = d->pictureFile;
-    sheet_d->sheetProtection = d->sheetProtection;
-
-    QMapIterator<int, QMap<int, std::shared_ptr<Cell> > > it(d->cellTable);
-    while (it.hasNext())
-    {
-        it.next();
-        int row = it.key();
-        QMapIterator<int, std::shared_ptr<Cell> > it2(it.value());
-        while (it2.hasNext())
-        {
-            it2.next();
-            int col = it2.key();
-
-            auto cell = std::make_shared<Cell>(it2.value().get(), sheet);
-//            cell->d_ptr->parent = sheet;
-
-//            if (cell->type() == Cell::Type::SharedString)
-//                d->workbook->sharedStrings()->addSharedString(cell->d_ptr->richString);
-
-            sheet_d->cellTable[row][col] = cell;
-        }
-    }
-
-    sheet_d->merges = d->merges;
-    sheet_d->rowsInfo = d->rowsInfo;
-    sheet_d->colsInfo = d->colsInfo;
-    sheet_d->dataValidationsList = d->dataValidationsList;
-    sheet_d->conditionalFormattingList = d->conditionalFormattingList;
-    sheet_d->sheetViews = d->sheetViews;
+    d->rowsInfoShared.storeRelease(1);
+    sheet_d->rowsInfoShared.storeRelease(1);
+    //the registries of the concurrent writer belong to this sheet only
+    sheet_d->writerStrings.reset();
+    sheet_d->writerFormats.clear();
+    sheet_d->writerFormatKeys.clear();
+    //the changes are tracked by the formula engine of the target workbook
+    sheet_d->trackChanges = false;
+    sheet_d->changesOverflow = false;
+    sheet_d->changedCells.clear();
+    sheet_d->trackReferences = false;
+    sheet_d->referencesOverflow = false;
+    sheet_d->referenceChanges.clear();
+    //the indexes of this sheet do not watch the snapshot
+    sheet_d->rangeWatches.clear();
 
     return sheet;
 }
 
 Worksheet::~Worksheet()
 {
+    //the cells shared with the copies and snapshots are not modified here: a
+    //snapshot may be being saved in another thread. They keep the owner.
+    d_func()->cellOwner->sheet = nullptr;
 }
 
 std::optional<bool> Worksheet::isWindowProtected(int viewIndex) const
@@ -860,21 +884,22 @@ bool Worksheet::setFormat(int row, int column, const Format &format)
     if (!d->addColumnToDimensions(column)) return false;
 
     Format fmt = format.isValid() ? format : d->cellFormat(row, column);
-    d->workbook->styles()->addXfFormat(fmt);
-    if (!d->cellTable[row][column])
-        d->cellTable[row][column] = std::make_shared<Cell>(QVariant{}, Cell::Type::Number, fmt, this);
+    d->registerFormat(fmt);
+    if (Cell *c = d->detachedCell(row, column))
+        c->assignFormat(fmt);
     else
-        d->cellTable[row][column]->setFormat(fmt);
+        d->setCell(row, column, std::make_shared<Cell>(QVariant{}, Cell::Type::Number, fmt, this));
     return true;
 }
 
 bool Worksheet::clearFormat(const CellRange &range)
 {
+    Q_D(Worksheet);
     bool applied = false;
     for (int row = range.firstRow(); row <= range.lastRow(); ++row) {
         for (int col = range.firstColumn(); col <= range.lastColumn(); ++col) {
-            if (auto c = cell(row, col)) {
-                c->setFormat({});
+            if (auto c = d->detachedCell(row, col)) {
+                c->assignFormat({});
                 applied = true;
             }
         }
@@ -884,8 +909,9 @@ bool Worksheet::clearFormat(const CellRange &range)
 
 bool Worksheet::clearFormat(int row, int column)
 {
-    if (auto c = cell(row, column)) {
-        c->setFormat({});
+    Q_D(Worksheet);
+    if (auto c = d->detachedCell(row, column)) {
+        c->assignFormat({});
         return true;
     }
     return false;
@@ -928,35 +954,442 @@ QVariant Worksheet::read(int row, int column) const
 {
     Q_D(const Worksheet);
 
-    Cell *c = cell(row, column);
+    const Cell *c = cell(row, column);
     if (!c)
         return QVariant();
 
     if (c->hasFormula()) {
         auto fType = c->formula().type().value_or(CellFormula::Type::Normal);
-        if (fType == CellFormula::Type::Normal)
-            return QVariant(QLatin1String("=")+c->formula().text());
+        if (fType == CellFormula::Type::Normal || fType == CellFormula::Type::Shared)
+            return QVariant(QLatin1String("=")+d->formulaText(row, column, c));
+    }
+
+    //the cell may be shared with another sheet, so use this sheet's date system
+    if (c->isDateTime())
+        return datetimeFromNumber(c->value().toDouble(), d->workbook->date1904().value_or(false));
+
+    return c->value();
+}
+
+/*!
+ * \internal
+ * Returns the formula text of \a cell at (\a row, \a column) without the leading '='.
+ * The text of a shared formula is produced from the template of the master cell,
+ * so the master formula is tokenized once for the whole group.
+ */
+QString WorksheetPrivate::formulaText(int row, int column, const Cell *cell) const
+{
+    const CellFormula formula = cell->formula();
+    if (formula.type().value_or(CellFormula::Type::Normal) != CellFormula::Type::Shared
+        || !formula.text().isEmpty())
+        return formula.text();
+
+    return formulaTemplate(row, column, cell)->toA1(row, column);
+}
+
+/*!
+ * \internal
+ * Returns the compiled formula of \a cell at (\a row, \a column). The cells of
+ * a shared formula get the template of the master cell.
+ */
+FormulaTemplatePtr WorksheetPrivate::formulaTemplate(int row, int column, const Cell *cell) const
+{
+    FormulaCache *cache = workbook->d_func()->formulaCache.get();
+    const CellFormula formula = cell->formula();
+    if (formula.type().value_or(CellFormula::Type::Normal) != CellFormula::Type::Shared
+        || !formula.text().isEmpty())
+        return cache->compile(formula.text(), row, column);
+
+    const CellFormula rootFormula = sharedFormulaMap.value(formula.sharedIndex().value_or(-1));
+    const CellReference root = rootFormula.reference().topLeft();
+    return cache->compile(rootFormula.text(), root.row(), root.column());
+}
+
+/*!
+ * \internal
+ * Calls \a visit(rowOffset, columnOffset, cell) for each existing cell of \a range
+ * in the row-major order. Only the stored cells are visited, so sparse ranges are cheap.
+ */
+template <typename Visit>
+void WorksheetPrivate::forEachCell(const CellRange &range, Visit visit) const
+{
+    const auto rowEnd = cellTable.upperBound(range.lastRow());
+    for (auto rowIt = cellTable.lowerBound(range.firstRow()); rowIt != rowEnd; ++rowIt) {
+        const auto &rowCells = rowIt.value();
+        const auto cellEnd = rowCells.upperBound(range.lastColumn());
+        for (auto it = rowCells.lowerBound(range.firstColumn()); it != cellEnd; ++it)
+            visit(rowIt.key() - range.firstRow(), it.key() - range.firstColumn(), it.value().get());
+    }
+}
+
+static bool isReadableRange(const CellRange &range)
+{
+    return range.isValid() && range.firstRow() > 0 && range.firstColumn() > 0;
+}
+
+int Worksheet::readNumbers(const CellRange &range, double *values, quint8 *validity) const
+{
+    Q_D(const Worksheet);
+    if (!isReadableRange(range) || !values)
+        return -1;
+
+    const qsizetype columns = range.columnCount();
+    const qsizetype size = range.rowCount() * columns;
+    std::fill_n(values, size, qQNaN());
+    if (validity)
+        std::fill_n(validity, size, quint8(0));
+
+    int count = 0;
+    d->forEachCell(range, [&](int row, int column, const Cell *cell) {
+        const qsizetype i = row * columns + column;
+        double number;
+        if (cell->toNumber(number)) {
+            values[i] = number;
+            if (validity)
+                validity[i] = 1;
+            ++count;
+        }
+    });
+    return count;
+}
+
+int Worksheet::readStrings(const CellRange &range, QStringList &values) const
+{
+    Q_D(const Worksheet);
+    values.clear();
+    if (!isReadableRange(range))
+        return -1;
 
-        if (fType == CellFormula::Type::Shared) {
-            if (!c->formula().text().isEmpty())
-                return QVariant(QLatin1String("=")+c->formula().text());
+    const qsizetype columns = range.columnCount();
+    const qsizetype size = range.rowCount() * columns;
+    values.reserve(size);
+    for (qsizetype i = 0; i < size; ++i)
+        values.append(QString());
 
-            int si = c->formula().sharedIndex().value_or(-1);
-            const CellFormula &rootFormula = d->sharedFormulaMap[ si ];
-            CellReference rootCellRef = rootFormula.reference().topLeft();
-            QString rootFormulaText = rootFormula.text();
-            QString newFormulaText = convertSharedFormula(rootFormulaText, rootCellRef, CellReference(row, column));
-            return QVariant(QLatin1String("=")+newFormulaText);
+    int count = 0;
+    d->forEachCell(range, [&](int row, int column, const Cell *cell) {
+        QString text = cell->toText();
+        if (!text.isNull()) {
+            values[row * columns + column] = text;
+            ++count;
         }
+    });
+    return count;
+}
+
+QVector<NumericColumn> Worksheet::readNumericColumns(const CellRange &range) const
+{
+    Q_D(const Worksheet);
+    if (!isReadableRange(range))
+        return {};
+
+    const int rows = range.rowCount();
+    QVector<NumericColumn> result(range.columnCount());
+    for (int c = 0; c < result.size(); ++c) {
+        result[c].column = range.firstColumn() + c;
+        result[c].values.fill(qQNaN(), rows);
+        result[c].validity.resize(rows);
     }
 
-    if (c->isDateTime())
-        return c->dateTime();
+    d->forEachCell(range, [&result](int row, int column, const Cell *cell) {
+        double number;
+        if (cell->toNumber(number)) {
+            auto &col = result[column];
+            col.values[row] = number;
+            col.validity.setBit(row);
+        }
+    });
+    return result;
+}
 
-    return c->value();
+QVector<StringColumn> Worksheet::readStringColumns(const CellRange &range) const
+{
+    Q_D(const Worksheet);
+    if (!isReadableRange(range))
+        return {};
+
+    const int rows = range.rowCount();
+    QVector<StringColumn> result(range.columnCount());
+    for (int c = 0; c < result.size(); ++c) {
+        result[c].column = range.firstColumn() + c;
+        result[c].values.resize(rows);
+        result[c].validity.resize(rows);
+    }
+
+    d->forEachCell(range, [&result](int row, int column, const Cell *cell) {
+        QString text = cell->toText();
+        if (!text.isNull()) {
+            auto &col = result[column];
+            col.values[row] = text;
+            col.validity.setBit(row);
+        }
+    });
+    return result;
+}
+
+namespace {
+
+/*!
+ * \internal
+ * Accumulates numbers for Worksheet::aggregate(). The numbers are collected into a
+ * dense buffer, and each full buffer is reduced by branch-free loops that keep
+ * Lanes independent partial results, combined at the end of the buffer. Without
+ * them each addition would wait for the previous one, and the compiler may not
+ * reorder floating point additions to vectorize the loop. The buffer results
+ * are combined with the pairwise update of Chan et al., which keeps the
+ * variance accurate for large counts.
+ */
+class NumberAccumulator
+{
+public:
+    explicit NumberAccumulator(Worksheet::Aggregates aggregates) : m_aggregates(aggregates) {}
+
+    void add(double value)
+    {
+        if (m_buffer.empty())
+            m_buffer.reserve(ChunkSize);
+        m_buffer.push_back(value);
+        if (m_buffer.size() == ChunkSize)
+            flush();
+    }
+    void addError() { ++m_errorCount; }
+
+    RangeStatistics result(int column)
+    {
+        flush();
+        RangeStatistics stats;
+        stats.column = column;
+        stats.count = m_count;
+        stats.errorCount = m_errorCount;
+        if (m_aggregates.testFlag(Worksheet::Sum)) stats.sum = m_sum;
+        if (m_count == 0) return stats;
+        if (m_aggregates.testFlag(Worksheet::Min)) stats.min = m_min;
+        if (m_aggregates.testFlag(Worksheet::Max)) stats.max = m_max;
+        //as in Excel's AVERAGE, the mean is SUM / COUNT
+        if (m_aggregates.testFlag(Worksheet::Mean)) stats.mean = m_sum / m_count;
+        if (m_aggregates.testFlag(Worksheet::StdDev) && m_count > 1)
+            stats.stdDev = std::sqrt(m_m2 / (m_count - 1));
+        return stats;
+    }
+
+private:
+    void flush()
+    {
+        const qsizetype n = qsizetype(m_buffer.size());
+        if (n == 0) return;
+        const double *v = m_buffer.data();
+
+        //the numbers that fill whole groups of lanes
+        const qsizetype whole = n - n % Lanes;
+
+        double sums[Lanes] = {};
+        for (qsizetype i = 0; i < whole; i += Lanes) {
+            for (qsizetype lane = 0; lane < Lanes; ++lane)
+                sums[lane] += v[i + lane];
+        }
+        double sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+        for (qsizetype i = whole; i < n; ++i)
+            sum += v[i];
+
+        double min = v[0];
+        double max = v[0];
+        if (m_aggregates.testFlag(Worksheet::Min) || m_aggregates.testFlag(Worksheet::Max)) {
+            double mins[Lanes] = {v[0], v[0], v[0], v[0]};
+            double maxs[Lanes] = {v[0], v[0], v[0], v[0]};
+            for (qsizetype i = 0; i < whole; i += Lanes) {
+                for (qsizetype lane = 0; lane < Lanes; ++lane) {
+                    mins[lane] = v[i + lane] < mins[lane] ? v[i + lane] : mins[lane];
+                    maxs[lane] = v[i + lane] > maxs[lane] ? v[i + lane] : maxs[lane];
+                }
+            }
+            for (qsizetype i = whole; i < n; ++i) {
+                min = v[i] < min ? v[i] : min;
+                max = v[i] > max ? v[i] : max;
+            }
+            for (qsizetype lane = 0; lane < Lanes; ++lane) {
+                min = std::min(min, mins[lane]);
+                max = std::max(max, maxs[lane]);
+            }
+        }
+
+        const double mean = sum / n;
+        double m2 = 0.0;
+        if (m_aggregates.testFlag(Worksheet::StdDev)) {
+            double m2s[Lanes] = {};
+            for (qsizetype i = 0; i < whole; i += Lanes) {
+                for (qsizetype lane = 0; lane < Lanes; ++lane) {
+                    const double d = v[i + lane] - mean;
+                    m2s[lane] += d * d;
+                }
+            }
+            m2 = (m2s[0] + m2s[1]) + (m2s[2] + m2s[3]);
+            for (qsizetype i = whole; i < n; ++i) {
+                const double d = v[i] - mean;
+                m2 += d * d;
+            }
+        }
+
+        if (m_count == 0) {
+            m_min = min;
+            m_max = max;
+            m_mean = mean;
+            m_m2 = m2;
+        }
+        else {
+            const double total = double(m_count + n);
+            const double delta = mean - m_mean;
+            m_m2 += m2 + delta * delta * (double(m_count) * n / total);
+            m_mean += delta * n / total;
+            m_min = std::min(m_min, min);
+            m_max = std::max(m_max, max);
+        }
+        m_sum += sum;
+        m_count += n;
+        m_buffer.clear();
+    }
+
+    static constexpr size_t ChunkSize = 1024;
+    static constexpr qsizetype Lanes = 4; //the combining code above assumes 4
+    Worksheet::Aggregates m_aggregates;
+    std::vector<double> m_buffer;
+    qint64 m_count = 0;
+    qint64 m_errorCount = 0;
+    double m_sum = 0.0;
+    double m_min = 0.0;
+    double m_max = 0.0;
+    double m_mean = 0.0;
+    double m_m2 = 0.0;
+};
+
+}
+
+RangeStatistics Worksheet::aggregate(const CellRange &range, Aggregates aggregates) const
+{
+    Q_D(const Worksheet);
+    if (!isReadableRange(range))
+        return {};
+
+    NumberAccumulator accumulator(aggregates);
+    d->forEachCell(range, [&accumulator](int, int, const Cell *cell) {
+        double number;
+        if (cell->toNumber(number))
+            accumulator.add(number);
+        else if (cell->type() == Cell::Type::Error)
+            accumulator.addError();
+    });
+    return accumulator.result(0);
+}
+
+QVector<RangeStatistics> Worksheet::columnStatistics(const CellRange &range, Aggregates aggregates) const
+{
+    Q_D(const Worksheet);
+    if (!isReadableRange(range))
+        return {};
+
+    std::vector<NumberAccumulator> accumulators(range.columnCount(), NumberAccumulator(aggregates));
+    d->forEachCell(range, [&accumulators](int, int column, const Cell *cell) {
+        double number;
+        if (cell->toNumber(number))
+            accumulators[column].add(number);
+        else if (cell->type() == Cell::Type::Error)
+            accumulators[column].addError();
+    });
+
+    QVector<RangeStatistics> result;
+    result.reserve(range.columnCount());
+    for (int c = 0; c < range.columnCount(); ++c)
+        result.append(accumulators[c].result(range.firstColumn() + c));
+    return result;
+}
+
+CellIndex Worksheet::buildIndex(const CellRange &keyColumnRange) const
+{
+    if (!isReadableRange(keyColumnRange))
+        return CellIndex();
+    return CellIndex(this, keyColumnRange);
+}
+
+IteratorRange<RowIterator> Worksheet::rows() const
+{
+    return rows(CellRange(1, 1, XLSX_ROW_MAX, XLSX_COLUMN_MAX));
+}
+
+IteratorRange<RowIterator> Worksheet::rows(const CellRange &range) const
+{
+    Q_D(const Worksheet);
+    if (!isReadableRange(range))
+        return {RowIterator(), RowIterator()};
+
+    const auto begin = d->cellTable.lowerBound(range.firstRow());
+    const auto end = d->cellTable.upperBound(range.lastRow());
+    return {RowIterator(begin, end, range.firstColumn(), range.lastColumn()),
+            RowIterator(end, end, range.firstColumn(), range.lastColumn())};
+}
+
+bool Worksheet::parallelForEachRowBlock(const CellRange &range, const std::function<void (const RowBlock &)> &kernel,
+                                        int threads) const
+{
+    return runRowBlocks(range, threads, nullptr, kernel);
+}
+
+/*!
+ * \internal
+ * Splits the stored rows of \a range into blocks, calls \a prepare with the number
+ * of blocks and then runs \a kernel on the blocks in \a threads threads. The calling
+ * thread takes part in the work, the other threads come from a local pool, so the
+ * method may be called from a task of the global thread pool.
+ */
+bool Worksheet::runRowBlocks(const CellRange &range, int threads, const std::function<void (int)> &prepare,
+                             const std::function<void (const RowBlock &)> &kernel) const
+{
+    Q_D(const Worksheet);
+    if (!isReadableRange(range) || !kernel)
+        return false;
+
+    QVector<int> storedRows;
+    const auto end = d->cellTable.upperBound(range.lastRow());
+    for (auto it = d->cellTable.lowerBound(range.firstRow()); it != end; ++it)
+        storedRows << it.key();
+
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    threads = qMax(1, threads);
+
+    //several blocks per thread keep the threads busy if some blocks are slower
+    const int minBlockRows = 64;
+    const int blockRows = qMax(minBlockRows, int(storedRows.size() / (threads * 8)) + 1);
+    const int blockCount = int((storedRows.size() + blockRows - 1) / blockRows);
+    if (prepare)
+        prepare(blockCount);
+    if (blockCount == 0)
+        return true;
+
+    std::atomic<int> nextBlock {0};
+    auto work = [&]() {
+        for (int index = nextBlock++; index < blockCount; index = nextBlock++) {
+            const int firstRow = storedRows.at(index * blockRows);
+            const int lastRow = storedRows.at(qMin(int(storedRows.size()), (index + 1) * blockRows) - 1);
+            const CellRange blockRange(firstRow, range.firstColumn(), lastRow, range.lastColumn());
+            kernel(RowBlock(index, blockRange, rows(blockRange)));
+        }
+    };
+
+    threads = qMin(threads, blockCount);
+    if (threads == 1) {
+        work();
+        return true;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads - 1);
+    for (int i = 1; i < threads; ++i)
+        pool.start(work);
+    work();
+    pool.waitForDone();
+    return true;
 }
 
-Cell *Worksheet::cell(const CellReference &ref) const
+const Cell *Worksheet::cell(const CellReference &ref) const
 {
     if (!ref.isValid())
         return nullptr;
@@ -964,16 +1397,211 @@ Cell *Worksheet::cell(const CellReference &ref) const
     return cell(ref.row(), ref.column());
 }
 
-Cell *Worksheet::cell(int row, int col) const
+const Cell *Worksheet::cell(int row, int col) const
 {
     Q_D(const Worksheet);
     auto it = d->cellTable.constFind(row);
     if (it == d->cellTable.constEnd())
         return nullptr;
-    if (!it->contains(col))
+    auto cellIt = it->constFind(col);
+    if (cellIt == it->constEnd())
+        return nullptr;
+
+    return cellIt.value().get();
+}
+
+Cell *Worksheet::cell(const CellReference &ref)
+{
+    if (!ref.isValid())
+        return nullptr;
+
+    return cell(ref.row(), ref.column());
+}
+
+Cell *Worksheet::cell(int row, int col)
+{
+    Q_D(Worksheet);
+    //a lookup is not a modification: the Cell setters notify the sheet
+    return d->ownedCell(row, col);
+}
+
+/*!
+ * \internal
+ * Returns the cell at (@a row, @a col) for modification, or nullptr if there
+ * is no such cell. A cell that is shared with a copy or a snapshot of this
+ * sheet, or with another position, is copied first. The modification is not
+ * recorded; see detachedCell().
+ */
+Cell *WorksheetPrivate::ownedCell(int row, int col)
+{
+    Q_Q(Worksheet);
+    auto it = cellTable.find(row);
+    if (it == cellTable.end())
+        return nullptr;
+    auto cellIt = it->find(col);
+    if (cellIt == it->end())
         return nullptr;
 
-    return (*it)[col].get();
+    std::shared_ptr<Cell> &cell = cellIt.value();
+    if (cell.use_count() > 1 || cell->owner() != cellOwner.get()) {
+        cell = std::make_shared<Cell>(cell.get());
+        cell->setParent(q);
+    }
+    return cell.get();
+}
+
+/*!
+ * \internal
+ * Returns the cell at (@a row, @a col) for modification like ownedCell() and
+ * records the modification of the cell.
+ */
+Cell *WorksheetPrivate::detachedCell(int row, int col)
+{
+    Cell *cell = ownedCell(row, col);
+    if (cell) {
+        cellsModified(CellRange(row, col, row, col));
+        recordChange(row, col);
+    }
+    return cell;
+}
+
+/*!
+ * \internal
+ * Records the modification of a cell made through the public Cell setters. The
+ * position of the cell is not known, so all the watched ranges become stale and
+ * the next calculation recalculates all formulas.
+ */
+void WorksheetPrivate::cellModifiedInPlace()
+{
+    cellsModified();
+    changedCells.clear();
+    changesOverflow = trackChanges;
+}
+
+/*!
+ * \internal
+ * Stores @a cell at (@a row, @a column), replacing the existing cell.
+ */
+void WorksheetPrivate::setCell(int row, int column, std::shared_ptr<Cell> cell)
+{
+    cellTable[row][column] = std::move(cell);
+    cellsModified(CellRange(row, column, row, column));
+    recordChange(row, column);
+}
+
+/*!
+ * \internal
+ * Records the modification of the cells of @a range, or of any cells if
+ * @a range is invalid, for the caches built from the sheet cells. Only the
+ * watched ranges that intersect @a range become stale.
+ */
+void WorksheetPrivate::cellsModified(const CellRange &range)
+{
+    ++cellRevision;
+    if (trackReferences && !referencesOverflow) {
+        //too many ranges, or an unknown one, make the reference index collect the sheet again
+        if (!range.isValid() || referenceChanges.size() >= 65536) {
+            referencesOverflow = true;
+            referenceChanges.clear();
+        }
+        else if (referenceChanges.isEmpty() || referenceChanges.last() != range)
+            referenceChanges.append(range);
+    }
+    for (const auto &entry: qAsConst(rangeWatches)) {
+        const auto watch = entry.lock();
+        if (!watch)
+            continue;
+        const CellRange &watched = watch->range;
+        if (!range.isValid()
+            || (watched.firstRow() <= range.lastRow() && range.firstRow() <= watched.lastRow()
+                && watched.firstColumn() <= range.lastColumn() && range.firstColumn() <= watched.lastColumn()))
+            ++watch->revision;
+    }
+}
+
+/*!
+ * \internal
+ * Returns a watch of the cells of @a range, see cellsModified(). The sheet
+ * keeps the watch until the caller releases it.
+ */
+std::shared_ptr<const CellRangeWatch> WorksheetPrivate::watchRange(const CellRange &range) const
+{
+    //the indexes of a sheet may be created by concurrent readers
+    static QMutex mutex;
+    QMutexLocker locker(&mutex);
+    rangeWatches.erase(std::remove_if(rangeWatches.begin(), rangeWatches.end(),
+                                      [](const std::weak_ptr<CellRangeWatch> &watch) { return watch.expired(); }),
+                       rangeWatches.end());
+    auto watch = std::make_shared<CellRangeWatch>();
+    watch->range = range;
+    rangeWatches.append(watch);
+    return watch;
+}
+
+/*!
+ * \internal
+ * Records the modification of the cell at (@a row, @a column) for the next
+ * incremental calculation. If too many cells are modified, the changes are
+ * dropped and the next calculation recalculates all formulas.
+ */
+void WorksheetPrivate::recordChange(int row, int column)
+{
+    if (!trackChanges || changesOverflow)
+        return;
+    if (changedCells.size() >= 65536) {
+        changesOverflow = true;
+        changedCells.clear();
+        return;
+    }
+    changedCells.insert(quint64(row) << 32 | quint32(column));
+}
+
+/*!
+ * \internal
+ * Stores the calculated result of the formula at (@a row, @a column). The
+ * result is not recorded as a modification of the cell.
+ */
+void WorksheetPrivate::setFormulaResult(int row, int column, Cell::Type type, const QVariant &value)
+{
+    const bool track = trackChanges;
+    trackChanges = false;
+    Cell *cell = detachedCell(row, column);
+    trackChanges = track;
+    if (cell)
+        cell->setResult(type, value);
+}
+
+/*!
+ * \internal
+ * Returns the info of @a row for modification, creating it if needed. Row infos
+ * are shared with the snapshots of this sheet, so they are copied on the first
+ * modification.
+ */
+XlsxRowInfo *WorksheetPrivate::detachedRowInfo(int row)
+{
+    if (rowsInfoShared.loadAcquire()) {
+        for (auto it = rowsInfo.begin(); it != rowsInfo.end(); ++it)
+            it.value() = QSharedPointer<XlsxRowInfo>(new XlsxRowInfo(*it.value()));
+        rowsInfoShared.storeRelease(0);
+    }
+    auto &info = rowsInfo[row];
+    if (!info)
+        info = QSharedPointer<XlsxRowInfo>(new XlsxRowInfo());
+    return info.data();
+}
+
+/*!
+ * \internal
+ * Returns true if the data written into the sheetData element are shared with
+ * \a other, i.e. this sheet is a copy or a snapshot of \a other (or vice versa)
+ * and neither of them has modified the cells and rows since.
+ */
+bool WorksheetPrivate::sharesSheetDataWith(const WorksheetPrivate &other) const
+{
+    return cellTable.isSharedWith(other.cellTable)
+            && rowsInfo.isSharedWith(other.rowsInfo)
+            && colsInfo.isSharedWith(other.colsInfo)
+            && sharedFormulaMap.isSharedWith(other.sharedFormulaMap);
 }
 
 Format WorksheetPrivate::cellFormat(int row, int col) const
@@ -1006,14 +1634,14 @@ bool Worksheet::writeString(int row, int column, const RichString &value, const
 //        error = -2;
 //    }
 
-    d->sharedStrings()->addSharedString(value);
+    d->stringRegistry()->addSharedString(value);
     Format fmt = format.isValid() ? format : d->cellFormat(row, column);
     if (value.fragmentCount() == 1 && value.fragmentFormat(0).isValid())
         fmt.mergeFormat(value.fragmentFormat(0));
-    d->workbook->styles()->addXfFormat(fmt);
+    d->registerFormat(fmt);
     auto cell = std::make_shared<Cell>(value.toPlainString(), Cell::Type::SharedString, fmt, this, 0, value);
 //    cell->d_ptr->richString = value;
-    d->cellTable[row][column] = cell;
+    d->setCell(row, column, cell);
     return true;
 }
 
@@ -1061,8 +1689,8 @@ bool Worksheet::writeInlineString(int row, int column, const QString &value, con
     }
 
     Format fmt = format.isValid() ? format : d->cellFormat(row, column);
-    d->workbook->styles()->addXfFormat(fmt);
-    d->cellTable[row][column] = std::make_shared<Cell>(value, Cell::Type::InlineString, fmt, this);
+    d->registerFormat(fmt);
+    d->setCell(row, column, std::make_shared<Cell>(value, Cell::Type::InlineString, fmt, this));
     return true;
 }
 
@@ -1081,8 +1709,8 @@ bool Worksheet::writeNumeric(int row, int column, double value, const Format &fo
     if (!d->addColumnToDimensions(column)) return false;
 
     Format fmt = format.isValid() ? format : d->cellFormat(row, column);
-    d->workbook->styles()->addXfFormat(fmt);
-    d->cellTable[row][column] = std::make_shared<Cell>(value, Cell::Type::Number, fmt, this);
+    d->registerFormat(fmt);
+    d->setCell(row, column, std::make_shared<Cell>(value, Cell::Type::Number, fmt, this));
     return true;
 }
 
@@ -1103,7 +1731,7 @@ bool Worksheet::writeFormula(int row, int column, const CellFormula &formula_, c
     if (!d->addColumnToDimensions(column)) return false;
 
     Format fmt = format.isValid() ? format : d->cellFormat(row, column);
-    d->workbook->styles()->addXfFormat(fmt);
+    d->registerFormat(fmt);
 
     CellFormula formula = formula_;
     if (!formula.needsRecalculation().has_value())
@@ -1118,8 +1746,8 @@ bool Worksheet::writeFormula(int row, int column, const CellFormula &formula_, c
     }
 
     auto data = std::make_shared<Cell>(result, Cell::Type::Number, fmt, this);
-    data->setFormula(formula);
-    d->cellTable[row][column] = data;
+    data->assignFormula(formula);
+    d->setCell(row, column, data);
 
     CellRange range = formula.reference();
     if (formula.type().value_or(CellFormula::Type::Normal) == CellFormula::Type::Shared) {
@@ -1129,12 +1757,12 @@ bool Worksheet::writeFormula(int row, int column, const CellFormula &formula_, c
         for (int r=range.firstRow(); r<=range.lastRow(); ++r) {
             for (int c=range.firstColumn(); c<=range.lastColumn(); ++c) {
                 if (!(r==row && c==column)) {
-                    if (Cell *ce = cell(r, c)) {
-                        ce->setFormula(sf);
+                    if (Cell *ce = d->detachedCell(r, c)) {
+                        ce->assignFormula(sf);
                     } else {
                         auto newCell = std::make_shared<Cell>(result, Cell::Type::Number, fmt, this);
-                        newCell->setFormula(sf);
-                        d->cellTable[r][c] = newCell;
+                        newCell->assignFormula(sf);
+                        d->setCell(r, c, newCell);
                     }
                 }
             }
@@ -1159,10 +1787,10 @@ bool Worksheet::writeBlank(int row, int column, const Format &format)
     if (!d->addColumnToDimensions(column)) return false;
 
     Format fmt = format.isValid() ? format : d->cellFormat(row, column);
-    d->workbook->styles()->addXfFormat(fmt);
+    d->registerFormat(fmt);
 
     //Note: NumberType with an invalid QVariant value means blank.
-    d->cellTable[row][column] = std::make_shared<Cell>(QVariant{}, Cell::Type::Number, fmt, this);
+    d->setCell(row, column, std::make_shared<Cell>(QVariant{}, Cell::Type::Number, fmt, this));
 
     return true;
 }
@@ -1182,8 +1810,8 @@ bool Worksheet::writeBool(int row, int column, bool value, const Format &format)
     if (!d->addColumnToDimensions(column)) return false;
 
     Format fmt = format.isValid() ? format : d->cellFormat(row, column);
-    d->workbook->styles()->addXfFormat(fmt);
-    d->cellTable[row][column] = std::make_shared<Cell>(value, Cell::Type::Boolean, fmt, this);
+    d->registerFormat(fmt);
+    d->setCell(row, column, std::make_shared<Cell>(value, Cell::Type::Boolean, fmt, this));
 
     return true;
 }
@@ -1205,11 +1833,11 @@ bool Worksheet::writeDateTime(int row, int column, const QDateTime &dt, const Fo
     Format fmt = format.isValid() ? format : d->cellFormat(row, column);
     if (!fmt.isValid() || !fmt.isDateTimeFormat())
         fmt.setNumberFormat(d->workbook->defaultDateFormat());
-    d->workbook->styles()->addXfFormat(fmt);
+    d->registerFormat(fmt);
 
     double value = datetimeToNumber(dt, d->workbook->date1904().value_or(false));
 
-    d->cellTable[row][column] = std::make_shared<Cell>(value, Cell::Type::Number, fmt, this);
+    d->setCell(row, column, std::make_shared<Cell>(value, Cell::Type::Number, fmt, this));
 
     return true;
 }
@@ -1235,11 +1863,11 @@ bool Worksheet::writeDate(int row, int column, const QDate &dt, const Format &fo
     if (!fmt.isValid() || !fmt.isDateTimeFormat())
         fmt.setNumberFormat(d->workbook->defaultDateFormat());
 
-    d->workbook->styles()->addXfFormat(fmt);
+    d->registerFormat(fmt);
 
     double value = datetimeToNumber(QDateTime(dt, QTime(0,0,0)), d->workbook->date1904().value_or(false));
 
-    d->cellTable[row][column] = std::make_shared<Cell>(value, Cell::Type::Number, fmt, this);
+    d->setCell(row, column, std::make_shared<Cell>(value, Cell::Type::Number, fmt, this));
 
     return true;
 }
@@ -1261,9 +1889,9 @@ bool Worksheet::writeTime(int row, int column, const QTime &t, const Format &for
     Format fmt = format.isValid() ? format : d->cellFormat(row, column);
     if (!fmt.isValid() || !fmt.isDateTimeFormat())
         fmt.setNumberFormat(QLatin1String("hh:mm:ss"));
-    d->workbook->styles()->addXfFormat(fmt);
+    d->registerFormat(fmt);
 
-    d->cellTable[row][column] = std::make_shared<Cell>(timeToNumber(t), Cell::Type::Number, fmt, this);
+    d->setCell(row, column, std::make_shared<Cell>(timeToNumber(t), Cell::Type::Number, fmt, this));
 
     return true;
 }
@@ -1316,11 +1944,11 @@ bool Worksheet::writeHyperlink(int row, int column, const QUrl &url, const Forma
         fmt.setFontColor(Qt::blue);
         fmt.setFontUnderline(Format::FontUnderlineSingle);
     }
-    d->workbook->styles()->addXfFormat(fmt);
+    d->registerFormat(fmt);
 
     //Write the hyperlink string as normal string.
-    d->sharedStrings()->addSharedString(displayString);
-    d->cellTable[row][column] = std::make_shared<Cell>(displayString, Cell::Type::SharedString, fmt, this);
+    d->stringRegistry()->addSharedString(displayString);
+    d->setCell(row, column, std::make_shared<Cell>(displayString, Cell::Type::SharedString, fmt, this));
 
     //Store the hyperlink data in a separate table
     d->urlTable[row][column] = QSharedPointer<XlsxHyperlinkData>(new XlsxHyperlinkData(XlsxHyperlinkData::External, urlString, locationString, QString(), tip));
@@ -1328,16 +1956,265 @@ bool Worksheet::writeHyperlink(int row, int column, const QUrl &url, const Forma
     return true;
 }
 
-bool Worksheet::addDataValidation(const DataValidation &validation)
+/*!
+ * \internal
+ * Writes a block of \a rows x \a columns cells starting from (\a firstRow, \a firstColumn).
+ * \a formats contains either one format for the whole block or a format for each
+ * column. An invalid format keeps the current format of a cell. If \a dateTime is
+ * true, formats without a date-time number format get the default date format.
+ *
+ * \a createCell(index, row, column, format) creates the cell for the value \a index
+ * of the row-major block; \a format is already registered in the styles.
+ *
+ * The range is validated and the formats are registered once per call, and each row
+ * of the cell table is looked up once.
+ */
+template <typename CreateCell>
+bool WorksheetPrivate::writeCells(int firstRow, int firstColumn, int rows, int columns,
+                                  const QList<Format> &formats, bool dateTime, CreateCell createCell)
 {
-    Q_D(Worksheet);
-    if (!validation.isValid() || validation.ranges().isEmpty() || validation.type() == DataValidation::Type::None)
+    if (rows < 0 || columns < 0 || rows > XLSX_ROW_MAX || columns > XLSX_COLUMN_MAX)
         return false;
+    if (rows == 0 || columns == 0)
+        return true;
+
+    const int lastRow = firstRow + rows - 1;
+    const int lastColumn = firstColumn + columns - 1;
+    if (!rowValid(firstRow) || !rowValid(lastRow) || !columnValid(firstColumn) || !columnValid(lastColumn))
+        return false;
+    addRowToDimensions(firstRow);
+    addRowToDimensions(lastRow);
+    addColumnToDimensions(firstColumn);
+    addColumnToDimensions(lastColumn);
+
+    const QString dateFormat = dateTime ? workbook->defaultDateFormat() : QString();
+
+    QVector<Format> columnFormats(columns);
+    bool keepFormats = false;
+    for (int c = 0; c < columns; ++c) {
+        if (c > 0 && formats.size() == 1) {
+            columnFormats[c] = columnFormats[0];
+            continue;
+        }
+        Format fmt = formats.value(c);
+        if (fmt.isValid()) {
+            if (dateTime && !fmt.isDateTimeFormat())
+                fmt.setNumberFormat(dateFormat);
+            registerFormat(fmt);
+        }
+        else keepFormats = true;
+        columnFormats[c] = fmt;
+    }
+
+    //formats for the cells that keep their current formats
+    Format dateTimeFormat;
+    if (keepFormats) {
+        if (dateTime) {
+            dateTimeFormat.setNumberFormat(dateFormat);
+            registerFormat(dateTimeFormat);
+        }
+        else registerFormat(Format());
+    }
+
+    cellsModified(CellRange(firstRow, firstColumn, lastRow, lastColumn));
+    //a block may exceed INT_MAX cells
+    qsizetype index = 0;
+    for (int row = firstRow; row <= lastRow; ++row) {
+        auto &rowCells = cellTable[row];
+        for (int c = 0; c < columns; ++c, ++index) {
+            const int column = firstColumn + c;
+            auto &cell = rowCells[column];
+            Format fmt = columnFormats.at(c);
+            if (!fmt.isValid()) {
+                if (cell)
+                    fmt = cell->format();
+                if (dateTime && !fmt.isValid())
+                    fmt = dateTimeFormat;
+                else if (dateTime && !fmt.isDateTimeFormat()) {
+                    fmt.setNumberFormat(dateFormat);
+                    registerFormat(fmt);
+                }
+            }
+            cell = createCell(index, row, column, fmt);
+            recordChange(row, column);
+        }
+    }
+    return true;
+}
+
+bool WorksheetPrivate::writeNumbers(int firstRow, int firstColumn, int rows, int columns, const double *values,
+                                    const QList<Format> &formats, bool dateTime)
+{
+    Q_Q(Worksheet);
+    return writeCells(firstRow, firstColumn, rows, columns, formats, dateTime,
+                      [values, q](qsizetype index, int, int, const Format &fmt) {
+        return std::make_shared<Cell>(values[index], Cell::Type::Number, fmt, q);
+    });
+}
+
+bool WorksheetPrivate::writeBools(int firstRow, int firstColumn, int rows, int columns, const bool *values,
+                                  const QList<Format> &formats)
+{
+    Q_Q(Worksheet);
+    return writeCells(firstRow, firstColumn, rows, columns, formats, false,
+                      [values, q](qsizetype index, int, int, const Format &fmt) {
+        return std::make_shared<Cell>(values[index], Cell::Type::Boolean, fmt, q);
+    });
+}
+
+bool WorksheetPrivate::writeStrings(int firstRow, int firstColumn, int rows, int columns,
+                                    const std::function<QStringView (int row, int column)> &values,
+                                    const QList<Format> &formats)
+{
+    Q_Q(Worksheet);
+    SharedStrings *sst = stringRegistry();
+    const bool html = workbook->isHtmlToRichStringEnabled();
+
+    return writeCells(firstRow, firstColumn, rows, columns, formats, false,
+                      [&](qsizetype, int row, int column, const Format &format) {
+        const QString value = values(row, column).toString();
+        RichString rs;
+        if (html && Qt::mightBeRichText(value))
+            rs.setHtml(value);
+        else
+            rs.addFragment(value, Format());
+        sst->addSharedString(rs);
+
+        Format fmt = format;
+        if (rs.fragmentCount() == 1 && rs.fragmentFormat(0).isValid()) {
+            fmt.mergeFormat(rs.fragmentFormat(0));
+            registerFormat(fmt);
+        }
+        return std::make_shared<Cell>(rs.toPlainString(), Cell::Type::SharedString, fmt, q, 0, rs);
+    });
+}
+
+bool Worksheet::writeRow(int row, int firstColumn, const double *values, int count, const Format &format)
+{
+    Q_D(Worksheet);
+    return d->writeNumbers(row, firstColumn, 1, count, values, {format});
+}
+
+bool Worksheet::writeRow(int row, int firstColumn, const QVector<double> &values, const Format &format)
+{
+    return writeRow(row, firstColumn, values.constData(), values.size(), format);
+}
+
+bool Worksheet::writeRow(int row, int firstColumn, const bool *values, int count, const Format &format)
+{
+    Q_D(Worksheet);
+    return d->writeBools(row, firstColumn, 1, count, values, {format});
+}
+
+bool Worksheet::writeRow(int row, int firstColumn, const QStringList &values, const Format &format)
+{
+    Q_D(Worksheet);
+    return d->writeStrings(row, firstColumn, 1, values.size(),
+                           [&values, firstColumn](int, int column) { return QStringView(values.at(column - firstColumn)); },
+                           {format});
+}
+
+bool Worksheet::writeRow(int row, int firstColumn, const QList<QDateTime> &values, const Format &format)
+{
+    Q_D(Worksheet);
+    const bool date1904 = d->workbook->date1904().value_or(false);
+    QVector<double> numbers;
+    numbers.reserve(values.size());
+    for (const auto &dt: values)
+        numbers << datetimeToNumber(dt, date1904);
+    return d->writeNumbers(row, firstColumn, 1, numbers.size(), numbers.constData(), {format}, true);
+}
+
+bool Worksheet::writeRow(int row, int firstColumn, const QList<QDate> &values, const Format &format)
+{
+    Q_D(Worksheet);
+    const bool date1904 = d->workbook->date1904().value_or(false);
+    QVector<double> numbers;
+    numbers.reserve(values.size());
+    for (const auto &dt: values)
+        numbers << datetimeToNumber(QDateTime(dt, QTime(0,0,0)), date1904);
+    return d->writeNumbers(row, firstColumn, 1, numbers.size(), numbers.constData(), {format}, true);
+}
+
+bool Worksheet::writeColumn(int firstRow, int column, const double *values, int count, const Format &format)
+{
+    Q_D(Worksheet);
+    return d->writeNumbers(firstRow, column, count, 1, values, {format});
+}
+
+bool Worksheet::writeColumn(int firstRow, int column, const QVector<double> &values, const Format &format)
+{
+    return writeColumn(firstRow, column, values.constData(), values.size(), format);
+}
+
+bool Worksheet::writeColumn(int firstRow, int column, const bool *values, int count, const Format &format)
+{
+    Q_D(Worksheet);
+    return d->writeBools(firstRow, column, count, 1, values, {format});
+}
+
+bool Worksheet::writeColumn(int firstRow, int column, const QStringList &values, const Format &format)
+{
+    Q_D(Worksheet);
+    return d->writeStrings(firstRow, column, values.size(), 1,
+                           [&values, firstRow](int row, int) { return QStringView(values.at(row - firstRow)); },
+                           {format});
+}
+
+bool Worksheet::writeColumn(int firstRow, int column, const QList<QDateTime> &values, const Format &format)
+{
+    Q_D(Worksheet);
+    const bool date1904 = d->workbook->date1904().value_or(false);
+    QVector<double> numbers;
+    numbers.reserve(values.size());
+    for (const auto &dt: values)
+        numbers << datetimeToNumber(dt, date1904);
+    return d->writeNumbers(firstRow, column, numbers.size(), 1, numbers.constData(), {format}, true);
+}
+
+bool Worksheet::writeColumn(int firstRow, int column, const QList<QDate> &values, const Format &format)
+{
+    Q_D(Worksheet);
+    const bool date1904 = d->workbook->date1904().value_or(false);
+    QVector<double> numbers;
+    numbers.reserve(values.size());
+    for (const auto &dt: values)
+        numbers << datetimeToNumber(QDateTime(dt, QTime(0,0,0)), date1904);
+    return d->writeNumbers(firstRow, column, numbers.size(), 1, numbers.constData(), {format}, true);
+}
+
+bool Worksheet::writeBlock(const CellReference &topLeft, int rows, int columns, const double *values,
+                           const QList<Format> &formats)
+{
+    Q_D(Worksheet);
+    if (!topLeft.isValid())
+        return false;
+    return d->writeNumbers(topLeft.row(), topLeft.column(), rows, columns, values, formats);
+}
+
+bool Worksheet::writeBlock(const CellReference &topLeft, int rows, int columns,
+                           const std::function<QStringView (int row, int column)> &values,
+                           const QList<Format> &formats)
+{
+    Q_D(Worksheet);
+    if (!topLeft.isValid())
+        return false;
+    return d->writeStrings(topLeft.row(), topLeft.column(), rows, columns, values, formats);
+}
+
+bool Worksheet::addDataValidation(const DataValidation &validation)
+{
+    Q_D(Worksheet);
+    if (!validation.isValid() || validation.ranges().isEmpty() || validation.type() == DataValidation::Type::None)
+        return false;
+
+    const auto ranges = validation.ranges();
+    for (const CellRange &range : ranges)
+        d->validationsIndex.insert(range, d->dataValidationsList.size());
+    d->dataValidationsList.append(validation);
+    return true;
+}
 
-    d->dataValidationsList.append(validation);
-    return true;
-}
-
 bool Worksheet::addDataValidation(const CellRange &range, DataValidation::Type type,
                                   const QString &formula1, std::optional<DataValidation::Predicate> predicate,
                                   const QString &formula2, bool strict)
@@ -1401,6 +2278,7 @@ void Worksheet::clearDataValidation()
 {
     Q_D(Worksheet);
     d->dataValidationsList.clear();
+    d->validationsIndex.reset();
 }
 
 bool Worksheet::hasDataValidation() const
@@ -1424,6 +2302,8 @@ DataValidation Worksheet::dataValidation(int index) const
 DataValidation &Worksheet::dataValidation(int index)
 {
     Q_D(Worksheet);
+    //the ranges may be changed through the reference
+    d->validationsIndex.reset();
     return d->dataValidationsList[index];
 }
 
@@ -1432,6 +2312,7 @@ bool Worksheet::removeDataValidation(int index)
     Q_D(Worksheet);
     if (index < 0 || index >= d->dataValidationsList.size()) return false;
     d->dataValidationsList.removeAt(index);
+    d->validationsIndex.reset();
     return true;
 }
 
@@ -1445,6 +2326,7 @@ void Worksheet::clearConditionalformatting()
 {
     Q_D(Worksheet);
     d->conditionalFormattingList.clear();
+    d->formattingsIndex.reset();
 }
 
 bool Worksheet::hasConditionalFormatting() const
@@ -1471,6 +2353,8 @@ ConditionalFormatting Worksheet::conditionalFormatting(int index) const
 ConditionalFormatting &Worksheet::conditionalFormatting(int index)
 {
     Q_D(Worksheet);
+    //the ranges may be changed through the reference
+    d->formattingsIndex.reset();
     return d->conditionalFormattingList[index];
 }
 
@@ -1479,6 +2363,7 @@ bool Worksheet::removeConditionalFormatting(int index)
     Q_D(Worksheet);
     if (index < 0 || index >= d->conditionalFormattingList.size()) return false;
     d->conditionalFormattingList.removeAt(index);
+    d->formattingsIndex.reset();
     return true;
 }
 
@@ -1492,6 +2377,9 @@ bool Worksheet::addConditionalFormatting(const ConditionalFormatting &cf)
         if (!rule->dxfFormat.isEmpty())
             d->workbook->styles()->addDxfFormat(rule->dxfFormat);
     }
+    const auto ranges = cf.ranges();
+    for (const CellRange &range : ranges)
+        d->formattingsIndex.insert(range, d->conditionalFormattingList.size());
     d->conditionalFormattingList.append(cf);
     return true;
 }
@@ -1791,70 +2679,1106 @@ bool Worksheet::removeChart(int index)
         }
     }
 
-    return false;
-}
+    return false;
+}
+
+int Worksheet::chartsCount() const
+{
+    Q_D(const Worksheet);
+    int count = 0;
+
+    if (d->drawing) {
+        for (auto anchor: qAsConst(d->drawing->anchors)) {
+            if (anchor && anchor->isChart())
+                count++;
+        }
+    }
+    return count;
+}
+
+bool Worksheet::mergeCells(const CellRange &range, const Format &format)
+{
+    return mergeCells(QList<CellRange> {range}, format);
+}
+
+bool Worksheet::mergeCells(const QList<CellRange> &ranges, const Format &format)
+{
+    Q_D(Worksheet);
+    if (ranges.isEmpty())
+        return false;
+
+    QVector<RangeIndex::Item> items;
+    items.reserve(ranges.size());
+    for (const CellRange &range : ranges) {
+        if (!range.isValid() || (range.rowCount() < 2 && range.columnCount() < 2)
+            || !d->rowValid(range.firstRow()) || !d->rowValid(range.lastRow())
+            || !d->columnValid(range.firstColumn()) || !d->columnValid(range.lastColumn()))
+            return false;
+        items.append(RangeIndex::Item {range, int(d->merges.size() + items.size())});
+    }
+    //the ranges must not overlap each other or the merged cells
+    RangeIndex added;
+    added.build(items);
+    const RangeIndex &merged = d->mergeIndex();
+    for (const CellRange &range : ranges) {
+        if (merged.intersects(range) || added.find(range).size() > 1)
+            return false;
+    }
+
+    if (format.isValid())
+        d->registerFormat(format);
+
+    for (const CellRange &range : ranges) {
+        d->addRowToDimensions(range.firstRow());
+        d->addColumnToDimensions(range.firstColumn());
+        for (int row = range.firstRow(); row <= range.lastRow(); ++row) {
+            for (int col = range.firstColumn(); col <= range.lastColumn(); ++col) {
+                if (row == range.firstRow() && col == range.firstColumn()) {
+                    if (!qAsConst(*this).cell(row, col))
+                        writeBlank(row, col, format);
+                    else if (format.isValid())
+                        d->detachedCell(row, col)->assignFormat(format);
+                }
+                else
+                    writeBlank(row, col, format);
+            }
+        }
+    }
+
+    d->mergesIndex.insert(items);
+    d->merges.append(ranges);
+    return true;
+}
+
+bool Worksheet::unmergeCells(const CellRange &range)
+{
+    Q_D(Worksheet);
+    int index = -1;
+    const auto items = d->mergeIndex().find(range);
+    for (const auto &item : items) {
+        if (item.range == range) {
+            index = item.value;
+            break;
+        }
+    }
+    if (index < 0)
+        return false;
+
+    //the last range takes the place of the removed one
+    const int last = d->merges.size() - 1;
+    d->mergesIndex.remove(range, index);
+    if (index != last) {
+        const CellRange moved = d->merges.at(last);
+        d->mergesIndex.remove(moved, last);
+        d->mergesIndex.insert(moved, index);
+        d->merges[index] = moved;
+    }
+    d->merges.removeLast();
+    return true;
+}
+
+QList<CellRange> Worksheet::mergedCells() const
+{
+    Q_D(const Worksheet);
+    return d->merges;
+}
+
+QList<CellRange> Worksheet::mergedCells(const CellRange &range) const
+{
+    Q_D(const Worksheet);
+    QList<CellRange> ranges;
+    const auto positions = d->mergeIndex().values(range);
+    for (int position : positions)
+        ranges << d->merges.at(position);
+    return ranges;
+}
+
+CellRange Worksheet::mergedRange(const CellReference &cell) const
+{
+    Q_D(const Worksheet);
+    if (!cell.isValid())
+        return CellRange();
+    const auto items = d->mergeIndex().find(CellRange(cell, cell));
+    return items.isEmpty() ? CellRange() : items.first().range;
+}
+
+QList<int> Worksheet::dataValidationIndexes(const CellRange &range) const
+{
+    Q_D(const Worksheet);
+    QList<int> indexes;
+    const auto values = d->validationIndex().values(range);
+    for (int index : values)
+        indexes << index;
+    return indexes;
+}
+
+QList<int> Worksheet::conditionalFormattingIndexes(const CellRange &range) const
+{
+    Q_D(const Worksheet);
+    QList<int> indexes;
+    const auto values = d->formattingIndex().values(range);
+    for (int index : values)
+        indexes << index;
+    return indexes;
+}
+
+ConditionalFormatEvaluator Worksheet::conditionalFormatEvaluator() const
+{
+    Q_D(const Worksheet);
+    if (!d->workbook)
+        return ConditionalFormatEvaluator();
+    return ConditionalFormatEvaluator(this);
+}
+
+bool Worksheet::insertRows(int row, int count)
+{
+    Q_D(Worksheet);
+    if (row < 1 || row > XLSX_ROW_MAX || count < 1)
+        return false;
+    //the cells pushed out of the sheet would be lost
+    if (!d->cellTable.isEmpty() && d->cellTable.lastKey() >= row
+        && d->cellTable.lastKey() > XLSX_ROW_MAX - count)
+        return false;
+    return d->shiftCells({true, row, count});
+}
+
+bool Worksheet::removeRows(int row, int count)
+{
+    Q_D(Worksheet);
+    if (row < 1 || row > XLSX_ROW_MAX || count < 1)
+        return false;
+    return d->shiftCells({true, row, -qMin(count, XLSX_ROW_MAX - row + 1)});
+}
+
+bool Worksheet::insertColumns(int column, int count)
+{
+    Q_D(Worksheet);
+    if (column < 1 || column > XLSX_COLUMN_MAX || count < 1)
+        return false;
+    if (d->dimension.isValid() && d->dimension.lastColumn() >= column
+        && d->dimension.lastColumn() > XLSX_COLUMN_MAX - count)
+        return false;
+    return d->shiftCells({false, column, count});
+}
+
+bool Worksheet::removeColumns(int column, int count)
+{
+    Q_D(Worksheet);
+    if (column < 1 || column > XLSX_COLUMN_MAX || count < 1)
+        return false;
+    return d->shiftCells({false, column, -qMin(count, XLSX_COLUMN_MAX - column + 1)});
+}
+
+bool Worksheet::copyRange(const CellRange &source, const CellReference &destination, CopyOptions options)
+{
+    return copyRange(source, this, destination, options);
+}
+
+bool Worksheet::copyRange(const CellRange &source, Worksheet *target, const CellReference &destination,
+                          CopyOptions options)
+{
+    Q_D(Worksheet);
+    return d->copyCells(source, target, destination, options, false);
+}
+
+bool Worksheet::moveRange(const CellRange &source, const CellReference &destination, CopyOptions options)
+{
+    return moveRange(source, this, destination, options);
+}
+
+bool Worksheet::moveRange(const CellRange &source, Worksheet *target, const CellReference &destination,
+                          CopyOptions options)
+{
+    Q_D(Worksheet);
+    return d->copyCells(source, target, destination, options, true);
+}
+
+/*!
+ * \internal
+ * Returns the cells that are moved or removed by the shift.
+ */
+CellRange SheetShift::area() const
+{
+    return rows ? CellRange(first, 1, XLSX_ROW_MAX, XLSX_COLUMN_MAX)
+                : CellRange(1, first, XLSX_ROW_MAX, XLSX_COLUMN_MAX);
+}
+
+/*!
+ * \internal
+ * Adjusts the span of rows (columns) [\a from, \a to]. A span that contains the
+ * insertion point grows, a span that overlaps the removed rows shrinks.
+ * Returns false if the whole span is removed or pushed out of the sheet.
+ */
+bool SheetShift::adjust(int &from, int &to) const
+{
+    if (count > 0) {
+        if (from >= first)
+            from += count;
+        if (to >= first)
+            to = qMin(to + count, limit());
+        return from <= limit();
+    }
+    if (from >= end())
+        from += count;
+    else if (from >= first)
+        from = first;
+    if (to >= end())
+        to += count;
+    else if (to >= first)
+        to = first - 1;
+    return from <= to;
+}
+
+bool SheetShift::adjust(CellRange &range) const
+{
+    if (!range.isValid())
+        return false;
+    if (rows) {
+        int from = range.firstRow();
+        int to = range.lastRow();
+        if (!adjust(from, to))
+            return false;
+        range = CellRange(from, range.firstColumn(), to, range.lastColumn());
+    }
+    else {
+        int from = range.firstColumn();
+        int to = range.lastColumn();
+        if (!adjust(from, to))
+            return false;
+        range = CellRange(range.firstRow(), from, range.lastRow(), to);
+    }
+    return true;
+}
+
+/*!
+ * \internal
+ * Adjusts \a reference with the coordinates as written. A reference to the
+ * removed cells only is made invalid, so it is written as #REF!.
+ * Returns true if the reference has changed.
+ */
+bool SheetShift::adjust(FormulaReference &reference) const
+{
+    //whole columns do not move when rows are inserted and vice versa
+    if (rows ? reference.wholeColumns : reference.wholeRows)
+        return false;
+    int &from = rows ? reference.firstRow : reference.firstColumn;
+    int &to = rows ? reference.lastRow : reference.lastColumn;
+    const int oldFrom = from;
+    const int oldTo = to;
+    if (!adjust(from, to)) {
+        reference.firstRow = 0;
+        return true;
+    }
+    return from != oldFrom || to != oldTo;
+}
+
+/*!
+ * \internal
+ * Returns true if the rows (columns) [\a from, \a to] are not all adjusted by
+ * the same offset.
+ */
+bool SheetShift::splits(int from, int to) const
+{
+    return from < to && from < end() && to >= first;
+}
+
+/*!
+ * \internal
+ * Returns true if the relative \a reference of a shared formula written in
+ * \a cells points to rows (columns) that are not all adjusted by the same offset.
+ */
+bool SheetShift::splits(const FormulaReference &reference, const CellRange &cells) const
+{
+    if (rows ? reference.wholeColumns : reference.wholeRows)
+        return false;
+    const int low = rows ? cells.firstRow() : cells.firstColumn();
+    const int high = rows ? cells.lastRow() : cells.lastColumn();
+    auto varies = [this, low, high](int offset, bool absolute) {
+        return !absolute && splits(offset + low, offset + high);
+    };
+    if (rows)
+        return varies(reference.firstRow, reference.firstRowAbsolute)
+                || varies(reference.lastRow, reference.lastRowAbsolute);
+    return varies(reference.firstColumn, reference.firstColumnAbsolute)
+            || varies(reference.lastColumn, reference.lastColumnAbsolute);
+}
+
+namespace {
+
+/*
+ * Applies the shift to the keys of map. Only the entries from the shift point
+ * on are touched; they are re-inserted in order at the end of the map.
+ */
+template <typename T>
+bool shiftKeys(QMap<int, T> &map, const SheetShift &shift)
+{
+    if (map.isEmpty() || map.lastKey() < shift.first)
+        return false;
+    QVector<QPair<int, T> > moved;
+    for (auto it = map.lowerBound(shift.first); it != map.end(); it = map.erase(it)) {
+        if (it.key() >= shift.end() && it.key() + shift.count <= shift.limit())
+            moved.append(qMakePair(it.key() + shift.count, it.value()));
+    }
+    for (const auto &entry: qAsConst(moved))
+        map.insert(map.constEnd(), entry.first, entry.second);
+    return true;
+}
+
+//Applies the shift to the column keys of each row
+template <typename T>
+void shiftColumnKeys(QMap<int, QMap<int, T> > &table, const SheetShift &shift)
+{
+    for (auto it = table.begin(); it != table.end();) {
+        if (shiftKeys(it.value(), shift) && it.value().isEmpty())
+            it = table.erase(it);
+        else
+            ++it;
+    }
+}
+
+bool intersects(const CellRange &a, const CellRange &b)
+{
+    return a.isValid() && b.isValid()
+            && a.firstRow() <= b.lastRow() && b.firstRow() <= a.lastRow()
+            && a.firstColumn() <= b.lastColumn() && b.firstColumn() <= a.lastColumn();
+}
+
+CellRange intersected(const CellRange &a, const CellRange &b)
+{
+    return CellRange(qMax(a.firstRow(), b.firstRow()), qMax(a.firstColumn(), b.firstColumn()),
+                     qMin(a.lastRow(), b.lastRow()), qMin(a.lastColumn(), b.lastColumn()));
+}
+
+CellRange translated(const CellRange &range, int rowOffset, int columnOffset)
+{
+    return CellRange(range.firstRow() + rowOffset, range.firstColumn() + columnOffset,
+                     range.lastRow() + rowOffset, range.lastColumn() + columnOffset);
+}
+
+//Returns the parts of range outside cut: the rows above and below it, then
+//the columns to the left and to the right of it
+QList<CellRange> subtractRange(const CellRange &range, const CellRange &cut)
+{
+    if (!intersects(range, cut))
+        return {range};
+    QList<CellRange> result;
+    if (range.firstRow() < cut.firstRow())
+        result << CellRange(range.firstRow(), range.firstColumn(), cut.firstRow() - 1, range.lastColumn());
+    if (range.lastRow() > cut.lastRow())
+        result << CellRange(cut.lastRow() + 1, range.firstColumn(), range.lastRow(), range.lastColumn());
+    const int top = qMax(range.firstRow(), cut.firstRow());
+    const int bottom = qMin(range.lastRow(), cut.lastRow());
+    if (range.firstColumn() < cut.firstColumn())
+        result << CellRange(top, range.firstColumn(), bottom, cut.firstColumn() - 1);
+    if (range.lastColumn() > cut.lastColumn())
+        result << CellRange(top, cut.lastColumn() + 1, bottom, range.lastColumn());
+    return result;
+}
+
+void removeHyperlinks(QMap<int, QMap<int, QSharedPointer<XlsxHyperlinkData> > > &links, const CellRange &range)
+{
+    auto rowIt = links.lowerBound(range.firstRow());
+    while (rowIt != links.end() && rowIt.key() <= range.lastRow()) {
+        auto it = rowIt->lowerBound(range.firstColumn());
+        while (it != rowIt->end() && it.key() <= range.lastColumn())
+            it = rowIt->erase(it);
+        if (rowIt->isEmpty())
+            rowIt = links.erase(rowIt);
+        else
+            ++rowIt;
+    }
+}
+
+QList<CellRange> shiftRanges(const QList<CellRange> &ranges, const SheetShift &shift)
+{
+    QList<CellRange> result;
+    for (CellRange range: ranges) {
+        if (shift.adjust(range) && !result.contains(range))
+            result << range;
+    }
+    return result;
+}
+
+}
+
+/*!
+ * \internal
+ * Inserts or removes rows or columns. The formulas, defined names, validations,
+ * formattings and chart series of the workbook that refer to the moved cells
+ * are rewritten first. Then the cell store and the sheet objects are shifted:
+ * the rows of the cell table are moved as whole blocks, the columns are moved
+ * within the rows that have cells past the shift point.
+ */
+bool WorksheetPrivate::shiftCells(const SheetShift &shift)
+{
+    Q_Q(Worksheet);
+    auto book_d = workbook->d_func();
+    if (!book_d->referenceIndex)
+        book_d->referenceIndex = std::make_shared<ReferenceIndex>(workbook);
+    ReferenceIndex *index = book_d->referenceIndex.get();
+    index->update();
+
+    //1. the shared formulas whose cells would move apart become single formulas
+    bool split = false;
+    const auto sheets = workbook->worksheets();
+    for (Worksheet *sheet: sheets) {
+        if (sheet->d_func()->splitSharedFormulas(q, shift, index))
+            split = true;
+    }
+    if (split)
+        index->update();
+
+    //2. the references to the moved cells
+    const auto sites = index->sites(q, shift.area());
+    for (const ReferenceSite &site: sites) {
+        const bool onSheet = site.kind == ReferenceSite::Kind::Cell
+                || site.kind == ReferenceSite::Kind::DataValidation
+                || site.kind == ReferenceSite::Kind::ConditionalFormatting;
+        const AbstractSheet *host = onSheet ? site.sheet : nullptr;
+        index->rewrite(site, [index, host, q, &shift](FormulaReference &reference) {
+            return index->resolveSheet(reference.sheet, host) == q && shift.adjust(reference);
+        });
+    }
+    //the index adjusts the rewritten references itself when the cells are shifted
+    for (Worksheet *sheet: sheets)
+        sheet->d_func()->referenceChanges.clear();
+    //the masters of the array and data table formulas whose ranges are adjusted
+    const auto masters = index->masters(q, shift.area());
+
+    //3. the cells and the sheet objects
+    if (shift.rows) {
+        shiftKeys(cellTable, shift);
+        shiftKeys(comments, shift);
+        shiftKeys(urlTable, shift);
+        shiftKeys(rowsInfo, shift);
+    }
+    else {
+        shiftColumnKeys(cellTable, shift);
+        shiftColumnKeys(comments, shift);
+        shiftColumnKeys(urlTable, shift);
+        shiftKeys(colsInfo, shift);
+    }
+    //the cells past the shift point have changed, the reference index is shifted
+    const bool track = trackReferences;
+    trackReferences = false;
+    cellsModified(shift.area());
+    trackReferences = track;
+    index->shiftSheet(q, shift);
+    //the formula engine has to build the graph again
+    changedCells.clear();
+    changesOverflow = trackChanges;
+
+    for (auto it = sharedFormulaMap.begin(); it != sharedFormulaMap.end();) {
+        CellRange range = it->reference();
+        const CellRange oldRange = range;
+        if (!shift.adjust(range)) {
+            it = sharedFormulaMap.erase(it);
+            continue;
+        }
+        if (range != oldRange) {
+            it->setReference(range);
+            if (Cell *master = detachedCell(range.firstRow(), range.firstColumn())) {
+                CellFormula formula = master->formula();
+                formula.setReference(range);
+                master->assignFormula(formula);
+            }
+        }
+        ++it;
+    }
+
+    //the masters of the array and data table formulas have been moved with the
+    //cells, their ranges still start at the old positions
+    for (const auto &master: masters) {
+        int row = master.first.row();
+        int column = master.first.column();
+        int &position = shift.rows ? row : column;
+        int last = position;
+        if (!shift.adjust(position, last))
+            continue; //the master is removed
+        CellRange range = master.second;
+        //a range that no longer starts at the master is reduced to the master
+        if (!shift.adjust(range) || range.topLeft() != CellReference(row, column))
+            range = CellRange(row, column, row, column);
+        if (range == master.second)
+            continue;
+        if (Cell *cell = detachedCell(row, column)) {
+            CellFormula formula = cell->formula();
+            formula.setReference(range);
+            cell->assignFormula(formula);
+        }
+    }
+
+    for (auto it = merges.begin(); it != merges.end();) {
+        if (shift.adjust(*it) && (it->rowCount() > 1 || it->columnCount() > 1))
+            ++it;
+        else
+            it = merges.erase(it);
+    }
+
+    for (int i = dataValidationsList.size() - 1; i >= 0; --i) {
+        const QList<CellRange> ranges = dataValidationsList.at(i).ranges();
+        const QList<CellRange> shifted = shiftRanges(ranges, shift);
+        if (shifted == ranges)
+            continue;
+        if (shifted.isEmpty()) {
+            dataValidationsList.removeAt(i);
+            continue;
+        }
+        DataValidation &validation = dataValidationsList[i];
+        for (const CellRange &range: ranges)
+            validation.removeRange(range);
+        for (const CellRange &range: shifted)
+            validation.addRange(range);
+    }
+
+    for (int i = conditionalFormattingList.size() - 1; i >= 0; --i) {
+        const QList<CellRange> ranges = conditionalFormattingList.at(i).ranges();
+        const QList<CellRange> shifted = shiftRanges(ranges, shift);
+        if (shifted == ranges)
+            continue;
+        if (shifted.isEmpty()) {
+            conditionalFormattingList.removeAt(i);
+            continue;
+        }
+        ConditionalFormatting &formatting = conditionalFormattingList[i];
+        formatting.clearRanges();
+        for (const CellRange &range: shifted)
+            formatting.addRange(range);
+    }
+    invalidateRangeIndexes();
+
+    if (autofilter.isValid()) {
+        CellRange range = autofilter.range();
+        if (range.isValid() && !shift.adjust(range))
+            autofilter = AutoFilter();
+        else {
+            autofilter.setRange(range);
+            SortState &sort = autofilter.sortState();
+            if (sort.range.isValid() && !shift.adjust(sort.range))
+                autofilter.clearSortState();
+            else {
+                for (int i = sort.sortConditions.size() - 1; i >= 0; --i) {
+                    if (!shift.adjust(sort.sortConditions[i].range))
+                        sort.sortConditions.removeAt(i);
+                }
+            }
+        }
+    }
+
+    if (dimension.isValid() && !shift.adjust(dimension))
+        dimension = CellRange();
+    validateDimension();
+    return true;
+}
+
+/*!
+ * \internal
+ * Makes single formulas of the shared formulas of this sheet whose cells or
+ * relative references to \a target would be adjusted by different offsets, so
+ * the text of the master cell can no longer describe them.
+ * Returns true if any formula has been split.
+ */
+bool WorksheetPrivate::splitSharedFormulas(const Worksheet *target, const SheetShift &shift,
+                                           const ReferenceIndex *index)
+{
+    Q_Q(Worksheet);
+    QList<int> indexes;
+    for (auto it = sharedFormulaMap.constBegin(); it != sharedFormulaMap.constEnd(); ++it) {
+        const CellRange cells = it->reference();
+        if (!cells.isValid())
+            continue;
+        bool splits = q == target
+                && (shift.rows ? shift.splits(cells.firstRow(), cells.lastRow())
+                               : shift.splits(cells.firstColumn(), cells.lastColumn()));
+        if (!splits) {
+            const FormulaTemplatePtr formula = workbook->d_func()->formulaCache->compile(
+                        it->text(), cells.firstRow(), cells.firstColumn());
+            const QVector<FormulaReference> references = formula->references();
+            for (const FormulaReference &reference: references) {
+                if (index->resolveSheet(reference.sheet, q) == target && shift.splits(reference, cells)) {
+                    splits = true;
+                    break;
+                }
+            }
+        }
+        if (splits)
+            indexes << it.key();
+    }
+    for (int sharedIndex: qAsConst(indexes))
+        unshareFormula(sharedIndex);
+    return !indexes.isEmpty();
+}
+
+/*!
+ * \internal
+ * Gives each cell of the shared formula \a sharedIndex its own formula text.
+ */
+void WorksheetPrivate::unshareFormula(int sharedIndex)
+{
+    const CellFormula master = sharedFormulaMap.take(sharedIndex);
+    const CellRange range = master.reference();
+    if (!range.isValid())
+        return;
+    const FormulaTemplatePtr formula = workbook->d_func()->formulaCache->compile(
+                master.text(), range.firstRow(), range.firstColumn());
+
+    QVector<QPair<int, int> > cells;
+    forEachCell(range, [&](int rowOffset, int columnOffset, const Cell *cell) {
+        const CellFormula cellFormula = cell->formula();
+        if (cellFormula.type().value_or(CellFormula::Type::Normal) == CellFormula::Type::Shared
+            && cellFormula.sharedIndex() == sharedIndex)
+            cells.append(qMakePair(range.firstRow() + rowOffset, range.firstColumn() + columnOffset));
+    });
+    for (const auto &position: qAsConst(cells)) {
+        Cell *cell = detachedCell(position.first, position.second);
+        const std::optional<bool> recalculate = cell->formula().needsRecalculation();
+        CellFormula single(formula->toA1(position.first, position.second));
+        if (recalculate.has_value())
+            single.setNeedsRecalculation(recalculate.value());
+        cell->assignFormula(single);
+    }
+}
+
+/*!
+ * \internal
+ * Gives their own formula texts to the cells of the shared formulas that have
+ * cells in \a range. Returns true if there were any.
+ */
+bool WorksheetPrivate::unshareFormulas(const CellRange &range)
+{
+    QList<int> indexes;
+    for (auto it = sharedFormulaMap.constBegin(); it != sharedFormulaMap.constEnd(); ++it) {
+        if (intersects(it->reference(), range))
+            indexes << it.key();
+    }
+    for (int sharedIndex: qAsConst(indexes))
+        unshareFormula(sharedIndex);
+    return !indexes.isEmpty();
+}
+
+/*!
+ * \internal
+ * Removes the cells of \a range. The rows that lie within the range are removed
+ * whole.
+ */
+void WorksheetPrivate::removeCells(const CellRange &range)
+{
+    auto rowIt = cellTable.lowerBound(range.firstRow());
+    while (rowIt != cellTable.end() && rowIt.key() <= range.lastRow()) {
+        const int row = rowIt.key();
+        QMap<int, std::shared_ptr<Cell> > &cells = rowIt.value();
+        if (cells.lastKey() < range.firstColumn() || cells.firstKey() > range.lastColumn()) {
+            ++rowIt;
+            continue;
+        }
+        if (cells.firstKey() >= range.firstColumn() && cells.lastKey() <= range.lastColumn()) {
+            for (auto it = cells.constBegin(); it != cells.constEnd(); ++it)
+                recordChange(row, it.key());
+            rowIt = cellTable.erase(rowIt);
+            continue;
+        }
+        for (auto it = cells.lowerBound(range.firstColumn()); it != cells.end() && it.key() <= range.lastColumn();) {
+            recordChange(row, it.key());
+            it = cells.erase(it);
+        }
+        ++rowIt;
+    }
+    cellsModified(range);
+}
+
+/*!
+ * \internal
+ * Clears the cells of \a range the way an empty cell copied with \a options
+ * does: without the formats only the values are removed, without the values
+ * only the formats.
+ */
+void WorksheetPrivate::clearCells(const CellRange &range, Worksheet::CopyOptions options)
+{
+    Q_Q(Worksheet);
+    const bool values = options.testFlag(Worksheet::CopyValues);
+    const bool formats = options.testFlag(Worksheet::CopyFormats);
+    if (values && formats) {
+        removeCells(range);
+        return;
+    }
+    if (!values && !formats)
+        return;
+
+    QVector<QPair<int, int> > positions;
+    forEachCell(range, [&](int rowOffset, int columnOffset, const Cell *) {
+        positions.append(qMakePair(range.firstRow() + rowOffset, range.firstColumn() + columnOffset));
+    });
+    for (const auto &position: qAsConst(positions)) {
+        if (formats) {
+            detachedCell(position.first, position.second)->assignFormat(Format());
+            continue;
+        }
+        const Format format = cellFormat(position.first, position.second);
+        if (format.isValid())
+            setCell(position.first, position.second, std::make_shared<Cell>(QVariant{}, Cell::Type::Number, format, q));
+        else
+            removeCells(CellRange(position.first, position.second, position.first, position.second));
+    }
+}
+
+/*!
+ * \internal
+ * Copies or moves the cells of \a source to \a target. The source rows are
+ * collected first, so the ranges may overlap. The cells are shared with the
+ * source within a sheet and copied without conversions otherwise; a row of
+ * cells that needs no changes is stored as the same row map. Only the formula
+ * cells get new texts, and the formats are registered once per distinct format
+ * if the target is in another workbook.
+ */
+bool WorksheetPrivate::copyCells(const CellRange &source, Worksheet *target, const CellReference &destination,
+                                 Worksheet::CopyOptions options, bool move)
+{
+    Q_Q(Worksheet);
+    if (!target || !source.isValid() || !destination.isValid() || !rowValid(source.firstRow())
+        || !rowValid(source.lastRow()) || !columnValid(source.firstColumn()) || !columnValid(source.lastColumn()))
+        return false;
+    const int rowOffset = destination.row() - source.firstRow();
+    const int columnOffset = destination.column() - source.firstColumn();
+    const CellRange area = translated(source, rowOffset, columnOffset);
+    if (!rowValid(area.firstRow()) || !rowValid(area.lastRow())
+        || !columnValid(area.firstColumn()) || !columnValid(area.lastColumn()))
+        return false;
+    if (target == q && rowOffset == 0 && columnOffset == 0)
+        return true;
+
+    auto t = target->d_func();
+    const bool sameBook = t->workbook == workbook;
+    const bool values = options.testFlag(Worksheet::CopyValues);
+    const bool formats = options.testFlag(Worksheet::CopyFormats);
+
+    //1. the shared formulas that would lose cells or the master cell
+    if (values) {
+        t->unshareFormulas(area);
+        if (move)
+            unshareFormulas(source);
+    }
+
+    //2. the references to the moved cells follow them
+    bool prefixSheet = false;
+    if (move && sameBook) {
+        auto book_d = workbook->d_func();
+        if (!book_d->referenceIndex)
+            book_d->referenceIndex = std::make_shared<ReferenceIndex>(workbook);
+        ReferenceIndex *index = book_d->referenceIndex.get();
+        index->update();
+
+        //only some cells of a shared formula may refer to the moved cells
+        bool split = false;
+        const auto referring = index->sites(q, source);
+        for (const ReferenceSite &site: referring) {
+            if (site.kind != ReferenceSite::Kind::Cell)
+                continue;
+            const Cell *cell = static_cast<const Worksheet *>(site.sheet)->cell(site.row, site.column);
+            const CellFormula formula = cell ? cell->formula() : CellFormula();
+            if (formula.type().value_or(CellFormula::Type::Normal) == CellFormula::Type::Shared) {
+                site.sheet->d_func()->unshareFormula(formula.sharedIndex().value_or(-1));
+                split = true;
+            }
+        }
+        if (split)
+            index->update();
+
+        const QString targetName = target->name();
+        const auto sites = index->sites(q, source);
+        for (const ReferenceSite &site: sites) {
+            const bool onSheet = site.kind == ReferenceSite::Kind::Cell
+                    || site.kind == ReferenceSite::Kind::DataValidation
+                    || site.kind == ReferenceSite::Kind::ConditionalFormatting;
+            const AbstractSheet *host = onSheet ? site.sheet : nullptr;
+            index->rewrite(site, [&](FormulaReference &reference) {
+                if (reference.wholeRows || reference.wholeColumns
+                    || index->resolveSheet(reference.sheet, host) != q || !source.contains(reference.range()))
+                    return false;
+                reference.firstRow += rowOffset;
+                reference.lastRow += rowOffset;
+                reference.firstColumn += columnOffset;
+                reference.lastColumn += columnOffset;
+                if (target != q)
+                    reference.sheet = host == target ? QString() : targetName;
+                return true;
+            });
+        }
+        //the other references of the moved formulas keep pointing to this sheet
+        prefixSheet = target != q;
+    }
+
+    //3. the source cells
+    QHash<QByteArray, Format> importedFormats;
+    auto importFormat = [&](const Format &format) {
+        if (sameBook || !format.isValid())
+            return format;
+        const QByteArray key = format.formatKey();
+        auto it = importedFormats.constFind(key);
+        if (it != importedFormats.constEnd())
+            return it.value();
+        const Format imported = Styles::unregisteredFormat(format);
+        t->registerFormat(imported);
+        importedFormats.insert(key, imported);
+        return imported;
+    };
+    const QString sheetName = q->name();
+    auto addSheetName = [&sheetName](FormulaReference &reference) {
+        if (!reference.sheet.isEmpty())
+            return false;
+        reference.sheet = sheetName;
+        return true;
+    };
+    auto copyCell = [&](int row, int column, const std::shared_ptr<Cell> &cell) {
+        std::optional<CellFormula> formula;
+        if (cell->hasFormula()) {
+            const CellFormula original = cell->formula();
+            const auto type = original.type().value_or(CellFormula::Type::Normal);
+            if (type == CellFormula::Type::Normal || type == CellFormula::Type::Shared
+                || type == CellFormula::Type::Array) {
+                QString text = formulaTemplate(row, column, cell.get())->toA1(move ? row : row + rowOffset,
+                                                                             move ? column : column + columnOffset);
+                if (prefixSheet)
+                    text = ReferenceIndex::rewriteFormula(text, addSheetName);
+                CellFormula copied = type == CellFormula::Type::Array
+                        ? CellFormula(text, translated(original.reference(), rowOffset, columnOffset), type)
+                        : CellFormula(text);
+                if (original.needsRecalculation().has_value())
+                    copied.setNeedsRecalculation(original.needsRecalculation().value());
+                if (copied != original)
+                    formula = copied;
+            }
+        }
+        //cells are shared within a sheet and copied on modification
+        if (target == q && !formula)
+            return cell;
+        auto result = std::make_shared<Cell>(cell.get());
+        result->setParent(target);
+        if (!sameBook)
+            result->assignFormat(importFormat(cell->format()));
+        //the string of a loaded cell is not in its rich string
+        if (cell->type() == Cell::Type::SharedString)
+            t->stringRegistry()->addSharedString(cell->isRichString() ? cell->richString()
+                                                                      : RichString(cell->value().toString()));
+        if (formula)
+            result->assignFormula(formula.value());
+        return result;
+    };
+
+    QMap<int, QMap<int, std::shared_ptr<Cell> > > block; //by the target row and column
+    int firstColumn = XLSX_COLUMN_MAX + 1;
+    int lastColumn = 0;
+    const auto rowEnd = cellTable.upperBound(source.lastRow());
+    for (auto rowIt = cellTable.lowerBound(source.firstRow()); rowIt != rowEnd; ++rowIt) {
+        const int row = rowIt.key();
+        const QMap<int, std::shared_ptr<Cell> > &cells = rowIt.value();
+        const auto cellEnd = cells.upperBound(source.lastColumn());
+        auto it = cells.lowerBound(source.firstColumn());
+        if (it == cellEnd)
+            continue;
+        firstColumn = qMin(firstColumn, it.key() + columnOffset);
+        QMap<int, std::shared_ptr<Cell> > copied;
+        bool unchanged = columnOffset == 0;
+        for (; it != cellEnd; ++it) {
+            std::shared_ptr<Cell> cell = values ? copyCell(row, it.key(), it.value()) : it.value();
+            if (cell != it.value())
+                unchanged = false;
+            lastColumn = qMax(lastColumn, it.key() + columnOffset);
+            copied.insert(copied.constEnd(), it.key() + columnOffset, std::move(cell));
+        }
+        const bool whole = cells.firstKey() >= source.firstColumn() && cells.lastKey() <= source.lastColumn();
+        block.insert(block.constEnd(), row + rowOffset, whole && unchanged ? cells : copied);
+    }
+
+    //4. the sheet objects of the source
+    QList<CellRange> mergedRanges;
+    if (options.testFlag(Worksheet::CopyMerges)) {
+        for (auto it = merges.begin(); it != merges.end();) {
+            if (source.contains(*it)) {
+                mergedRanges << translated(*it, rowOffset, columnOffset);
+                if (move) {
+                    it = merges.erase(it);
+                    continue;
+                }
+            }
+            ++it;
+        }
+    }
+
+    QMap<int, QMap<int, QSharedPointer<XlsxHyperlinkData> > > links; //by the target row and column
+    if (options.testFlag(Worksheet::CopyHyperlinks)) {
+        const auto linkRowEnd = urlTable.upperBound(source.lastRow());
+        for (auto rowIt = urlTable.lowerBound(source.firstRow()); rowIt != linkRowEnd; ++rowIt) {
+            const auto linkEnd = rowIt->upperBound(source.lastColumn());
+            for (auto it = rowIt->lowerBound(source.firstColumn()); it != linkEnd; ++it)
+                links[rowIt.key() + rowOffset].insert(it.key() + columnOffset,
+                                                      QSharedPointer<XlsxHyperlinkData>::create(*it.value()));
+        }
+        if (move)
+            removeHyperlinks(urlTable, source);
+    }
 
-int Worksheet::chartsCount() const
-{
-    Q_D(const Worksheet);
-    int count = 0;
+    QList<DataValidation> validations;
+    if (options.testFlag(Worksheet::CopyValidations)) {
+        for (int i = dataValidationsList.size() - 1; i >= 0; --i) {
+            const QList<CellRange> ranges = dataValidationsList.at(i).ranges();
+            QList<CellRange> copied;
+            QList<CellRange> remaining;
+            for (const CellRange &range: ranges) {
+                if (!intersects(range, source)) {
+                    remaining << range;
+                    continue;
+                }
+                copied << translated(intersected(range, source), rowOffset, columnOffset);
+                remaining << subtractRange(range, source);
+            }
+            if (copied.isEmpty())
+                continue;
+
+            DataValidation validation = dataValidationsList.at(i);
+            for (const CellRange &range: ranges)
+                validation.removeRange(range);
+            for (const CellRange &range: qAsConst(copied))
+                validation.addRange(range);
+            if (!move) {
+                //the relative references follow the range like in the formulas
+                FormulaCache *cache = workbook->d_func()->formulaCache.get();
+                validation.setFormula1(cache->compile(validation.formula1(), source.firstRow(), source.firstColumn())
+                                       ->toA1(area.firstRow(), area.firstColumn()));
+                if (!validation.formula2().isEmpty())
+                    validation.setFormula2(cache->compile(validation.formula2(), source.firstRow(), source.firstColumn())
+                                           ->toA1(area.firstRow(), area.firstColumn()));
+            }
+            validations.prepend(validation);
 
-    if (d->drawing) {
-        for (auto anchor: qAsConst(d->drawing->anchors)) {
-            if (anchor && anchor->isChart())
-                count++;
+            if (move) {
+                if (remaining.isEmpty()) {
+                    dataValidationsList.removeAt(i);
+                    continue;
+                }
+                DataValidation &moved = dataValidationsList[i];
+                for (const CellRange &range: ranges)
+                    moved.removeRange(range);
+                for (const CellRange &range: qAsConst(remaining))
+                    moved.addRange(range);
+            }
         }
     }
-    return count;
-}
 
-bool Worksheet::mergeCells(const CellRange &range, const Format &format)
-{
-    Q_D(Worksheet);
-    if (range.rowCount() < 2 && range.columnCount() < 2)
-        return false;
+    //5. the target
+    t->clearCells(area, options);
+    if (values && formats) {
+        for (auto rowIt = block.constBegin(); rowIt != block.constEnd(); ++rowIt) {
+            QMap<int, std::shared_ptr<Cell> > &cells = t->cellTable[rowIt.key()];
+            if (cells.isEmpty())
+                cells = rowIt.value();
+            else {
+                for (auto it = rowIt->constBegin(); it != rowIt->constEnd(); ++it)
+                    cells.insert(it.key(), it.value());
+            }
+            if (t->trackChanges) {
+                for (auto it = rowIt->constBegin(); it != rowIt->constEnd(); ++it)
+                    t->recordChange(rowIt.key(), it.key());
+            }
+        }
+        t->cellsModified(area);
+    }
+    else if (values || formats) {
+        for (auto rowIt = block.constBegin(); rowIt != block.constEnd(); ++rowIt) {
+            const int row = rowIt.key();
+            for (auto it = rowIt->constBegin(); it != rowIt->constEnd(); ++it) {
+                if (values) {
+                    //the strings of the block are registered by copyCell()
+                    auto cell = std::make_shared<Cell>(it.value().get());
+                    cell->setParent(target);
+                    cell->assignFormat(t->cellFormat(row, it.key()));
+                    t->setCell(row, it.key(), cell);
+                    continue;
+                }
+                const Format format = importFormat(it.value()->format());
+                if (Cell *cell = t->detachedCell(row, it.key()))
+                    cell->assignFormat(format);
+                else if (format.isValid())
+                    t->setCell(row, it.key(), std::make_shared<Cell>(QVariant{}, Cell::Type::Number, format, target));
+            }
+        }
+    }
+    if (!block.isEmpty() && (values || formats)) {
+        t->addRowToDimensions(block.firstKey());
+        t->addRowToDimensions(block.lastKey());
+        t->addColumnToDimensions(firstColumn);
+        t->addColumnToDimensions(lastColumn);
+    }
 
-    if (!d->addRowToDimensions(range.firstRow())) return false;
-    if (!d->addColumnToDimensions(range.firstColumn())) return false;
+    if (options.testFlag(Worksheet::CopyMerges)) {
+        for (auto it = t->merges.begin(); it != t->merges.end();) {
+            if (intersects(*it, area))
+                it = t->merges.erase(it);
+            else
+                ++it;
+        }
+        t->merges << mergedRanges;
+    }
 
-    if (format.isValid())
-        d->workbook->styles()->addXfFormat(format);
+    if (options.testFlag(Worksheet::CopyHyperlinks)) {
+        removeHyperlinks(t->urlTable, area);
+        for (auto rowIt = links.constBegin(); rowIt != links.constEnd(); ++rowIt) {
+            for (auto it = rowIt->constBegin(); it != rowIt->constEnd(); ++it)
+                t->urlTable[rowIt.key()].insert(it.key(), it.value());
+        }
+    }
 
-    for (int row = range.firstRow(); row <= range.lastRow(); ++row) {
-        for (int col = range.firstColumn(); col <= range.lastColumn(); ++col) {
-            if (row == range.firstRow() && col == range.firstColumn()) {
-                if (Cell *c = cell(row, col)) {
-                    if (format.isValid())
-                        c->setFormat(format);
-                }
-                else
-                    writeBlank(row, col, format);
+    if (options.testFlag(Worksheet::CopyValidations)) {
+        for (int i = t->dataValidationsList.size() - 1; i >= 0; --i) {
+            const QList<CellRange> ranges = t->dataValidationsList.at(i).ranges();
+            QList<CellRange> remaining;
+            for (const CellRange &range: ranges)
+                remaining << subtractRange(range, area);
+            if (remaining == ranges)
+                continue;
+            if (remaining.isEmpty()) {
+                t->dataValidationsList.removeAt(i);
+                continue;
             }
-            else
-                writeBlank(row, col, format);
+            DataValidation &validation = t->dataValidationsList[i];
+            for (const CellRange &range: ranges)
+                validation.removeRange(range);
+            for (const CellRange &range: qAsConst(remaining))
+                validation.addRange(range);
         }
+        t->dataValidationsList << validations;
+    }
+    if (options.testFlag(Worksheet::CopyMerges) || options.testFlag(Worksheet::CopyValidations)) {
+        invalidateRangeIndexes();
+        t->invalidateRangeIndexes();
     }
 
-    d->merges.append(range);
+    //6. the moved cells that have not been overwritten
+    if (move) {
+        if (target == q && intersects(source, area)) {
+            const QList<CellRange> parts = subtractRange(source, area);
+            for (const CellRange &part: parts)
+                clearCells(part, options);
+        }
+        else
+            clearCells(source, options);
+    }
     return true;
 }
 
-bool Worksheet::unmergeCells(const CellRange &range)
-{
-    Q_D(Worksheet);
-    return d->merges.removeOne(range);
-}
-
-QList<CellRange> Worksheet::mergedCells() const
+/*!
+ * \internal
+ */
+void Worksheet::saveToXmlFile(QIODevice *device) const
 {
-    Q_D(const Worksheet);
-    return d->merges;
+    saveToXmlFile(device, true);
 }
 
 /*!
  * \internal
+ * If \a saveSheetData is false, the sheetData element is written empty. The
+ * rest of the part is written as usual.
  */
-void Worksheet::saveToXmlFile(QIODevice *device) const
+void Worksheet::saveToXmlFile(QIODevice *device, bool saveSheetData) const
 {
     Q_D(const Worksheet);
     d->relationships->clear();
@@ -1912,7 +3836,7 @@ void Worksheet::saveToXmlFile(QIODevice *device) const
     }
     //6. sheetData
     writer.writeStartElement(QLatin1String("sheetData"));
-    if (d->dimension.isValid())
+    if (saveSheetData && d->dimension.isValid())
         d->saveXmlSheetData(writer);
     writer.writeEndElement();//sheetData
 
@@ -2006,10 +3930,210 @@ void Worksheet::saveToXmlFile(QIODevice *device) const
     writer.writeEndDocument();
 }
 
+namespace {
+
+/*!
+ * \internal
+ * The normal formulas that are saved as shared formulas: the runs of adjacent
+ * cells in a column, or else in a row, whose formulas are equal in the R1C1
+ * notation. The first cell of a run keeps the formula text and the range of
+ * the run, the other cells refer to it by the shared index.
+ *
+ * The formulas of a run differ only in the letters and digits of their
+ * references, so a formula is compiled only when the rest of its text matches
+ * the formula of the previous cell; the other formulas are not tokenized.
+ */
+class SharedFormulaPlan
+{
+public:
+    void build(const WorksheetPrivate *d);
+    bool isEmpty() const { return m_groups.isEmpty(); }
+    CellFormula formula(int row, int column, const Cell *cell) const;
+
+private:
+    struct Group
+    {
+        CellRange range;
+        int sharedIndex;
+    };
+    struct Run
+    {
+        int first = 0;
+        int last = 0;
+        int row = 0; //of the first cell
+        int column = 0;
+        const Cell *cell = nullptr;
+        QString skeleton; //the formula text without letters and digits
+        FormulaTemplatePtr formula; //compiled on the first comparison
+        std::optional<bool> needsRecalculation;
+    };
+    using Runs = QHash<int, QMap<int, int> >; //column (row) -> first row (column) -> group
+
+    static bool joins(const WorksheetPrivate *d, Run &run, Run &next);
+    void addGroup(const CellRange &range, Runs &runs, int key, int first);
+    const Group *find(const Runs &runs, int key, int position, int row, int column) const;
+
+    QVector<Group> m_groups;
+    Runs m_columnRuns;
+    Runs m_rowRuns;
+    int m_nextIndex = 0;
+};
+
+/*!
+ * \internal
+ * Returns true if the formula of the cell \a next is equal to the formula of
+ * \a run in the R1C1 notation. The formulas are compiled only if their texts
+ * match except for the letters and digits.
+ */
+bool SharedFormulaPlan::joins(const WorksheetPrivate *d, Run &run, Run &next)
+{
+    if (run.skeleton != next.skeleton || run.needsRecalculation != next.needsRecalculation)
+        return false;
+    if (!run.formula)
+        run.formula = d->formulaTemplate(run.row, run.column, run.cell);
+    if (!run.formula->isValid())
+        return false;
+    if (!next.formula)
+        next.formula = d->formulaTemplate(next.row, next.column, next.cell);
+    return next.formula == run.formula;
+}
+
+void SharedFormulaPlan::build(const WorksheetPrivate *d)
+{
+    //the loaded shared formulas keep their indexes
+    if (!d->sharedFormulaMap.isEmpty())
+        m_nextIndex = d->sharedFormulaMap.lastKey() + 1;
+
+    auto candidate = [](int row, int column, const Cell *cell, Run &run) {
+        if (!cell->hasFormula())
+            return false;
+        const CellFormula formula = cell->formula();
+        if (formula.type().value_or(CellFormula::Type::Normal) != CellFormula::Type::Normal
+            || formula.text().isEmpty())
+            return false;
+        const QString text = formula.text();
+        run = Run();
+        run.first = run.last = row;
+        run.row = row;
+        run.column = column;
+        run.cell = cell;
+        run.skeleton.reserve(text.size());
+        for (const QChar &c: text) {
+            if (!c.isLetterOrNumber())
+                run.skeleton.append(c);
+        }
+        run.needsRecalculation = formula.needsRecalculation();
+        return true;
+    };
+
+    //1. runs in the columns; the single cells are left for the runs in the rows
+    QHash<int, Run> open; //by column
+    QMap<int, QMap<int, Run> > singles; //row -> column -> cell
+    auto close = [this, &singles](int column, const Run &run) {
+        if (run.last > run.first)
+            addGroup(CellRange(run.first, column, run.last, column), m_columnRuns, column, run.first);
+        else
+            singles[run.first].insert(column, run);
+    };
+    for (auto rowIt = d->cellTable.constBegin(); rowIt != d->cellTable.constEnd(); ++rowIt) {
+        const int row = rowIt.key();
+        for (auto it = rowIt.value().constBegin(); it != rowIt.value().constEnd(); ++it) {
+            Run next;
+            const bool formula = candidate(row, it.key(), it.value().get(), next);
+            auto runIt = open.find(it.key());
+            if (runIt != open.end()) {
+                if (formula && runIt->last == row - 1 && joins(d, runIt.value(), next)) {
+                    runIt->last = row;
+                    continue;
+                }
+                close(it.key(), runIt.value());
+                open.erase(runIt);
+            }
+            if (formula)
+                open.insert(it.key(), next);
+        }
+    }
+    for (auto it = open.constBegin(); it != open.constEnd(); ++it)
+        close(it.key(), it.value());
+
+    //2. runs in the rows
+    for (auto rowIt = singles.constBegin(); rowIt != singles.constEnd(); ++rowIt) {
+        Run run;
+        for (auto it = rowIt.value().constBegin(); it != rowIt.value().constEnd(); ++it) {
+            Run next = it.value();
+            if (run.cell && run.last == it.key() - 1 && joins(d, run, next)) {
+                run.last = it.key();
+                continue;
+            }
+            if (run.last > run.first)
+                addGroup(CellRange(rowIt.key(), run.first, rowIt.key(), run.last), m_rowRuns, rowIt.key(), run.first);
+            run = next;
+            run.first = run.last = it.key();
+        }
+        if (run.last > run.first)
+            addGroup(CellRange(rowIt.key(), run.first, rowIt.key(), run.last), m_rowRuns, rowIt.key(), run.first);
+    }
+}
+
+void SharedFormulaPlan::addGroup(const CellRange &range, Runs &runs, int key, int first)
+{
+    runs[key].insert(first, m_groups.size());
+    m_groups.append({range, m_nextIndex++});
+}
+
+const SharedFormulaPlan::Group *SharedFormulaPlan::find(const Runs &runs, int key, int position,
+                                                        int row, int column) const
+{
+    auto it = runs.constFind(key);
+    if (it == runs.constEnd())
+        return nullptr;
+    auto groupIt = it.value().upperBound(position);
+    if (groupIt == it.value().constBegin())
+        return nullptr;
+    --groupIt;
+    const Group &group = m_groups.at(groupIt.value());
+    return group.range.contains(row, column) ? &group : nullptr;
+}
+
+/*!
+ * \internal
+ * Returns the formula to save for \a cell at (\a row, \a column).
+ */
+CellFormula SharedFormulaPlan::formula(int row, int column, const Cell *cell) const
+{
+    const CellFormula formula = cell->formula();
+    const Group *group = find(m_columnRuns, column, row, row, column);
+    if (!group)
+        group = find(m_rowRuns, row, column, row, column);
+    if (!group)
+        return formula;
+
+    const bool master = row == group->range.firstRow() && column == group->range.firstColumn();
+    CellFormula shared = master ? CellFormula(formula.text(), group->range, CellFormula::Type::Shared)
+                                : CellFormula(QString(), CellFormula::Type::Shared);
+    shared.setSharedIndex(group->sharedIndex);
+    if (formula.needsRecalculation().has_value())
+        shared.setNeedsRecalculation(formula.needsRecalculation().value());
+    return shared;
+}
+
+}
+
 void WorksheetPrivate::saveXmlSheetData(QXmlStreamWriter &writer) const
 {
     QMap<int, QString> rowSpans = calculateSpans();
+    SharedFormulaPlan sharedFormulas;
+    if (workbook->isSharedFormulasEnabled())
+        sharedFormulas.build(this);
+    ProgressControl *progress = this->progress();
     for (int row = dimension.firstRow(); row <= dimension.lastRow(); row++) {
+        if (progress) {
+            //the document will not be saved, no need to write the rest
+            if (progress->isCanceled())
+                return;
+            progress->setPartProgress(row - dimension.firstRow());
+        }
+
         auto ctIt = cellTable.constFind(row);
         auto riIt = rowsInfo.constFind(row);
         auto cmIt = comments.constFind(row);
@@ -2050,15 +4174,21 @@ void WorksheetPrivate::saveXmlSheetData(QXmlStreamWriter &writer) const
         //Write cell data if row contains filled cells
         if (ctIt != cellTable.constEnd()) {
             for (int col_num = dimension.firstColumn(); col_num <= dimension.lastColumn(); col_num++) {
-                if (ctIt->contains(col_num))
-                    saveXmlCellData(writer, row, col_num, (*ctIt)[col_num]);
+                auto cellIt = ctIt->constFind(col_num);
+                if (cellIt == ctIt->constEnd())
+                    continue;
+                const Cell *cell = cellIt->get();
+                const CellFormula formula = cell->hasFormula() && !sharedFormulas.isEmpty()
+                        ? sharedFormulas.formula(row, col_num, cell) : cell->formula();
+                saveXmlCellData(writer, row, col_num, cellIt.value(), formula);
             }
         }
         writer.writeEndElement(); //row
     }
 }
 
-void WorksheetPrivate::saveXmlCellData(QXmlStreamWriter &writer, int row, int col, std::shared_ptr<Cell> cell) const
+void WorksheetPrivate::saveXmlCellData(QXmlStreamWriter &writer, int row, int col, std::shared_ptr<Cell> cell,
+                                       const CellFormula &formula) const
 {
     writer.writeStartElement(QLatin1String("c"));
     writer.writeAttribute(QLatin1String("r"), CellReference(row, col).toString());
@@ -2091,7 +4221,7 @@ void WorksheetPrivate::saveXmlCellData(QXmlStreamWriter &writer, int row, int co
             writer.writeAttribute(QLatin1String("t"), QLatin1String("n")); // dev67
 
             if (cell->hasFormula())
-                cell->formula().saveToXml(writer);
+                formula.saveToXml(writer);
 
             if (cell->value().isValid()) {   //note that, invalid value means 'v' is blank
                 double value = cell->value().toDouble();
@@ -2102,7 +4232,7 @@ void WorksheetPrivate::saveXmlCellData(QXmlStreamWriter &writer, int row, int co
         case Cell::Type::Formula: {// 'str'
             writer.writeAttribute(QLatin1String("t"), QLatin1String("str"));
             if (cell->hasFormula())
-                cell->formula().saveToXml(writer);
+                formula.saveToXml(writer);
 
             writer.writeTextElement(QLatin1String("v"), cell->value().toString());
             break;
@@ -2112,7 +4242,7 @@ void WorksheetPrivate::saveXmlCellData(QXmlStreamWriter &writer, int row, int co
 
             // dev34
             if (cell->hasFormula())
-                cell->formula().saveToXml(writer);
+                formula.saveToXml(writer);
 
             writer.writeTextElement(QLatin1String("v"), cell->value().toBool() ? QLatin1String("1") : QLatin1String("0"));
             break;
@@ -2125,17 +4255,21 @@ void WorksheetPrivate::saveXmlCellData(QXmlStreamWriter &writer, int row, int co
 
             // number type. see for 18.18.11 ST_CellType (Cell Type) more information.
             writer.writeAttribute(QLatin1String("t"), QLatin1String("n"));
+            if (cell->hasFormula())
+                formula.saveToXml(writer);
             writer.writeTextElement(QLatin1String("v"), cell->value().toString() );
             break;
         }
         case Cell::Type::Error: {// 'e'
             writer.writeAttribute(QLatin1String("t"), QLatin1String("e"));
+            if (cell->hasFormula())
+                formula.saveToXml(writer);
             writer.writeTextElement(QLatin1String("v"), cell->value().toString() );
             break;
         }
         default: { //Cell::CustomType
             if (cell->hasFormula())
-                cell->formula().saveToXml(writer);
+                formula.saveToXml(writer);
 
             if (cell->value().isValid()) {   //note that, invalid value means 'v' is blank
                 double value = cell->value().toDouble();
@@ -2303,7 +4437,7 @@ bool Worksheet::setColumnFormat(int colFirst, int colLast, const Format &format)
     for (int i=colFirst; i<=colLast; ++i)
         d->colsInfo[i].format = format;
 
-    d->workbook->styles()->addXfFormat(format);
+    d->registerFormat(format);
     return true;
 }
 
@@ -2368,9 +4502,7 @@ bool Worksheet::setRowHeight(int rowFirst, int rowLast, double height)
     if (!d->addRowToDimensions(rowLast)) return false;
 
     for (int row = rowFirst; row <= rowLast; ++row) {
-        if (!d->rowsInfo.contains(row))
-            d->rowsInfo[row] = QSharedPointer<XlsxRowInfo>(new XlsxRowInfo());
-        d->rowsInfo[row]->height = height;
+        d->detachedRowInfo(row)->height = height;
         d->addRowToDimensions(row);
     }
 
@@ -2390,12 +4522,10 @@ bool Worksheet::setRowFormat(int rowFirst,int rowLast, const Format &format)
     if (!d->addRowToDimensions(rowLast)) return false;
 
     for (int row = rowFirst; row <= rowLast; ++row) {
-        if (!d->rowsInfo.contains(row))
-            d->rowsInfo[row] = QSharedPointer<XlsxRowInfo>(new XlsxRowInfo());
-        d->rowsInfo[row]->format = format;
+        d->detachedRowInfo(row)->format = format;
         d->addRowToDimensions(row);
     }
-    d->workbook->styles()->addXfFormat(format);
+    d->registerFormat(format);
 
     return true;
 }
@@ -2413,9 +4543,7 @@ bool Worksheet::setRowHidden(int rowFirst,int rowLast, bool hidden)
     if (!d->addRowToDimensions(rowLast)) return false;
 
     for (int row = rowFirst; row <= rowLast; ++row) {
-        if (!d->rowsInfo.contains(row))
-            d->rowsInfo[row] = QSharedPointer<XlsxRowInfo>(new XlsxRowInfo());
-        d->rowsInfo[row]->hidden = hidden;
+        d->detachedRowInfo(row)->hidden = hidden;
         d->addRowToDimensions(row);
     }
 
@@ -2466,23 +4594,13 @@ bool Worksheet::groupRows(int rowFirst, int rowLast, bool collapsed)
     if (maximumOutlineLevel >= 7) return false;
 
     for (int row=rowFirst; row<=rowLast; ++row) {
-        auto it = d->rowsInfo.find(row);
-        if (it != d->rowsInfo.end()) {
-            (*it)->outlineLevel = (*it)->outlineLevel.value_or(0) + 1;
-        } else {
-            QSharedPointer<XlsxRowInfo> info(new XlsxRowInfo);
-            info->outlineLevel = info->outlineLevel.value_or(0) + 1;
-            it = d->rowsInfo.insert(row, info);
-        }
+        XlsxRowInfo *info = d->detachedRowInfo(row);
+        info->outlineLevel = info->outlineLevel.value_or(0) + 1;
         if (collapsed)
-            (*it)->hidden = true;
-    }
-    if (collapsed) {
-        auto it = d->rowsInfo.find(rowLast+1);
-        if (it == d->rowsInfo.end())
-            it = d->rowsInfo.insert(rowLast+1, QSharedPointer<XlsxRowInfo>(new XlsxRowInfo));
-        (*it)->collapsed = true;
+            info->hidden = true;
     }
+    if (collapsed)
+        d->detachedRowInfo(rowLast+1)->collapsed = true;
     d->sheetFormatProperties.outlineLevelRow = maximumOutlineLevel+1;
     return true;
 }
@@ -2711,6 +4829,27 @@ void WorksheetPrivate::loadXmlSheetData(QXmlStreamReader &reader)
 
     const auto &name = reader.name();
 
+    ProgressControl *progress = this->progress();
+
+    //with a row filter, the cells and the info of a row are kept until the whole
+    //row is tested
+    std::unique_ptr<RowFilterMatcher> matcher;
+    if (!loadFilter.isEmpty())
+        matcher.reset(new RowFilterMatcher(loadFilter, sharedStrings()));
+    QVector<XlsxRawCell> rowCells;
+    QSharedPointer<XlsxRowInfo> rowInfo;
+    auto finishRow = [&](int row) {
+        if (matcher->rowPasses()) {
+            if (rowInfo)
+                rowsInfo[row] = rowInfo;
+            for (const auto &raw: qAsConst(rowCells))
+                setCell(raw.row, raw.column, createLoadedCell(raw));
+        }
+        rowCells.clear();
+        rowInfo.reset();
+        matcher->beginRow();
+    };
+
     //since row numbers are optional, we need to track the current row
     int currentRow = 0;
     while (!reader.atEnd())    {
@@ -2719,6 +4858,15 @@ void WorksheetPrivate::loadXmlSheetData(QXmlStreamReader &reader)
             const auto &a = reader.attributes();
 
             if (reader.name() == QLatin1String("row")) {
+                if (progress) {
+                    if (progress->isCanceled()) {
+                        reader.raiseError(QStringLiteral("Loading canceled"));
+                        return;
+                    }
+                    //the part size is in bytes, the reader reads the device ahead in chunks
+                    if (reader.device())
+                        progress->setPartProgress(reader.device()->pos());
+                }
                 currentRow++;
                 QSharedPointer<XlsxRowInfo> info(new XlsxRowInfo);
                 if (a.hasAttribute(QLatin1String("customFormat")) &&
@@ -2737,92 +4885,98 @@ void WorksheetPrivate::loadXmlSheetData(QXmlStreamReader &reader)
                 //"r" is optional too.
                 if (a.hasAttribute(QLatin1String("r")))
                     currentRow = a.value(QLatin1String("r")).toInt();
-                if (info->isValid())
-                    rowsInfo[currentRow] = info;
+                if (info->isValid()) {
+                    if (matcher) rowInfo = info;
+                    else rowsInfo[currentRow] = info;
+                }
+            }
+            else if (reader.name() == QLatin1String("c")) { //Cell
+                XlsxRawCell raw;
+                CellReference pos(a.value(QLatin1String("r")).toString());
+                raw.row = pos.row();
+                raw.column = pos.column();
+                if (!matcher) {
+                    readXmlCell(reader, raw);
+                    setCell(raw.row, raw.column, createLoadedCell(raw));
+                }
+                else if (!matcher->isLoaded(raw.column) && !matcher->isTested(raw.column)) {
+                    //the cell may be the master of a shared formula of the loaded cells
+                    readXmlCell(reader, raw);
+                }
+                else {
+                    readXmlCell(reader, raw);
+                    matcher->testCell(raw.column, raw.type, raw.value, raw.formula.has_value(),
+                                      raw.inlineString ? &raw.inlineString.value() : nullptr);
+                    if (matcher->isLoaded(raw.column))
+                        rowCells.append(raw);
+                }
             }
-            else if (reader.name() == QLatin1String("c"))  //Cell
-                loadXmlCell(reader);
+        }
+        else if (token == QXmlStreamReader::EndElement && reader.name() == QLatin1String("row")) {
+            if (matcher) finishRow(currentRow);
         }
         else if (token == QXmlStreamReader::EndElement && reader.name() == name)
             break;
     }
+
+    if (matcher) {
+        //the shared formulas whose master cell was dropped become single formulas
+        QList<int> orphans;
+        for (auto it = sharedFormulaMap.constBegin(); it != sharedFormulaMap.constEnd(); ++it) {
+            const CellReference master = it->reference().topLeft();
+            const auto rowIt = cellTable.constFind(master.row());
+            if (rowIt == cellTable.constEnd() || !rowIt->contains(master.column()))
+                orphans << it.key();
+        }
+        for (int sharedIndex: qAsConst(orphans))
+            unshareFormula(sharedIndex);
+
+        //the filter is applied once, and the stored dimension no longer fits
+        loadFilter = RowFilter();
+        dimension = CellRange();
+    }
 }
 
-void WorksheetPrivate::loadXmlCell(QXmlStreamReader &reader)
+/*!
+ * \internal
+ * Reads the c element into \a raw without creating a cell. The position of
+ * the cell should be set by the caller. The master cells of the shared formulas
+ * are recorded in sharedFormulaMap.
+ */
+void WorksheetPrivate::readXmlCell(QXmlStreamReader &reader, XlsxRawCell &raw)
 {
-    Q_Q(Worksheet);
-
     const auto &name = reader.name();
     const auto &a = reader.attributes();
 
-    CellReference pos(a.value(QLatin1String("r")).toString());
-
-    //get format
-    Format format;
-    qint32 styleIndex = -1;
-    if (a.hasAttribute(QLatin1String("s"))) {// Style (defined in the styles.xml file)
-        //"s" == style index
-        styleIndex = a.value(QLatin1String("s")).toInt();
-        format = workbook->styles()->xfFormat(styleIndex);
-    }
-
-    auto cellType = Cell::Type::Custom;
+    if (a.hasAttribute(QLatin1String("s"))) // Style (defined in the styles.xml file)
+        raw.styleIndex = a.value(QLatin1String("s")).toInt();
 
     if (a.hasAttribute(QLatin1String("t"))) {// Type
         auto typeString = a.value(QLatin1String("t")).toString();
-        Cell::fromString(typeString, cellType);
+        Cell::fromString(typeString, raw.type);
     }
 
-    if (Cell::isDateType(cellType, format)) cellType = Cell::Type::Date;
-
-    // create a heap of new cell
-    auto cell = std::make_shared<Cell>(QVariant{}, cellType, format, q, styleIndex);
-
     while (!reader.atEnd())    {
         auto token = reader.readNext();
         if (token == QXmlStreamReader::StartElement) {
             if (reader.name() == QLatin1String("f")) {// formula
                 CellFormula formula;
                 formula.loadFromXml(reader);
+                //the master of a shared formula is recorded even if the row filter
+                //drops its cell, the other cells of the group need its text
                 if (formula.type().value_or(CellFormula::Type::Normal) == CellFormula::Type::Shared
-                    && !formula.text().isEmpty()) {
-                    int si = formula.sharedIndex().value_or(-1);
-                    sharedFormulaMap[si] = formula;
-                }
-                cell->setFormula(formula);
+                    && !formula.text().isEmpty())
+                    sharedFormulaMap[formula.sharedIndex().value_or(-1)] = formula;
+                raw.formula = formula;
             }
             else if (reader.name() == QLatin1String("v")) {// Value
-                QString value = reader.readElementText();
-                if (cellType == Cell::Type::SharedString) {
-                    int sst_idx = value.toInt();
-                    sharedStrings()->incRefByStringIndex(sst_idx);
-                    RichString rs = sharedStrings()->getSharedString(sst_idx);
-                    QString strPlainString = rs.toPlainString();
-                    cell->setValue(strPlainString);
-                    if (rs.isRichString())
-                        cell->setRichString(rs);
-                }
-                else if (cellType == Cell::Type::Number) {
-                    cell->setValue(value.toDouble());
-                }
-                else if (cellType == Cell::Type::Boolean) {
-                    cell->setValue(fromST_Boolean(value));
-                }
-                else  if (cellType == Cell::Type::Date) {
-                    // [dev54] DateType
-
-                    double dValue = value.toDouble(); // days from 1900(or 1904)
-                    cell->setValue(dValue); // dev67
-                }
-                else {
-                    // ELSE type
-                    cell->setValue(value);
-                }
+                raw.value = reader.readElementText();
+                raw.hasValue = true;
             }
             else if (reader.name() == QLatin1String("is")) {
                 RichString rs;
                 rs.read(reader, QLatin1String("is"));
-                cell->setRichString(rs);
+                raw.inlineString = rs;
             }
             else if (reader.name() == QLatin1String("extLst"))
                 reader.skipCurrentElement();
@@ -2830,7 +4984,62 @@ void WorksheetPrivate::loadXmlCell(QXmlStreamReader &reader)
         else if (token == QXmlStreamReader::EndElement && reader.name() == name)
             break;
     }
-    cellTable[pos.row()][pos.column()] = cell;
+}
+
+/*!
+ * \internal
+ * Creates the cell from the data read by readXmlCell().
+ */
+std::shared_ptr<Cell> WorksheetPrivate::createLoadedCell(const XlsxRawCell &raw)
+{
+    Q_Q(Worksheet);
+
+    //get format
+    Format format;
+    if (raw.styleIndex >= 0)
+        format = workbook->styles()->xfFormat(raw.styleIndex);
+
+    auto cellType = raw.type;
+    if (Cell::isDateType(cellType, format)) cellType = Cell::Type::Date;
+
+    // create a heap of new cell
+    auto cell = std::make_shared<Cell>(QVariant{}, cellType, format, q, raw.styleIndex);
+
+    if (raw.formula.has_value())
+        cell->assignFormula(raw.formula.value());
+
+    if (raw.hasValue) {
+        const QString &value = raw.value;
+        if (cellType == Cell::Type::SharedString) {
+            int sst_idx = value.toInt();
+            sharedStrings()->incRefByStringIndex(sst_idx);
+            RichString rs = sharedStrings()->getSharedString(sst_idx);
+            QString strPlainString = rs.toPlainString();
+            cell->assignValue(strPlainString);
+            if (rs.isRichString())
+                cell->assignRichString(rs);
+        }
+        else if (cellType == Cell::Type::Number) {
+            cell->assignValue(value.toDouble());
+        }
+        else if (cellType == Cell::Type::Boolean) {
+            cell->assignValue(fromST_Boolean(value));
+        }
+        else  if (cellType == Cell::Type::Date) {
+            // [dev54] DateType
+
+            double dValue = value.toDouble(); // days from 1900(or 1904)
+            cell->assignValue(dValue); // dev67
+        }
+        else {
+            // ELSE type
+            cell->assignValue(value);
+        }
+    }
+
+    if (raw.inlineString.has_value())
+        cell->assignRichString(raw.inlineString.value());
+    return cell;
 }
 
 void WorksheetPrivate::loadXmlColumnsInfo(QXmlStreamReader &reader)
@@ -3031,6 +5240,9 @@ bool Worksheet::loadFromXmlFile(QIODevice *device)
         }
     }
 
+    if (auto progress = d->progress(); progress && progress->isCanceled())
+        return false;
+
     d->validateDimension();
     return true;
 }
@@ -3075,6 +5287,259 @@ SharedStrings *WorksheetPrivate::sharedStrings() const
     return workbook->sharedStrings();
 }
 
+/*!
+ * \internal
+ * Returns the shared strings table that the writers of this sheet add strings to.
+ * In the concurrent writing mode it is a table of this sheet, so that the sheets
+ * can be written from different threads.
+ */
+SharedStrings *WorksheetPrivate::stringRegistry()
+{
+    if (!workbook->isConcurrentWritingEnabled())
+        return workbook->sharedStrings();
+    if (!writerStrings)
+        writerStrings = std::make_shared<SharedStrings>(SharedStrings::F_NewFromScratch);
+    return writerStrings.get();
+}
+
+/*!
+ * \internal
+ * Registers \a format in the workbook styles. In the concurrent writing mode only
+ * records the format, the styles get it in mergeWriterRegistries().
+ */
+void WorksheetPrivate::registerFormat(const Format &format)
+{
+    if (!workbook->isConcurrentWritingEnabled()) {
+        workbook->styles()->addXfFormat(format);
+        return;
+    }
+    const QByteArray key = format.formatKey();
+    if (!writerFormatKeys.contains(key)) {
+        writerFormatKeys.insert(key);
+        writerFormats.append(format);
+    }
+}
+
+/*!
+ * \internal
+ * Moves the strings and formats written in the concurrent writing mode to the
+ * workbook shared strings and styles. New strings and formats get their indexes
+ * in the order they were first written, so the result does not depend on the
+ * timing of the writer threads if the sheets are merged in a fixed order.
+ *
+ * Cells keep their strings and formats, not indexes, so the shared strings need
+ * no remapping. The cells whose formats were created separately from the
+ * recorded ones with the same properties get their style indexes in one pass
+ * over the cell table.
+ */
+void WorksheetPrivate::mergeWriterRegistries()
+{
+    if (writerStrings) {
+        workbook->sharedStrings()->merge(*writerStrings);
+        writerStrings.reset();
+    }
+    if (writerFormats.isEmpty())
+        return;
+
+    Styles *styles = workbook->styles();
+    for (const auto &format : qAsConst(writerFormats))
+        styles->addXfFormat(format);
+    writerFormats.clear();
+    writerFormatKeys.clear();
+
+    auto addFormat = [styles](const Format &format) {
+        if (!format.isEmpty() && !format.xfIndexValid())
+            styles->addXfFormat(format);
+    };
+    for (const auto &row : qAsConst(cellTable)) {
+        for (const auto &cell : row)
+            addFormat(cell->format());
+    }
+    for (const auto &info : qAsConst(rowsInfo))
+        addFormat(info->format);
+    for (const auto &info : qAsConst(colsInfo))
+        addFormat(info.format);
+}
+
+/*!
+ * \internal
+ * Builds \a index from the items returned by \a collect unless it is valid.
+ * The const readers of a sheet may run on several threads, so the build is
+ * serialized and the index is published only once it is complete; a valid
+ * index is returned without a lock.
+ */
+template <typename Collect>
+static const RangeIndex &builtIndex(RangeIndex &index, Collect collect)
+{
+    if (!index.isValid()) {
+        static QMutex mutex;
+        QMutexLocker locker(&mutex);
+        if (!index.isValid())
+            index.build(collect());
+    }
+    return index;
+}
+
+/*!
+ * \internal
+ * Returns the spatial index of the merged cells. It is built on the first call
+ * after the merges were modified other than by mergeCells() and unmergeCells().
+ */
+const RangeIndex &WorksheetPrivate::mergeIndex() const
+{
+    return builtIndex(mergesIndex, [this] {
+        QVector<RangeIndex::Item> items;
+        items.reserve(merges.size());
+        for (int i = 0; i < merges.size(); ++i)
+            items.append(RangeIndex::Item {merges.at(i), i});
+        return items;
+    });
+}
+
+const RangeIndex &WorksheetPrivate::validationIndex() const
+{
+    return builtIndex(validationsIndex, [this] {
+        QVector<RangeIndex::Item> items;
+        for (int i = 0; i < dataValidationsList.size(); ++i) {
+            const auto ranges = dataValidationsList.at(i).ranges();
+            for (const CellRange &range : ranges)
+                items.append(RangeIndex::Item {range, i});
+        }
+        return items;
+    });
+}
+
+const RangeIndex &WorksheetPrivate::formattingIndex() const
+{
+    return builtIndex(formattingsIndex, [this] {
+        QVector<RangeIndex::Item> items;
+        for (int i = 0; i < conditionalFormattingList.size(); ++i) {
+            const auto ranges = conditionalFormattingList.at(i).ranges();
+            for (const CellRange &range : ranges)
+                items.append(RangeIndex::Item {range, i});
+        }
+        return items;
+    });
+}
+
+/*!
+ * \internal
+ * Drops the range indexes after the merges, validations or conditional
+ * formattings were modified in bulk; they are built again on the next query.
+ */
+void WorksheetPrivate::invalidateRangeIndexes()
+{
+    mergesIndex.reset();
+    validationsIndex.reset();
+    formattingsIndex.reset();
+}
+
+/*!
+ * \internal
+ * Moves the sheet data, taken over from a sheet of another workbook by
+ * snapshot(), to the styles, shared strings and media of this workbook. The remap tables
+ * are built while the data are copied, so each distinct format of the source
+ * is registered once, found later by its xf index in the source styles, and
+ * each picture is compared with the media of this workbook by its hash once.
+ * The strings of the sheet are collected in a table of their own, which is
+ * merged into the shared strings in one pass.
+ */
+void WorksheetPrivate::importData()
+{
+    Q_Q(Worksheet);
+
+    QVector<Format> xfFormats; //by the xf index in the source styles
+    QHash<QByteArray, Format> otherFormats; //the formats not registered in the source styles
+    auto importFormat = [&](const Format &format) {
+        if (format.isEmpty())
+            return Format();
+        Format *imported;
+        if (format.xfIndexValid()) {
+            if (format.xfIndex() >= xfFormats.size())
+                xfFormats.resize(format.xfIndex() + 1);
+            imported = &xfFormats[format.xfIndex()];
+        }
+        else
+            imported = &otherFormats[format.formatKey()];
+        if (!imported->isValid()) {
+            *imported = Styles::unregisteredFormat(format);
+            registerFormat(*imported);
+        }
+        return *imported;
+    };
+
+    //the cells, with the parent and the format of this sheet. The cells are still
+    //shared with the source sheet, which may be saved in another thread, so each
+    //one is copied; the table is detached once and its nodes are reused.
+    SharedStrings strings(SharedStrings::F_NewFromScratch);
+    for (auto rowIt = cellTable.begin(); rowIt != cellTable.end(); ++rowIt) {
+        for (auto it = rowIt->begin(); it != rowIt->end(); ++it) {
+            const Cell *cell = it.value().get();
+            auto imported = std::make_shared<Cell>(cell);
+            imported->setParent(q);
+            imported->assignFormat(importFormat(cell->format()));
+            if (cell->type() == Cell::Type::SharedString)
+                strings.addSharedString(cell->isRichString() ? cell->richString()
+                                                             : RichString(cell->value().toString()));
+            it.value() = std::move(imported);
+        }
+    }
+    cellsModified();
+    stringRegistry()->merge(strings);
+
+    for (auto it = rowsInfo.begin(); it != rowsInfo.end(); ++it) {
+        auto info = QSharedPointer<XlsxRowInfo>::create(*it.value());
+        info->format = importFormat(info->format);
+        it.value() = info;
+    }
+    //the row infos are not shared with the source any more
+    rowsInfoShared.storeRelease(0);
+    for (auto &info : colsInfo)
+        info.format = importFormat(info.format);
+
+    Styles *styles = workbook->styles();
+    for (auto &cf : conditionalFormattingList) {
+        for (auto &rule : cf.d->cfRules) {
+            auto imported = std::make_shared<XlsxCfRuleData>(*rule);
+            if (!rule->dxfFormat.isEmpty()) {
+                imported->dxfFormat = Styles::unregisteredFormat(rule->dxfFormat);
+                styles->addDxfFormat(imported->dxfFormat);
+            }
+            rule = imported;
+        }
+    }
+
+    //the pictures, by the hash of their contents
+    QHash<QByteArray, QSharedPointer<MediaFile> > media;
+    const auto mediaFiles = workbook->mediaFiles();
+    for (const auto &file : mediaFiles) {
+        if (auto mf = file.lock())
+            media.insert(mf->hashKey(), mf);
+    }
+    auto importMedia = [&](const QSharedPointer<MediaFile> &file) {
+        if (!file)
+            return file;
+        QSharedPointer<MediaFile> &imported = media[file->hashKey()];
+        if (!imported) {
+            imported = QSharedPointer<MediaFile>::create(file->contents(), file->suffix(), file->mimeType());
+            workbook->addMediaFile(imported, true);
+        }
+        return imported;
+    };
+    pictureFile = importMedia(pictureFile);
+    if (drawing) {
+        for (auto anchor : qAsConst(drawing->anchors)) {
+            if (anchor->isPicture())
+                anchor->setPictureFile(importMedia(anchor->pictureFile()));
+        }
+    }
+}
+
+ProgressControl *WorksheetPrivate::progress() const
+{
+    return workbook ? workbook->d_func()->progress : nullptr;
+}
+
 bool Worksheet::autosizeColumnsWidth(int firstColumn, int lastColumn)
 {
     CellRange r(1, firstColumn, INT_MAX, lastColumn);
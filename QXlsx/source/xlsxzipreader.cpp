@@ -27,8 +27,10 @@ void ZipReader::init()
 {
     const auto& allFiles = m_reader->fileInfoList();
     for (const auto &fi : allFiles) {
-        if (fi.isFile || (!fi.isDir && !fi.isFile && !fi.isSymLink))
+        if (fi.isFile || (!fi.isDir && !fi.isFile && !fi.isSymLink)) {
             m_filePaths.append(fi.filePath);
+            m_totalSize += fi.size;
+        }
     }
 }
 
@@ -47,4 +49,9 @@ QByteArray ZipReader::fileData(const QString &fileName) const
     return m_reader->fileData(fileName);
 }
 
+qint64 ZipReader::totalSize() const
+{
+    return m_totalSize;
+}
+
 }
@@ -4,45 +4,587 @@
 
 #include <QtGlobal>
 #include <QDebug>
-#include <private/qzipwriter_p.h>
+#include <QFile>
+#include <QDateTime>
+#include <QtEndian>
+
+#ifdef QXLSX_QT_ZLIB
+#  include <QtZlib/zlib.h>
+#else
+#  include <zlib.h>
+#endif
 
 namespace QXlsx {
 
-ZipWriter::ZipWriter(const QString &filePath)
+namespace {
+
+const quint32 LocalHeaderSignature = 0x04034b50;
+const quint32 DataDescriptorSignature = 0x08074b50;
+const quint32 CentralHeaderSignature = 0x02014b50;
+const quint32 Zip64EndOfDirectorySignature = 0x06064b50;
+const quint32 Zip64LocatorSignature = 0x07064b50;
+const quint32 EndOfDirectorySignature = 0x06054b50;
+
+const quint16 FlagDataDescriptor = 0x0008;
+const quint16 FlagUtf8 = 0x0800;
+
+const quint16 MethodStored = 0;
+const quint16 MethodDeflated = 8;
+
+const quint16 VersionDefault = 20;
+const quint16 VersionZip64 = 45;
+
+const quint16 Zip64ExtraId = 0x0001;
+
+const quint64 Max32 = 0xffffffffu;
+const quint64 Max16 = 0xffffu;
+
+//zlib functions take uInt lengths, so huge buffers are processed in chunks
+const qint64 MaxChunk = 1 << 30;
+
+//the compressed data of a streamed entry held before it is streamed with Zip64 sizes
+const int MaxPendingSize = 4 * 1024 * 1024;
+
+void appendUInt16(QByteArray &buffer, quint16 value)
 {
-    m_writer = new QZipWriter(filePath, QIODevice::WriteOnly);
-    m_writer->setCompressionPolicy(QZipWriter::AutoCompress);
+    char bytes[2];
+    qToLittleEndian(value, bytes);
+    buffer.append(bytes, 2);
 }
 
-ZipWriter::ZipWriter(QIODevice *device)
+void appendUInt32(QByteArray &buffer, quint32 value)
 {
-    m_writer = new QZipWriter(device);
-    m_writer->setCompressionPolicy(QZipWriter::AutoCompress);
+    char bytes[4];
+    qToLittleEndian(value, bytes);
+    buffer.append(bytes, 4);
+}
+
+void appendUInt64(QByteArray &buffer, quint64 value)
+{
+    char bytes[8];
+    qToLittleEndian(value, bytes);
+    buffer.append(bytes, 8);
+}
+
+quint32 updateCrc(quint32 crc, const char *data, qint64 size)
+{
+    while (size > 0) {
+        const uInt chunk = uInt(qMin(size, MaxChunk));
+        crc = quint32(crc32(crc, reinterpret_cast<const Bytef *>(data), chunk));
+        data += chunk;
+        size -= chunk;
+    }
+    return crc;
+}
+
+int zlibLevel(SaveOptions::Compression compression)
+{
+    switch (compression) {
+        case SaveOptions::Compression::Store: return Z_NO_COMPRESSION;
+        case SaveOptions::Compression::Fast: return Z_BEST_SPEED;
+        case SaveOptions::Compression::Default: return Z_DEFAULT_COMPRESSION;
+        case SaveOptions::Compression::Best: return Z_BEST_COMPRESSION;
+    }
+    return Z_DEFAULT_COMPRESSION;
+}
+
+}
+
+/*
+ * Raw deflate stream (no zlib header and trailer), as ZIP method 8 requires.
+ */
+class ZipDeflater
+{
+public:
+    explicit ZipDeflater(int level)
+    {
+        m_stream.zalloc = Z_NULL;
+        m_stream.zfree = Z_NULL;
+        m_stream.opaque = Z_NULL;
+        m_valid = deflateInit2(&m_stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~ZipDeflater()
+    {
+        if (m_valid)
+            deflateEnd(&m_stream);
+    }
+
+    // Compresses @a size bytes and appends the produced output to @a out.
+    // If @a finish is true, flushes the stream.
+    bool deflate(const char *data, qint64 size, bool finish, QByteArray &out)
+    {
+        if (!m_valid)
+            return false;
+
+        char buffer[16384];
+        do {
+            const uInt chunk = uInt(qMin(size, MaxChunk));
+            m_stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+            m_stream.avail_in = chunk;
+            data += chunk;
+            size -= chunk;
+            const int flush = (finish && size == 0) ? Z_FINISH : Z_NO_FLUSH;
+            do {
+                m_stream.next_out = reinterpret_cast<Bytef *>(buffer);
+                m_stream.avail_out = sizeof(buffer);
+                if (::deflate(&m_stream, flush) == Z_STREAM_ERROR)
+                    return false;
+                out.append(buffer, int(sizeof(buffer) - m_stream.avail_out));
+            } while (m_stream.avail_out == 0);
+        } while (size > 0);
+        return true;
+    }
+
+private:
+    z_stream m_stream;
+    bool m_valid;
+};
+
+/*
+ * Write-only device that feeds the current streamed entry of a ZipWriter.
+ * Small writes (QXmlStreamWriter writes element by element) are collected
+ * into a buffer of fixed size, so memory usage doesn't depend on the entry size.
+ */
+class ZipEntryDevice : public QIODevice
+{
+public:
+    explicit ZipEntryDevice(ZipWriter *writer) : m_writer(writer)
+    {
+        m_buffer.reserve(BufferSize);
+    }
+
+    bool isSequential() const override
+    {
+        return true;
+    }
+
+    void close() override
+    {
+        flush();
+        QIODevice::close();
+    }
+
+    bool flush()
+    {
+        if (m_buffer.isEmpty())
+            return true;
+        const bool ok = m_writer->writeData(m_buffer);
+        m_buffer.clear();
+        return ok;
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        Q_UNUSED(data);
+        Q_UNUSED(maxSize);
+        return -1;
+    }
+
+    qint64 writeData(const char *data, qint64 size) override
+    {
+        if (m_buffer.size() + size > BufferSize && !flush())
+            return -1;
+        if (size >= BufferSize)
+            return m_writer->writeData(data, size) ? size : -1;
+        m_buffer.append(data, int(size));
+        return size;
+    }
+
+private:
+    enum { BufferSize = 256 * 1024 };
+
+    ZipWriter *m_writer;
+    QByteArray m_buffer;
+};
+
+ZipWriter::ZipWriter(const QString &filePath, const SaveOptions &options)
+    : m_device(new QFile(filePath)), m_ownDevice(true), m_options(options)
+{
+    init();
+    m_error = !m_device->open(QIODevice::WriteOnly);
+}
+
+ZipWriter::ZipWriter(QIODevice *device, const SaveOptions &options)
+    : m_device(device), m_ownDevice(false), m_options(options)
+{
+    init();
+    m_error = !m_device || !m_device->isWritable();
+}
+
+void ZipWriter::init()
+{
+    m_streaming = false;
+    m_headerWritten = false;
+    m_offset = 0;
+    m_closed = false;
+
+    const QDateTime now = QDateTime::currentDateTime();
+    const QDate date = now.date();
+    const QTime time = now.time();
+    m_dosTime = quint16((time.hour() << 11) | (time.minute() << 5) | (time.second() / 2));
+    m_dosDate = quint16(((qMax(date.year(), 1980) - 1980) << 9) | (date.month() << 5) | date.day());
 }
 
 ZipWriter::~ZipWriter()
 {
-    delete m_writer;
+    if (!m_closed)
+        close();
+    if (m_ownDevice)
+        delete m_device;
 }
 
 bool ZipWriter::error() const
 {
-    return m_writer->status() != QZipWriter::NoError;
+    return m_error;
+}
+
+ZipWriter::Entry ZipWriter::createEntry(const QString &filePath) const
+{
+    Entry entry;
+    entry.name = filePath.toUtf8();
+    entry.flags = FlagUtf8;
+    entry.offset = m_offset;
+    return entry;
+}
+
+bool ZipWriter::writeRaw(const QByteArray &data)
+{
+    if (m_error)
+        return false;
+    if (data.isEmpty())
+        return true;
+    if (m_device->write(data) != data.size()) {
+        qDebug() << "ZipWriter: failed to write data:" << m_device->errorString();
+        m_error = true;
+        return false;
+    }
+    m_offset += quint64(data.size());
+    return true;
+}
+
+bool ZipWriter::writeLocalHeader(const Entry &entry)
+{
+    //the sizes of a streamed entry are unknown, so it always has the Zip64 extra
+    //field (with zeroes) to allow the 8 byte sizes in its data descriptor
+    const bool streamed = entry.flags & FlagDataDescriptor;
+    const bool zip64 = streamed || entry.compressedSize >= Max32 || entry.uncompressedSize >= Max32;
+
+    QByteArray header;
+    appendUInt32(header, LocalHeaderSignature);
+    appendUInt16(header, zip64 ? VersionZip64 : VersionDefault);
+    appendUInt16(header, entry.flags);
+    appendUInt16(header, entry.method);
+    appendUInt16(header, m_dosTime);
+    appendUInt16(header, m_dosDate);
+    //streamed entries have zeroes here, the real values are in the data descriptor
+    appendUInt32(header, entry.crc);
+    appendUInt32(header, quint32(zip64 ? Max32 : entry.compressedSize));
+    appendUInt32(header, quint32(zip64 ? Max32 : entry.uncompressedSize));
+    appendUInt16(header, quint16(entry.name.size()));
+    appendUInt16(header, zip64 ? 20 : 0);
+    header.append(entry.name);
+    if (zip64) {
+        appendUInt16(header, Zip64ExtraId);
+        appendUInt16(header, 16);
+        appendUInt64(header, entry.uncompressedSize);
+        appendUInt64(header, entry.compressedSize);
+    }
+    return writeRaw(header);
 }
 
 void ZipWriter::addFile(const QString &filePath, QIODevice *device)
 {
-    m_writer->addFile(filePath, device);
+    if (!device)
+        return;
+    bool opened = false;
+    if (!device->isOpen()) {
+        if (!device->open(QIODevice::ReadOnly)) {
+            qDebug() << "ZipWriter: cannot open device for" << filePath;
+            return;
+        }
+        opened = true;
+    }
+
+    if (beginFile(filePath)) {
+        char buffer[16384];
+        while (!m_error) {
+            const qint64 read = device->read(buffer, sizeof(buffer));
+            if (read <= 0)
+                break;
+            writeData(buffer, read);
+        }
+        endFile();
+    }
+
+    if (opened)
+        device->close();
+}
+
+ZipWriter::CompressedData ZipWriter::compress(const QByteArray &data, SaveOptions::Compression compression)
+{
+    CompressedData result;
+    result.compression = compression;
+    result.uncompressedSize = quint64(data.size());
+    result.crc = updateCrc(quint32(crc32(0, Z_NULL, 0)), data.constData(), data.size());
+
+    QByteArray compressed;
+    if (compression != SaveOptions::Compression::Store) {
+        ZipDeflater deflater(zlibLevel(compression));
+        if (!deflater.deflate(data.constData(), data.size(), true, compressed))
+            compressed.clear();
+    }
+
+    //store data as is if deflate doesn't make it smaller, f.e. for PNG images
+    const bool deflated = !compressed.isEmpty() && compressed.size() < data.size();
+    result.method = deflated ? MethodDeflated : MethodStored;
+    result.data = deflated ? compressed : data;
+    return result;
 }
 
 void ZipWriter::addFile(const QString &filePath, const QByteArray &data)
 {
-    m_writer->addFile(filePath, data);
+    if (m_error || m_closed)
+        return;
+    addCompressedFile(filePath, compress(data, m_options.partCompression(filePath)));
+}
+
+void ZipWriter::addCompressedFile(const QString &filePath, const CompressedData &data)
+{
+    if (m_error || m_closed)
+        return;
+    if (m_streaming)
+        endFile();
+
+    Entry entry = createEntry(filePath);
+    entry.method = data.method;
+    entry.crc = data.crc;
+    entry.uncompressedSize = data.uncompressedSize;
+    entry.compressedSize = quint64(data.data.size());
+
+    if (writeLocalHeader(entry) && writeRaw(data.data))
+        m_entries.append(entry);
+}
+
+void ZipWriter::addFile(const QString &filePath, const std::function<void (QIODevice *)> &writeFunc)
+{
+    if (!beginFile(filePath))
+        return;
+
+    ZipEntryDevice device(this);
+    device.open(QIODevice::WriteOnly);
+    writeFunc(&device);
+    device.close();
+
+    endFile();
+}
+
+bool ZipWriter::beginFile(const QString &filePath)
+{
+    if (m_error || m_closed)
+        return false;
+    if (m_streaming)
+        endFile();
+
+    m_current = createEntry(filePath);
+    m_current.flags |= FlagDataDescriptor;
+    m_current.crc = quint32(crc32(0, Z_NULL, 0));
+
+    const auto compression = m_options.partCompression(filePath);
+    if (compression == SaveOptions::Compression::Store) {
+        m_current.method = MethodStored;
+        m_deflater.reset();
+    }
+    else {
+        m_current.method = MethodDeflated;
+        m_deflater.reset(new ZipDeflater(zlibLevel(compression)));
+    }
+
+    //the local header is written when the data exceeds MaxPendingSize or ends
+    m_pending.clear();
+    m_headerWritten = false;
+    m_streaming = true;
+    return true;
+}
+
+// Writes the compressed @a data of the streamed entry, or holds it until the
+// entry ends while the data of the entry fits in MaxPendingSize.
+bool ZipWriter::writeEntryData(const QByteArray &data)
+{
+    if (!m_headerWritten) {
+        if (m_pending.size() + qint64(data.size()) <= MaxPendingSize) {
+            m_pending.append(data);
+            return true;
+        }
+        //crc and sizes are unknown yet
+        Entry header = m_current;
+        header.crc = 0;
+        header.compressedSize = 0;
+        header.uncompressedSize = 0;
+        m_headerWritten = true;
+        if (!writeLocalHeader(header) || !writeRaw(m_pending))
+            return false;
+        m_pending.clear();
+    }
+    return writeRaw(data);
+}
+
+bool ZipWriter::writeData(const char *data, qint64 size)
+{
+    if (!m_streaming || m_error)
+        return false;
+    if (size <= 0)
+        return true;
+
+    m_current.crc = updateCrc(m_current.crc, data, size);
+    m_current.uncompressedSize += quint64(size);
+
+    if (!m_deflater) {
+        m_current.compressedSize += quint64(size);
+        return writeEntryData(QByteArray::fromRawData(data, int(size)));
+    }
+
+    QByteArray compressed;
+    if (!m_deflater->deflate(data, size, false, compressed)) {
+        m_error = true;
+        return false;
+    }
+    m_current.compressedSize += quint64(compressed.size());
+    return writeEntryData(compressed);
+}
+
+bool ZipWriter::writeData(const QByteArray &data)
+{
+    return writeData(data.constData(), data.size());
+}
+
+bool ZipWriter::endFile()
+{
+    if (!m_streaming)
+        return false;
+    m_streaming = false;
+
+    if (m_deflater) {
+        QByteArray compressed;
+        if (!m_deflater->deflate(nullptr, 0, true, compressed))
+            m_error = true;
+        m_current.compressedSize += quint64(compressed.size());
+        writeEntryData(compressed);
+        m_deflater.reset();
+    }
+
+    //a small entry is written as a whole, without a data descriptor
+    if (!m_headerWritten) {
+        m_current.flags &= quint16(~FlagDataDescriptor);
+        const bool written = writeLocalHeader(m_current) && writeRaw(m_pending);
+        m_pending.clear();
+        if (written)
+            m_entries.append(m_current);
+        return written;
+    }
+
+    //data descriptor, sizes are 8 bytes long as the local header has the Zip64 extra field
+    QByteArray descriptor;
+    appendUInt32(descriptor, DataDescriptorSignature);
+    appendUInt32(descriptor, m_current.crc);
+    appendUInt64(descriptor, m_current.compressedSize);
+    appendUInt64(descriptor, m_current.uncompressedSize);
+    if (!writeRaw(descriptor))
+        return false;
+
+    m_entries.append(m_current);
+    return true;
+}
+
+bool ZipWriter::writeCentralDirectory()
+{
+    const quint64 directoryOffset = m_offset;
+
+    for (const Entry &entry : qAsConst(m_entries)) {
+        //Zip64 extra field contains only the values that overflow, in this order
+        QByteArray extra;
+        if (entry.uncompressedSize >= Max32)
+            appendUInt64(extra, entry.uncompressedSize);
+        if (entry.compressedSize >= Max32)
+            appendUInt64(extra, entry.compressedSize);
+        if (entry.offset >= Max32)
+            appendUInt64(extra, entry.offset);
+        const bool zip64 = !extra.isEmpty();
+        const bool needsZip64 = zip64 || (entry.flags & FlagDataDescriptor);
+
+        QByteArray header;
+        appendUInt32(header, CentralHeaderSignature);
+        appendUInt16(header, needsZip64 ? VersionZip64 : VersionDefault); //made by MS-DOS
+        appendUInt16(header, needsZip64 ? VersionZip64 : VersionDefault);
+        appendUInt16(header, entry.flags);
+        appendUInt16(header, entry.method);
+        appendUInt16(header, m_dosTime);
+        appendUInt16(header, m_dosDate);
+        appendUInt32(header, entry.crc);
+        appendUInt32(header, quint32(qMin(entry.compressedSize, Max32)));
+        appendUInt32(header, quint32(qMin(entry.uncompressedSize, Max32)));
+        appendUInt16(header, quint16(entry.name.size()));
+        appendUInt16(header, zip64 ? quint16(extra.size() + 4) : 0);
+        appendUInt16(header, 0); //comment length
+        appendUInt16(header, 0); //disk number
+        appendUInt16(header, 0); //internal attributes
+        appendUInt32(header, 0); //external attributes
+        appendUInt32(header, quint32(qMin(entry.offset, Max32)));
+        header.append(entry.name);
+        if (zip64) {
+            appendUInt16(header, Zip64ExtraId);
+            appendUInt16(header, quint16(extra.size()));
+            header.append(extra);
+        }
+        if (!writeRaw(header))
+            return false;
+    }
+
+    const quint64 directorySize = m_offset - directoryOffset;
+    const quint64 count = quint64(m_entries.size());
+
+    QByteArray end;
+    if (count >= Max16 || directorySize >= Max32 || directoryOffset >= Max32) {
+        const quint64 zip64EndOffset = m_offset;
+        appendUInt32(end, Zip64EndOfDirectorySignature);
+        appendUInt64(end, 44); //size of the remaining record
+        appendUInt16(end, VersionZip64);
+        appendUInt16(end, VersionZip64);
+        appendUInt32(end, 0); //this disk
+        appendUInt32(end, 0); //disk with the central directory
+        appendUInt64(end, count);
+        appendUInt64(end, count);
+        appendUInt64(end, directorySize);
+        appendUInt64(end, directoryOffset);
+
+        appendUInt32(end, Zip64LocatorSignature);
+        appendUInt32(end, 0); //disk with the zip64 end of central directory
+        appendUInt64(end, zip64EndOffset);
+        appendUInt32(end, 1); //total number of disks
+    }
+    appendUInt32(end, EndOfDirectorySignature);
+    appendUInt16(end, 0); //this disk
+    appendUInt16(end, 0); //disk with the central directory
+    appendUInt16(end, quint16(qMin(count, Max16)));
+    appendUInt16(end, quint16(qMin(count, Max16)));
+    appendUInt32(end, quint32(qMin(directorySize, Max32)));
+    appendUInt32(end, quint32(qMin(directoryOffset, Max32)));
+    appendUInt16(end, 0); //comment length
+    return writeRaw(end);
 }
 
 void ZipWriter::close()
 {
-    m_writer->close();
+    if (m_closed)
+        return;
+    if (m_streaming)
+        endFile();
+    if (!m_error)
+        writeCentralDirectory();
+    m_closed = true;
+
+    if (m_ownDevice)
+        m_device->close();
 }
 
 }
@@ -0,0 +1,28 @@
+# ConcurrentReaders.pro
+ 
+TARGET = ConcurrentReaders
+TEMPLATE = app
+
+QT += core
+
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# CONFIG += tsan # run the readers under the thread sanitizer
+tsan {
+    QMAKE_CXXFLAGS += -fsanitize=thread -g
+    QMAKE_LFLAGS += -fsanitize=thread
+}
+
+##########################################################################
+# NOTE: Here you can change path to QXlsx sources
+
+QXLSX_PARENTPATH=../../QXlsx/
+QXLSX_HEADERPATH=$${QXLSX_PARENTPATH}header/ # should be path to QXlsx/header directory
+QXLSX_SOURCEPATH=$${QXLSX_PARENTPATH}source/ # should be path to QXlsx/source directory
+
+include($${QXLSX_PARENTPATH}QXlsx.pri)
+
+SOURCES += main.cpp
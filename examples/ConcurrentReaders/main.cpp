@@ -0,0 +1,137 @@
+// main.cpp
+
+// Several threads read one loaded document at the same time: the cell values,
+// the keys of the cell formats and the rich strings, the merged ranges and a
+// cell index. The keys and the indexes are built lazily by the first reader.
+// Build with -DQXLSX_TSAN=ON (qmake: CONFIG+=tsan) to check the readers with
+// the thread sanitizer.
+
+#include <QCoreApplication>
+#include <QBuffer>
+#include <QColor>
+#include <QDebug>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "xlsxdocument.h"
+#include "xlsxworksheet.h"
+#include "xlsxcell.h"
+#include "xlsxcellindex.h"
+#include "xlsxcellrange.h"
+#include "xlsxformat.h"
+#include "xlsxrichstring.h"
+
+using namespace QXlsx;
+
+static const int rowCount = 2000;
+static const int threadCount = 8;
+static const int roundCount = 4;
+
+static QString plainText(int row) { return QStringLiteral("text %1").arg(row % 100); }
+static QString richText(int row) { return QStringLiteral("rich %1 string").arg(row); }
+
+// Writes the test document: numbers, strings and rich strings with many formats.
+static QByteArray createDocument()
+{
+    Document doc;
+    Worksheet *sheet = doc.activeWorksheet();
+    Format bold;
+    bold.setFontBold(true);
+    for (int row = 1; row <= rowCount; ++row) {
+        Format format;
+        format.setFontBold(row % 2);
+        format.setFontColor(QColor::fromRgb(row % 256, 0, 0));
+        format.setPatternBackgroundColor(QColor::fromRgb(0, row % 256, 0));
+        sheet->write(row, 1, row, format);
+        sheet->write(row, 2, plainText(row), format);
+
+        RichString rich;
+        rich.addFragment(QStringLiteral("rich %1 ").arg(row), bold);
+        rich.addFragment(QStringLiteral("string"), format);
+        sheet->writeString(row, 3, rich);
+
+        if (row % 10 == 1)
+            sheet->mergeCells(CellRange(row, 4, row + 1, 5));
+    }
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+    if (!doc.saveAs(&buffer))
+        return QByteArray();
+    return bytes;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QByteArray bytes = createDocument();
+    if (bytes.isEmpty()) {
+        qDebug() << "[error] failed to write xlsx document";
+        return 1;
+    }
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::ReadOnly);
+    Document doc(&buffer);
+    if (!doc.isLoaded()) {
+        qDebug() << "[error] failed to load xlsx document";
+        return 1;
+    }
+
+    // The index is stale when the readers start, so they race to rebuild it.
+    Worksheet *writer = doc.activeWorksheet();
+    CellIndex index = writer->buildIndex(CellRange(1, 1, rowCount, 1));
+    writer->write(1, 1, 1);
+    const Worksheet *sheet = writer;
+
+    std::atomic<int> failures {0};
+    std::vector<quint64> checksums(threadCount, 0);
+    auto readCells = [&](int thread) {
+        quint64 checksum = 0;
+        for (int round = 0; round < roundCount; ++round) {
+            for (int i = 0; i < rowCount; ++i) {
+                // each thread starts at a different row
+                const int row = 1 + (i + thread * rowCount / threadCount) % rowCount;
+                if (sheet->read(row, 1).toInt() != row || sheet->read(row, 2).toString() != plainText(row))
+                    ++failures;
+
+                const Cell *number = sheet->cell(row, 1);
+                const Cell *rich = sheet->cell(row, 3);
+                if (!number || !rich || rich->richString().toPlainString() != richText(row)) {
+                    ++failures;
+                    continue;
+                }
+                const Format format = number->format();
+                checksum += qHash(format.formatKey()) + qHash(format.fontKey()) + qHash(format.fillKey());
+                checksum += qHash(rich->richString());
+
+                const bool merged = row % 10 == 1 || row % 10 == 2;
+                if (sheet->mergedRange(CellReference(row, 4)).isValid() != merged)
+                    ++failures;
+                if (index.find(row) != row)
+                    ++failures;
+            }
+        }
+        checksums[thread] = checksum;
+    };
+
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < threadCount; ++thread)
+        threads.emplace_back(readCells, thread);
+    for (std::thread &thread : threads)
+        thread.join();
+
+    for (int thread = 1; thread < threadCount; ++thread) {
+        if (checksums[thread] != checksums[0])
+            ++failures;
+    }
+    if (failures > 0) {
+        qDebug() << "[error]" << failures.load() << "failed reads";
+        return 1;
+    }
+    qDebug() << "[debug]" << threadCount << "threads read" << rowCount << "rows" << roundCount << "times";
+    return 0;
+}
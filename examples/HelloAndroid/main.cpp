@@ -68,10 +68,17 @@ int main(int argc, char *argv[])
 
     DynArray2D< std::string > dynIntArray(maxCol, maxRow);
 
-    for (int row = 0; row < maxRow; row++)  {
-        for (int col = 0; col < maxCol; col++) {
-            auto val = wsheet->read(row + wsheet->dimension().firstRow(),
-                                    col + wsheet->dimension().firstColumn()).toString();
+    // visit only non-empty cells
+    const CellRange dim = wsheet->dimension();
+    for (const RowView &rowView : wsheet->rows(dim))  {
+        const int row = rowView.row() - dim.firstRow();
+        if (row >= maxRow)
+            break;
+        for (const CellView &cell : rowView.cells()) {
+            const int col = cell.column() - dim.firstColumn();
+            if (col >= maxCol)
+                break;
+            auto val = wsheet->read(cell.row(), cell.column()).toString();
             // set string value to (col, row)
             dynIntArray.setValue( col, row, val.toStdString() );
         }